@@ -161,6 +161,28 @@ VLC_API block_t *block_Init(block_t *block,
  */
 VLC_API block_t *block_Alloc(size_t size) VLC_USED VLC_MALLOC;
 
+/**
+ * Block allocator statistics.
+ *
+ * Small blocks allocated with block_Alloc() are recycled through per-thread
+ * caches of common sizes, which exchange batches of blocks through a shared
+ * depot. These counters cover those blocks only.
+ */
+struct vlc_block_pool_stats
+{
+    uint64_t allocs; /**< pooled allocations */
+    uint64_t hits; /**< pooled allocations served from a cache */
+    uint64_t releases; /**< pooled releases */
+    uint64_t recycled; /**< pooled releases kept in a cache */
+};
+
+/**
+ * Gets the block allocator statistics.
+ *
+ * @param stats structure to fill with the counters of all threads [OUT]
+ */
+VLC_API void block_PoolGetStats(struct vlc_block_pool_stats *stats);
+
 VLC_API block_t *block_TryRealloc(block_t *, ssize_t pre, size_t body) VLC_USED;
 
 /**
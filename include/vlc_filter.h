@@ -26,6 +26,7 @@
 #define VLC_FILTER_H 1
 
 #include <vlc_es.h>
+#include <vlc_block.h>
 
 /**
  * \defgroup filter Filters
@@ -36,9 +37,22 @@
  * Filter modules interface
  */
 
+/**
+ * Callback processing a band of lines of a picture
+ *
+ * \param filter the filter
+ * \param opaque the data passed to filter_RunSlices()
+ * \param first the first line of the band
+ * \param count the number of lines of the band
+ */
+typedef void (*filter_slice_cb)(filter_t *filter, void *opaque,
+                                unsigned first, unsigned count);
+
 struct filter_video_callbacks
 {
     picture_t *(*buffer_new)(filter_t *);
+    /** Run a slice callback over bands of lines (optional) */
+    void (*run_slices)(filter_t *, filter_slice_cb, void *, unsigned);
 };
 
 struct filter_subpicture_callbacks
@@ -46,12 +60,18 @@ struct filter_subpicture_callbacks
     subpicture_t *(*buffer_new)(filter_t *);
 };
 
+struct filter_audio_callbacks
+{
+    block_t *(*buffer_new)(filter_t *, size_t);
+};
+
 typedef struct filter_owner_t
 {
     union
     {
         const struct filter_video_callbacks *video;
         const struct filter_subpicture_callbacks *sub;
+        const struct filter_audio_callbacks *audio;
     };
     void *sys;
 } filter_owner_t;
@@ -169,6 +189,92 @@ static inline picture_t *filter_NewPicture( filter_t *p_filter )
     return pic;
 }
 
+/**
+ * This function will return a new block usable by an audio filter as an
+ * output buffer, with i_buffer set to the requested size. You have to release
+ * it using block_Release or by returning it to the caller as a
+ * pf_audio_filter return value.
+ *
+ * The buffer comes from the pool of the filter owner if it provides one,
+ * so that steady state processing does not hit the heap.
+ *
+ * \param p_filter filter_t object
+ * \param i_size size of the output in bytes
+ * \return new block on success or NULL on failure
+ */
+static inline block_t *filter_NewAudioBuffer( filter_t *p_filter,
+                                              size_t i_size )
+{
+    const struct filter_audio_callbacks *cbs = p_filter->owner.audio;
+    block_t *p_block;
+
+    if( cbs != NULL && cbs->buffer_new != NULL )
+        p_block = cbs->buffer_new( p_filter, i_size );
+    else
+        p_block = block_Alloc( i_size );
+    if( p_block == NULL )
+        msg_Warn( p_filter, "can't get output buffer" );
+    return p_block;
+}
+
+/**
+ * This function returns an output buffer for an audio filter that can
+ * process in place: the input block itself if its storage can hold i_size
+ * bytes from its payload start, otherwise a block from
+ * filter_NewAudioBuffer(). Either way i_buffer is set to i_size.
+ *
+ * The filter must not write an output byte before reading the input bytes
+ * it overwrites, e.g. it converts to wider samples from the end. It must
+ * only release the input if the returned block is another one.
+ *
+ * \param p_filter filter_t object
+ * \param p_in input block
+ * \param i_size size of the output in bytes
+ * \return the input or a new block on success, or NULL on failure
+ */
+static inline block_t *filter_ReuseAudioBuffer( filter_t *p_filter,
+                                                block_t *p_in, size_t i_size )
+{
+    if( (size_t)(p_in->p_start + p_in->i_size - p_in->p_buffer) >= i_size )
+    {
+        p_in->i_buffer = i_size;
+        return p_in;
+    }
+
+    block_t *p_out = filter_NewAudioBuffer( p_filter, i_size );
+    if( p_out != NULL )
+        block_CopyProperties( p_out, p_in );
+    return p_out;
+}
+
+/**
+ * Run a slice callback over all the lines of a picture.
+ *
+ * The callback is called for disjoint bands of lines covering [0, lines),
+ * possibly concurrently from several threads, if the filter owner provides
+ * a pool of threads. Otherwise, the whole range is run in a single call.
+ * The function returns once all the bands have been processed.
+ *
+ * A video filter can use this for its row-independent processing: each
+ * output line must only depend on the input picture and on state that is
+ * not modified by the callback.
+ *
+ * \param p_filter filter_t object
+ * \param cb callback processing a band of lines
+ * \param opaque data passed to the callback
+ * \param lines number of lines to process
+ */
+static inline void filter_RunSlices( filter_t *p_filter, filter_slice_cb cb,
+                                     void *opaque, unsigned lines )
+{
+    const struct filter_video_callbacks *cbs = p_filter->owner.video;
+
+    if( cbs != NULL && cbs->run_slices != NULL )
+        cbs->run_slices( p_filter, cb, opaque, lines );
+    else
+        cb( p_filter, opaque, 0, lines );
+}
+
 /**
  * Flush a filter
  *
@@ -299,6 +405,37 @@ VLC_API void filter_DeleteBlend( filter_t * );
         return p_outpic;                                                \
     }
 
+/**
+ * Create a picture_t *(*)( filter_t *, picture_t * ) compatible wrapper
+ * using a void (*)( filter_t *, picture_t *, picture_t *, unsigned,
+ * unsigned ) function converting a band of lines, run with
+ * filter_RunSlices() over all the lines of the input format
+ *
+ * Currently used by the chroma video filters
+ */
+#define VIDEO_FILTER_WRAPPER_SLICED( name )                             \
+    static void name ## _Slice ( filter_t *p_filter, void *opaque,      \
+                                 unsigned first, unsigned count )       \
+    {                                                                   \
+        picture_t **pp_pics = opaque;                                   \
+        name( p_filter, pp_pics[0], pp_pics[1], first, count );         \
+    }                                                                   \
+    static picture_t *name ## _Filter ( filter_t *p_filter,             \
+                                        picture_t *p_pic )              \
+    {                                                                   \
+        picture_t *p_outpic = filter_NewPicture( p_filter );            \
+        if( p_outpic )                                                  \
+        {                                                               \
+            picture_t *pp_pics[2] = { p_pic, p_outpic };                \
+            filter_RunSlices( p_filter, name ## _Slice, pp_pics,        \
+                              p_filter->fmt_in.video.i_y_offset         \
+                            + p_filter->fmt_in.video.i_visible_height );\
+            picture_CopyProperties( p_outpic, p_pic );                  \
+        }                                                               \
+        picture_Release( p_pic );                                       \
+        return p_outpic;                                                \
+    }
+
 /**
  * Filter chain management API
  * The filter chain management API is used to dynamically construct filters
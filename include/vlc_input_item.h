@@ -433,6 +433,18 @@ struct input_stats_t
     /* Vout */
     int64_t i_displayed_pictures;
     int64_t i_lost_pictures;
+    int64_t i_late_pictures; /**< displayed after their deadline */
+
+    /** Vout per-frame timing distributions (median and 99th percentile) */
+    struct input_stats_timing
+    {
+        vlc_tick_t p50;
+        vlc_tick_t p99;
+    } vout_queue,   /**< margin before the deadline out of the decoder */
+      vout_filter,  /**< filter chains */
+      vout_prepare, /**< subpicture rendering and display preparation */
+      vout_display, /**< display call */
+      vout_jitter;  /**< display start against the deadline */
 
     /* Aout */
     int64_t i_played_abuffers;
@@ -38,6 +38,10 @@
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
+#ifdef HAVE_RECVMMSG
+# include <time.h>
+# include <sys/socket.h>
+#endif
 
 #include "rtp.h"
 #ifdef HAVE_SRTP
@@ -100,6 +104,163 @@ static int rtp_timeout (vlc_tick_t deadline)
     return t;
 }
 
+#ifdef HAVE_RECVMMSG
+/**
+ * Receive buffers for batched datagram reception
+ */
+struct rtp_batch
+{
+    unsigned       size; /**< number of datagrams received at once */
+    size_t         mru;
+    bool           timestamps; /**< kernel receive timestamps enabled */
+    block_t       *blockv[RTP_BATCH_MAX];
+    struct iovec   iovv[RTP_BATCH_MAX];
+    struct mmsghdr msgv[RTP_BATCH_MAX];
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof (struct timespec))];
+    } ctlv[RTP_BATCH_MAX];
+};
+
+static void rtp_batch_release (void *data)
+{
+    struct rtp_batch *batch = data;
+
+    for (unsigned i = 0; i < batch->size; i++)
+        if (batch->blockv[i] != NULL)
+        {
+            block_Release (batch->blockv[i]);
+            batch->blockv[i] = NULL;
+        }
+}
+
+/**
+ * Converts a kernel (real-time) receive timestamp to the VLC clock.
+ */
+static vlc_tick_t rtp_batch_timestamp (const struct msghdr *msg,
+                                       vlc_tick_t now, vlc_tick_t now_real)
+{
+#ifdef SCM_TIMESTAMPNS
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (msg);
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR ((struct msghdr *)msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET
+         || cmsg->cmsg_type != SCM_TIMESTAMPNS)
+            continue;
+
+        struct timespec ts;
+        memcpy (&ts, CMSG_DATA (cmsg), sizeof (ts));
+
+        vlc_tick_t age = now_real - vlc_tick_from_timespec (&ts);
+        return (age > 0) ? now - age : now;
+    }
+#else
+    VLC_UNUSED(msg); VLC_UNUSED(now_real);
+#endif
+    return now;
+}
+
+/**
+ * Receives all pending datagrams (up to the batch size) with one system call.
+ *
+ * @return false if the receive buffers cannot be allocated at all
+ */
+static bool rtp_batch_recv (demux_t *demux, int fd, struct rtp_batch *batch)
+{
+    unsigned count;
+
+    /* (Re)fill the receive buffers */
+    for (count = 0; count < batch->size; count++)
+    {
+        if (batch->blockv[count] == NULL)
+        {
+            batch->blockv[count] = block_Alloc (batch->mru);
+            if (unlikely(batch->blockv[count] == NULL))
+                break;
+        }
+
+        struct msghdr *msg = &batch->msgv[count].msg_hdr;
+
+        batch->iovv[count].iov_base = batch->blockv[count]->p_buffer;
+        batch->iovv[count].iov_len = batch->mru;
+        memset (msg, 0, sizeof (*msg));
+        msg->msg_iov = &batch->iovv[count];
+        msg->msg_iovlen = 1;
+        if (batch->timestamps)
+        {
+            msg->msg_control = batch->ctlv[count].buf;
+            msg->msg_controllen = sizeof (batch->ctlv[count].buf);
+        }
+    }
+
+    if (unlikely(count == 0))
+    {
+        if (batch->mru == DEFAULT_MRU)
+            return false; /* we are totallly screwed */
+        batch->mru = DEFAULT_MRU; /* retry with shrunk MRU */
+        return true;
+    }
+
+    int n = recvmmsg (fd, batch->msgv, count, MSG_DONTWAIT | MSG_TRUNC, NULL);
+    if (n == -1)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            msg_Warn (demux, "RTP network error: %s", vlc_strerror_c(errno));
+        return true;
+    }
+
+    vlc_tick_t now = vlc_tick_now (), now_real = VLC_TICK_INVALID;
+    if (batch->timestamps)
+    {
+        struct timespec ts;
+
+        if (clock_gettime (CLOCK_REALTIME, &ts) == 0)
+            now_real = vlc_tick_from_timespec (&ts);
+    }
+
+    size_t mru = batch->mru;
+
+    for (int i = 0; i < n; i++)
+    {
+        block_t *block = batch->blockv[i];
+        const struct msghdr *msg = &batch->msgv[i].msg_hdr;
+        size_t len = batch->msgv[i].msg_len;
+
+        if (msg->msg_flags & MSG_TRUNC)
+        {
+            msg_Err(demux, "%zu bytes packet truncated (MRU was %zu)",
+                    len, batch->mru);
+            block->i_flags |= BLOCK_FLAG_CORRUPTED;
+            if (len > mru)
+                mru = len;
+        }
+        else
+            block->i_buffer = len;
+
+        /* Reception time, for jitter estimation */
+        if (now_real != VLC_TICK_INVALID)
+            block->i_dts = rtp_batch_timestamp (msg, now, now_real);
+
+        rtp_process (demux, block);
+    }
+
+    /* Keep the unused buffers for the next time */
+    memmove (batch->blockv, batch->blockv + n,
+             (batch->size - n) * sizeof (batch->blockv[0]));
+    for (unsigned i = batch->size - n; i < batch->size; i++)
+        batch->blockv[i] = NULL;
+
+    if (mru != batch->mru)
+    {   /* Spare buffers are too small now */
+        rtp_batch_release (batch);
+        batch->mru = mru;
+    }
+    return true;
+}
+#endif
+
 /**
  * RTP/RTCP session thread for datagram sockets
  */
@@ -109,11 +270,26 @@ void *rtp_dgram_thread (void *opaque)
     demux_sys_t *sys = demux->p_sys;
     vlc_tick_t deadline = VLC_TICK_INVALID;
     int rtp_fd = sys->fd;
-#ifdef __linux__
-    const int trunc_flag = MSG_TRUNC;
+#ifdef HAVE_RECVMMSG
+    struct rtp_batch batch =
+    {
+        .size = sys->batch,
+        .mru = DEFAULT_MRU,
+        .timestamps = false,
+    };
+
+    for (unsigned i = 0; i < batch.size; i++)
+        batch.blockv[i] = NULL;
+# ifdef SO_TIMESTAMPNS
+    batch.timestamps = setsockopt (rtp_fd, SOL_SOCKET, SO_TIMESTAMPNS,
+                                   &(int){ 1 }, sizeof (int)) == 0;
+# endif
 #else
+# ifdef __linux__
+    const int trunc_flag = MSG_TRUNC;
+# else
     const int trunc_flag = 0;
-#endif
+# endif
 
     struct iovec iov =
     {
@@ -124,11 +300,15 @@ void *rtp_dgram_thread (void *opaque)
         .msg_iov = &iov,
         .msg_iovlen = 1,
     };
+#endif
 
     struct pollfd ufd[1];
     ufd[0].fd = rtp_fd;
     ufd[0].events = POLLIN;
 
+#ifdef HAVE_RECVMMSG
+    vlc_cleanup_push (rtp_batch_release, &batch);
+#endif
     for (;;)
     {
         int n = poll (ufd, 1, rtp_timeout (deadline));
@@ -145,6 +325,10 @@ void *rtp_dgram_thread (void *opaque)
             if (unlikely(ufd[0].revents & POLLHUP))
                 break; /* RTP socket dead (DCCP only) */
 
+#ifdef HAVE_RECVMMSG
+            if (!rtp_batch_recv (demux, rtp_fd, &batch))
+                break;
+#else
             block_t *block = block_Alloc (iov.iov_len);
             if (unlikely(block == NULL))
             {
@@ -178,6 +362,7 @@ void *rtp_dgram_thread (void *opaque)
                           vlc_strerror_c(errno));
                 block_Release (block);
             }
+#endif
         }
 
     dequeue:
@@ -185,6 +370,10 @@ void *rtp_dgram_thread (void *opaque)
             deadline = VLC_TICK_INVALID;
         vlc_restorecancel (canc);
     }
+#ifdef HAVE_RECVMMSG
+    vlc_cleanup_pop ();
+    rtp_batch_release (&batch);
+#endif
     return NULL;
 }
 
@@ -75,6 +75,11 @@
     "RTP packets will be discarded if they are too far behind (i.e. in the " \
     "past) by this many packets from the last received packet." )
 
+#define RTP_BATCH_TEXT N_("Datagrams received at once")
+#define RTP_BATCH_LONGTEXT N_( \
+    "Maximum number of pending RTP datagrams received with a single " \
+    "system call." )
+
 #define RTP_DYNAMIC_PT_TEXT N_("RTP payload format assumed for dynamic " \
                                "payloads")
 #define RTP_DYNAMIC_PT_LONGTEXT N_( \
@@ -122,6 +127,11 @@ vlc_module_begin ()
     add_integer ("rtp-max-misorder", 100, RTP_MAX_MISORDER_TEXT,
                  RTP_MAX_MISORDER_LONGTEXT, true)
         change_integer_range (0, 32767)
+#ifdef HAVE_RECVMMSG
+    add_integer ("rtp-batch", 16, RTP_BATCH_TEXT,
+                 RTP_BATCH_LONGTEXT, true)
+        change_integer_range (1, RTP_BATCH_MAX)
+#endif
     add_string ("rtp-dynamic-pt", NULL, RTP_DYNAMIC_PT_TEXT,
                 RTP_DYNAMIC_PT_LONGTEXT, true)
         change_string_list (dynamic_pt_list, dynamic_pt_list_text)
@@ -266,6 +276,10 @@ static int Open (vlc_object_t *obj)
     p_sys->timeout      = vlc_tick_from_sec( var_CreateGetInteger (obj, "rtp-timeout") );
     p_sys->max_dropout  = var_CreateGetInteger (obj, "rtp-max-dropout");
     p_sys->max_misorder = var_CreateGetInteger (obj, "rtp-max-misorder");
+#ifdef HAVE_RECVMMSG
+    p_sys->batch        = VLC_CLIP (var_InheritInteger (obj, "rtp-batch"),
+                                    1, RTP_BATCH_MAX);
+#endif
     p_sys->thread_ready = false;
     p_sys->autodetect   = true;
 
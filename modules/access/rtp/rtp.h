@@ -62,6 +62,9 @@ void *rtp_dgram_thread (void *data);
 void *rtp_stream_thread (void *data);
 
 /* Global data */
+/** Maximum number of datagrams received per system call */
+#define RTP_BATCH_MAX 64
+
 typedef struct
 {
     rtp_session_t *session;
@@ -77,6 +80,9 @@ typedef struct
     uint16_t      max_dropout; /**< Max packet forward misordering */
     uint16_t      max_misorder; /**< Max packet backward misordering */
     uint8_t       max_src; /**< Max simultaneous RTP sources */
+#ifdef HAVE_RECVMMSG
+    uint8_t       batch; /**< Max datagrams received per system call */
+#endif
     bool          thread_ready;
     bool          autodetect; /**< Payload type autodetection pending */
 } demux_sys_t;
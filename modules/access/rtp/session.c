@@ -256,7 +256,9 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
         block->i_buffer -= padding;
     }
 
-    vlc_tick_t     now = vlc_tick_now ();
+    /* Use the reception time from the input thread if known */
+    vlc_tick_t     now = (block->i_dts != VLC_TICK_INVALID) ? block->i_dts
+                                                          : vlc_tick_now ();
     rtp_source_t  *src  = NULL;
     const uint16_t seq  = rtp_seq (block);
     const uint32_t ssrc = GetDWBE (block->p_buffer + 8);
@@ -58,6 +58,12 @@ static void Close( vlc_object_t * );
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
 #define TIMEOUT_TEXT N_("UDP Source timeout (sec)")
+#define BATCH_TEXT N_("Datagrams received at once")
+#define BATCH_LONGTEXT N_("Maximum number of pending datagrams received " \
+                          "with a single system call." )
+
+/* Maximum number of datagrams received per system call */
+#define UDP_BATCH_MAX 64
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -68,6 +74,10 @@ vlc_module_begin ()
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_obsolete_integer( "udp-buffer" ) /* since 3.0.0 */
     add_integer( "udp-timeout", -1, TIMEOUT_TEXT, NULL, true )
+#ifdef HAVE_RECVMMSG
+    add_integer( "udp-batch", 16, BATCH_TEXT, BATCH_LONGTEXT, true )
+        change_integer_range( 1, UDP_BATCH_MAX )
+#endif
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -81,12 +91,23 @@ typedef struct
     int timeout;
     size_t mtu;
     block_t *overflow_block;
+#ifdef HAVE_RECVMMSG
+    unsigned batch;  /* maximum datagrams received at once */
+    unsigned next;   /* index of the first received datagram not returned */
+    unsigned queued; /* count of received datagrams not returned */
+    block_t **blockv;
+    struct mmsghdr *msgv;
+    struct iovec (*iovv)[2];
+#endif
 } access_sys_t;
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 static block_t *BlockUDP( stream_t *, bool * );
+#ifdef HAVE_RECVMMSG
+static block_t *BlockUDPBatch( stream_t *, bool * );
+#endif
 static int Control( stream_t *, int, va_list );
 
 /*****************************************************************************
@@ -116,6 +137,24 @@ static int Open( vlc_object_t *p_this )
     p_access->p_sys = sys;
 
     /* Set up p_access */
+#ifdef HAVE_RECVMMSG
+    sys->batch = VLC_CLIP( var_InheritInteger( p_access, "udp-batch" ),
+                           1, UDP_BATCH_MAX );
+    sys->next = sys->queued = 0;
+    sys->blockv = vlc_obj_calloc( p_this, sys->batch, sizeof (*sys->blockv) );
+    sys->msgv = vlc_obj_calloc( p_this, sys->batch, sizeof (*sys->msgv) );
+    sys->iovv = vlc_obj_calloc( p_this, sys->batch, sizeof (*sys->iovv) );
+    if( unlikely( sys->blockv == NULL || sys->msgv == NULL
+               || sys->iovv == NULL ) )
+    {
+        block_Release( sys->overflow_block );
+        return VLC_ENOMEM;
+    }
+
+    if( sys->batch > 1 )
+        ACCESS_SET_CALLBACKS( NULL, BlockUDPBatch, Control, NULL );
+    else
+#endif
     ACCESS_SET_CALLBACKS( NULL, BlockUDP, Control, NULL );
 
     char *psz_name = strdup( p_access->psz_location );
@@ -193,6 +232,11 @@ static void Close( vlc_object_t *p_this )
     access_sys_t *sys = p_access->p_sys;
     if( sys->overflow_block )
         block_Release( sys->overflow_block );
+#ifdef HAVE_RECVMMSG
+    for( unsigned i = 0; i < sys->batch; i++ )
+        if( sys->blockv[i] != NULL )
+            block_Release( sys->blockv[i] );
+#endif
 
     net_Close( sys->fd );
 }
@@ -300,3 +344,135 @@ skip:
 
     return pkt;
 }
+
+#ifdef HAVE_RECVMMSG
+/*****************************************************************************
+ * BlockUDPBatch: receives all pending datagrams with a single system call,
+ * then returns them one at a time
+ *****************************************************************************/
+static block_t *BlockUDPBatch(stream_t *access, bool *restrict eof)
+{
+    access_sys_t *sys = access->p_sys;
+    block_t *pkt;
+
+    if (sys->queued > 0)
+        goto dequeue;
+
+    /* (Re)fill the receive buffers, unused ones are kept from last time */
+    unsigned count;
+    for (count = 0; count < sys->batch; count++)
+    {
+        if (sys->blockv[count] == NULL)
+        {
+            sys->blockv[count] = block_Alloc(sys->mtu);
+            if (unlikely(sys->blockv[count] == NULL))
+                break;
+        }
+
+        struct iovec *iov = sys->iovv[count];
+
+        iov[0].iov_base = sys->blockv[count]->p_buffer;
+        iov[0].iov_len = sys->mtu;
+        iov[1].iov_base = sys->overflow_block->p_buffer;
+        iov[1].iov_len = sys->overflow_block->i_buffer;
+        memset(&sys->msgv[count].msg_hdr, 0, sizeof (struct msghdr));
+        sys->msgv[count].msg_hdr.msg_iov = iov;
+        sys->msgv[count].msg_hdr.msg_iovlen = 2;
+    }
+
+    if (unlikely(count == 0))
+    {   /* OOM - dequeue and discard one packet */
+        char dummy;
+        recv(sys->fd, &dummy, 1, 0);
+        return NULL;
+    }
+
+    struct pollfd ufd[1];
+
+    ufd[0].fd = sys->fd;
+    ufd[0].events = POLLIN;
+
+    switch (vlc_poll_i11e(ufd, 1, sys->timeout))
+    {
+        case 0:
+            msg_Err(access, "receive time-out");
+            *eof = true;
+            /* fall through */
+        case -1:
+            return NULL;
+     }
+
+    int n = recvmmsg(sys->fd, sys->msgv, count, MSG_DONTWAIT, NULL);
+    if (n <= 0)
+        return NULL;
+
+    /* All datagrams share the same overflow buffer, so only the last one
+     * exceeding the MTU can be recovered. */
+    int last_overflow = -1;
+    size_t mtu = sys->mtu;
+
+    for (int i = 0; i < n; i++)
+        if (sys->msgv[i].msg_len > sys->mtu)
+        {
+            last_overflow = i;
+            if (sys->msgv[i].msg_len > mtu)
+                mtu = sys->msgv[i].msg_len;
+        }
+
+    for (int i = 0; i < n; i++)
+    {
+        size_t len = sys->msgv[i].msg_len;
+
+        pkt = sys->blockv[i];
+
+        if (likely(len <= sys->mtu))
+            pkt->i_buffer = len;
+        else if (i == last_overflow)
+        {
+            msg_Warn(access, "%zu bytes packet received (MTU was %zu), "
+                     "adjusting mtu", len, sys->mtu);
+            block_t *gather_block = sys->overflow_block;
+
+            sys->overflow_block = block_Alloc(65507 - mtu);
+
+            gather_block->i_buffer = len - sys->mtu;
+            pkt->p_next = gather_block;
+            sys->blockv[i] = block_ChainGather(pkt);
+        }
+        else
+        {
+            msg_Err(access, "%zu bytes packet truncated (MTU was %zu)",
+                    len, sys->mtu);
+            pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
+        }
+    }
+
+    if (unlikely(mtu != sys->mtu))
+    {   /* Spare buffers are too small now */
+        for (unsigned i = n; i < count; i++)
+        {
+            block_Release(sys->blockv[i]);
+            sys->blockv[i] = NULL;
+        }
+        sys->mtu = mtu;
+    }
+
+    sys->next = 0;
+    sys->queued = n;
+
+dequeue:
+    pkt = sys->blockv[sys->next];
+    sys->blockv[sys->next] = NULL;
+    sys->next++;
+    sys->queued--;
+
+    if (sys->queued == 0 && sys->next < sys->batch)
+    {   /* Move the spare buffers to the front */
+        memmove(sys->blockv, sys->blockv + sys->next,
+                (sys->batch - sys->next) * sizeof (*sys->blockv));
+        memset(sys->blockv + sys->batch - sys->next, 0,
+               sys->next * sizeof (*sys->blockv));
+    }
+    return pkt;
+}
+#endif
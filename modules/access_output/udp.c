@@ -45,11 +45,21 @@
 #elif defined (HAVE_SYS_SOCKET_H)
 #   include <sys/socket.h>
 #endif
+#ifdef HAVE_NETINET_UDP_H
+#   include <netinet/udp.h>
+#endif
 
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
 
+/* Upper bound on datagrams handed to the kernel in one system call */
+#define UDP_BATCH_MAX 64
+/* Packets due this soon after the current one are sent along with it */
+#define UDP_BATCH_WINDOW VLC_TICK_FROM_MS(1)
+/* Stay clear of the 64 KiB IP datagram limit when offloading segmentation */
+#define UDP_GSO_MAX_BYTES 65000
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -70,6 +80,11 @@ static void Close( vlc_object_t * );
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
 
+#define BATCH_TEXT N_("Batch size")
+#define BATCH_LONGTEXT N_("Maximum number of datagrams that are due at " \
+                          "the same time and are sent with a single " \
+                          "system call.")
+
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
     set_shortname( "UDP" )
@@ -78,6 +93,9 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_integer( SOUT_CFG_PREFIX "batch", 16, BATCH_TEXT, BATCH_LONGTEXT,
+                                 true )
+        change_integer_range( 1, UDP_BATCH_MAX )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -91,6 +109,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "batch",
     NULL
 };
 
@@ -113,6 +132,10 @@ typedef struct
     int           i_handle;
     bool          b_mtu_warning;
     size_t        i_mtu;
+    unsigned      i_batch;
+#ifdef UDP_SEGMENT
+    bool          b_gso;
+#endif
 
     block_fifo_t *p_fifo;
     block_t      *p_buffer;
@@ -206,6 +229,12 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_handle = i_handle;
     p_sys->i_mtu = var_CreateGetInteger( p_this, "mtu" );
     p_sys->b_mtu_warning = false;
+    p_sys->i_batch = VLC_CLIP( var_GetInteger( p_access,
+                                               SOUT_CFG_PREFIX "batch" ),
+                               1, UDP_BATCH_MAX );
+#ifdef UDP_SEGMENT
+    p_sys->b_gso = true;
+#endif
     p_sys->p_fifo = block_FifoNew();
     p_sys->p_buffer = NULL;
 
@@ -345,6 +374,120 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
     return i_len;
 }
 
+/*****************************************************************************
+ * SendBatch: send a batch of datagrams with as few system calls as possible.
+ *****************************************************************************
+ * Runs of equally-sized datagrams are coalesced into a single message when
+ * the kernel supports UDP segmentation offload; only the last datagram of
+ * such a run may be shorter than the others.
+ *****************************************************************************/
+static void SendBatch( sout_access_out_t *p_access, block_t **pkv,
+                       unsigned pkc )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgv[UDP_BATCH_MAX];
+    struct iovec iov[UDP_BATCH_MAX];
+# ifdef UDP_SEGMENT
+    union
+    {
+        char buf[CMSG_SPACE(sizeof (uint16_t))];
+        struct cmsghdr align;
+    } cmsgv[UDP_BATCH_MAX];
+# endif
+    unsigned msgc = 0;
+
+    for( unsigned i = 0; i < pkc; )
+    {
+        struct msghdr *msg = &msgv[msgc].msg_hdr;
+        unsigned segs = 1;
+
+        iov[i].iov_base = pkv[i]->p_buffer;
+        iov[i].iov_len = pkv[i]->i_buffer;
+        memset( msg, 0, sizeof (*msg) );
+        msg->msg_iov = &iov[i];
+
+# ifdef UDP_SEGMENT
+        if( p_sys->b_gso )
+        {
+            const size_t i_seg = pkv[i]->i_buffer;
+            size_t i_total = i_seg;
+
+            while( i + segs < pkc && pkv[i + segs]->i_buffer <= i_seg
+                && i_total + pkv[i + segs]->i_buffer <= UDP_GSO_MAX_BYTES )
+            {
+                block_t *p_pk = pkv[i + segs];
+
+                iov[i + segs].iov_base = p_pk->p_buffer;
+                iov[i + segs].iov_len = p_pk->i_buffer;
+                i_total += p_pk->i_buffer;
+                segs++;
+                if( p_pk->i_buffer < i_seg )
+                    break;
+            }
+
+            if( segs > 1 )
+            {
+                uint16_t i_gso = i_seg;
+                struct cmsghdr *cmsg;
+
+                msg->msg_control = cmsgv[msgc].buf;
+                msg->msg_controllen = sizeof (cmsgv[msgc].buf);
+                cmsg = CMSG_FIRSTHDR( msg );
+                cmsg->cmsg_level = IPPROTO_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN( sizeof (i_gso) );
+                memcpy( CMSG_DATA( cmsg ), &i_gso, sizeof (i_gso) );
+            }
+        }
+# endif
+        msg->msg_iovlen = segs;
+        msgc++;
+        i += segs;
+    }
+
+    for( unsigned i = 0; i < msgc; )
+    {
+        int val = sendmmsg( p_sys->i_handle, msgv + i, msgc - i, 0 );
+        if( val > 0 )
+        {
+            i += val;
+            continue;
+        }
+
+# ifdef UDP_SEGMENT
+        if( msgv[i].msg_hdr.msg_controllen > 0
+         && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT) )
+        {   /* No segmentation offload: send that run one datagram at once */
+            const struct msghdr *msg = &msgv[i].msg_hdr;
+
+            if( p_sys->b_gso )
+            {
+                msg_Dbg( p_access, "UDP segmentation offload unavailable: %s",
+                         vlc_strerror_c(errno) );
+                p_sys->b_gso = false;
+            }
+            for( size_t j = 0; j < msg->msg_iovlen; j++ )
+                if( send( p_sys->i_handle, msg->msg_iov[j].iov_base,
+                          msg->msg_iov[j].iov_len, 0 ) == -1 )
+                    msg_Warn( p_access, "send error: %s",
+                              vlc_strerror_c(errno) );
+            i++;
+            continue;
+        }
+# endif
+        msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+        i++; /* skip the offending message, as a single send() would */
+    }
+#else
+    for( unsigned i = 0; i < pkc; i++ )
+        if( send( p_sys->i_handle, pkv[i]->p_buffer, pkv[i]->i_buffer,
+                  0 ) == -1 )
+            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+#endif
+}
+
 /*****************************************************************************
  * ThreadWrite: Write a packet on the network at the good time.
  *****************************************************************************/
@@ -357,12 +500,18 @@ static void* ThreadWrite( void *data )
                                              SOUT_CFG_PREFIX "group" );
     int i_to_send = i_group;
     unsigned i_dropped_packets = 0;
+    block_t *p_next = NULL;
 
     for (;;)
     {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
+        block_t *p_pk = p_next;
         vlc_tick_t    i_date;
 
+        if( p_pk != NULL )
+            p_next = NULL;
+        else
+            p_pk = block_FifoGet( p_sys->p_fifo );
+
         i_date = p_sys->i_caching + p_pk->i_dts;
         if( i_date_last > 0 )
         {
@@ -393,17 +542,54 @@ static void* ThreadWrite( void *data )
             vlc_tick_wait( i_date );
             i_to_send = i_group;
         }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
         vlc_cleanup_pop();
 
+        /* Gather the packets that are already queued and due within the
+         * same pacing window, so that they go out in a single system call.
+         * A packet that would have to wait is kept for the next round. */
+        block_t *pkv[UDP_BATCH_MAX];
+        unsigned pkc = 1;
+        vlc_tick_t i_date_batch = i_date;
+
+        pkv[0] = p_pk;
+        if( p_sys->i_batch > 1 )
+        {
+            const vlc_tick_t i_deadline = vlc_tick_now() + UDP_BATCH_WINDOW;
+
+            vlc_fifo_Lock( p_sys->p_fifo );
+            while( pkc < p_sys->i_batch
+                && !vlc_fifo_IsEmpty( p_sys->p_fifo ) )
+            {
+                block_t *p_nk = vlc_fifo_DequeueUnlocked( p_sys->p_fifo );
+                vlc_tick_t i_date_nk = p_sys->i_caching + p_nk->i_dts;
+                bool b_wait = i_to_send == 1
+                           || (p_nk->i_flags & BLOCK_FLAG_CLOCK);
+
+                if( i_date_nk - i_date_batch > VLC_TICK_FROM_SEC(2)
+                 || (b_wait && i_date_nk > i_deadline) )
+                {
+                    p_next = p_nk;
+                    break;
+                }
+
+                i_to_send = b_wait ? (int)i_group : i_to_send - 1;
+                i_date_batch = i_date_nk;
+                pkv[pkc++] = p_nk;
+            }
+            vlc_fifo_Unlock( p_sys->p_fifo );
+        }
+
+        int canc = vlc_savecancel();
+        SendBatch( p_access, pkv, pkc );
+        vlc_restorecancel( canc );
+
         if( i_dropped_packets )
         {
             msg_Dbg( p_access, "dropped %i packets", i_dropped_packets );
             i_dropped_packets = 0;
         }
 
-        i_date_last = i_date;
+        i_date_last = i_date_batch;
 
 #if 1
         i_date = vlc_tick_now() - i_date;
@@ -414,7 +600,8 @@ static void* ThreadWrite( void *data )
         }
 #endif
 
-        block_Release( p_pk );
+        for( unsigned i = 0; i < pkc; i++ )
+            block_Release( pkv[i] );
 
     }
     return NULL;
@@ -38,447 +38,841 @@
 #include <vlc_aout.h>
 #include <vlc_block.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
+
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
 
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
 static int  Open(vlc_object_t *);
+static void Close(vlc_object_t *);
+
+#define DITHER_TEXT N_("Dither to 16-bits")
+#define DITHER_LONGTEXT N_("Add triangular dither noise when converting " \
+    "floating point samples to 16-bits integers.")
 
 vlc_module_begin()
     set_description(N_("Audio filter for PCM format conversion"))
     set_category(CAT_AUDIO)
     set_subcategory(SUBCAT_AUDIO_MISC)
     set_capability("audio converter", 1)
-    set_callbacks(Open, NULL)
+    add_bool("audio-format-dither", false, DITHER_TEXT, DITHER_LONGTEXT, true)
+    set_callbacks(Open, Close)
 vlc_module_end()
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 
-typedef block_t *(*cvt_t)(filter_t *, block_t *);
-static cvt_t FindConversion(vlc_fourcc_t src, vlc_fourcc_t dst);
-
-static int Open(vlc_object_t *object)
-{
-    filter_t     *filter = (filter_t *)object;
-
-    const es_format_t *src = &filter->fmt_in;
-    es_format_t       *dst = &filter->fmt_out;
-
-    if (!AOUT_FMTS_SIMILAR(&src->audio, &dst->audio))
-        return VLC_EGENERIC;
-    if (src->i_codec == dst->i_codec)
-        return VLC_EGENERIC;
-
-    filter->pf_audio_filter = FindConversion(src->i_codec, dst->i_codec);
-    if (filter->pf_audio_filter == NULL)
-        return VLC_EGENERIC;
+/* Converts count samples. The destination either does not overlap the
+ * source, or starts at the same address: conversions to wider samples then
+ * run from the end, the other ones from the start. */
+typedef void (*cvt_t)(void *dst, const void *src, size_t count);
+/* Same with a dither state, one lane per 8 consecutive samples */
+typedef void (*cvt_dither_t)(void *dst, const void *src, size_t count,
+                             uint32_t *state);
 
-    msg_Dbg(filter, "%4.4s->%4.4s, bits per sample: %i->%i",
-            (char *)&src->i_codec, (char *)&dst->i_codec,
-            src->audio.i_bitspersample, dst->audio.i_bitspersample);
-    return VLC_SUCCESS;
-}
+#define DITHER_LANES 8
 
+typedef struct
+{
+    cvt_t convert;
+    cvt_dither_t dither;
+    unsigned src_size;
+    unsigned dst_size;
+    uint32_t state[DITHER_LANES];
+} filter_sys_t;
 
 /*** from U8 ***/
-static block_t *U8toS16(filter_t *filter, block_t *bsrc)
+static void U8toS16(void *dst, const void *src, size_t count)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    uint8_t *src = (uint8_t *)bsrc->p_buffer;
-    int16_t *dst = (int16_t *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer; i--;)
-        *dst++ = ((*src++) << 8) - 0x8000;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    const uint8_t *s = (const uint8_t *)src + count;
+    int16_t *d = (int16_t *)dst + count;
+    while (count--)
+        *--d = ((*--s) << 8) - 0x8000;
 }
 
-static block_t *U8toFl32(filter_t *filter, block_t *bsrc)
+static void U8toFl32(void *dst, const void *src, size_t count)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 4);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    uint8_t *src = (uint8_t *)bsrc->p_buffer;
-    float   *dst = (float *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer; i--;)
-        *dst++ = ((float)((*src++) - 128)) / 128.f;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    const uint8_t *s = (const uint8_t *)src + count;
+    float *d = (float *)dst + count;
+    while (count--)
+        *--d = ((float)((*--s) - 128)) / 128.f;
 }
 
-static block_t *U8toS32(filter_t *filter, block_t *bsrc)
+static void U8toS32(void *dst, const void *src, size_t count)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 4);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    uint8_t *src = (uint8_t *)bsrc->p_buffer;
-    int32_t *dst = (int32_t *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer; i--;)
-        *dst++ = ((*src++) << 24) - 0x80000000;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    const uint8_t *s = (const uint8_t *)src + count;
+    int32_t *d = (int32_t *)dst + count;
+    while (count--)
+        *--d = ((*--s) << 24) - 0x80000000;
 }
 
-static block_t *U8toFl64(filter_t *filter, block_t *bsrc)
+static void U8toFl64(void *dst, const void *src, size_t count)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 8);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    uint8_t *src = (uint8_t *)bsrc->p_buffer;
-    double  *dst = (double *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer; i--;)
-        *dst++ = ((double)((*src++) - 128)) / 128.;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    const uint8_t *s = (const uint8_t *)src + count;
+    double *d = (double *)dst + count;
+    while (count--)
+        *--d = ((double)((*--s) - 128)) / 128.;
 }
 
 
 /*** from S16N ***/
-static block_t *S16toU8(filter_t *filter, block_t *b)
+static void S16toU8(void *dst, const void *src, size_t count)
 {
-    VLC_UNUSED(filter);
-    int16_t *src = (int16_t *)b->p_buffer;
-    uint8_t *dst = (uint8_t *)src;
-    for (size_t i = b->i_buffer / 2; i--;)
-        *dst++ = ((*src++) + 32768) >> 8;
-
-    b->i_buffer /= 2;
-    return b;
+    const int16_t *s = src;
+    uint8_t *d = dst;
+    while (count--)
+        *d++ = ((*s++) + 32768) >> 8;
 }
 
-static block_t *S16toFl32(filter_t *filter, block_t *bsrc)
+static void S16toFl32(void *dst, const void *src, size_t count)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    int16_t *src = (int16_t *)bsrc->p_buffer;
-    float   *dst = (float *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer / 2; i--;)
+    const int16_t *s = (const int16_t *)src + count;
+    float *d = (float *)dst + count;
+    while (count--)
 #if 0
         /* Slow version */
-        *dst++ = (float)*src++ / 32768.f;
+        *--d = (float)*--s / 32768.f;
 #else
     {   /* This is Walken's trick based on IEEE float format. On my PIII
          * this takes 16 seconds to perform one billion conversions, instead
          * of 19 seconds for the above division. */
         union { float f; int32_t i; } u;
-        u.i = *src++ + 0x43c00000;
-        *dst++ = u.f - 384.f;
+        u.i = *--s + 0x43c00000;
+        *--d = u.f - 384.f;
     }
 #endif
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
 }
 
-static block_t *S16toS32(filter_t *filter, block_t *bsrc)
+static void S16toS32(void *dst, const void *src, size_t count)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    int16_t *src = (int16_t *)bsrc->p_buffer;
-    int32_t *dst = (int32_t *)bdst->p_buffer;
-    for (int i = bsrc->i_buffer / 2; i--;)
-        *dst++ = *src++ << 16;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    const int16_t *s = (const int16_t *)src + count;
+    int32_t *d = (int32_t *)dst + count;
+    while (count--)
+        *--d = *--s << 16;
 }
 
-static block_t *S16toFl64(filter_t *filter, block_t *bsrc)
+static void S16toFl64(void *dst, const void *src, size_t count)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 4);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    int16_t *src = (int16_t *)bsrc->p_buffer;
-    float   *dst = (float *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer / 2; i--;)
-        *dst++ = (double)*src++ / 32768.;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    const int16_t *s = (const int16_t *)src + count;
+    double *d = (double *)dst + count;
+    while (count--)
+        *--d = (double)*--s / 32768.;
 }
 
 
 /*** from FL32 ***/
-static block_t *Fl32toU8(filter_t *filter, block_t *b)
+static void Fl32toU8(void *dst, const void *src, size_t count)
 {
-    float   *src = (float *)b->p_buffer;
-    uint8_t *dst = (uint8_t *)src;
-    for (size_t i = b->i_buffer / 4; i--;)
+    const float *s = src;
+    uint8_t *d = dst;
+    while (count--)
     {
-        float s = *(src++) * 128.f;
-        if (s >= 127.f)
-            *(dst++) = 255;
+        float v = *(s++) * 128.f;
+        if (v >= 127.f)
+            *(d++) = 255;
         else
-        if (s <= -128.f)
-            *(dst++) = 0;
+        if (v <= -128.f)
+            *(d++) = 0;
         else
-            *(dst++) = lroundf(s) + 128;
+            *(d++) = lroundf(v) + 128;
     }
-    b->i_buffer /= 4;
-    VLC_UNUSED(filter);
-    return b;
 }
 
-static block_t *Fl32toS16(filter_t *filter, block_t *b)
+static void Fl32toS16(void *dst, const void *src, size_t count)
 {
-    VLC_UNUSED(filter);
-    float   *src = (float *)b->p_buffer;
-    int16_t *dst = (int16_t *)src;
-    for (int i = b->i_buffer / 4; i--;) {
+    const float *s = src;
+    int16_t *d = dst;
+    while (count--) {
 #if 0
         /* Slow version. */
-        if (*src >= 1.0) *dst = 32767;
-        else if (*src < -1.0) *dst = -32768;
-        else *dst = lroundf(*src * 32768.f);
-        src++; dst++;
+        if (*s >= 1.0) *d = 32767;
+        else if (*s < -1.0) *d = -32768;
+        else *d = lroundf(*s * 32768.f);
+        s++; d++;
 #else
-        /* This is Walken's trick based on IEEE float format. */
+        /* This is Walken's trick based on IEEE float format.
+         * NaN saturates high whatever its sign, as in the SIMD versions. */
         union { float f; int32_t i; } u;
-        u.f = *src++ + 384.f;
-        if (u.i > 0x43c07fff)
-            *dst++ = 32767;
+        u.f = *s++ + 384.f;
+        if (u.i > 0x43c07fff || isnan(u.f))
+            *d++ = 32767;
         else if (u.i < 0x43bf8000)
-            *dst++ = -32768;
+            *d++ = -32768;
         else
-            *dst++ = u.i - 0x43c00000;
+            *d++ = u.i - 0x43c00000;
 #endif
     }
-    b->i_buffer /= 2;
-    return b;
 }
 
-static block_t *Fl32toS32(filter_t *filter, block_t *b)
+/* Triangular dither of +/-1 LSB, from the sum of the two 16-bits halves of
+ * a xorshift32 output. All the operations are exact so that the vectorized
+ * versions give the same results. */
+static void Fl32toS16Dither(void *dst, const void *src, size_t count,
+                            uint32_t *state)
+{
+    const float *s = src;
+    int16_t *d = dst;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t r = state[i % DITHER_LANES];
+        r ^= r << 13;
+        r ^= r >> 17;
+        r ^= r << 5;
+        state[i % DITHER_LANES] = r;
+
+        float noise = (float)(int32_t)((r & 0xffff) + (r >> 16))
+                    * (1.f / 65536.f) - 1.f;
+        float v = s[i] * 32768.f + noise;
+        if (v >= 32767.f || isnan(v))
+            v = 32767.f;
+        else if (v <= -32768.f)
+            v = -32768.f;
+        d[i] = lrintf(v);
+    }
+}
+
+static void Fl32toS32(void *dst, const void *src, size_t count)
 {
-    float   *src = (float *)b->p_buffer;
-    int32_t *dst = (int32_t *)src;
-    for (size_t i = b->i_buffer / 4; i--;)
+    const float *s = src;
+    int32_t *d = dst;
+    while (count--)
     {
-        float s = *(src++) * 2147483648.f;
-        if (s >= 2147483647.f)
-            *(dst++) = 2147483647;
+        float v = *(s++) * 2147483648.f;
+        if (v >= 2147483647.f || isnan(v))
+            *(d++) = 2147483647;
         else
-        if (s <= -2147483648.f)
-            *(dst++) = -2147483648;
+        if (v <= -2147483648.f)
+            *(d++) = -2147483648;
         else
-            *(dst++) = lroundf(s);
+            *(d++) = lroundf(v);
     }
-    VLC_UNUSED(filter);
-    return b;
 }
 
-static block_t *Fl32toFl64(filter_t *filter, block_t *bsrc)
+static void Fl32toFl64(void *dst, const void *src, size_t count)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    float  *src = (float *)bsrc->p_buffer;
-    double *dst = (double *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer / 4; i--;)
-        *(dst++) = *(src++);
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    const float *s = (const float *)src + count;
+    double *d = (double *)dst + count;
+    while (count--)
+        *--d = *--s;
 }
 
 
 /*** from S32N ***/
-static block_t *S32toU8(filter_t *filter, block_t *b)
+static void S32toU8(void *dst, const void *src, size_t count)
 {
-    VLC_UNUSED(filter);
-    int32_t *src = (int32_t *)b->p_buffer;
-    uint8_t *dst = (uint8_t *)src;
-    for (size_t i = b->i_buffer / 4; i--;)
-        *dst++ = ((*src++) >> 24) + 128;
-
-    b->i_buffer /= 4;
-    return b;
+    const int32_t *s = src;
+    uint8_t *d = dst;
+    while (count--)
+        *d++ = ((*s++) >> 24) + 128;
 }
 
-static block_t *S32toS16(filter_t *filter, block_t *b)
+static void S32toS16(void *dst, const void *src, size_t count)
 {
-    VLC_UNUSED(filter);
-    int32_t *src = (int32_t *)b->p_buffer;
-    int16_t *dst = (int16_t *)src;
-    for (size_t i = b->i_buffer / 4; i--;)
-        *dst++ = (*src++) >> 16;
-
-    b->i_buffer /= 2;
-    return b;
+    const int32_t *s = src;
+    int16_t *d = dst;
+    while (count--)
+        *d++ = (*s++) >> 16;
 }
 
-static block_t *S32toFl32(filter_t *filter, block_t *b)
+static void S32toFl32(void *dst, const void *src, size_t count)
 {
-    VLC_UNUSED(filter);
-    int32_t *src = (int32_t*)b->p_buffer;
-    float   *dst = (float *)src;
-    for (int i = b->i_buffer / 4; i--;)
-        *dst++ = (float)(*src++) / 2147483648.f;
-    return b;
+    const int32_t *s = src;
+    float *d = dst;
+    while (count--)
+        *d++ = (float)(*s++) / 2147483648.f;
 }
 
-static block_t *S32toFl64(filter_t *filter, block_t *bsrc)
+static void S32toFl64(void *dst, const void *src, size_t count)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    int32_t *src = (int32_t*)bsrc->p_buffer;
-    double  *dst = (double *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer / 4; i--;)
-        *dst++ = (double)(*src++) / 2147483648.;
-out:
-    VLC_UNUSED(filter);
-    block_Release(bsrc);
-    return bdst;
+    const int32_t *s = (const int32_t *)src + count;
+    double *d = (double *)dst + count;
+    while (count--)
+        *--d = (double)*--s / 2147483648.;
 }
 
 
 /*** from FL64 ***/
-static block_t *Fl64toU8(filter_t *filter, block_t *b)
+static void Fl64toU8(void *dst, const void *src, size_t count)
 {
-    double  *src = (double *)b->p_buffer;
-    uint8_t *dst = (uint8_t *)src;
-    for (size_t i = b->i_buffer / 8; i--;)
+    const double *s = src;
+    uint8_t *d = dst;
+    while (count--)
     {
-        float s = *(src++) * 128.;
-        if (s >= 127.f)
-            *(dst++) = 255;
+        float v = *(s++) * 128.;
+        if (v >= 127.f)
+            *(d++) = 255;
         else
-        if (s <= -128.f)
-            *(dst++) = 0;
+        if (v <= -128.f)
+            *(d++) = 0;
         else
-            *(dst++) = lround(s) + 128;
+            *(d++) = lround(v) + 128;
     }
-    b->i_buffer /= 8;
-    VLC_UNUSED(filter);
-    return b;
 }
 
-static block_t *Fl64toS16(filter_t *filter, block_t *b)
+static void Fl64toS16(void *dst, const void *src, size_t count)
 {
-    VLC_UNUSED(filter);
-    double  *src = (double *)b->p_buffer;
-    int16_t *dst = (int16_t *)src;
-    for (size_t i = b->i_buffer / 8; i--;) {
-        const double v = *src++ * 32768.;
+    const double *s = src;
+    int16_t *d = dst;
+    while (count--) {
+        const double v = *s++ * 32768.;
         /* Slow version. */
         if (v >= 32767.)
-            *dst++ = 32767;
+            *d++ = 32767;
         else if (v < -32768.)
-            *dst++ = -32768;
+            *d++ = -32768;
         else
-            *dst++ = lround(v);
+            *d++ = lround(v);
     }
-    b->i_buffer /= 4;
-    return b;
 }
 
-static block_t *Fl64toFl32(filter_t *filter, block_t *b)
+static void Fl64toFl32(void *dst, const void *src, size_t count)
 {
-    double *src = (double *)b->p_buffer;
-    float  *dst = (float *)src;
-    for (size_t i = b->i_buffer / 8; i--;)
-        *(dst++) = *(src++);
-
-    VLC_UNUSED(filter);
-    return b;
+    const double *s = src;
+    float *d = dst;
+    while (count--)
+        *(d++) = *(s++);
 }
 
-static block_t *Fl64toS32(filter_t *filter, block_t *b)
+static void Fl64toS32(void *dst, const void *src, size_t count)
 {
-    double  *src = (double *)b->p_buffer;
-    int32_t *dst = (int32_t *)src;
-    for (size_t i = b->i_buffer / 8; i--;)
+    const double *s = src;
+    int32_t *d = dst;
+    while (count--)
     {
-        float s = *(src++) * 2147483648.;
-        if (s >= 2147483647.f)
-            *(dst++) = 2147483647;
+        float v = *(s++) * 2147483648.;
+        if (v >= 2147483647.f)
+            *(d++) = 2147483647;
         else
-        if (s <= -2147483648.f)
-            *(dst++) = -2147483648;
+        if (v <= -2147483648.f)
+            *(d++) = -2147483648;
         else
-            *(dst++) = lround(s);
+            *(d++) = lround(v);
+    }
+}
+
+/*****************************************************************************
+ * Vectorized conversions
+ *
+ * They give the same results as the C versions above, which also convert
+ * the remaining samples. Conversions to wider samples convert those first,
+ * then go backward a vector at a time, always loading a vector before
+ * storing over it.
+ *****************************************************************************/
+#ifdef HAVE_SSE2_INTRINSICS
+__attribute__((__target__("sse2")))
+static void S16toFl32_sse2(void *dst, const void *src, size_t count)
+{
+    const int16_t *s = src;
+    float *d = dst;
+    size_t i = count & ~(size_t)7;
+    const __m128 scale = _mm_set1_ps(1.f / 32768.f);
+
+    S16toFl32(d + i, s + i, count - i);
+    while (i > 0)
+    {
+        i -= 8;
+        __m128i v = _mm_loadu_si128((const __m128i *)&s[i]);
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(&d[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(&d[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+}
+
+__attribute__((__target__("sse2")))
+static inline __m128i Fl32toS32x4_sse2(__m128 v, __m128 scale)
+{
+    v = _mm_mul_ps(v, scale);
+    /* min and max return their second operand if either is NaN: clamp NaN
+     * to the maximum, as the C version */
+    v = _mm_max_ps(_mm_min_ps(v, _mm_set1_ps(32767.f)), _mm_set1_ps(-32768.f));
+    return _mm_cvtps_epi32(v);
+}
+
+__attribute__((__target__("sse2")))
+static void Fl32toS16_sse2(void *dst, const void *src, size_t count)
+{
+    const float *s = src;
+    int16_t *d = dst;
+    size_t i = 0;
+    const __m128 scale = _mm_set1_ps(32768.f);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i lo = Fl32toS32x4_sse2(_mm_loadu_ps(&s[i]), scale);
+        __m128i hi = Fl32toS32x4_sse2(_mm_loadu_ps(&s[i + 4]), scale);
+        _mm_storeu_si128((__m128i *)&d[i], _mm_packs_epi32(lo, hi));
     }
-    VLC_UNUSED(filter);
-    return b;
+    Fl32toS16(d + i, s + i, count - i);
 }
 
+__attribute__((__target__("sse2")))
+static inline __m128 Dither4_sse2(__m128i *state)
+{
+    __m128i r = *state;
+    r = _mm_xor_si128(r, _mm_slli_epi32(r, 13));
+    r = _mm_xor_si128(r, _mm_srli_epi32(r, 17));
+    r = _mm_xor_si128(r, _mm_slli_epi32(r, 5));
+    *state = r;
+
+    r = _mm_add_epi32(_mm_and_si128(r, _mm_set1_epi32(0xffff)),
+                      _mm_srli_epi32(r, 16));
+    return _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(r),
+                                 _mm_set1_ps(1.f / 65536.f)),
+                      _mm_set1_ps(1.f));
+}
+
+__attribute__((__target__("sse2")))
+static void Fl32toS16Dither_sse2(void *dst, const void *src, size_t count,
+                                 uint32_t *state)
+{
+    const float *s = src;
+    int16_t *d = dst;
+    size_t i = 0;
+    const __m128 scale = _mm_set1_ps(32768.f);
+    const __m128 min = _mm_set1_ps(-32768.f), max = _mm_set1_ps(32767.f);
+    __m128i state0 = _mm_loadu_si128((const __m128i *)&state[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 lo = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s[i]), scale),
+                               Dither4_sse2(&state0));
+        __m128 hi = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&s[i + 4]), scale),
+                               Dither4_sse2(&state1));
+        lo = _mm_max_ps(_mm_min_ps(lo, max), min);
+        hi = _mm_max_ps(_mm_min_ps(hi, max), min);
+        _mm_storeu_si128((__m128i *)&d[i],
+                         _mm_packs_epi32(_mm_cvtps_epi32(lo),
+                                         _mm_cvtps_epi32(hi)));
+    }
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+    Fl32toS16Dither(d + i, s + i, count - i, state);
+}
+
+/* lroundf() with saturation */
+__attribute__((__target__("sse2")))
+static inline __m128i Fl32toS32x4_round_sse2(__m128 v)
+{
+    const __m128 half = _mm_set1_ps(.5f), mhalf = _mm_set1_ps(-.5f);
+
+    /* NaN goes through max and saturates high, as in the C version */
+    v = _mm_max_ps(_mm_set1_ps(-2147483648.f),
+                   _mm_mul_ps(v, _mm_set1_ps(2147483648.f)));
+
+    __m128i over = _mm_castps_si128(_mm_cmpnlt_ps(v, _mm_set1_ps(2147483648.f)));
+    __m128i t = _mm_cvttps_epi32(v);
+    __m128 frac = _mm_sub_ps(v, _mm_cvtepi32_ps(t));
+
+    t = _mm_sub_epi32(t, _mm_castps_si128(_mm_cmpge_ps(frac, half)));
+    t = _mm_add_epi32(t, _mm_castps_si128(_mm_cmple_ps(frac, mhalf)));
+    return _mm_or_si128(_mm_andnot_si128(over, t),
+                        _mm_and_si128(over, _mm_set1_epi32(INT32_MAX)));
+}
+
+__attribute__((__target__("sse2")))
+static void Fl32toS32_sse2(void *dst, const void *src, size_t count)
+{
+    const float *s = src;
+    int32_t *d = dst;
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i *)&d[i],
+                         Fl32toS32x4_round_sse2(_mm_loadu_ps(&s[i])));
+    Fl32toS32(d + i, s + i, count - i);
+}
+
+__attribute__((__target__("sse2")))
+static void S32toFl32_sse2(void *dst, const void *src, size_t count)
+{
+    const int32_t *s = src;
+    float *d = dst;
+    size_t i = 0;
+    const __m128 scale = _mm_set1_ps(1.f / 2147483648.f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)&s[i]);
+        _mm_storeu_ps(&d[i], _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    S32toFl32(d + i, s + i, count - i);
+}
+
+__attribute__((__target__("sse2")))
+static void Fl32toFl64_sse2(void *dst, const void *src, size_t count)
+{
+    const float *s = src;
+    double *d = dst;
+    size_t i = count & ~(size_t)3;
+
+    Fl32toFl64(d + i, s + i, count - i);
+    while (i > 0)
+    {
+        i -= 4;
+        __m128 v = _mm_loadu_ps(&s[i]);
+        _mm_storeu_pd(&d[i], _mm_cvtps_pd(v));
+        _mm_storeu_pd(&d[i + 2], _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+}
+
+__attribute__((__target__("sse2")))
+static void Fl64toFl32_sse2(void *dst, const void *src, size_t count)
+{
+    const double *s = src;
+    float *d = dst;
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(&s[i]));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(&s[i + 2]));
+        _mm_storeu_ps(&d[i], _mm_movelh_ps(lo, hi));
+    }
+    Fl64toFl32(d + i, s + i, count - i);
+}
+#endif
 
-/* */
-/* */
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__((__target__("avx2")))
+static void S16toFl32_avx2(void *dst, const void *src, size_t count)
+{
+    const int16_t *s = src;
+    float *d = dst;
+    size_t i = count & ~(size_t)15;
+    const __m256 scale = _mm256_set1_ps(1.f / 32768.f);
+
+    S16toFl32(d + i, s + i, count - i);
+    while (i > 0)
+    {
+        i -= 16;
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&s[i]));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&s[i + 8]));
+        _mm256_storeu_ps(&d[i + 8], _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+        _mm256_storeu_ps(&d[i], _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+    }
+}
+
+__attribute__((__target__("avx2")))
+static void Fl32toS16_avx2(void *dst, const void *src, size_t count)
+{
+    const float *s = src;
+    int16_t *d = dst;
+    size_t i = 0;
+    const __m256 scale = _mm256_set1_ps(32768.f);
+    const __m256 min = _mm256_set1_ps(-32768.f), max = _mm256_set1_ps(32767.f);
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256 lo = _mm256_mul_ps(_mm256_loadu_ps(&s[i]), scale);
+        __m256 hi = _mm256_mul_ps(_mm256_loadu_ps(&s[i + 8]), scale);
+        /* NaN clamps to the maximum, see Fl32toS32x4_sse2() */
+        lo = _mm256_max_ps(_mm256_min_ps(lo, max), min);
+        hi = _mm256_max_ps(_mm256_min_ps(hi, max), min);
+
+        /* packs works within 128-bits lanes */
+        __m256i v = _mm256_packs_epi32(_mm256_cvtps_epi32(lo),
+                                       _mm256_cvtps_epi32(hi));
+        v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)&d[i], v);
+    }
+    Fl32toS16(d + i, s + i, count - i);
+}
+
+__attribute__((__target__("avx2")))
+static void Fl32toS16Dither_avx2(void *dst, const void *src, size_t count,
+                                 uint32_t *state)
+{
+    const float *s = src;
+    int16_t *d = dst;
+    size_t i = 0;
+    const __m256 scale = _mm256_set1_ps(32768.f);
+    const __m256 min = _mm256_set1_ps(-32768.f), max = _mm256_set1_ps(32767.f);
+    const __m256i mask = _mm256_set1_epi32(0xffff);
+    __m256i r = _mm256_loadu_si256((const __m256i *)state);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        r = _mm256_xor_si256(r, _mm256_slli_epi32(r, 13));
+        r = _mm256_xor_si256(r, _mm256_srli_epi32(r, 17));
+        r = _mm256_xor_si256(r, _mm256_slli_epi32(r, 5));
+
+        __m256i sum = _mm256_add_epi32(_mm256_and_si256(r, mask),
+                                       _mm256_srli_epi32(r, 16));
+        __m256 noise = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(sum),
+                                           _mm256_set1_ps(1.f / 65536.f)),
+                                     _mm256_set1_ps(1.f));
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&s[i]), scale),
+                                 noise);
+        v = _mm256_max_ps(_mm256_min_ps(v, max), min);
+
+        __m256i w = _mm256_cvtps_epi32(v);
+        __m128i p = _mm_packs_epi32(_mm256_castsi256_si128(w),
+                                    _mm256_extracti128_si256(w, 1));
+        _mm_storeu_si128((__m128i *)&d[i], p);
+    }
+    _mm256_storeu_si256((__m256i *)state, r);
+    Fl32toS16Dither(d + i, s + i, count - i, state);
+}
+
+__attribute__((__target__("avx2")))
+static void Fl32toS32_avx2(void *dst, const void *src, size_t count)
+{
+    const float *s = src;
+    int32_t *d = dst;
+    size_t i = 0;
+    const __m256 scale = _mm256_set1_ps(2147483648.f);
+    const __m256 half = _mm256_set1_ps(.5f), mhalf = _mm256_set1_ps(-.5f);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_max_ps(_mm256_set1_ps(-2147483648.f),
+                                 _mm256_mul_ps(_mm256_loadu_ps(&s[i]), scale));
+        __m256 over = _mm256_cmp_ps(v, scale, _CMP_NLT_UQ);
+        __m256i t = _mm256_cvttps_epi32(v);
+        __m256 frac = _mm256_sub_ps(v, _mm256_cvtepi32_ps(t));
+
+        /* round half away from zero, as lroundf() */
+        t = _mm256_sub_epi32(t, _mm256_castps_si256(
+                                    _mm256_cmp_ps(frac, half, _CMP_GE_OQ)));
+        t = _mm256_add_epi32(t, _mm256_castps_si256(
+                                    _mm256_cmp_ps(frac, mhalf, _CMP_LE_OQ)));
+        t = _mm256_blendv_epi8(t, _mm256_set1_epi32(INT32_MAX),
+                               _mm256_castps_si256(over));
+        _mm256_storeu_si256((__m256i *)&d[i], t);
+    }
+    Fl32toS32(d + i, s + i, count - i);
+}
+
+__attribute__((__target__("avx2")))
+static void S32toFl32_avx2(void *dst, const void *src, size_t count)
+{
+    const int32_t *s = src;
+    float *d = dst;
+    size_t i = 0;
+    const __m256 scale = _mm256_set1_ps(1.f / 2147483648.f);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&s[i]);
+        _mm256_storeu_ps(&d[i], _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    S32toFl32(d + i, s + i, count - i);
+}
+
+__attribute__((__target__("avx2")))
+static void Fl32toFl64_avx2(void *dst, const void *src, size_t count)
+{
+    const float *s = src;
+    double *d = dst;
+    size_t i = count & ~(size_t)7;
+
+    Fl32toFl64(d + i, s + i, count - i);
+    while (i > 0)
+    {
+        i -= 8;
+        __m256 v = _mm256_loadu_ps(&s[i]);
+        _mm256_storeu_pd(&d[i + 4], _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+        _mm256_storeu_pd(&d[i], _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+    }
+}
+
+__attribute__((__target__("avx2")))
+static void Fl64toFl32_avx2(void *dst, const void *src, size_t count)
+{
+    const double *s = src;
+    float *d = dst;
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(&s[i]));
+        __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(&s[i + 4]));
+        _mm256_storeu_ps(&d[i], _mm256_set_m128(hi, lo));
+    }
+    Fl64toFl32(d + i, s + i, count - i);
+}
+#endif
+
+/* Best first, the C versions are always usable */
 static const struct {
     vlc_fourcc_t src;
     vlc_fourcc_t dst;
     cvt_t convert;
+    unsigned cpu;
+    const char *name;
 } cvt_directs[] = {
-    { VLC_CODEC_U8,   VLC_CODEC_S16N, U8toS16    },
-    { VLC_CODEC_U8,   VLC_CODEC_FL32, U8toFl32   },
-    { VLC_CODEC_U8,   VLC_CODEC_S32N, U8toS32    },
-    { VLC_CODEC_U8,   VLC_CODEC_FL64, U8toFl64   },
-
-    { VLC_CODEC_S16N, VLC_CODEC_U8,   S16toU8    },
-    { VLC_CODEC_S16N, VLC_CODEC_FL32, S16toFl32  },
-    { VLC_CODEC_S16N, VLC_CODEC_S32N, S16toS32   },
-    { VLC_CODEC_S16N, VLC_CODEC_FL64, S16toFl64  },
-
-    { VLC_CODEC_FL32, VLC_CODEC_U8,   Fl32toU8   },
-    { VLC_CODEC_FL32, VLC_CODEC_S16N, Fl32toS16  },
-    { VLC_CODEC_FL32, VLC_CODEC_S32N, Fl32toS32  },
-    { VLC_CODEC_FL32, VLC_CODEC_FL64, Fl32toFl64 },
-
-    { VLC_CODEC_S32N, VLC_CODEC_U8,   S32toU8    },
-    { VLC_CODEC_S32N, VLC_CODEC_S16N, S32toS16   },
-    { VLC_CODEC_S32N, VLC_CODEC_FL32, S32toFl32  },
-    { VLC_CODEC_S32N, VLC_CODEC_FL64, S32toFl64  },
-
-    { VLC_CODEC_FL64, VLC_CODEC_U8,   Fl64toU8   },
-    { VLC_CODEC_FL64, VLC_CODEC_S16N, Fl64toS16  },
-    { VLC_CODEC_FL64, VLC_CODEC_FL32, Fl64toFl32 },
-    { VLC_CODEC_FL64, VLC_CODEC_S32N, Fl64toS32  },
-
-    { 0, 0, NULL }
+#ifdef HAVE_AVX2_INTRINSICS
+    { VLC_CODEC_S16N, VLC_CODEC_FL32, S16toFl32_avx2,  VLC_CPU_AVX2, "avx2" },
+    { VLC_CODEC_FL32, VLC_CODEC_S16N, Fl32toS16_avx2,  VLC_CPU_AVX2, "avx2" },
+    { VLC_CODEC_FL32, VLC_CODEC_S32N, Fl32toS32_avx2,  VLC_CPU_AVX2, "avx2" },
+    { VLC_CODEC_FL32, VLC_CODEC_FL64, Fl32toFl64_avx2, VLC_CPU_AVX2, "avx2" },
+    { VLC_CODEC_S32N, VLC_CODEC_FL32, S32toFl32_avx2,  VLC_CPU_AVX2, "avx2" },
+    { VLC_CODEC_FL64, VLC_CODEC_FL32, Fl64toFl32_avx2, VLC_CPU_AVX2, "avx2" },
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    { VLC_CODEC_S16N, VLC_CODEC_FL32, S16toFl32_sse2,  VLC_CPU_SSE2, "sse2" },
+    { VLC_CODEC_FL32, VLC_CODEC_S16N, Fl32toS16_sse2,  VLC_CPU_SSE2, "sse2" },
+    { VLC_CODEC_FL32, VLC_CODEC_S32N, Fl32toS32_sse2,  VLC_CPU_SSE2, "sse2" },
+    { VLC_CODEC_FL32, VLC_CODEC_FL64, Fl32toFl64_sse2, VLC_CPU_SSE2, "sse2" },
+    { VLC_CODEC_S32N, VLC_CODEC_FL32, S32toFl32_sse2,  VLC_CPU_SSE2, "sse2" },
+    { VLC_CODEC_FL64, VLC_CODEC_FL32, Fl64toFl32_sse2, VLC_CPU_SSE2, "sse2" },
+#endif
+
+    { VLC_CODEC_U8,   VLC_CODEC_S16N, U8toS16,    0, "c" },
+    { VLC_CODEC_U8,   VLC_CODEC_FL32, U8toFl32,   0, "c" },
+    { VLC_CODEC_U8,   VLC_CODEC_S32N, U8toS32,    0, "c" },
+    { VLC_CODEC_U8,   VLC_CODEC_FL64, U8toFl64,   0, "c" },
+
+    { VLC_CODEC_S16N, VLC_CODEC_U8,   S16toU8,    0, "c" },
+    { VLC_CODEC_S16N, VLC_CODEC_FL32, S16toFl32,  0, "c" },
+    { VLC_CODEC_S16N, VLC_CODEC_S32N, S16toS32,   0, "c" },
+    { VLC_CODEC_S16N, VLC_CODEC_FL64, S16toFl64,  0, "c" },
+
+    { VLC_CODEC_FL32, VLC_CODEC_U8,   Fl32toU8,   0, "c" },
+    { VLC_CODEC_FL32, VLC_CODEC_S16N, Fl32toS16,  0, "c" },
+    { VLC_CODEC_FL32, VLC_CODEC_S32N, Fl32toS32,  0, "c" },
+    { VLC_CODEC_FL32, VLC_CODEC_FL64, Fl32toFl64, 0, "c" },
+
+    { VLC_CODEC_S32N, VLC_CODEC_U8,   S32toU8,    0, "c" },
+    { VLC_CODEC_S32N, VLC_CODEC_S16N, S32toS16,   0, "c" },
+    { VLC_CODEC_S32N, VLC_CODEC_FL32, S32toFl32,  0, "c" },
+    { VLC_CODEC_S32N, VLC_CODEC_FL64, S32toFl64,  0, "c" },
+
+    { VLC_CODEC_FL64, VLC_CODEC_U8,   Fl64toU8,   0, "c" },
+    { VLC_CODEC_FL64, VLC_CODEC_S16N, Fl64toS16,  0, "c" },
+    { VLC_CODEC_FL64, VLC_CODEC_FL32, Fl64toFl32, 0, "c" },
+    { VLC_CODEC_FL64, VLC_CODEC_S32N, Fl64toS32,  0, "c" },
 };
 
-static cvt_t FindConversion(vlc_fourcc_t src, vlc_fourcc_t dst)
+static const struct {
+    cvt_dither_t dither;
+    unsigned cpu;
+    const char *name;
+} cvt_dithers[] = {
+#ifdef HAVE_AVX2_INTRINSICS
+    { Fl32toS16Dither_avx2, VLC_CPU_AVX2, "avx2" },
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    { Fl32toS16Dither_sse2, VLC_CPU_SSE2, "sse2" },
+#endif
+    { Fl32toS16Dither, 0, "c" },
+};
+
+static int FindConversion(vlc_fourcc_t src, vlc_fourcc_t dst)
 {
-    for (int i = 0; cvt_directs[i].convert; i++) {
+    const unsigned cpu = vlc_CPU();
+
+    for (size_t i = 0; i < ARRAY_SIZE(cvt_directs); i++) {
         if (cvt_directs[i].src == src &&
-            cvt_directs[i].dst == dst)
-            return cvt_directs[i].convert;
+            cvt_directs[i].dst == dst &&
+            (cpu & cvt_directs[i].cpu) == cvt_directs[i].cpu)
+            return i;
+    }
+    return -1;
+}
+
+static int FindDither(void)
+{
+    const unsigned cpu = vlc_CPU();
+
+    for (size_t i = 0; i < ARRAY_SIZE(cvt_dithers); i++)
+        if ((cpu & cvt_dithers[i].cpu) == cvt_dithers[i].cpu)
+            return i;
+    vlc_assert_unreachable();
+}
+
+static void InitDither(uint32_t *state)
+{
+    for (unsigned i = 0; i < DITHER_LANES; i++)
+        state[i] = 0x9e3779b9 * (i + 1);
+}
+
+static block_t *Convert(filter_t *filter, block_t *b)
+{
+    filter_sys_t *sys = filter->p_sys;
+    size_t count = b->i_buffer / sys->src_size;
+    block_t *out = b;
+
+    if (sys->dst_size > sys->src_size)
+    {
+        out = filter_ReuseAudioBuffer(filter, b, count * sys->dst_size);
+        if (unlikely(out == NULL))
+        {
+            block_Release(b);
+            return NULL;
+        }
+    }
+
+    if (sys->dither != NULL)
+        sys->dither(out->p_buffer, b->p_buffer, count, sys->state);
+    else
+        sys->convert(out->p_buffer, b->p_buffer, count);
+
+    if (out != b)
+        block_Release(b);
+    else
+        b->i_buffer = count * sys->dst_size;
+    return out;
+}
+
+static int Open(vlc_object_t *object)
+{
+    filter_t     *filter = (filter_t *)object;
+
+    const es_format_t *src = &filter->fmt_in;
+    es_format_t       *dst = &filter->fmt_out;
+
+    if (!AOUT_FMTS_SIMILAR(&src->audio, &dst->audio))
+        return VLC_EGENERIC;
+    if (src->i_codec == dst->i_codec)
+        return VLC_EGENERIC;
+
+    int idx = FindConversion(src->i_codec, dst->i_codec);
+    if (idx < 0)
+        return VLC_EGENERIC;
+
+    filter_sys_t *sys = malloc(sizeof(*sys));
+    if (unlikely(sys == NULL))
+        return VLC_ENOMEM;
+
+    const char *name = cvt_directs[idx].name;
+    sys->convert = cvt_directs[idx].convert;
+    sys->dither = NULL;
+    sys->src_size = aout_BitsPerSample(src->i_codec) / 8;
+    sys->dst_size = aout_BitsPerSample(dst->i_codec) / 8;
+    if (src->i_codec == VLC_CODEC_FL32 && dst->i_codec == VLC_CODEC_S16N
+     && var_InheritBool(filter, "audio-format-dither"))
+    {
+        int didx = FindDither();
+
+        sys->dither = cvt_dithers[didx].dither;
+        name = cvt_dithers[didx].name;
+        InitDither(sys->state);
     }
-    return NULL;
+
+    filter->p_sys = sys;
+    filter->pf_audio_filter = Convert;
+
+    msg_Dbg(filter, "%4.4s->%4.4s, bits per sample: %i->%i, %s%s",
+            (char *)&src->i_codec, (char *)&dst->i_codec,
+            src->audio.i_bitspersample, dst->audio.i_bitspersample,
+            name, sys->dither != NULL ? " dithered" : "");
+    return VLC_SUCCESS;
+}
+
+static void Close(vlc_object_t *object)
+{
+    filter_t *filter = (filter_t *)object;
+
+    free(filter->p_sys);
 }
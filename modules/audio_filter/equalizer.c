@@ -29,18 +29,26 @@
 #endif
 
 #include <math.h>
+#include <stdatomic.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_charset.h>
+#include <vlc_cpu.h>
 
 #include <vlc_aout.h>
 #include <vlc_filter.h>
 
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+
 #include "equalizer_presets.h"
 
 /* TODO:
- *  - optimize a bit (you can hardly do slower ;)
  *  - add tables for more bands (15 and 32 would be cool), maybe with auto coeffs
  *    computation (not too hard once the Q is found).
  *  - support for external preset
@@ -100,35 +108,53 @@ vlc_module_end ()
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
+#define EQZ_CHANNELS_MAX 32
+
+/* Filter dyn config */
 typedef struct
+{
+    float f_amp[EQZ_BANDS_MAX];     /* Per band amp */
+    float f_gamp;                   /* Global preamp */
+    bool  b_2eqz;
+} eqz_params_t;
+
+/* Filter state of one pass, x[0]/y[0] is the previous sample and x[1]/y[1]
+ * the one before. Channels are contiguous so that they fill vector lanes. */
+typedef struct
+{
+    float x[2][EQZ_CHANNELS_MAX];
+    float y[EQZ_BANDS_MAX][2][EQZ_CHANNELS_MAX];
+} eqz_state_t;
+
+typedef struct filter_sys_t filter_sys_t;
+typedef void (*eqz_filter_t)( filter_sys_t *, const eqz_params_t *,
+                              float *, unsigned, unsigned );
+
+struct filter_sys_t
 {
     /* Filter static config */
     int i_band;
-    float *f_alpha;
-    float *f_beta;
-    float *f_gamma;
+    float f_alpha[EQZ_BANDS_MAX];
+    float f_beta[EQZ_BANDS_MAX];
+    float f_gamma[EQZ_BANDS_MAX];
 
-    /* Filter dyn config */
-    float *f_amp;   /* Per band amp */
-    float f_gamp;   /* Global preamp */
-    bool b_2eqz;
+    /* Filter dyn config, double buffered: the callbacks write the inactive
+     * copy then bump i_params, so that the audio thread never waits */
+    eqz_params_t params[2];
+    atomic_uint  i_params;
 
-    /* Filter state */
-    float x[32][2];
-    float y[32][128][2];
+    /* Filter state, for the first and second pass */
+    eqz_state_t state[2];
+    eqz_filter_t pf_filter;
 
-    /* Second filter state */
-    float x2[32][2];
-    float y2[32][128][2];
-
-    vlc_mutex_t lock;
-} filter_sys_t;
+    vlc_mutex_t lock; /* serializes the callbacks */
+};
 
 static block_t *DoWork( filter_t *, block_t * );
 
 #define EQZ_IN_FACTOR (0.25f)
 static int  EqzInit( filter_t *, int );
-static void EqzFilter( filter_t *, float *, float *, int, int );
+static void EqzFilter( filter_t *, float *, unsigned, unsigned );
 static void EqzClean( filter_t * );
 
 static int PresetCallback ( vlc_object_t *, char const *, vlc_value_t,
@@ -149,6 +175,9 @@ static int Open( vlc_object_t *p_this )
 {
     filter_t     *p_filter = (filter_t *)p_this;
 
+    if( aout_FormatNbChannels( &p_filter->fmt_in.audio ) > EQZ_CHANNELS_MAX )
+        return VLC_EGENERIC;
+
     /* Allocate structure */
     filter_sys_t *p_sys = p_filter->p_sys = malloc( sizeof( *p_sys ) );
     if( !p_sys )
@@ -190,8 +219,7 @@ static void Close( vlc_object_t *p_this )
  *****************************************************************************/
 static block_t * DoWork( filter_t * p_filter, block_t * p_in_buf )
 {
-    EqzFilter( p_filter, (float*)p_in_buf->p_buffer,
-               (float*)p_in_buf->p_buffer, p_in_buf->i_nb_samples,
+    EqzFilter( p_filter, (float*)p_in_buf->p_buffer, p_in_buf->i_nb_samples,
                aout_FormatNbChannels( &p_filter->fmt_in.audio ) );
     return p_in_buf;
 }
@@ -276,27 +304,61 @@ static inline float EqzConvertdB( float db )
     return EQZ_IN_FACTOR * ( powf( 10.0f, db / 20.0f ) - 1.0f );
 }
 
-static int EqzInit( filter_t *p_filter, int i_rate )
+/* Begins a parameters update, the result is published by EqzParamsCommit */
+static eqz_params_t *EqzParamsBegin( filter_sys_t *p_sys )
+{
+    vlc_mutex_lock( &p_sys->lock );
+
+    unsigned i = atomic_load_explicit( &p_sys->i_params, memory_order_relaxed );
+    eqz_params_t *p_params = &p_sys->params[(i + 1) & 1];
+
+    *p_params = p_sys->params[i & 1];
+    return p_params;
+}
+
+static void EqzParamsCommit( filter_sys_t *p_sys )
+{
+    unsigned i = atomic_load_explicit( &p_sys->i_params, memory_order_relaxed );
+
+    atomic_store_explicit( &p_sys->i_params, i + 1, memory_order_release );
+    vlc_mutex_unlock( &p_sys->lock );
+}
+
+static void EqzFilter_c( filter_sys_t *, const eqz_params_t *,
+                         float *, unsigned, unsigned );
+#ifdef HAVE_SSE2_INTRINSICS
+static void EqzFilter_sse2( filter_sys_t *, const eqz_params_t *,
+                            float *, unsigned, unsigned );
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+static void EqzFilter_avx2( filter_sys_t *, const eqz_params_t *,
+                            float *, unsigned, unsigned );
+#endif
+
+static eqz_filter_t EqzFilterSelect( unsigned i_channels )
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    /* 8 channels per vector, only worth it beyond 4 */
+    if( vlc_CPU_AVX2() && i_channels > 4 )
+        return EqzFilter_avx2;
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    if( vlc_CPU_SSE2() )
+        return EqzFilter_sse2;
+#endif
+    VLC_UNUSED( i_channels );
+    return EqzFilter_c;
+}
+
+/* Static config and state, which does not depend on the variables */
+static void EqzInitState( filter_sys_t *p_sys, int i_rate, bool b_vlcFreqs )
 {
-    filter_sys_t *p_sys = p_filter->p_sys;
     eqz_config_t cfg;
-    int i, ch;
-    vlc_value_t val1, val2, val3;
-    vlc_object_t *p_aout = p_filter->obj.parent;
-    int i_ret = VLC_ENOMEM;
 
-    bool b_vlcFreqs = var_InheritBool( p_aout, "equalizer-vlcfreqs" );
     EqzCoeffs( i_rate, 1.0f, b_vlcFreqs, &cfg );
 
-    /* Create the static filter config */
     p_sys->i_band = cfg.i_band;
-    p_sys->f_alpha = vlc_alloc( p_sys->i_band, sizeof(float) );
-    p_sys->f_beta  = vlc_alloc( p_sys->i_band, sizeof(float) );
-    p_sys->f_gamma = vlc_alloc( p_sys->i_band, sizeof(float) );
-    if( !p_sys->f_alpha || !p_sys->f_beta || !p_sys->f_gamma )
-        goto error;
-
-    for( i = 0; i < p_sys->i_band; i++ )
+    for( int i = 0; i < p_sys->i_band; i++ )
     {
         p_sys->f_alpha[i] = cfg.band[i].f_alpha;
         p_sys->f_beta[i]  = cfg.band[i].f_beta;
@@ -304,38 +366,31 @@ static int EqzInit( filter_t *p_filter, int i_rate )
     }
 
     /* Filter dyn config */
-    p_sys->b_2eqz = false;
-    p_sys->f_gamp = 1.0f;
-    p_sys->f_amp  = vlc_alloc( p_sys->i_band, sizeof(float) );
-    if( !p_sys->f_amp )
-        goto error;
-
-    for( i = 0; i < p_sys->i_band; i++ )
-    {
-        p_sys->f_amp[i] = 0.0f;
-    }
+    for( int i = 0; i < p_sys->i_band; i++ )
+        p_sys->params[0].f_amp[i] = 0.0f;
+    p_sys->params[0].f_gamp = 1.0f;
+    p_sys->params[0].b_2eqz = false;
+    atomic_init( &p_sys->i_params, 0 );
 
     /* Filter state */
-    for( ch = 0; ch < 32; ch++ )
-    {
-        p_sys->x[ch][0]  =
-        p_sys->x[ch][1]  =
-        p_sys->x2[ch][0] =
-        p_sys->x2[ch][1] = 0.0f;
+    memset( p_sys->state, 0, sizeof(p_sys->state) );
+}
 
-        for( i = 0; i < p_sys->i_band; i++ )
-        {
-            p_sys->y[ch][i][0]  =
-            p_sys->y[ch][i][1]  =
-            p_sys->y2[ch][i][0] =
-            p_sys->y2[ch][i][1] = 0.0f;
-        }
-    }
+static int EqzInit( filter_t *p_filter, int i_rate )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    vlc_value_t val1, val2, val3;
+    vlc_object_t *p_aout = p_filter->obj.parent;
+
+    bool b_vlcFreqs = var_InheritBool( p_aout, "equalizer-vlcfreqs" );
+    EqzInitState( p_sys, i_rate, b_vlcFreqs );
+    p_sys->pf_filter =
+        EqzFilterSelect( aout_FormatNbChannels( &p_filter->fmt_in.audio ) );
 
     var_Create( p_aout, "equalizer-bands", VLC_VAR_STRING | VLC_VAR_DOINHERIT );
     var_Create( p_aout, "equalizer-preset", VLC_VAR_STRING | VLC_VAR_DOINHERIT );
 
-    p_sys->b_2eqz = var_CreateGetBool( p_aout, "equalizer-2pass" );
+    p_sys->params[0].b_2eqz = var_CreateGetBool( p_aout, "equalizer-2pass" );
 
     var_Create( p_aout, "equalizer-preamp", VLC_VAR_FLOAT | VLC_VAR_DOINHERIT );
 
@@ -356,9 +411,7 @@ static int EqzInit( filter_t *p_filter, int i_rate )
     {
         msg_Err(p_filter, "No preset selected");
         free( val2.psz_string );
-        free( p_sys->f_amp );
-        i_ret = VLC_EGENERIC;
-        goto error;
+        return VLC_EGENERIC;
     }
     free( val2.psz_string );
 
@@ -368,85 +421,267 @@ static int EqzInit( filter_t *p_filter, int i_rate )
     var_AddCallback( p_aout, "equalizer-preamp", PreampCallback, p_sys );
     var_AddCallback( p_aout, "equalizer-2pass", TwoPassCallback, p_sys );
 
+    const float *f_freq_table_10b = b_vlcFreqs
+                                  ? f_vlc_frequency_table_10b
+                                  : f_iso_frequency_table_10b;
+    const eqz_params_t *p_params =
+        &p_sys->params[atomic_load( &p_sys->i_params ) & 1];
     msg_Dbg( p_filter, "equalizer loaded for %d Hz with %d bands %d pass",
-                        i_rate, p_sys->i_band, p_sys->b_2eqz ? 2 : 1 );
-    for( i = 0; i < p_sys->i_band; i++ )
+                        i_rate, p_sys->i_band, p_params->b_2eqz ? 2 : 1 );
+    for( int i = 0; i < p_sys->i_band; i++ )
     {
         msg_Dbg( p_filter, "   %.2f Hz -> factor:%f alpha:%f beta:%f gamma:%f",
-                 cfg.band[i].f_frequency, p_sys->f_amp[i],
+                 f_freq_table_10b[i], p_params->f_amp[i],
                  p_sys->f_alpha[i], p_sys->f_beta[i], p_sys->f_gamma[i]);
     }
     return VLC_SUCCESS;
-
-error:
-    free( p_sys->f_alpha );
-    free( p_sys->f_beta );
-    free( p_sys->f_gamma );
-    return i_ret;
 }
 
-static void EqzFilter( filter_t *p_filter, float *out, float *in,
-                       int i_samples, int i_channels )
+static void EqzFilter( filter_t *p_filter, float *buf,
+                       unsigned i_samples, unsigned i_channels )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
-    int i, ch, j;
+    eqz_params_t params;
+    unsigned i;
 
-    vlc_mutex_lock( &p_sys->lock );
-    for( i = 0; i < i_samples; i++ )
+    /* Read a consistent copy of the parameters, retrying if the callbacks
+     * went through both copies meanwhile */
+    do
     {
-        for( ch = 0; ch < i_channels; ch++ )
+        i = atomic_load_explicit( &p_sys->i_params, memory_order_acquire );
+        params = p_sys->params[i & 1];
+        atomic_thread_fence( memory_order_acquire );
+    }
+    while( atomic_load_explicit( &p_sys->i_params, memory_order_relaxed ) != i );
+
+    p_sys->pf_filter( p_sys, &params, buf, i_samples, i_channels );
+}
+
+/* Runs the bands of one pass over all the channels of a sample. The inner
+ * loops walk the contiguous channels of the state, so that the compiler can
+ * vectorize them on any target. */
+static void EqzPass_c( const filter_sys_t *p_sys, const eqz_params_t *p_params,
+                       eqz_state_t *st, float *restrict x, float *restrict o,
+                       unsigned i_channels )
+{
+    for( int j = 0; j < p_sys->i_band; j++ )
+    {
+        const float alpha = p_sys->f_alpha[j];
+        const float beta = p_sys->f_beta[j];
+        const float gamma = p_sys->f_gamma[j];
+        const float amp = p_params->f_amp[j];
+        const float *restrict x1 = st->x[1];
+        float *restrict y0 = st->y[j][0];
+        float *restrict y1 = st->y[j][1];
+
+        for( unsigned ch = 0; ch < i_channels; ch++ )
         {
-            const float x = in[ch];
-            float o = 0.0f;
+            float y = alpha * ( x[ch] - x1[ch] ) +
+                      gamma * y0[ch] -
+                      beta  * y1[ch];
 
-            for( j = 0; j < p_sys->i_band; j++ )
-            {
-                float y = p_sys->f_alpha[j] * ( x - p_sys->x[ch][1] ) +
-                          p_sys->f_gamma[j] * p_sys->y[ch][j][0] -
-                          p_sys->f_beta[j]  * p_sys->y[ch][j][1];
+            y1[ch] = y0[ch];
+            y0[ch] = y;
+            o[ch] += y * amp;
+        }
+    }
 
-                p_sys->y[ch][j][1] = p_sys->y[ch][j][0];
-                p_sys->y[ch][j][0] = y;
+    for( unsigned ch = 0; ch < i_channels; ch++ )
+    {
+        st->x[1][ch] = st->x[0][ch];
+        st->x[0][ch] = x[ch];
+    }
+}
 
-                o += y * p_sys->f_amp[j];
-            }
-            p_sys->x[ch][1] = p_sys->x[ch][0];
-            p_sys->x[ch][0] = x;
+static void EqzFilter_c( filter_sys_t *p_sys, const eqz_params_t *p_params,
+                         float *buf, unsigned i_samples, unsigned i_channels )
+{
+    const float gamp = p_params->b_2eqz ? p_params->f_gamp * p_params->f_gamp
+                                        : p_params->f_gamp;
+    float x[EQZ_CHANNELS_MAX], o[EQZ_CHANNELS_MAX];
+
+    for( unsigned i = 0; i < i_samples; i++ )
+    {
+        for( unsigned ch = 0; ch < i_channels; ch++ )
+        {
+            x[ch] = buf[ch];
+            o[ch] = 0.0f;
+        }
 
-            /* Second filter */
-            if( p_sys->b_2eqz )
+        EqzPass_c( p_sys, p_params, &p_sys->state[0], x, o, i_channels );
+        if( p_params->b_2eqz )
+        {
+            for( unsigned ch = 0; ch < i_channels; ch++ )
             {
-                const float x2 = EQZ_IN_FACTOR * x + o;
-                o = 0.0f;
-                for( j = 0; j < p_sys->i_band; j++ )
-                {
-                    float y = p_sys->f_alpha[j] * ( x2 - p_sys->x2[ch][1] ) +
-                              p_sys->f_gamma[j] * p_sys->y2[ch][j][0] -
-                              p_sys->f_beta[j]  * p_sys->y2[ch][j][1];
-
-                    p_sys->y2[ch][j][1] = p_sys->y2[ch][j][0];
-                    p_sys->y2[ch][j][0] = y;
-
-                    o += y * p_sys->f_amp[j];
-                }
-                p_sys->x2[ch][1] = p_sys->x2[ch][0];
-                p_sys->x2[ch][0] = x2;
-
-                /* We add source PCM + filtered PCM */
-                out[ch] = p_sys->f_gamp * p_sys->f_gamp *( EQZ_IN_FACTOR * x2 + o );
+                x[ch] = EQZ_IN_FACTOR * x[ch] + o[ch];
+                o[ch] = 0.0f;
             }
-            else
+            EqzPass_c( p_sys, p_params, &p_sys->state[1], x, o, i_channels );
+        }
+
+        /* We add source PCM + filtered PCM */
+        for( unsigned ch = 0; ch < i_channels; ch++ )
+            buf[ch] = gamp * ( EQZ_IN_FACTOR * x[ch] + o[ch] );
+        buf += i_channels;
+    }
+}
+
+/* The vectorized filters process as many channels as they have lanes at
+ * once, which keeps the per band recursions of each channel independent */
+#ifdef HAVE_SSE2_INTRINSICS
+__attribute__((__target__("sse2")))
+static inline __m128 EqzLoad_sse2( const float *p, unsigned lanes )
+{
+    switch( lanes )
+    {
+        case 1:  return _mm_load_ss( p );
+        case 2:  return _mm_loadl_pi( _mm_setzero_ps(), (const __m64 *)p );
+        case 3:  return _mm_movelh_ps( _mm_loadl_pi( _mm_setzero_ps(),
+                                                     (const __m64 *)p ),
+                                       _mm_load_ss( &p[2] ) );
+        default: return _mm_loadu_ps( p );
+    }
+}
+
+__attribute__((__target__("sse2")))
+static inline void EqzStore_sse2( float *p, unsigned lanes, __m128 v )
+{
+    switch( lanes )
+    {
+        case 1:  _mm_store_ss( p, v ); break;
+        case 2:  _mm_storel_pi( (__m64 *)p, v ); break;
+        case 3:  _mm_storel_pi( (__m64 *)p, v );
+                 _mm_store_ss( &p[2], _mm_movehl_ps( v, v ) ); break;
+        default: _mm_storeu_ps( p, v ); break;
+    }
+}
+
+__attribute__((__target__("sse2")))
+static inline __m128 EqzPass_sse2( const filter_sys_t *p_sys,
+                                   const __m128 *amp, eqz_state_t *st,
+                                   unsigned ch, __m128 x )
+{
+    __m128 x1 = _mm_loadu_ps( &st->x[1][ch] );
+    __m128 o = _mm_setzero_ps();
+
+    for( int j = 0; j < p_sys->i_band; j++ )
+    {
+        __m128 y0 = _mm_loadu_ps( &st->y[j][0][ch] );
+        __m128 y1 = _mm_loadu_ps( &st->y[j][1][ch] );
+        __m128 y = _mm_sub_ps(
+            _mm_add_ps( _mm_mul_ps( _mm_set1_ps( p_sys->f_alpha[j] ),
+                                    _mm_sub_ps( x, x1 ) ),
+                        _mm_mul_ps( _mm_set1_ps( p_sys->f_gamma[j] ), y0 ) ),
+            _mm_mul_ps( _mm_set1_ps( p_sys->f_beta[j] ), y1 ) );
+
+        _mm_storeu_ps( &st->y[j][1][ch], y0 );
+        _mm_storeu_ps( &st->y[j][0][ch], y );
+        o = _mm_add_ps( o, _mm_mul_ps( y, amp[j] ) );
+    }
+    _mm_storeu_ps( &st->x[1][ch], _mm_loadu_ps( &st->x[0][ch] ) );
+    _mm_storeu_ps( &st->x[0][ch], x );
+    return o;
+}
+
+__attribute__((__target__("sse2")))
+static void EqzFilter_sse2( filter_sys_t *p_sys, const eqz_params_t *p_params,
+                            float *buf, unsigned i_samples, unsigned i_channels )
+{
+    const __m128 factor = _mm_set1_ps( EQZ_IN_FACTOR );
+    const __m128 gamp = _mm_set1_ps( p_params->b_2eqz
+                                     ? p_params->f_gamp * p_params->f_gamp
+                                     : p_params->f_gamp );
+    __m128 amp[EQZ_BANDS_MAX];
+
+    for( int j = 0; j < p_sys->i_band; j++ )
+        amp[j] = _mm_set1_ps( p_params->f_amp[j] );
+
+    for( unsigned ch = 0; ch < i_channels; ch += 4 )
+    {
+        const unsigned lanes = __MIN( i_channels - ch, 4 );
+        float *p = &buf[ch];
+
+        for( unsigned i = 0; i < i_samples; i++, p += i_channels )
+        {
+            __m128 x = EqzLoad_sse2( p, lanes ), o;
+
+            o = EqzPass_sse2( p_sys, amp, &p_sys->state[0], ch, x );
+            if( p_params->b_2eqz )
             {
-                /* We add source PCM + filtered PCM */
-                out[ch] = p_sys->f_gamp *( EQZ_IN_FACTOR * x + o );
+                x = _mm_add_ps( _mm_mul_ps( factor, x ), o );
+                o = EqzPass_sse2( p_sys, amp, &p_sys->state[1], ch, x );
             }
+            o = _mm_mul_ps( gamp, _mm_add_ps( _mm_mul_ps( factor, x ), o ) );
+            EqzStore_sse2( p, lanes, o );
         }
+    }
+}
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__((__target__("avx2")))
+static inline __m256 EqzPass_avx2( const filter_sys_t *p_sys,
+                                   const __m256 *amp, eqz_state_t *st,
+                                   unsigned ch, __m256 x )
+{
+    __m256 x1 = _mm256_loadu_ps( &st->x[1][ch] );
+    __m256 o = _mm256_setzero_ps();
 
-        in  += i_channels;
-        out += i_channels;
+    for( int j = 0; j < p_sys->i_band; j++ )
+    {
+        __m256 y0 = _mm256_loadu_ps( &st->y[j][0][ch] );
+        __m256 y1 = _mm256_loadu_ps( &st->y[j][1][ch] );
+        __m256 y = _mm256_sub_ps(
+            _mm256_add_ps( _mm256_mul_ps( _mm256_set1_ps( p_sys->f_alpha[j] ),
+                                          _mm256_sub_ps( x, x1 ) ),
+                           _mm256_mul_ps( _mm256_set1_ps( p_sys->f_gamma[j] ), y0 ) ),
+            _mm256_mul_ps( _mm256_set1_ps( p_sys->f_beta[j] ), y1 ) );
+
+        _mm256_storeu_ps( &st->y[j][1][ch], y0 );
+        _mm256_storeu_ps( &st->y[j][0][ch], y );
+        o = _mm256_add_ps( o, _mm256_mul_ps( y, amp[j] ) );
+    }
+    _mm256_storeu_ps( &st->x[1][ch], _mm256_loadu_ps( &st->x[0][ch] ) );
+    _mm256_storeu_ps( &st->x[0][ch], x );
+    return o;
+}
+
+__attribute__((__target__("avx2")))
+static void EqzFilter_avx2( filter_sys_t *p_sys, const eqz_params_t *p_params,
+                            float *buf, unsigned i_samples, unsigned i_channels )
+{
+    const __m256 factor = _mm256_set1_ps( EQZ_IN_FACTOR );
+    const __m256 gamp = _mm256_set1_ps( p_params->b_2eqz
+                                        ? p_params->f_gamp * p_params->f_gamp
+                                        : p_params->f_gamp );
+    __m256 amp[EQZ_BANDS_MAX];
+
+    for( int j = 0; j < p_sys->i_band; j++ )
+        amp[j] = _mm256_set1_ps( p_params->f_amp[j] );
+
+    for( unsigned ch = 0; ch < i_channels; ch += 8 )
+    {
+        const unsigned lanes = __MIN( i_channels - ch, 8 );
+        const __m256i mask = _mm256_cmpgt_epi32( _mm256_set1_epi32( lanes ),
+                                 _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+        float *p = &buf[ch];
+
+        for( unsigned i = 0; i < i_samples; i++, p += i_channels )
+        {
+            __m256 x = _mm256_maskload_ps( p, mask ), o;
+
+            o = EqzPass_avx2( p_sys, amp, &p_sys->state[0], ch, x );
+            if( p_params->b_2eqz )
+            {
+                x = _mm256_add_ps( _mm256_mul_ps( factor, x ), o );
+                o = EqzPass_avx2( p_sys, amp, &p_sys->state[1], ch, x );
+            }
+            o = _mm256_mul_ps( gamp, _mm256_add_ps( _mm256_mul_ps( factor, x ), o ) );
+            _mm256_maskstore_ps( p, mask, o );
+        }
     }
-    vlc_mutex_unlock( &p_sys->lock );
 }
+#endif
 
 static void EqzClean( filter_t *p_filter )
 {
@@ -457,12 +692,6 @@ static void EqzClean( filter_t *p_filter )
     var_DelCallback( p_aout, "equalizer-preset", PresetCallback, p_sys );
     var_DelCallback( p_aout, "equalizer-preamp", PreampCallback, p_sys );
     var_DelCallback( p_aout, "equalizer-2pass", TwoPassCallback, p_sys );
-
-    free( p_sys->f_alpha );
-    free( p_sys->f_beta );
-    free( p_sys->f_gamma );
-
-    free( p_sys->f_amp );
 }
 
 
@@ -527,9 +756,8 @@ static int PreampCallback( vlc_object_t *p_this, char const *psz_cmd,
     else
         preamp = 10.f;
 
-    vlc_mutex_lock( &p_sys->lock );
-    p_sys->f_gamp = preamp;
-    vlc_mutex_unlock( &p_sys->lock );
+    EqzParamsBegin( p_sys )->f_gamp = preamp;
+    EqzParamsCommit( p_sys );
     return VLC_SUCCESS;
 }
 
@@ -542,7 +770,7 @@ static int BandsCallback( vlc_object_t *p_this, char const *psz_cmd,
     int i = 0;
 
     /* Same thing for bands */
-    vlc_mutex_lock( &p_sys->lock );
+    eqz_params_t *p_params = EqzParamsBegin( p_sys );
     while( i < p_sys->i_band )
     {
         char *next;
@@ -551,15 +779,15 @@ static int BandsCallback( vlc_object_t *p_this, char const *psz_cmd,
         if( next == p || isnan( f ) )
             break; /* no conversion */
 
-        p_sys->f_amp[i++] = EqzConvertdB( f );
+        p_params->f_amp[i++] = EqzConvertdB( f );
 
         if( *next == '\0' )
             break; /* end of line */
         p = &next[1];
     }
     while( i < p_sys->i_band )
-        p_sys->f_amp[i++] = EqzConvertdB( 0.f );
-    vlc_mutex_unlock( &p_sys->lock );
+        p_params->f_amp[i++] = EqzConvertdB( 0.f );
+    EqzParamsCommit( p_sys );
     return VLC_SUCCESS;
 }
 static int TwoPassCallback( vlc_object_t *p_this, char const *psz_cmd,
@@ -568,9 +796,7 @@ static int TwoPassCallback( vlc_object_t *p_this, char const *psz_cmd,
     VLC_UNUSED(p_this); VLC_UNUSED(psz_cmd); VLC_UNUSED(oldval);
     filter_sys_t *p_sys = p_data;
 
-    vlc_mutex_lock( &p_sys->lock );
-    p_sys->b_2eqz = newval.b_bool;
-    vlc_mutex_unlock( &p_sys->lock );
+    EqzParamsBegin( p_sys )->b_2eqz = newval.b_bool;
+    EqzParamsCommit( p_sys );
     return VLC_SUCCESS;
 }
-
@@ -30,6 +30,11 @@
  * It uses a Kaiser-windowed sinc-function low-pass filter and the width of the
  * filter is 13 samples.
  *
+ * When the ratio between the rates is a simple fraction, as between the
+ * usual 44.1, 48 and 96 kHz rates, the interpolated filter coefficients only
+ * take a few distinct values. They are then computed once per phase, and each
+ * output frame is a plain dot product with the input.
+ *
  *****************************************************************************/
 
 #ifdef HAVE_CONFIG_H
@@ -41,8 +46,15 @@
 #include <vlc_aout.h>
 #include <vlc_filter.h>
 #include <vlc_block.h>
+#include <vlc_cpu.h>
 
 #include <assert.h>
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
 
 #include "bandlimited.h"
 
@@ -59,9 +71,20 @@ static void ResampleFloat( filter_t *p_filter,
                            block_t **pp_out_buf,  size_t *pi_out,
                            float **pp_in,
                            int i_in, int i_in_end,
-                           double d_factor, bool b_factor_old,
+                           double d_factor, bool b_factor_old, bool b_poly,
                            int i_nb_channels, int i_bytes_per_frame );
 
+/* Computes one output frame from a window of input frames: the sum, for
+ * each channel, of the coefficients times the interleaved samples */
+typedef void (*poly_dot_t)( float *p_out, const float *p_in,
+                            const float *p_coefs, unsigned i_len,
+                            unsigned i_nb_channels );
+
+/* Taps per phase are padded to a multiple of this, with zero coefficients */
+#define POLY_TAPS_ALIGN 8
+/* Ratios needing more phases are resampled with the generic code */
+#define POLY_MAX_PHASES 1024
+
 /*****************************************************************************
  * Local structures
  *****************************************************************************/
@@ -77,6 +100,22 @@ typedef struct
     bool b_first;
 
     date_t end_date;
+
+    /* Polyphase tables, for one pair of rates */
+    struct
+    {
+        float *p_coefs;            /* i_phases x i_taps x channels, or NULL */
+        unsigned i_in_rate, i_out_rate;
+        unsigned i_gcd;             /* the remainder is a multiple of it */
+        unsigned i_phases;
+        unsigned i_taps;
+        unsigned i_left;     /* taps up to and including the current frame */
+        bool b_up;
+        poly_dot_t pf_dot;
+
+        float *p_in;     /* padded copy of the input, for the whole window */
+        size_t i_in_size;
+    } poly;
 } filter_sys_t;
 
 /*****************************************************************************
@@ -94,6 +133,305 @@ vlc_module_begin ()
     set_callbacks( OpenFilter, CloseFilter )
 vlc_module_end ()
 
+/*****************************************************************************
+ * Polyphase resampling
+ *****************************************************************************/
+static void PolyDot_c( float *p_out, const float *p_in, const float *p_coefs,
+                       unsigned i_len, unsigned i_nb_channels )
+{
+    for( unsigned c = 0; c < i_nb_channels; c++ )
+    {
+        float f_sum = 0.f;
+        for( unsigned i = c; i < i_len; i += i_nb_channels )
+            f_sum += p_coefs[i] * p_in[i];
+        p_out[c] = f_sum;
+    }
+}
+
+/* The window is a multiple of 8 frames. It is summed in blocks of i_acc
+ * vectors, so that every block starts on the first channel, and the lanes
+ * of the sums are folded into the channels at the end. These are inlined
+ * with a constant i_acc, so that the sums stay in registers. */
+#ifdef HAVE_SSE2_INTRINSICS
+__attribute__((__target__("sse2"), __always_inline__))
+static inline void PolyDotN_sse2( float *p_out, const float *p_in,
+                                  const float *p_coefs, unsigned i_len,
+                                  unsigned i_nb_channels, unsigned i_acc )
+{
+    __m128 sum[7];
+    float tmp[7 * 4];
+
+    for( unsigned a = 0; a < i_acc; a++ )
+        sum[a] = _mm_setzero_ps();
+    for( unsigned i = 0; i < i_len; i += 4 * i_acc )
+        for( unsigned a = 0; a < i_acc; a++ )
+            sum[a] = _mm_add_ps( sum[a],
+                                 _mm_mul_ps( _mm_loadu_ps( &p_coefs[i + 4 * a] ),
+                                             _mm_loadu_ps( &p_in[i + 4 * a] ) ) );
+    for( unsigned a = 0; a < i_acc; a++ )
+        _mm_storeu_ps( &tmp[4 * a], sum[a] );
+
+    for( unsigned c = 0; c < i_nb_channels; c++ )
+    {
+        float f_sum = 0.f;
+        for( unsigned k = c; k < 4 * i_acc; k += i_nb_channels )
+            f_sum += tmp[k];
+        p_out[c] = f_sum;
+    }
+}
+
+__attribute__((__target__("sse2")))
+static void PolyDot_sse2( float *p_out, const float *p_in, const float *p_coefs,
+                          unsigned i_len, unsigned i_nb_channels )
+{
+    switch( i_nb_channels )
+    {
+        case 1: case 2: case 4: case 8:
+            PolyDotN_sse2( p_out, p_in, p_coefs, i_len, i_nb_channels, 2 );
+            break;
+        case 3: case 6:
+            PolyDotN_sse2( p_out, p_in, p_coefs, i_len, i_nb_channels, 3 );
+            break;
+        case 5:
+            PolyDotN_sse2( p_out, p_in, p_coefs, i_len, i_nb_channels, 5 );
+            break;
+        case 7:
+            PolyDotN_sse2( p_out, p_in, p_coefs, i_len, i_nb_channels, 7 );
+            break;
+        default:
+            PolyDot_c( p_out, p_in, p_coefs, i_len, i_nb_channels );
+    }
+}
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__((__target__("avx2"), __always_inline__))
+static inline void PolyDotN_avx2( float *p_out, const float *p_in,
+                                  const float *p_coefs, unsigned i_len,
+                                  unsigned i_nb_channels, unsigned i_acc )
+{
+    __m256 sum[7];
+    float tmp[7 * 8];
+
+    for( unsigned a = 0; a < i_acc; a++ )
+        sum[a] = _mm256_setzero_ps();
+    for( unsigned i = 0; i < i_len; i += 8 * i_acc )
+        for( unsigned a = 0; a < i_acc; a++ )
+            sum[a] = _mm256_add_ps( sum[a],
+                        _mm256_mul_ps( _mm256_loadu_ps( &p_coefs[i + 8 * a] ),
+                                       _mm256_loadu_ps( &p_in[i + 8 * a] ) ) );
+    for( unsigned a = 0; a < i_acc; a++ )
+        _mm256_storeu_ps( &tmp[8 * a], sum[a] );
+
+    for( unsigned c = 0; c < i_nb_channels; c++ )
+    {
+        float f_sum = 0.f;
+        for( unsigned k = c; k < 8 * i_acc; k += i_nb_channels )
+            f_sum += tmp[k];
+        p_out[c] = f_sum;
+    }
+}
+
+__attribute__((__target__("avx2")))
+static void PolyDot_avx2( float *p_out, const float *p_in, const float *p_coefs,
+                          unsigned i_len, unsigned i_nb_channels )
+{
+    switch( i_nb_channels )
+    {
+        case 1: case 2: case 4: case 8:
+            PolyDotN_avx2( p_out, p_in, p_coefs, i_len, i_nb_channels, 1 );
+            break;
+        case 3: case 6:
+            PolyDotN_avx2( p_out, p_in, p_coefs, i_len, i_nb_channels, 3 );
+            break;
+        case 5:
+            PolyDotN_avx2( p_out, p_in, p_coefs, i_len, i_nb_channels, 5 );
+            break;
+        case 7:
+            PolyDotN_avx2( p_out, p_in, p_coefs, i_len, i_nb_channels, 7 );
+            break;
+        default:
+            PolyDot_c( p_out, p_in, p_coefs, i_len, i_nb_channels );
+    }
+}
+#endif
+
+/* Best first, the last one is always usable */
+static const struct
+{
+    poly_dot_t  pf_dot;
+    unsigned    i_cpu;
+    const char *psz_name;
+} poly_kernels[] =
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    { PolyDot_avx2, VLC_CPU_AVX2, "avx2" },
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    { PolyDot_sse2, VLC_CPU_SSE2, "sse2" },
+#endif
+    { PolyDot_c, 0, "c" },
+};
+
+/* Computes the coefficients of one wing exactly as FilterFloatUP() and
+ * FilterFloatUD() interpolate them, and returns their count */
+static unsigned PolyWing( float *p_taps, bool b_up, bool b_right,
+                          uint32_t ui_remainder,
+                          uint32_t ui_output_rate, uint32_t ui_input_rate )
+{
+    const float *Imp = SMALL_FILTER_FLOAT_IMP, *ImpD = SMALL_FILTER_FLOAT_IMPD;
+    /* the right wing drops its last coefficient */
+    const uint32_t ui_end = SMALL_FILTER_NWING - b_right;
+    unsigned n = 0;
+
+    if( b_up )
+    {
+        uint32_t ui_idx = (ui_remainder<<Nhc) / ui_output_rate;
+        uint32_t ui_linear_remainder =
+            (ui_remainder<<Nhc) - ui_idx * ui_output_rate;
+
+        if( b_right && ui_remainder == 0 )
+            ui_idx += Npc;
+        for( ; ui_idx < ui_end; ui_idx += Npc )
+            p_taps[n++] = Imp[ui_idx] +
+                ImpD[ui_idx] * ui_linear_remainder / ui_output_rate / Npc;
+    }
+    else
+    {
+        for( uint32_t ui_counter = b_right && ui_remainder == 0; ;
+             ui_counter++ )
+        {
+            uint32_t ui_pos = (ui_output_rate * ui_counter + ui_remainder) << Nhc;
+            uint32_t ui_idx = ui_pos / ui_input_rate;
+            if( ui_idx >= ui_end )
+                break;
+
+            uint32_t ui_linear_remainder = ui_pos - ui_idx * ui_input_rate;
+            p_taps[n++] = Imp[ui_idx] +
+                ImpD[ui_idx] * ui_linear_remainder / ui_input_rate / Npc;
+        }
+    }
+    return n;
+}
+
+/* Lays out one phase as the coefficients of a window of i_taps frames,
+ * starting i_left - 1 frames before the current one */
+static void PolyPhase( float *p_coefs, float *p_taps, unsigned *pi_left,
+                       unsigned *pi_right, bool b_up, uint32_t ui_remainder,
+                       uint32_t ui_output_rate, uint32_t ui_input_rate,
+                       unsigned i_left, unsigned i_nb_channels )
+{
+    unsigned i_nl = PolyWing( p_taps, b_up, false, ui_remainder,
+                              ui_output_rate, ui_input_rate );
+    if( p_coefs != NULL )
+        for( unsigned j = 0; j < i_nl; j++ )
+            for( unsigned c = 0; c < i_nb_channels; c++ )
+                p_coefs[(i_left - 1 - j) * i_nb_channels + c] = p_taps[j];
+
+    unsigned i_nr = PolyWing( p_taps, b_up, true,
+                              ui_output_rate - ui_remainder,
+                              ui_output_rate, ui_input_rate );
+    if( p_coefs != NULL )
+        for( unsigned j = 0; j < i_nr; j++ )
+            for( unsigned c = 0; c < i_nb_channels; c++ )
+                p_coefs[(i_left + j) * i_nb_channels + c] = p_taps[j];
+
+    *pi_left = i_nl;
+    *pi_right = i_nr;
+}
+
+static void PolyInit( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const unsigned i_in_rate = p_filter->fmt_in.audio.i_rate;
+    const unsigned i_out_rate = p_filter->fmt_out.audio.i_rate;
+    const unsigned i_nb_channels = p_filter->fmt_in.audio.i_channels;
+    const unsigned i_gcd = GCD( i_in_rate, i_out_rate );
+    const unsigned i_phases = i_out_rate / i_gcd;
+    const bool b_up = i_out_rate >= i_in_rate;
+    unsigned i_left = 0, i_right = 0, i_nl, i_nr;
+
+    p_sys->poly.p_coefs = NULL;
+    p_sys->poly.p_in = NULL;
+    p_sys->poly.i_in_size = 0;
+    if( i_phases > POLY_MAX_PHASES )
+        return;
+
+    float *p_taps = vlc_alloc( SMALL_FILTER_NWING, sizeof (float) );
+    if( unlikely(p_taps == NULL) )
+        return;
+
+    for( unsigned p = 0; p < i_phases; p++ )
+    {
+        PolyPhase( NULL, p_taps, &i_nl, &i_nr, b_up, p * i_gcd,
+                   i_out_rate, i_in_rate, 0, i_nb_channels );
+        i_left = __MAX( i_left, i_nl );
+        i_right = __MAX( i_right, i_nr );
+    }
+
+    unsigned i_taps = (i_left + i_right + POLY_TAPS_ALIGN - 1)
+                    / POLY_TAPS_ALIGN * POLY_TAPS_ALIGN;
+    float *p_coefs = calloc( (size_t)i_phases * i_taps * i_nb_channels,
+                             sizeof (float) );
+    if( unlikely(p_coefs == NULL) )
+    {
+        free( p_taps );
+        return;
+    }
+
+    for( unsigned p = 0; p < i_phases; p++ )
+        PolyPhase( p_coefs + (size_t)p * i_taps * i_nb_channels, p_taps,
+                   &i_nl, &i_nr, b_up, p * i_gcd, i_out_rate, i_in_rate,
+                   i_left, i_nb_channels );
+    free( p_taps );
+
+    const unsigned i_cpu = vlc_CPU();
+    size_t k = 0;
+    while( ( i_cpu & poly_kernels[k].i_cpu ) != poly_kernels[k].i_cpu )
+        k++;
+
+    p_sys->poly.p_coefs    = p_coefs;
+    p_sys->poly.i_in_rate  = i_in_rate;
+    p_sys->poly.i_out_rate = i_out_rate;
+    p_sys->poly.i_gcd      = i_gcd;
+    p_sys->poly.i_phases   = i_phases;
+    p_sys->poly.i_taps     = i_taps;
+    p_sys->poly.i_left     = i_left;
+    p_sys->poly.b_up       = b_up;
+    p_sys->poly.pf_dot     = poly_kernels[k].pf_dot;
+
+    msg_Dbg( p_filter, "%u phases of %u taps, %s", i_phases, i_taps,
+             poly_kernels[k].psz_name );
+}
+
+/* Copies the input with i_taps frames of zeros on each side, so that the
+ * whole window of any output frame can be read */
+static float *PolyLoad( filter_sys_t *p_sys, const float *p_in,
+                        size_t i_in_nb, unsigned i_nb_channels )
+{
+    const size_t i_pad = p_sys->poly.i_taps * i_nb_channels;
+    const size_t i_size = (i_in_nb * i_nb_channels + 2 * i_pad) * sizeof (float);
+
+    if( i_size > p_sys->poly.i_in_size )
+    {
+        free( p_sys->poly.p_in );
+        p_sys->poly.p_in = malloc( i_size );
+        if( unlikely(p_sys->poly.p_in == NULL) )
+        {
+            p_sys->poly.i_in_size = 0;
+            return NULL;
+        }
+        p_sys->poly.i_in_size = i_size;
+    }
+
+    float *p_buf = p_sys->poly.p_in;
+    memset( p_buf, 0, i_pad * sizeof (float) );
+    memcpy( p_buf + i_pad, p_in, i_in_nb * i_nb_channels * sizeof (float) );
+    memset( p_buf + i_pad + i_in_nb * i_nb_channels, 0,
+            i_pad * sizeof (float) );
+    return p_buf + i_pad;
+}
+
 /*****************************************************************************
  * Resample: convert a buffer
  *****************************************************************************/
@@ -143,8 +481,8 @@ static block_t *Resample( filter_t * p_filter, block_t * p_in_buf )
                                  p_filter->fmt_out.audio.i_bitspersample / 8;
     size_t i_out_size = i_bytes_per_frame * ( 1 + ( p_in_buf->i_nb_samples *
               p_filter->fmt_out.audio.i_rate / p_filter->fmt_in.audio.i_rate) )
-            + p_filter->p_sys->i_buf_size;
-    block_t *p_out_buf = block_Alloc( i_out_size );
+            + p_sys->i_buf_size;
+    block_t *p_out_buf = filter_NewAudioBuffer( p_filter, i_out_size );
     if( !p_out_buf )
     {
         block_Release( p_in_buf );
@@ -166,7 +504,7 @@ static block_t *Resample( filter_t * p_filter, block_t * p_in_buf )
 
     size_t i_in_nb = p_in_buf->i_nb_samples;
     size_t i_in, i_out = 0;
-    double d_factor, d_scale_factor, d_old_scale_factor;
+    double d_factor;
     size_t i_filter_wing;
 
 #if 0
@@ -193,19 +531,30 @@ static block_t *Resample( filter_t * p_filter, block_t * p_in_buf )
     }
     i_in_nb += (p_sys->i_old_wing * 2);
     float *p_in = (float *)p_in_buf->p_buffer;
-    const float *p_in_orig = p_in;
 
     /* Make sure the output buffer is reset */
     memset( p_out_buf->p_buffer, 0, p_out_buf->i_buffer );
 
     /* Calculate the new length of the filter wing */
     d_factor = (double)i_out_rate / p_filter->fmt_in.audio.i_rate;
-    i_filter_wing = ((SMALL_FILTER_NMULT+1)/2.0) * __MAX(1.0,1.0/d_factor) + 1;
 
-    /* Account for increased filter gain when using factors less than 1 */
-    d_old_scale_factor = SMALL_FILTER_SCALE *
-        p_sys->d_old_factor + 0.5;
-    d_scale_factor = SMALL_FILTER_SCALE * d_factor + 0.5;
+    /* Use the polyphase tables if they match the rates, working on a padded
+     * copy of the input */
+    bool b_poly = p_sys->poly.p_coefs != NULL
+               && p_sys->poly.i_in_rate == p_filter->fmt_in.audio.i_rate
+               && p_sys->poly.i_out_rate == i_out_rate
+               && ( p_sys->i_old_wing == 0 || p_sys->d_old_factor == d_factor );
+    if( b_poly )
+    {
+        float *p_copy = PolyLoad( p_sys, p_in, i_in_nb, i_nb_channels );
+        if( p_copy != NULL )
+            p_in = p_copy;
+        else
+            b_poly = false;
+    }
+    const float *p_in_orig = p_in;
+
+    i_filter_wing = ((SMALL_FILTER_NMULT+1)/2.0) * __MAX(1.0,1.0/d_factor) + 1;
 
     /* Apply the old rate until we have enough samples for the new one */
     i_in = p_sys->i_old_wing;
@@ -218,7 +567,7 @@ static block_t *Resample( filter_t * p_filter, block_t * p_in_buf )
     ResampleFloat( p_filter,
                    &p_out_buf, &i_out, &p_in,
                    i_in, i_old_in_end,
-                   p_sys->d_old_factor, true,
+                   p_sys->d_old_factor, true, b_poly,
                    i_nb_channels, i_bytes_per_frame );
     i_in = __MAX( i_in, i_old_in_end );
 
@@ -233,7 +582,7 @@ static block_t *Resample( filter_t * p_filter, block_t * p_in_buf )
         ResampleFloat( p_filter,
                        &p_out_buf, &i_out, &p_in,
                        i_in, i_in_nb - i_filter_wing,
-                       d_factor, false,
+                       d_factor, false, b_poly,
                        i_nb_channels, i_bytes_per_frame );
 
         /* Finalize aout buffer */
@@ -297,7 +646,7 @@ static int OpenFilter( vlc_object_t *p_this )
     }
 
     /* Allocate the memory needed to store the module's structure */
-    p_filter->p_sys = p_sys = malloc( sizeof(struct filter_sys_t) );
+    p_filter->p_sys = p_sys = malloc( sizeof(*p_sys) );
     if( p_sys == NULL )
         return VLC_ENOMEM;
 
@@ -308,6 +657,8 @@ static int OpenFilter( vlc_object_t *p_this )
     p_sys->b_first = true;
     p_filter->pf_audio_filter = Resample;
 
+    PolyInit( p_filter );
+
     msg_Dbg( p_this, "%4.4s/%iKHz/%i->%4.4s/%iKHz/%i",
              (char *)&p_filter->fmt_in.i_codec,
              p_filter->fmt_in.audio.i_rate,
@@ -328,8 +679,12 @@ static int OpenFilter( vlc_object_t *p_this )
 static void CloseFilter( vlc_object_t *p_this )
 {
     filter_t *p_filter = (filter_t *)p_this;
-    free( p_filter->p_sys->p_buf );
-    free( p_filter->p_sys );
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    free( p_sys->poly.p_in );
+    free( p_sys->poly.p_coefs );
+    free( p_sys->p_buf );
+    free( p_sys );
 }
 
 static void FilterFloatUP( const float Imp[], const float ImpD[], uint16_t Nwing, float *p_in,
@@ -455,10 +810,13 @@ static void ResampleFloat( filter_t *p_filter,
                            block_t **pp_out_buf,  size_t *pi_out,
                            float **pp_in,
                            int i_in, int i_in_end,
-                           double d_factor, bool b_factor_old,
+                           double d_factor, bool b_factor_old, bool b_poly,
                            int i_nb_channels, int i_bytes_per_frame )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
+    const unsigned i_len = p_sys->poly.i_taps * i_nb_channels;
+
+    b_poly = b_poly && ( d_factor >= 1 ) == p_sys->poly.b_up;
 
     float *p_in = *pp_in;
     size_t i_out = *pi_out;
@@ -485,7 +843,16 @@ static void ResampleFloat( filter_t *p_filter,
                                i_out, i_nb_channels, i_bytes_per_frame ) )
                 return;
 
-            if( d_factor >= 1 )
+            if( b_poly && p_sys->i_remainder % p_sys->poly.i_gcd == 0 )
+            {
+                const float *p_coefs = p_sys->poly.p_coefs +
+                    (size_t)(p_sys->i_remainder / p_sys->poly.i_gcd) * i_len;
+
+                p_sys->poly.pf_dot( p_out,
+                    p_in - (p_sys->poly.i_left - 1) * i_nb_channels,
+                    p_coefs, i_len, i_nb_channels );
+            }
+            else if( d_factor >= 1 )
             {
                 /* FilterFloatUP() is faster if we can use it */
 
@@ -502,14 +869,6 @@ static void ResampleFloat( filter_t *p_filter,
                                p_sys->i_remainder,
                                p_filter->fmt_out.audio.i_rate,
                                1, i_nb_channels );
-
-#if 0
-                /* Normalize for unity filter gain */
-                for( i = 0; i < i_nb_channels; i++ )
-                {
-                    *(p_out+i) *= d_old_scale_factor;
-                }
-#endif
             }
             else
             {
@@ -541,5 +900,3 @@ static void ResampleFloat( filter_t *p_filter,
     *pp_in  = p_in;
     *pi_out = i_out;
 }
-
-
@@ -34,8 +34,16 @@
 #include <vlc_filter.h>
 #include <vlc_modules.h>
 
+#include <vlc_cpu.h>
+
 #include <string.h> /* for memset */
 #include <limits.h> /* form INT_MIN */
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
 
 /*****************************************************************************
  * Module descriptor
@@ -68,6 +76,10 @@ vlc_module_begin ()
         N_("Overlap Length"), N_("Percentage of stride to overlap"), true )
     add_integer_with_range( "scaletempo-search", 14, 0, 200,
         N_("Search Length"), N_("Length in milliseconds to search for best overlap position"), true )
+    add_integer_with_range( "scaletempo-coarse", 1, 1, 16,
+        N_("Coarse Search Decimation"),
+        N_("Search the best overlap position on audio decimated by this factor "
+           "first, then refine around it at full rate. 1 searches every position."), true )
 #ifdef PITCH_SHIFTER
     add_float_with_range( "pitch-shift", 0, -12, 12,
         N_("Pitch Shift"), N_("Pitch shift in semitones."), false )
@@ -102,6 +114,7 @@ typedef struct
     unsigned  ms_stride;
     double    percent_overlap;
     unsigned  ms_search;
+    unsigned  frames_decimate;
     /* audio format */
     unsigned  samples_per_frame;  /* AKA number of channels */
     unsigned  bytes_per_sample;
@@ -128,6 +141,10 @@ typedef struct
     unsigned  frames_search;
     void     *buf_pre_corr;
     void     *table_window;
+    void     *buf_pre_corr_coarse;
+    void     *buf_queue_coarse;
+    float   (*corr)( const float *a, const float *b, unsigned n );
+    const char *corr_name;
     unsigned(*best_overlap_offset)( filter_t *p_filter );
 #ifdef PITCH_SHIFTER
     /* pitch */
@@ -136,16 +153,100 @@ typedef struct
 #endif
 } filter_sys_t;
 
+/*****************************************************************************
+ * corr: dot product of the windowed overlap with a search position
+ *****************************************************************************/
+static float corr_float_c( const float *a, const float *b, unsigned n )
+{
+    float corr = 0;
+    for( unsigned i = 0; i < n; i++ )
+        corr += a[i] * b[i];
+    return corr;
+}
+
+#ifdef HAVE_SSE2_INTRINSICS
+__attribute__((__target__("sse2")))
+static float corr_float_sse2( const float *a, const float *b, unsigned n )
+{
+    __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+    unsigned i = 0;
+
+    for( ; i + 8 <= n; i += 8 )
+    {
+        sum0 = _mm_add_ps( sum0, _mm_mul_ps( _mm_loadu_ps( &a[i] ),
+                                             _mm_loadu_ps( &b[i] ) ) );
+        sum1 = _mm_add_ps( sum1, _mm_mul_ps( _mm_loadu_ps( &a[i + 4] ),
+                                             _mm_loadu_ps( &b[i + 4] ) ) );
+    }
+    sum0 = _mm_add_ps( sum0, sum1 );
+    sum0 = _mm_add_ps( sum0, _mm_movehl_ps( sum0, sum0 ) );
+    sum0 = _mm_add_ss( sum0, _mm_shuffle_ps( sum0, sum0, 1 ) );
+
+    float corr = _mm_cvtss_f32( sum0 );
+    for( ; i < n; i++ )
+        corr += a[i] * b[i];
+    return corr;
+}
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__((__target__("avx2")))
+static float corr_float_avx2( const float *a, const float *b, unsigned n )
+{
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    unsigned i = 0;
+
+    for( ; i + 16 <= n; i += 16 )
+    {
+        sum0 = _mm256_add_ps( sum0, _mm256_mul_ps( _mm256_loadu_ps( &a[i] ),
+                                                   _mm256_loadu_ps( &b[i] ) ) );
+        sum1 = _mm256_add_ps( sum1, _mm256_mul_ps( _mm256_loadu_ps( &a[i + 8] ),
+                                                   _mm256_loadu_ps( &b[i + 8] ) ) );
+    }
+    sum0 = _mm256_add_ps( sum0, sum1 );
+    if( i + 8 <= n )
+    {
+        sum0 = _mm256_add_ps( sum0, _mm256_mul_ps( _mm256_loadu_ps( &a[i] ),
+                                                   _mm256_loadu_ps( &b[i] ) ) );
+        i += 8;
+    }
+
+    __m128 sum = _mm_add_ps( _mm256_castps256_ps128( sum0 ),
+                             _mm256_extractf128_ps( sum0, 1 ) );
+    sum = _mm_add_ps( sum, _mm_movehl_ps( sum, sum ) );
+    sum = _mm_add_ss( sum, _mm_shuffle_ps( sum, sum, 1 ) );
+
+    float corr = _mm_cvtss_f32( sum );
+    for( ; i < n; i++ )
+        corr += a[i] * b[i];
+    return corr;
+}
+#endif
+
+/* Best first, the last one is always usable */
+static const struct
+{
+    float     (*corr)( const float *, const float *, unsigned );
+    unsigned    cpu;
+    const char *name;
+} corr_kernels[] =
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    { corr_float_avx2, VLC_CPU_AVX2, "avx2" },
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    { corr_float_sse2, VLC_CPU_SSE2, "sse2" },
+#endif
+    { corr_float_c, 0, "c" },
+};
+
 /*****************************************************************************
  * best_overlap_offset: calculate best offset for overlap
  *****************************************************************************/
-static unsigned best_overlap_offset_float( filter_t *p_filter )
+static void pre_corr_float( filter_sys_t *p )
 {
-    filter_sys_t *p = p_filter->p_sys;
-    float *pw, *po, *ppc, *search_start;
-    float best_corr = INT_MIN;
-    unsigned best_off = 0;
-    unsigned i, off;
+    float *pw, *po, *ppc;
+    unsigned i;
 
     pw  = p->table_window;
     po  = p->buf_overlap;
@@ -154,15 +255,22 @@ static unsigned best_overlap_offset_float( filter_t *p_filter )
     for( i = p->samples_per_frame; i < p->samples_overlap; i++ ) {
       *ppc++ = *pw++ * *po++;
     }
+}
+
+static unsigned best_overlap_offset_float( filter_t *p_filter )
+{
+    filter_sys_t *p = p_filter->p_sys;
+    const unsigned samples_corr = p->samples_overlap - p->samples_per_frame;
+    float *search_start;
+    float best_corr = INT_MIN;
+    unsigned best_off = 0;
+    unsigned off;
+
+    pre_corr_float( p );
 
     search_start = (float *)p->buf_queue + p->samples_per_frame;
     for( off = 0; off < p->frames_search; off++ ) {
-      float corr = 0;
-      float *ps = search_start;
-      ppc = p->buf_pre_corr;
-      for( i = p->samples_per_frame; i < p->samples_overlap; i++ ) {
-        corr += *ppc++ * *ps++;
-      }
+      float corr = p->corr( p->buf_pre_corr, search_start, samples_corr );
       if( corr > best_corr ) {
         best_corr = corr;
         best_off  = off;
@@ -173,6 +281,75 @@ static unsigned best_overlap_offset_float( filter_t *p_filter )
     return best_off * p->bytes_per_frame;
 }
 
+/* Sums each run of "decimate" frames, i.e. a box filter followed by a
+ * decimation, which is all the coarse search needs */
+static void decimate_float( float *dst, const float *src, unsigned frames,
+                            unsigned decimate, unsigned samples_per_frame )
+{
+    for( unsigned i = 0; i < frames; i++ )
+    {
+        for( unsigned j = 0; j < samples_per_frame; j++ )
+            dst[j] = src[j];
+        src += samples_per_frame;
+        for( unsigned k = 1; k < decimate; k++ )
+        {
+            for( unsigned j = 0; j < samples_per_frame; j++ )
+                dst[j] += src[j];
+            src += samples_per_frame;
+        }
+        dst += samples_per_frame;
+    }
+}
+
+static unsigned best_overlap_offset_coarse_float( filter_t *p_filter )
+{
+    filter_sys_t *p = p_filter->p_sys;
+    const unsigned spf = p->samples_per_frame;
+    const unsigned dec = p->frames_decimate;
+    const unsigned frames_corr = p->samples_overlap / spf - 1;
+    const unsigned frames_corr_coarse = frames_corr / dec;
+    const unsigned frames_search_coarse = ( p->frames_search + dec - 1 ) / dec;
+    const float *search_start;
+    float best_corr = INT_MIN;
+    unsigned best_off = 0;
+    unsigned off, off_min, off_max;
+
+    pre_corr_float( p );
+
+    /* coarse search, every "dec" frames on decimated audio */
+    decimate_float( p->buf_pre_corr_coarse, p->buf_pre_corr,
+                    frames_corr_coarse, dec, spf );
+    decimate_float( p->buf_queue_coarse, (float *)p->buf_queue + spf,
+                    frames_search_coarse + frames_corr_coarse - 1, dec, spf );
+
+    search_start = p->buf_queue_coarse;
+    for( off = 0; off < frames_search_coarse; off++ ) {
+      float corr = p->corr( p->buf_pre_corr_coarse, search_start,
+                            frames_corr_coarse * spf );
+      if( corr > best_corr ) {
+        best_corr = corr;
+        best_off  = off;
+      }
+      search_start += spf;
+    }
+
+    /* refine around the coarse position at full rate */
+    off_min = best_off * dec >= dec - 1 ? best_off * dec - ( dec - 1 ) : 0;
+    off_max = __MIN( best_off * dec + dec, p->frames_search );
+    best_corr = INT_MIN;
+    search_start = (float *)p->buf_queue + ( off_min + 1 ) * spf;
+    for( off = off_min; off < off_max; off++ ) {
+      float corr = p->corr( p->buf_pre_corr, search_start, frames_corr * spf );
+      if( corr > best_corr ) {
+        best_corr = corr;
+        best_off  = off;
+      }
+      search_start += spf;
+    }
+
+    return best_off * p->bytes_per_frame;
+}
+
 /*****************************************************************************
  * output_overlap: blend end of previous stride with beginning of current stride
  *****************************************************************************/
@@ -361,6 +538,25 @@ static int reinit_buffers( filter_t *p_filter )
                 *pw++ = v;
         }
         p->best_overlap_offset = best_overlap_offset_float;
+
+        unsigned frames_corr_coarse = ( frames_overlap - 1 ) / p->frames_decimate;
+        if( p->frames_decimate > 1 && frames_corr_coarse > 0 )
+        {
+            unsigned frames_search_coarse =
+                ( p->frames_search + p->frames_decimate - 1 ) / p->frames_decimate;
+            p->buf_pre_corr_coarse = vlc_alloc( frames_corr_coarse,
+                                                p->bytes_per_frame );
+            p->buf_queue_coarse = vlc_alloc( frames_search_coarse + frames_corr_coarse,
+                                             p->bytes_per_frame );
+            if( !p->buf_pre_corr_coarse || !p->buf_queue_coarse )
+                return VLC_ENOMEM;
+            p->best_overlap_offset = best_overlap_offset_coarse_float;
+        }
+
+        unsigned cpu = vlc_CPU();
+        for( i = 0; ( cpu & corr_kernels[i].cpu ) != corr_kernels[i].cpu; i++ );
+        p->corr      = corr_kernels[i].corr;
+        p->corr_name = corr_kernels[i].name;
     }
 
     unsigned new_size = ( p->frames_search + frames_stride + frames_overlap ) * p->bytes_per_frame;
@@ -390,13 +586,15 @@ static int reinit_buffers( filter_t *p_filter )
     p->frames_stride_scaled = p->bytes_stride_scaled / p->bytes_per_frame;
 
     msg_Dbg( VLC_OBJECT(p_filter),
-             "%.3f scale, %.3f stride_in, %i stride_out, %i standing, %i overlap, %i search, %i queue, %s mode",
+             "%.3f scale, %.3f stride_in, %i stride_out, %i standing, %i overlap, %i search (%s, 1/%u), %i queue, %s mode",
              p->scale,
              p->frames_stride_scaled,
              (int)( p->bytes_stride / p->bytes_per_frame ),
              (int)( p->bytes_standing / p->bytes_per_frame ),
              (int)( p->bytes_overlap / p->bytes_per_frame ),
              p->frames_search,
+             p->best_overlap_offset ? p->corr_name : "none",
+             p->best_overlap_offset == best_overlap_offset_coarse_float ? p->frames_decimate : 1,
              (int)( p->bytes_queue_max / p->bytes_per_frame ),
              "fl32");
 
@@ -430,15 +628,19 @@ static int Open( vlc_object_t *p_this )
     p_sys->ms_stride       = var_InheritInteger( p_this, "scaletempo-stride" );
     p_sys->percent_overlap = var_InheritFloat( p_this, "scaletempo-overlap" );
     p_sys->ms_search       = var_InheritInteger( p_this, "scaletempo-search" );
+    p_sys->frames_decimate = var_InheritInteger( p_this, "scaletempo-coarse" );
 
-    msg_Dbg( p_this, "params: %i stride, %.3f overlap, %i search",
-             p_sys->ms_stride, p_sys->percent_overlap, p_sys->ms_search );
+    msg_Dbg( p_this, "params: %i stride, %.3f overlap, %i search, %u coarse",
+             p_sys->ms_stride, p_sys->percent_overlap, p_sys->ms_search,
+             p_sys->frames_decimate );
 
     p_sys->buf_queue      = NULL;
     p_sys->buf_overlap    = NULL;
     p_sys->table_blend    = NULL;
     p_sys->buf_pre_corr   = NULL;
     p_sys->table_window   = NULL;
+    p_sys->buf_pre_corr_coarse = NULL;
+    p_sys->buf_queue_coarse    = NULL;
     p_sys->bytes_overlap  = 0;
     p_sys->bytes_queued   = 0;
     p_sys->bytes_to_slide = 0;
@@ -536,6 +738,8 @@ static void Close( vlc_object_t *p_this )
     free( p_sys->table_blend );
     free( p_sys->buf_pre_corr );
     free( p_sys->table_window );
+    free( p_sys->buf_pre_corr_coarse );
+    free( p_sys->buf_queue_coarse );
     free( p_sys );
 }
 
@@ -576,7 +780,7 @@ static block_t *DoWork( filter_t * p_filter, block_t * p_in_buf )
     }
 
     size_t i_outsize = calculate_output_buffer_size ( p_filter, p_in_buf->i_buffer );
-    block_t *p_out_buf = block_Alloc( i_outsize );
+    block_t *p_out_buf = filter_NewAudioBuffer( p_filter, i_outsize );
     if( p_out_buf == NULL )
     {
         block_Release( p_in_buf );
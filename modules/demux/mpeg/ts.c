@@ -192,6 +192,7 @@ static bool GatherSectionsData( demux_t *p_demux, ts_pid_t *, block_t *, size_t
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, stime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static unsigned SkipDiscardableTSPackets( demux_t *p_demux, unsigned i_max );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, stime_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, stime_t );
@@ -635,6 +636,12 @@ static int Demux( demux_t *p_demux )
         bool         b_frame = false;
         int          i_header = 0;
         block_t     *p_pkt;
+
+        /* Drop packets nobody wants straight from the stream buffer */
+        i_pkt += SkipDiscardableTSPackets( p_demux, p_sys->i_ts_read - i_pkt );
+        if( i_pkt >= p_sys->i_ts_read )
+            break;
+
         if( !(p_pkt = ReadTSPacket( p_demux )) )
         {
             return VLC_DEMUXER_EOF;
@@ -1799,6 +1806,118 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     return p_pkt;
 }
 
+/* Returns the PID of the packet if it would be dropped by Demux() without
+ * having any side effect other than continuity tracking, so that it does not
+ * need to be materialized as a block, or NULL otherwise. This does not change
+ * any state: see SkippedTSPacket(). */
+static ts_pid_t *GetDiscardableTSPacketPID( demux_sys_t *p_sys,
+                                            const uint8_t *p )
+{
+    if( p[0] != 0x47 || (p[1] & 0x80) ) /* resync or error path */
+        return NULL;
+
+    ts_pid_t *pid = GetPID( p_sys, ((p[1]&0x1f)<<8)|p[2] );
+    if( !SEEN(pid) )
+        return NULL;
+
+    if( pid->i_pid == 0x1FFF )
+        return pid;
+
+    if( pid->type != TYPE_STREAM ||
+        p_sys->b_access_control ||
+        (pid->i_flags & FLAG_FILTERED) ||
+        p_sys->es_creation == DELAY_ES ||
+        !SEEN( GetPID( p_sys, 0 ) ) ) /* PAT/PMT fixup needs probing */
+        return NULL;
+
+    /* PCR must be handled even for unselected ES */
+    if( (p[3] & 0x20) && p[4] >= 7 && (p[5] & 0x10) )
+        return NULL;
+
+    /* Scrambling state changes and descrambling need the full path */
+    const bool b_scrambled = p[3] & 0xc0;
+    if( (b_scrambled && p_sys->csa) || b_scrambled != !!SCRAMBLED(*pid) )
+        return NULL;
+
+    return pid;
+}
+
+/* Accounts for a discardable packet once it has been consumed from the
+ * stream, given its 4th header byte */
+static void SkippedTSPacket( demux_sys_t *p_sys, ts_pid_t *pid, uint8_t i_flags )
+{
+    if( pid->i_pid == 0x1FFF )
+        return;
+
+    /* Keep continuity state so that selecting that ES later
+     * does not trigger a spurious discontinuity */
+    if( i_flags & 0x10 )
+    {
+        pid->i_cc = i_flags & 0x0f;
+        pid->i_dup = 0;
+    }
+    p_sys->b_end_preparse = true;
+}
+
+#define TS_SKIP_BATCH 32
+
+/* Skips the leading run of discardable packets, up to i_max, avoiding a
+ * block allocation per packet for unselected programs/ES. Packets are peeked
+ * and skipped by batches, bounded by the packets left to read in this Demux()
+ * call. Returns the number of packets consumed. */
+static unsigned SkipDiscardableTSPackets( demux_t *p_demux, unsigned i_max )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const unsigned i_size = p_sys->i_packet_size;
+    unsigned i_count = 0;
+
+    while( i_count < i_max )
+    {
+        ts_pid_t *pids[TS_SKIP_BATCH];
+        uint8_t flags[TS_SKIP_BATCH];
+        const uint8_t *p_peek;
+        unsigned i_batch = __MIN( i_max - i_count, TS_SKIP_BATCH );
+
+        ssize_t i_peek = vlc_stream_Peek( p_sys->stream, &p_peek,
+                                          i_batch * i_size );
+        if( i_peek < 0 )
+            break;
+        i_batch = __MIN( i_batch, (size_t)i_peek / i_size );
+
+        /* The peek buffer is gone once read: keep what the state needs */
+        unsigned i_run = 0;
+        for( ; i_run < i_batch; i_run++ )
+        {
+            const uint8_t *p = &p_peek[i_run * i_size +
+                                       p_sys->i_packet_header_size];
+
+            pids[i_run] = GetDiscardableTSPacketPID( p_sys, p );
+            if( pids[i_run] == NULL )
+                break;
+            flags[i_run] = p[3];
+        }
+
+        if( i_run == 0 )
+            break;
+
+        ssize_t i_read = vlc_stream_Read( p_sys->stream, NULL,
+                                          i_run * i_size );
+        if( i_read <= 0 )
+            break;
+
+        /* Only account for the packets that were actually consumed */
+        unsigned i_skipped = (size_t)i_read / i_size;
+        for( unsigned i = 0; i < i_skipped; i++ )
+            SkippedTSPacket( p_sys, pids[i], flags[i] );
+        i_count += i_skipped;
+
+        if( i_skipped < i_batch )
+            break;
+    }
+
+    return i_count;
+}
+
 static stime_t GetPCR( const block_t *p_pkt )
 {
     const uint8_t *p = p_pkt->p_buffer;
@@ -19,6 +19,14 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
  *****************************************************************************/
 #include <vlc_bits.h>
+#include <vlc_cpu.h>
+
+#if defined(HAVE_SSE2_INTRINSICS)
+   #include <emmintrin.h>
+#endif
+#if defined(HAVE_AVX2_INTRINSICS)
+   #include <immintrin.h>
+#endif
 
 static inline uint8_t *hxxx_ep3b_to_rbsp( uint8_t *p, uint8_t *end, unsigned *pi_prev, size_t i_count )
 {
@@ -81,13 +89,85 @@ static void hxxx_bsfw_ep3b_ctx_init( struct hxxx_bsfw_ep3b_ctx_s *ctx )
     ctx->i_bytesize = 0;
 }
 
-static size_t hxxx_ep3b_total_size( const uint8_t *p, const uint8_t *p_end )
+/* Emulation prevention bytes are rare: skip ahead over the bytes following p
+ * that can not be one. Any 0x03 preceded by a 0x00 stops the scan, which is
+ * conservative, so that it does not have to track the escaping state.
+ * Returns the number of bytes that can be consumed as is. */
+#if defined(HAVE_SSE2_INTRINSICS)
+__attribute__ ((__target__ ("sse2")))
+static inline size_t hxxx_ep3b_skip_SSE2( const uint8_t *p, const uint8_t *p_end )
+{
+    const uint8_t *p_start = p;
+    const __m128i zeros = _mm_setzero_si128();
+    const __m128i threes = _mm_set1_epi8( 0x03 );
+
+    for( ; p_end - p >= 17; p += 16 )
+    {
+        __m128i prev = _mm_loadu_si128( (const __m128i *)&p[0] );
+        __m128i cur = _mm_loadu_si128( (const __m128i *)&p[1] );
+        __m128i res = _mm_and_si128( _mm_cmpeq_epi8( prev, zeros ),
+                                     _mm_cmpeq_epi8( cur, threes ) );
+        if( _mm_movemask_epi8( res ) )
+            break;
+    }
+    return p - p_start;
+}
+#endif
+
+#if defined(HAVE_AVX2_INTRINSICS)
+__attribute__ ((__target__ ("avx2")))
+static inline size_t hxxx_ep3b_skip_AVX2( const uint8_t *p, const uint8_t *p_end )
+{
+    const uint8_t *p_start = p;
+    const __m256i zeros = _mm256_setzero_si256();
+    const __m256i threes = _mm256_set1_epi8( 0x03 );
+
+    for( ; p_end - p >= 33; p += 32 )
+    {
+        __m256i prev = _mm256_loadu_si256( (const __m256i *)&p[0] );
+        __m256i cur = _mm256_loadu_si256( (const __m256i *)&p[1] );
+        __m256i res = _mm256_and_si256( _mm256_cmpeq_epi8( prev, zeros ),
+                                        _mm256_cmpeq_epi8( cur, threes ) );
+        if( _mm256_movemask_epi8( res ) )
+            break;
+    }
+    return p - p_start;
+}
+#endif
+
+static inline size_t hxxx_ep3b_skip( const uint8_t *p, const uint8_t *p_end )
+{
+#if defined(HAVE_AVX2_INTRINSICS)
+    if( vlc_CPU_AVX2() )
+        return hxxx_ep3b_skip_AVX2( p, p_end );
+#endif
+#if defined(HAVE_SSE2_INTRINSICS)
+    if( vlc_CPU_SSE2() )
+        return hxxx_ep3b_skip_SSE2( p, p_end );
+#endif
+    VLC_UNUSED(p); VLC_UNUSED(p_end);
+    return 0;
+}
+
+static inline size_t hxxx_ep3b_total_size_skip( const uint8_t *p, const uint8_t *p_end,
+                                                size_t (*pf_skip)(const uint8_t *,
+                                                                  const uint8_t *) )
 {
     /* compute final size */
     unsigned i_prev = 0;
     size_t i = 0;
     while( p < p_end )
     {
+        size_t i_skip = pf_skip( p, p_end );
+        if( i_skip > 1 )
+        {
+            /* Only the last two bytes matter to the escaping state */
+            p += i_skip;
+            i += i_skip;
+            i_prev = (!p[-1] << 1) | !p[0];
+            continue;
+        }
+
         uint8_t *n = hxxx_ep3b_to_rbsp( (uint8_t *)p, (uint8_t *)p_end, &i_prev, 1 );
         if( n > p )
             ++i;
@@ -96,6 +176,11 @@ static size_t hxxx_ep3b_total_size( const uint8_t *p, const uint8_t *p_end )
     return i;
 }
 
+static size_t hxxx_ep3b_total_size( const uint8_t *p, const uint8_t *p_end )
+{
+    return hxxx_ep3b_total_size_skip( p, p_end, hxxx_ep3b_skip );
+}
+
 static size_t hxxx_bsfw_byte_forward_ep3b( bs_t *s, size_t i_count )
 {
     struct hxxx_bsfw_ep3b_ctx_s *ctx = (struct hxxx_bsfw_ep3b_ctx_s *) s->p_priv;
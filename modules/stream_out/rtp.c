@@ -1389,41 +1389,117 @@ static int  HttpCallback( httpd_file_sys_t *p_args,
 /****************************************************************************
  * RTP send
  ****************************************************************************/
-static void* ThreadSend( void *data )
-{
 #ifdef _WIN32
 # define ENOBUFS      WSAENOBUFS
 # define EAGAIN       WSAEWOULDBLOCK
 # define EWOULDBLOCK  WSAEWOULDBLOCK
 #endif
+
+/* Maximum number of packets sent to a sink with a single system call */
+#define RTP_SEND_BATCH 16
+/* Packets due this soon after the current one are sent along with it */
+#define RTP_SEND_WINDOW VLC_TICK_FROM_MS(1)
+
+#ifdef HAVE_SRTP
+static block_t *rtp_protect( sout_stream_id_sys_t *id, block_t *out )
+{   /* FIXME: this is awfully inefficient */
+    size_t len = out->i_buffer;
+    out = block_Realloc( out, 0, len + 10 );
+    if( out == NULL )
+        return NULL;
+    out->i_buffer = len;
+
+    int canc = vlc_savecancel ();
+    int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
+    vlc_restorecancel (canc);
+    if( val )
+    {
+        msg_Dbg( id->p_stream, "SRTP sending error: %s",
+                 vlc_strerror_c(val) );
+        block_Release( out );
+        return NULL;
+    }
+    out->i_buffer = len;
+    return out;
+}
+#endif
+
+static bool rtp_send_error( int fd, const block_t *out )
+{
+    if( net_errno == EAGAIN || net_errno == EWOULDBLOCK
+     || net_errno == ENOBUFS || net_errno == ENOMEM )
+        return false;
+
+    int type;
+    getsockopt( fd, SOL_SOCKET, SO_TYPE, &type, &(socklen_t){ sizeof(type) });
+    if( type != SOCK_DGRAM )
+        return true; /* Broken connection */
+
+    /* ICMP soft error: ignore and retry */
+    send( fd, out->p_buffer, out->i_buffer, 0 );
+    return false;
+}
+
+/**
+ * Sends a batch of packets to one sink.
+ * @return true if the connection is broken and the sink should be removed
+ */
+static bool rtp_send_batch( int fd, block_t *const *pktv, unsigned pktc )
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgv[RTP_SEND_BATCH];
+    struct iovec iov[RTP_SEND_BATCH];
+
+    assert( pktc <= RTP_SEND_BATCH );
+    memset( msgv, 0, pktc * sizeof (*msgv) );
+    for( unsigned i = 0; i < pktc; i++ )
+    {
+        iov[i].iov_base = pktv[i]->p_buffer;
+        iov[i].iov_len = pktv[i]->i_buffer;
+        msgv[i].msg_hdr.msg_iov = &iov[i];
+        msgv[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for( unsigned i = 0; i < pktc; )
+    {
+        int val = sendmmsg( fd, msgv + i, pktc - i, 0 );
+        if( val > 0 )
+        {
+            i += val;
+            continue;
+        }
+        if( rtp_send_error( fd, pktv[i] ) )
+            return true;
+        i++;
+    }
+#else
+    for( unsigned i = 0; i < pktc; i++ )
+        if( send( fd, pktv[i]->p_buffer, pktv[i]->i_buffer, 0 ) == -1
+         && rtp_send_error( fd, pktv[i] ) )
+            return true;
+#endif
+    return false;
+}
+
+static void* ThreadSend( void *data )
+{
     sout_stream_id_sys_t *id = data;
     vlc_tick_t i_caching = id->i_caching;
+    block_t *next = NULL;
 
     for (;;)
     {
-        block_t *out = block_FifoGet( id->p_fifo );
+        block_t *out = next;
+
+        if( out != NULL )
+            next = NULL;
+        else
+            out = block_FifoGet( id->p_fifo );
         block_cleanup_push (out);
 
 #ifdef HAVE_SRTP
         if( id->srtp )
-        {   /* FIXME: this is awfully inefficient */
-            size_t len = out->i_buffer;
-            out = block_Realloc( out, 0, len + 10 );
-            out->i_buffer = len;
-
-            int canc = vlc_savecancel ();
-            int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
-            vlc_restorecancel (canc);
-            if( val )
-            {
-                msg_Dbg( id->p_stream, "SRTP sending error: %s",
-                         vlc_strerror_c(val) );
-                block_Release( out );
-                out = NULL;
-            }
-            else
-                out->i_buffer = len;
-        }
+            out = rtp_protect( id, out );
         if (out)
             vlc_tick_wait (out->i_dts + i_caching);
         vlc_cleanup_pop ();
@@ -1434,9 +1510,44 @@ static void* ThreadSend( void *data )
         vlc_cleanup_pop ();
 #endif
 
-        ssize_t len = out->i_buffer;
         int canc = vlc_savecancel ();
 
+        /* Send the packets that are already queued and due within the
+         * same pacing window along with this one. */
+        block_t *pktv[RTP_SEND_BATCH];
+        unsigned pktc = 1;
+        const vlc_tick_t deadline = vlc_tick_now() + RTP_SEND_WINDOW;
+
+        pktv[0] = out;
+        vlc_fifo_Lock( id->p_fifo );
+        while( pktc < RTP_SEND_BATCH && !vlc_fifo_IsEmpty( id->p_fifo ) )
+        {
+            block_t *pkt = vlc_fifo_DequeueUnlocked( id->p_fifo );
+
+            if( pkt->i_dts + i_caching > deadline )
+            {
+                next = pkt;
+                break;
+            }
+            pktv[pktc++] = pkt;
+        }
+        vlc_fifo_Unlock( id->p_fifo );
+
+#ifdef HAVE_SRTP
+        if( id->srtp )
+        {
+            unsigned n = 1;
+
+            for( unsigned i = 1; i < pktc; i++ )
+            {
+                block_t *pkt = rtp_protect( id, pktv[i] );
+                if( pkt != NULL )
+                    pktv[n++] = pkt;
+            }
+            pktc = n;
+        }
+#endif
+
         vlc_mutex_lock( &id->lock_sink );
         unsigned deadc = 0; /* How many dead sockets? */
         int deadv[id->sinkc ? id->sinkc : 1]; /* Dead sockets list */
@@ -1446,26 +1557,18 @@ static void* ThreadSend( void *data )
 #ifdef HAVE_SRTP
             if( !id->srtp ) /* FIXME: SRTCP support */
 #endif
-                SendRTCP( id->sinkv[i].rtcp, out );
+                for( unsigned j = 0; j < pktc; j++ )
+                    SendRTCP( id->sinkv[i].rtcp, pktv[j] );
 
-            if( send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 ) == -1
-             && net_errno != EAGAIN && net_errno != EWOULDBLOCK
-             && net_errno != ENOBUFS && net_errno != ENOMEM )
-            {
-                int type;
-                getsockopt( id->sinkv[i].rtp_fd, SOL_SOCKET, SO_TYPE,
-                            &type, &(socklen_t){ sizeof(type) });
-                if( type == SOCK_DGRAM )
-                    /* ICMP soft error: ignore and retry */
-                    send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 );
-                else
-                    /* Broken connection */
-                    deadv[deadc++] = id->sinkv[i].rtp_fd;
-            }
+            if( rtp_send_batch( id->sinkv[i].rtp_fd, pktv, pktc ) )
+                deadv[deadc++] = id->sinkv[i].rtp_fd;
         }
-        id->i_seq_sent_next = ntohs(((uint16_t *) out->p_buffer)[1]) + 1;
+        id->i_seq_sent_next =
+            ntohs(((uint16_t *) pktv[pktc - 1]->p_buffer)[1]) + 1;
         vlc_mutex_unlock( &id->lock_sink );
-        block_Release( out );
+
+        for( unsigned i = 0; i < pktc; i++ )
+            block_Release( pktv[i] );
 
         for( unsigned i = 0; i < deadc; i++ )
         {
@@ -69,6 +69,7 @@
 #include "platform_fonts.h"
 #include "freetype.h"
 #include "text_layout.h"
+#include "text_cache.h"
 
 /*****************************************************************************
  * Module descriptor
@@ -1240,7 +1241,51 @@ static int Render( filter_t *p_filter, subpicture_region_t *p_region_out,
 
     text_block.i_max_width = i_max_width;
     text_block.i_max_height = i_max_height;
-    rv = LayoutTextBlock( p_filter, &text_block, &text_block.p_laid, &bbox, &i_max_face_height );
+
+    /* Ruby and karaoke text are not cached: the latter changes over time */
+    const bool b_cacheable = p_sys->p_cache != NULL && !text_block.pp_ruby
+                          && !text_block.pi_k_durations;
+    const layout_cache_value_t *p_cached = NULL;
+    bool b_cache_owned = false;
+    layout_cache_key_t cache_key;
+
+    if( b_cacheable )
+    {
+        cache_key = (layout_cache_key_t) {
+            .p_uchars = text_block.p_uchars,
+            .pp_styles = text_block.pp_styles,
+            .i_count = text_block.i_count,
+            .b_balanced = text_block.b_balanced,
+            .b_grid = text_block.b_grid,
+            .i_max_width = i_max_width,
+            .i_max_height = i_max_height,
+            .i_scale = p_sys->i_scale,
+            .i_video_width = p_filter->fmt_out.video.i_width,
+            .i_video_height = p_filter->fmt_out.video.i_height,
+        };
+        p_cached = LayoutCacheGet( p_sys->p_cache, &cache_key );
+    }
+
+    if( p_cached != NULL )
+    {
+        text_block.p_laid = p_cached->p_lines;
+        bbox = p_cached->bbox;
+        i_max_face_height = p_cached->i_max_face_height;
+    }
+    else
+    {
+        rv = LayoutTextBlock( p_filter, &text_block, &text_block.p_laid, &bbox, &i_max_face_height );
+        if( !rv && b_cacheable )
+        {
+            const layout_cache_value_t value = {
+                .p_lines = text_block.p_laid,
+                .bbox = bbox,
+                .i_max_face_height = i_max_face_height,
+            };
+            b_cache_owned = LayoutCachePut( p_sys->p_cache, &cache_key,
+                                            &value ) == VLC_SUCCESS;
+        }
+    }
 
     /* Don't attempt to render text that couldn't be layed out
      * properly. */
@@ -1375,7 +1420,11 @@ static int Render( filter_t *p_filter, subpicture_region_t *p_region_out,
             var_SetBool( p_filter, "text-rerender", true );
     }
 
-    FreeLines( text_block.p_laid );
+    if( b_cache_owned )
+        return rv;
+
+    if( p_cached == NULL )
+        FreeLines( text_block.p_laid );
 
     free( text_block.p_uchars );
     FreeStylesArray( text_block.pp_styles, text_block.i_count );
@@ -1427,6 +1476,9 @@ static int Create( vlc_object_t *p_this )
     vlc_dictionary_init( &p_sys->family_map, 50 );
     vlc_dictionary_init( &p_sys->fallback_map, 20 );
 
+    /* Not fatal: text is laid out from scratch every time without it */
+    p_sys->p_cache = TextCacheNew();
+
     p_sys->i_scale = 100;
 
     /* default style to apply to uncomplete segmeents styles */
@@ -1551,6 +1603,10 @@ static void Destroy( vlc_object_t *p_this )
     text_style_Delete( p_sys->p_default_style );
     text_style_Delete( p_sys->p_forced_style );
 
+    /* Caches, which reference the faces */
+    if( p_sys->p_cache )
+        TextCacheDelete( p_filter, p_sys->p_cache );
+
     /* Fonts dicts */
     vlc_dictionary_clear( &p_sys->fallback_map, FreeFamilies, p_filter );
     vlc_dictionary_clear( &p_sys->face_map, FreeFace, p_filter );
@@ -0,0 +1,387 @@
+/*****************************************************************************
+ * text_cache.c : Glyph and layout caches
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/** \ingroup freetype
+ * @{
+ * \file
+ * Glyph and layout caches
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_list.h>
+#include <vlc_text_style.h>
+
+#include "text_layout.h"
+#include "text_cache.h"
+
+#define GLYPH_CACHE_SIZE    1024
+#define LAYOUT_CACHE_SIZE   16
+#define CACHE_BUCKETS       256 /* must be a power of 2 */
+
+typedef struct cache_entry_t cache_entry_t;
+struct cache_entry_t
+{
+    struct vlc_list node;       /* in the LRU list, most recent first */
+    cache_entry_t  *p_next;     /* next in the hash bucket */
+    uint32_t        i_hash;
+};
+
+typedef struct
+{
+    cache_entry_t  *pp_buckets[CACHE_BUCKETS];
+    struct vlc_list lru;
+    unsigned        i_count;
+    unsigned        i_max;
+    unsigned        i_hits;
+    unsigned        i_misses;
+    void          (*pf_free)( cache_entry_t * );
+} lru_cache_t;
+
+typedef struct
+{
+    cache_entry_t       entry;
+    glyph_cache_key_t   key;
+    glyph_cache_value_t value;
+} glyph_entry_t;
+
+typedef struct
+{
+    cache_entry_t        entry;
+    layout_cache_key_t   key;
+    layout_cache_value_t value;
+} layout_entry_t;
+
+struct text_cache_t
+{
+    lru_cache_t glyphs;
+    lru_cache_t layouts;
+};
+
+/* FNV-1a */
+#define HASH_INIT 2166136261u
+
+static uint32_t Hash( uint32_t i_hash, const void *p_data, size_t i_size )
+{
+    const uint8_t *p = p_data;
+    for( size_t i = 0; i < i_size; i++ )
+        i_hash = (i_hash ^ p[i]) * 16777619u;
+    return i_hash;
+}
+
+static void LruInit( lru_cache_t *p_lru, unsigned i_max,
+                     void (*pf_free)( cache_entry_t * ) )
+{
+    for( unsigned i = 0; i < CACHE_BUCKETS; i++ )
+        p_lru->pp_buckets[i] = NULL;
+    vlc_list_init( &p_lru->lru );
+    p_lru->i_count = 0;
+    p_lru->i_max = i_max;
+    p_lru->i_hits = 0;
+    p_lru->i_misses = 0;
+    p_lru->pf_free = pf_free;
+}
+
+static void LruClean( lru_cache_t *p_lru )
+{
+    cache_entry_t *p_entry;
+
+    vlc_list_foreach( p_entry, &p_lru->lru, node )
+        p_lru->pf_free( p_entry );
+}
+
+static void LruPrintStats( filter_t *p_filter, const lru_cache_t *p_lru,
+                           const char *psz_name )
+{
+    unsigned i_total = p_lru->i_hits + p_lru->i_misses;
+    if( i_total == 0 )
+        return;
+    msg_Dbg( p_filter, "%s cache: %u hits, %u misses (%.1f%% hit rate)",
+             psz_name, p_lru->i_hits, p_lru->i_misses,
+             100.f * p_lru->i_hits / i_total );
+}
+
+/**
+ * Finds the first entry with the given hash accepted by the match callback,
+ * and marks it as most recently used.
+ */
+static cache_entry_t *LruGet( lru_cache_t *p_lru, uint32_t i_hash,
+                              bool (*pf_match)( const cache_entry_t *,
+                                                const void * ),
+                              const void *p_key )
+{
+    for( cache_entry_t *p_entry = p_lru->pp_buckets[i_hash & (CACHE_BUCKETS - 1)];
+         p_entry != NULL; p_entry = p_entry->p_next )
+    {
+        if( p_entry->i_hash == i_hash && pf_match( p_entry, p_key ) )
+        {
+            vlc_list_remove( &p_entry->node );
+            vlc_list_prepend( &p_entry->node, &p_lru->lru );
+            p_lru->i_hits++;
+            return p_entry;
+        }
+    }
+    p_lru->i_misses++;
+    return NULL;
+}
+
+static void LruPut( lru_cache_t *p_lru, cache_entry_t *p_entry,
+                    uint32_t i_hash )
+{
+    if( p_lru->i_count == p_lru->i_max )
+    {
+        cache_entry_t *p_old = vlc_list_last_entry_or_null( &p_lru->lru,
+                                                            cache_entry_t, node );
+        cache_entry_t **pp = &p_lru->pp_buckets[p_old->i_hash & (CACHE_BUCKETS - 1)];
+        while( *pp != p_old )
+            pp = &(*pp)->p_next;
+        *pp = p_old->p_next;
+        vlc_list_remove( &p_old->node );
+        p_lru->pf_free( p_old );
+        p_lru->i_count--;
+    }
+
+    cache_entry_t **pp_bucket = &p_lru->pp_buckets[i_hash & (CACHE_BUCKETS - 1)];
+    p_entry->i_hash = i_hash;
+    p_entry->p_next = *pp_bucket;
+    *pp_bucket = p_entry;
+    vlc_list_prepend( &p_entry->node, &p_lru->lru );
+    p_lru->i_count++;
+}
+
+/*
+ * Glyphs
+ */
+static uint32_t GlyphHash( const glyph_cache_key_t *p_key )
+{
+    uint32_t i_hash = HASH_INIT;
+    i_hash = Hash( i_hash, &p_key->p_face, sizeof( p_key->p_face ) );
+    i_hash = Hash( i_hash, &p_key->i_glyph_index, sizeof( p_key->i_glyph_index ) );
+    i_hash = Hash( i_hash, &p_key->i_style_flags, sizeof( p_key->i_style_flags ) );
+    i_hash = Hash( i_hash, &p_key->i_outline_radius, sizeof( p_key->i_outline_radius ) );
+    return i_hash;
+}
+
+static bool GlyphMatch( const cache_entry_t *p_entry, const void *p_data )
+{
+    const glyph_cache_key_t *p_key = p_data;
+    const glyph_cache_key_t *p_other =
+        &container_of( p_entry, glyph_entry_t, entry )->key;
+
+    return p_key->p_face == p_other->p_face
+        && p_key->i_glyph_index == p_other->i_glyph_index
+        && p_key->i_style_flags == p_other->i_style_flags
+        && p_key->i_outline_radius == p_other->i_outline_radius;
+}
+
+static void GlyphFree( cache_entry_t *p_entry )
+{
+    glyph_entry_t *p_glyph = container_of( p_entry, glyph_entry_t, entry );
+
+    FT_Done_Glyph( p_glyph->value.p_glyph );
+    if( p_glyph->value.p_outline )
+        FT_Done_Glyph( p_glyph->value.p_outline );
+    free( p_glyph );
+}
+
+const glyph_cache_value_t *GlyphCacheGet( text_cache_t *p_cache,
+                                          const glyph_cache_key_t *p_key )
+{
+    cache_entry_t *p_entry = LruGet( &p_cache->glyphs, GlyphHash( p_key ),
+                                     GlyphMatch, p_key );
+    if( p_entry == NULL )
+        return NULL;
+    return &container_of( p_entry, glyph_entry_t, entry )->value;
+}
+
+void GlyphCachePut( text_cache_t *p_cache, const glyph_cache_key_t *p_key,
+                    const glyph_cache_value_t *p_value )
+{
+    glyph_entry_t *p_glyph = malloc( sizeof( *p_glyph ) );
+    if( unlikely(p_glyph == NULL) )
+        return;
+
+    p_glyph->key = *p_key;
+    p_glyph->value = *p_value;
+    p_glyph->value.p_outline = NULL;
+
+    if( FT_Glyph_Copy( p_value->p_glyph, &p_glyph->value.p_glyph ) )
+    {
+        free( p_glyph );
+        return;
+    }
+    if( p_value->p_outline
+     && FT_Glyph_Copy( p_value->p_outline, &p_glyph->value.p_outline ) )
+    {
+        FT_Done_Glyph( p_glyph->value.p_glyph );
+        free( p_glyph );
+        return;
+    }
+
+    LruPut( &p_cache->glyphs, &p_glyph->entry, GlyphHash( p_key ) );
+}
+
+/*
+ * Layouts
+ */
+static uint32_t LayoutHash( const layout_cache_key_t *p_key )
+{
+    uint32_t i_hash = HASH_INIT;
+    i_hash = Hash( i_hash, p_key->p_uchars,
+                   p_key->i_count * sizeof( *p_key->p_uchars ) );
+    i_hash = Hash( i_hash, &p_key->i_max_width, sizeof( p_key->i_max_width ) );
+    i_hash = Hash( i_hash, &p_key->i_max_height, sizeof( p_key->i_max_height ) );
+    return i_hash;
+}
+
+static bool StringEquals( const char *psz_a, const char *psz_b )
+{
+    if( psz_a == NULL || psz_b == NULL )
+        return psz_a == psz_b;
+    return !strcmp( psz_a, psz_b );
+}
+
+static bool StyleEquals( const text_style_t *p_a, const text_style_t *p_b )
+{
+    if( p_a == p_b )
+        return true;
+
+    return StringEquals( p_a->psz_fontname, p_b->psz_fontname )
+        && StringEquals( p_a->psz_monofontname, p_b->psz_monofontname )
+        && p_a->i_features == p_b->i_features
+        && p_a->i_style_flags == p_b->i_style_flags
+        && p_a->f_font_relsize == p_b->f_font_relsize
+        && p_a->i_font_size == p_b->i_font_size
+        && p_a->i_font_color == p_b->i_font_color
+        && p_a->i_font_alpha == p_b->i_font_alpha
+        && p_a->i_spacing == p_b->i_spacing
+        && p_a->i_outline_color == p_b->i_outline_color
+        && p_a->i_outline_alpha == p_b->i_outline_alpha
+        && p_a->i_outline_width == p_b->i_outline_width
+        && p_a->i_shadow_color == p_b->i_shadow_color
+        && p_a->i_shadow_alpha == p_b->i_shadow_alpha
+        && p_a->i_shadow_width == p_b->i_shadow_width
+        && p_a->i_background_color == p_b->i_background_color
+        && p_a->i_background_alpha == p_b->i_background_alpha
+        && p_a->i_karaoke_background_color == p_b->i_karaoke_background_color
+        && p_a->i_karaoke_background_alpha == p_b->i_karaoke_background_alpha
+        && p_a->e_wrapinfo == p_b->e_wrapinfo;
+}
+
+static bool LayoutMatch( const cache_entry_t *p_entry, const void *p_data )
+{
+    const layout_cache_key_t *p_key = p_data;
+    const layout_cache_key_t *p_other =
+        &container_of( p_entry, layout_entry_t, entry )->key;
+
+    if( p_key->i_count != p_other->i_count
+     || p_key->b_balanced != p_other->b_balanced
+     || p_key->b_grid != p_other->b_grid
+     || p_key->i_max_width != p_other->i_max_width
+     || p_key->i_max_height != p_other->i_max_height
+     || p_key->i_scale != p_other->i_scale
+     || p_key->i_video_width != p_other->i_video_width
+     || p_key->i_video_height != p_other->i_video_height
+     || memcmp( p_key->p_uchars, p_other->p_uchars,
+                p_key->i_count * sizeof( *p_key->p_uchars ) ) )
+        return false;
+
+    for( size_t i = 0; i < p_key->i_count; i++ )
+    {
+        /* Consecutive characters usually share their style */
+        if( i > 0 && p_key->pp_styles[i] == p_key->pp_styles[i - 1]
+                  && p_other->pp_styles[i] == p_other->pp_styles[i - 1] )
+            continue;
+        if( !StyleEquals( p_key->pp_styles[i], p_other->pp_styles[i] ) )
+            return false;
+    }
+    return true;
+}
+
+static void LayoutFree( cache_entry_t *p_entry )
+{
+    layout_entry_t *p_layout = container_of( p_entry, layout_entry_t, entry );
+    text_style_t *p_style = NULL;
+
+    FreeLines( p_layout->value.p_lines );
+    for( size_t i = 0; i < p_layout->key.i_count; i++ )
+    {
+        if( p_style != p_layout->key.pp_styles[i] )
+        {
+            p_style = p_layout->key.pp_styles[i];
+            text_style_Delete( p_style );
+        }
+    }
+    free( p_layout->key.pp_styles );
+    free( p_layout->key.p_uchars );
+    free( p_layout );
+}
+
+const layout_cache_value_t *LayoutCacheGet( text_cache_t *p_cache,
+                                            const layout_cache_key_t *p_key )
+{
+    cache_entry_t *p_entry = LruGet( &p_cache->layouts, LayoutHash( p_key ),
+                                     LayoutMatch, p_key );
+    if( p_entry == NULL )
+        return NULL;
+    return &container_of( p_entry, layout_entry_t, entry )->value;
+}
+
+int LayoutCachePut( text_cache_t *p_cache, const layout_cache_key_t *p_key,
+                    const layout_cache_value_t *p_value )
+{
+    layout_entry_t *p_layout = malloc( sizeof( *p_layout ) );
+    if( unlikely(p_layout == NULL) )
+        return VLC_ENOMEM;
+
+    p_layout->key = *p_key;
+    p_layout->value = *p_value;
+    LruPut( &p_cache->layouts, &p_layout->entry, LayoutHash( p_key ) );
+    return VLC_SUCCESS;
+}
+
+/*
+ * Both
+ */
+text_cache_t *TextCacheNew( void )
+{
+    text_cache_t *p_cache = malloc( sizeof( *p_cache ) );
+    if( unlikely(p_cache == NULL) )
+        return NULL;
+
+    LruInit( &p_cache->glyphs, GLYPH_CACHE_SIZE, GlyphFree );
+    LruInit( &p_cache->layouts, LAYOUT_CACHE_SIZE, LayoutFree );
+    return p_cache;
+}
+
+void TextCacheDelete( filter_t *p_filter, text_cache_t *p_cache )
+{
+    LruPrintStats( p_filter, &p_cache->glyphs, "glyph" );
+    LruPrintStats( p_filter, &p_cache->layouts, "layout" );
+    LruClean( &p_cache->layouts );
+    LruClean( &p_cache->glyphs );
+    free( p_cache );
+}
+
+/** @} */
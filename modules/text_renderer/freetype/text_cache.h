@@ -0,0 +1,128 @@
+/*****************************************************************************
+ * text_cache.h : Glyph and layout caches
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/** \ingroup freetype
+ * @{
+ * \file
+ * Glyph and layout caches
+ *
+ * Subtitles, marquees and tickers render the same strings over and over.
+ * Two bounded LRU caches avoid redoing the work:
+ * - the glyph cache keeps loaded (hinted, emboldened, stroked) glyph outlines,
+ * - the layout cache keeps complete laid out and rasterized text blocks.
+ */
+
+#include "freetype.h"
+
+/**
+ * \struct glyph_cache_key_t
+ * \brief Identifies a loaded glyph
+ */
+typedef struct
+{
+    FT_Face  p_face;            /*!< face, which also determines the size */
+    FT_UInt  i_glyph_index;     /*!< glyph index within the face */
+    uint16_t i_style_flags;     /*!< emulated STYLE_BOLD/STYLE_ITALIC, and STYLE_OUTLINE */
+    int      i_outline_radius;  /*!< stroker radius (26.6) if outlined */
+} glyph_cache_key_t;
+
+/**
+ * \struct glyph_cache_value_t
+ * \brief A loaded glyph, owned by the cache
+ */
+typedef struct
+{
+    FT_Glyph p_glyph;
+    FT_Glyph p_outline;         /*!< stroked glyph, or NULL */
+    FT_Pos   i_x_advance;
+    FT_Pos   i_y_advance;
+} glyph_cache_value_t;
+
+/**
+ * \struct layout_cache_key_t
+ * \brief Identifies a laid out text block
+ */
+typedef struct
+{
+    uni_char_t *p_uchars;       /*!< array of size \p i_count character codepoints */
+    text_style_t **pp_styles;   /*!< array of size \p i_count character styles */
+    size_t i_count;             /*!< length of the arrays */
+    bool b_balanced;
+    bool b_grid;
+    unsigned i_max_width;
+    unsigned i_max_height;
+    int i_scale;                /*!< text scaling, in percent */
+    unsigned i_video_width;     /*!< sizes relative to the video depend on it */
+    unsigned i_video_height;
+} layout_cache_key_t;
+
+/**
+ * \struct layout_cache_value_t
+ * \brief A laid out text block, owned by the cache
+ */
+typedef struct
+{
+    struct line_desc_t *p_lines;
+    FT_BBox bbox;
+    int i_max_face_height;
+} layout_cache_value_t;
+
+text_cache_t *TextCacheNew( void );
+
+/**
+ * Destroys the caches, and prints their statistics.
+ *
+ * This must be called before the faces are released.
+ */
+void TextCacheDelete( filter_t *p_filter, text_cache_t *p_cache );
+
+/**
+ * Looks a glyph up.
+ *
+ * \return the cached glyph, valid until the next insertion, or NULL
+ */
+const glyph_cache_value_t *GlyphCacheGet( text_cache_t *p_cache,
+                                          const glyph_cache_key_t *p_key );
+
+/**
+ * Inserts a copy of a glyph, evicting the least recently used one if full.
+ */
+void GlyphCachePut( text_cache_t *p_cache, const glyph_cache_key_t *p_key,
+                    const glyph_cache_value_t *p_value );
+
+/**
+ * Looks a text block up.
+ *
+ * \return the cached layout, valid until the next insertion, or NULL
+ */
+const layout_cache_value_t *LayoutCacheGet( text_cache_t *p_cache,
+                                            const layout_cache_key_t *p_key );
+
+/**
+ * Inserts a text block, evicting the least recently used one if full.
+ *
+ * On success, the cache takes ownership of the key arrays and of the lines.
+ *
+ * \return VLC_SUCCESS, or VLC_ENOMEM (the caller keeps ownership)
+ */
+int LayoutCachePut( text_cache_t *p_cache, const layout_cache_key_t *p_key,
+                    const layout_cache_value_t *p_value );
+
+/** @} */
@@ -63,6 +63,7 @@
 
 #include "freetype.h"
 #include "text_layout.h"
+#include "text_cache.h"
 #include "platform_fonts.h"
 
 #include <stdlib.h>
@@ -1055,6 +1056,9 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
         else
             p_face = p_run->p_face;
 
+        /* Everything but the face and glyph index that changes the glyph */
+        glyph_cache_key_t cache_key = { .p_face = p_face };
+
         if( p_sys->p_stroker && (p_style->i_style_flags & STYLE_OUTLINE) )
         {
             double f_outline_thickness =
@@ -1065,7 +1069,15 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
                             i_radius,
                             FT_STROKER_LINECAP_ROUND,
                             FT_STROKER_LINEJOIN_ROUND, 0 );
+            cache_key.i_style_flags |= STYLE_OUTLINE;
+            cache_key.i_outline_radius = i_radius;
         }
+        if( ( p_style->i_style_flags & STYLE_BOLD )
+              && !( p_face->style_flags & FT_STYLE_FLAG_BOLD ) )
+            cache_key.i_style_flags |= STYLE_BOLD;
+        if( ( p_style->i_style_flags & STYLE_ITALIC )
+              && !( p_face->style_flags & FT_STYLE_FLAG_ITALIC ) )
+            cache_key.i_style_flags |= STYLE_ITALIC;
 
         for( int j = p_run->i_start_offset; j < p_run->i_end_offset; ++j )
         {
@@ -1117,39 +1129,65 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
                     SKIP_GLYPH( p_bitmaps )
             }
 
-            if( FT_Load_Glyph( p_face, i_glyph_index,
-                               FT_LOAD_NO_BITMAP | FT_LOAD_DEFAULT )
-             && FT_Load_Glyph( p_face, i_glyph_index, FT_LOAD_DEFAULT ) )
-                SKIP_GLYPH( p_bitmaps )
+            cache_key.i_glyph_index = i_glyph_index;
+            const glyph_cache_value_t *p_cached = p_sys->p_cache ?
+                GlyphCacheGet( p_sys->p_cache, &cache_key ) : NULL;
+            glyph_cache_value_t loaded;
 
-            if( ( p_style->i_style_flags & STYLE_BOLD )
-                  && !( p_face->style_flags & FT_STYLE_FLAG_BOLD ) )
-                FT_GlyphSlot_Embolden( p_face->glyph );
-            if( ( p_style->i_style_flags & STYLE_ITALIC )
-                  && !( p_face->style_flags & FT_STYLE_FLAG_ITALIC ) )
-                FT_GlyphSlot_Oblique( p_face->glyph );
+            if( p_cached )
+            {   /* Copying the outlines is much cheaper than loading (hinting)
+                 * and stroking them again */
+                if( FT_Glyph_Copy( p_cached->p_glyph, &p_bitmaps->p_glyph ) )
+                    SKIP_GLYPH( p_bitmaps )
+                if( p_cached->p_outline
+                 && FT_Glyph_Copy( p_cached->p_outline, &p_bitmaps->p_outline ) )
+                    p_bitmaps->p_outline = 0;
+                loaded = *p_cached;
+            }
+            else
+            {
+                if( FT_Load_Glyph( p_face, i_glyph_index,
+                                   FT_LOAD_NO_BITMAP | FT_LOAD_DEFAULT )
+                 && FT_Load_Glyph( p_face, i_glyph_index, FT_LOAD_DEFAULT ) )
+                    SKIP_GLYPH( p_bitmaps )
 
-            if( FT_Get_Glyph( p_face->glyph, &p_bitmaps->p_glyph ) )
-                SKIP_GLYPH( p_bitmaps )
+                if( cache_key.i_style_flags & STYLE_BOLD )
+                    FT_GlyphSlot_Embolden( p_face->glyph );
+                if( cache_key.i_style_flags & STYLE_ITALIC )
+                    FT_GlyphSlot_Oblique( p_face->glyph );
 
-#undef SKIP_GLYPH
+                if( FT_Get_Glyph( p_face->glyph, &p_bitmaps->p_glyph ) )
+                    SKIP_GLYPH( p_bitmaps )
 
-            if( p_sys->p_stroker && (p_style->i_style_flags & STYLE_OUTLINE) )
-            {
-                p_bitmaps->p_outline = p_bitmaps->p_glyph;
-                if( FT_Glyph_StrokeBorder( &p_bitmaps->p_outline,
-                                           p_sys->p_stroker, 0, 0 ) )
-                    p_bitmaps->p_outline = 0;
+                if( cache_key.i_style_flags & STYLE_OUTLINE )
+                {
+                    p_bitmaps->p_outline = p_bitmaps->p_glyph;
+                    if( FT_Glyph_StrokeBorder( &p_bitmaps->p_outline,
+                                               p_sys->p_stroker, 0, 0 ) )
+                        p_bitmaps->p_outline = 0;
+                }
+
+                loaded = (glyph_cache_value_t) {
+                    .p_glyph = p_bitmaps->p_glyph,
+                    .p_outline = (cache_key.i_style_flags & STYLE_OUTLINE) ?
+                                 p_bitmaps->p_outline : NULL,
+                    .i_x_advance = p_face->glyph->advance.x,
+                    .i_y_advance = p_face->glyph->advance.y,
+                };
+                if( p_sys->p_cache )
+                    GlyphCachePut( p_sys->p_cache, &cache_key, &loaded );
             }
 
+#undef SKIP_GLYPH
+
             if( p_style->i_shadow_alpha != STYLE_ALPHA_TRANSPARENT )
                 p_bitmaps->p_shadow = p_bitmaps->p_outline ?
                                       p_bitmaps->p_outline : p_bitmaps->p_glyph;
 
             if( b_overwrite_advance )
             {
-                p_bitmaps->i_x_advance = p_face->glyph->advance.x;
-                p_bitmaps->i_y_advance = p_face->glyph->advance.y;
+                p_bitmaps->i_x_advance = loaded.i_x_advance;
+                p_bitmaps->i_y_advance = loaded.i_y_advance;
             }
 
             unsigned i_x_advance = FT_FLOOR( abs( p_bitmaps->i_x_advance ) );
@@ -57,6 +57,8 @@ static picture_t *Chain         ( filter_t *, picture_t * );
 
 static int BuildTransformChain( filter_t *p_filter );
 static int BuildChromaResize( filter_t * );
+static int BuildChromaResizeSteps( filter_t * );
+static int BuildChromaResizeMiddle( filter_t * );
 static int BuildChromaChain( filter_t *p_filter );
 static int BuildFilterChain( filter_t *p_filter );
 
@@ -211,6 +213,10 @@ static int ActivateConverter( vlc_object_t *p_this )
 {
     filter_t *p_filter = (filter_t *)p_this;
 
+    /* The parent wants single module steps, cf. BuildChromaResize() */
+    if( var_Type( p_filter->obj.parent, "chain-single-step" ) != 0 )
+        return VLC_EGENERIC;
+
     const bool b_chroma = p_filter->fmt_in.video.i_chroma != p_filter->fmt_out.video.i_chroma;
     const bool b_resize = p_filter->fmt_in.video.i_width  != p_filter->fmt_out.video.i_width ||
                           p_filter->fmt_in.video.i_height != p_filter->fmt_out.video.i_height;
@@ -295,6 +301,23 @@ static int BuildTransformChain( filter_t *p_filter )
 }
 
 static int BuildChromaResize( filter_t *p_filter )
+{
+    /* Every step writes a full intermediate picture: first look for two
+     * single module steps, one of them doing both the resizing and a chroma
+     * conversion, before letting the steps be chains themselves. */
+    var_Create( p_filter, "chain-single-step", VLC_VAR_BOOL );
+    int i_ret = BuildChromaResizeSteps( p_filter );
+    if( i_ret != VLC_SUCCESS )
+        i_ret = BuildChromaResizeMiddle( p_filter );
+    var_Destroy( p_filter, "chain-single-step" );
+
+    if( i_ret == VLC_SUCCESS )
+        return VLC_SUCCESS;
+
+    return BuildChromaResizeSteps( p_filter );
+}
+
+static int BuildChromaResizeSteps( filter_t *p_filter )
 {
     es_format_t fmt_mid;
     int i_ret;
@@ -319,6 +342,54 @@ static int BuildChromaResize( filter_t *p_filter )
     return VLC_EGENERIC;
 }
 
+static int BuildChromaResizeMiddle( filter_t *p_filter )
+{
+    const video_format_t *p_in = &p_filter->fmt_in.video;
+    const video_format_t *p_out = &p_filter->fmt_out.video;
+    es_format_t fmt_mid;
+    int i_ret = VLC_EGENERIC;
+
+    /* Resize in the first step when downscaling, so that the second step
+     * processes fewer pixels, and in the last one otherwise */
+    const bool b_downscale = (uint64_t)p_out->i_width * p_out->i_height <
+                             (uint64_t)p_in->i_width * p_in->i_height;
+
+    const vlc_fourcc_t *pi_allowed_chromas = get_allowed_chromas( p_filter );
+    for( int i = 0; pi_allowed_chromas[i] && i_ret != VLC_SUCCESS; i++ )
+    {
+        const vlc_fourcc_t i_chroma = pi_allowed_chromas[i];
+        if( i_chroma == p_filter->fmt_in.i_codec ||
+            i_chroma == p_filter->fmt_out.i_codec )
+            continue;
+
+        for( int j = 0; j < 2 && i_ret != VLC_SUCCESS; j++ )
+        {
+            const bool b_resize_first = b_downscale == (j == 0);
+
+            msg_Dbg( p_filter, "Trying to use chroma %4.4s as middle man, "
+                     "resizing in the %s step", (char*)&i_chroma,
+                     b_resize_first ? "first" : "last" );
+
+            if( b_resize_first )
+                EsFormatMergeSize( &fmt_mid, &p_filter->fmt_in,
+                                   &p_filter->fmt_out );
+            else
+                es_format_Copy( &fmt_mid, &p_filter->fmt_in );
+            fmt_mid.i_codec        =
+            fmt_mid.video.i_chroma = i_chroma;
+            fmt_mid.video.i_rmask  = 0;
+            fmt_mid.video.i_gmask  = 0;
+            fmt_mid.video.i_bmask  = 0;
+            video_format_FixRgb(&fmt_mid.video);
+
+            i_ret = CreateChain( p_filter, &fmt_mid );
+            es_format_Clean( &fmt_mid );
+        }
+    }
+
+    return i_ret;
+}
+
 static int BuildChromaChain( filter_t *p_filter )
 {
     es_format_t fmt_mid;
@@ -130,8 +130,396 @@ void CopyCleanCache(copy_cache_t *cache)
 # define vlc_CPU_SSSE3() (0)
 # undef vlc_CPU_SSE2
 # define vlc_CPU_SSE2() (0)
+# undef vlc_CPU_AVX2
+# define vlc_CPU_AVX2() (0)
+# undef vlc_CPU_AVX512
+# define vlc_CPU_AVX512() (0)
+#elif defined(COPY_TEST)
+/* Restrict the optimizations to a given instruction set level, so that every
+ * code path can be tested (and benchmarked) on a single machine */
+static unsigned copy_cpu_mask = ~0u;
+# define COPY_CPU(flag) ((vlc_CPU() & copy_cpu_mask & (flag)) != 0)
+# undef vlc_CPU_SSE4_1
+# define vlc_CPU_SSE4_1() COPY_CPU(VLC_CPU_SSE4_1)
+# undef vlc_CPU_SSE3
+# define vlc_CPU_SSE3() COPY_CPU(VLC_CPU_SSE3)
+# undef vlc_CPU_SSSE3
+# define vlc_CPU_SSSE3() COPY_CPU(VLC_CPU_SSSE3)
+# undef vlc_CPU_SSE2
+# define vlc_CPU_SSE2() COPY_CPU(VLC_CPU_SSE2)
+# undef vlc_CPU_AVX2
+# define vlc_CPU_AVX2() COPY_CPU(VLC_CPU_AVX2)
+# undef vlc_CPU_AVX512
+# define vlc_CPU_AVX512() COPY_CPU(VLC_CPU_AVX512)
 #endif
 
+#ifdef CAN_COMPILE_AVX2
+/* Copy 32/128 bytes from srcp to dstp with the AVX2 instructions load and
+ * store. Only the registers are wider than in COPY16/COPY64.
+ */
+
+#define AVX_SHIFT1(op, x) \
+    op " " x ", %%ymm1, %%ymm1\n"
+#define AVX_SHIFT4(op, x) \
+    op " " x ", %%ymm1, %%ymm1\n" \
+    op " " x ", %%ymm2, %%ymm2\n" \
+    op " " x ", %%ymm3, %%ymm3\n" \
+    op " " x ", %%ymm4, %%ymm4\n"
+
+#define COPY32_AVX_S(dstp, srcp, load, store, shiftstr) \
+    asm volatile (                      \
+        load "  0(%[src]), %%ymm1\n"    \
+        shiftstr                        \
+        store " %%ymm1,    0(%[dst])\n" \
+        : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1")
+
+#define COPY128_AVX_S(dstp, srcp, load, store, shiftstr) \
+    asm volatile (                      \
+        load "  0(%[src]), %%ymm1\n"    \
+        load " 32(%[src]), %%ymm2\n"    \
+        load " 64(%[src]), %%ymm3\n"    \
+        load " 96(%[src]), %%ymm4\n"    \
+        shiftstr                        \
+        store " %%ymm1,    0(%[dst])\n" \
+        store " %%ymm2,   32(%[dst])\n" \
+        store " %%ymm3,   64(%[dst])\n" \
+        store " %%ymm4,   96(%[dst])\n" \
+        : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1", "xmm2", "xmm3", "xmm4")
+
+VLC_SSE
+static void AVX2_CopyFromUswc(uint8_t *dst, size_t dst_pitch,
+                              const uint8_t *src, size_t src_pitch,
+                              unsigned width, unsigned height, int bitshift)
+{
+    asm volatile ("mfence");
+
+#define AVX2_USWC_COPY(shiftstr32, shiftstr128) \
+    for (unsigned y = 0; y < height; y++) { \
+        unsigned x = 0; \
+        if (width >= 32) { \
+            /* 256-bits streaming loads need aligned sources */ \
+            const unsigned unaligned = (-(uintptr_t)src) & 0x1f; \
+            if (unaligned) { \
+                COPY32_AVX_S(dst, src, "vmovdqu", "vmovdqu", shiftstr32); \
+                x = unaligned; \
+            } \
+            for (; x+127 < width; x += 128) \
+                COPY128_AVX_S(&dst[x], &src[x], "vmovntdqa", "vmovdqu", shiftstr128); \
+            /* CopyPlane() may run legacy SSE code */ \
+            asm volatile ("vzeroupper"); \
+        } \
+        if (x < width) \
+            CopyPlane(&dst[x], dst_pitch - x, &src[x], src_pitch - x, 1, bitshift); \
+        src += src_pitch; \
+        dst += dst_pitch; \
+    }
+
+    switch (bitshift)
+    {
+        case 0:
+            AVX2_USWC_COPY("", "")
+            break;
+        case -6:
+            AVX2_USWC_COPY(AVX_SHIFT1("vpsllw", "$6"), AVX_SHIFT4("vpsllw", "$6"))
+            break;
+        case 6:
+            AVX2_USWC_COPY(AVX_SHIFT1("vpsrlw", "$6"), AVX_SHIFT4("vpsrlw", "$6"))
+            break;
+        case 2:
+            AVX2_USWC_COPY(AVX_SHIFT1("vpsrlw", "$2"), AVX_SHIFT4("vpsrlw", "$2"))
+            break;
+        case -2:
+            AVX2_USWC_COPY(AVX_SHIFT1("vpsllw", "$2"), AVX_SHIFT4("vpsllw", "$2"))
+            break;
+        case 4:
+            AVX2_USWC_COPY(AVX_SHIFT1("vpsrlw", "$4"), AVX_SHIFT4("vpsrlw", "$4"))
+            break;
+        case -4:
+            AVX2_USWC_COPY(AVX_SHIFT1("vpsllw", "$4"), AVX_SHIFT4("vpsllw", "$4"))
+            break;
+        default:
+            vlc_assert_unreachable();
+    }
+#undef AVX2_USWC_COPY
+
+    asm volatile ("mfence");
+}
+
+VLC_SSE
+static void AVX2_Copy2d(uint8_t *dst, size_t dst_pitch,
+                        const uint8_t *src, size_t src_pitch,
+                        unsigned width, unsigned height)
+{
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x = 0;
+
+        bool unaligned = ((intptr_t)dst & 0x1f) != 0;
+        if (!unaligned) {
+            for (; x+127 < width; x += 128)
+                COPY128_AVX_S(&dst[x], &src[x], "vmovdqu", "vmovntdq", "");
+        } else {
+            for (; x+127 < width; x += 128)
+                COPY128_AVX_S(&dst[x], &src[x], "vmovdqu", "vmovdqu", "");
+        }
+        /* The scalar tail may be vectorized with legacy SSE */
+        asm volatile ("vzeroupper");
+
+        for (; x < width; x++)
+            dst[x] = src[x];
+
+        src += src_pitch;
+        dst += dst_pitch;
+    }
+}
+
+VLC_SSE
+static void AVX2_InterleaveUV(uint8_t *dst, size_t dst_pitch,
+                              const uint8_t *srcu, size_t srcu_pitch,
+                              const uint8_t *srcv, size_t srcv_pitch,
+                              unsigned width, unsigned height,
+                              uint8_t pixel_size)
+{
+    assert(pixel_size == 1 || pixel_size == 2);
+
+    /* vpunpck* interleave within each 128-bits lane: reorder the quadwords
+     * first, so that the low lanes hold the first halves of U and V */
+#define INTERLEAVE64(unpckl, unpckh) \
+    "vmovdqu     (%[src1]), %%ymm0\n"           \
+    "vmovdqu     (%[src2]), %%ymm1\n"           \
+    "vpermq $0xd8, %%ymm0, %%ymm0\n"            \
+    "vpermq $0xd8, %%ymm1, %%ymm1\n"            \
+    unpckl "     %%ymm1, %%ymm0, %%ymm2\n"      \
+    unpckh "     %%ymm1, %%ymm0, %%ymm3\n"      \
+    "vmovdqu     %%ymm2,  0(%[dst])\n"          \
+    "vmovdqu     %%ymm3, 32(%[dst])\n"
+
+    for (unsigned y = 0; y < height; y++)
+    {
+        unsigned x = 0;
+
+        if (pixel_size == 1)
+            for (; x < (width & ~31); x += 32)
+                asm volatile (INTERLEAVE64("vpunpcklbw", "vpunpckhbw")
+                    : : [dst]"r"(dst+2*x),
+                        [src1]"r"(srcu+x), [src2]"r"(srcv+x)
+                    : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+        else
+            for (; x < (width & ~31); x += 32)
+                asm volatile (INTERLEAVE64("vpunpcklwd", "vpunpckhwd")
+                    : : [dst]"r"(dst+2*x),
+                        [src1]"r"(srcu+x), [src2]"r"(srcv+x)
+                    : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+        /* The scalar tail may be vectorized with legacy SSE */
+        asm volatile ("vzeroupper");
+
+        if (pixel_size == 1)
+        {
+            for (; x < width; x++) {
+                dst[2*x+0] = srcu[x];
+                dst[2*x+1] = srcv[x];
+            }
+        }
+        else
+        {
+            for (; x < width; x+= 2) {
+                dst[2*x+0] = srcu[x];
+                dst[2*x+1] = srcu[x + 1];
+                dst[2*x+2] = srcv[x];
+                dst[2*x+3] = srcv[x + 1];
+            }
+        }
+        srcu += srcu_pitch;
+        srcv += srcv_pitch;
+        dst += dst_pitch;
+    }
+#undef INTERLEAVE64
+}
+
+VLC_SSE
+static void AVX2_SplitUV(uint8_t *dstu, size_t dstu_pitch,
+                         uint8_t *dstv, size_t dstv_pitch,
+                         const uint8_t *src, size_t src_pitch,
+                         unsigned width, unsigned height, uint8_t pixel_size)
+{
+    assert(pixel_size == 1 || pixel_size == 2);
+
+    static const uint8_t shuffle_8[] = { 0, 2, 4, 6, 8, 10, 12, 14,
+                                         1, 3, 5, 7, 9, 11, 13, 15 };
+    static const uint8_t shuffle_16[] = {  0,  1,  4,  5,  8,  9, 12, 13,
+                                           2,  3,  6,  7, 10, 11, 14, 15 };
+    const uint8_t *shuffle = pixel_size == 1 ? shuffle_8 : shuffle_16;
+
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x = 0;
+        /* vpshufb splits U and V within each 128-bits lane, vpermq gathers
+         * them in lanes, vperm2i128 gathers the lanes */
+        for (; x < (width & ~31); x += 32) {
+            asm volatile (
+                "vbroadcasti128 (%[shuffle]), %%ymm7\n"
+                "vmovdqu   0(%[src]), %%ymm0\n"
+                "vmovdqu  32(%[src]), %%ymm1\n"
+                "vpshufb   %%ymm7, %%ymm0, %%ymm0\n"
+                "vpshufb   %%ymm7, %%ymm1, %%ymm1\n"
+                "vpermq    $0xd8, %%ymm0, %%ymm0\n"
+                "vpermq    $0xd8, %%ymm1, %%ymm1\n"
+                "vperm2i128 $0x20, %%ymm1, %%ymm0, %%ymm2\n"
+                "vperm2i128 $0x31, %%ymm1, %%ymm0, %%ymm3\n"
+                "vmovdqu   %%ymm2, (%[dst1])\n"
+                "vmovdqu   %%ymm3, (%[dst2])\n"
+                : : [dst1]"r"(&dstu[x]), [dst2]"r"(&dstv[x]),
+                    [src]"r"(&src[2*x]), [shuffle]"r"(shuffle)
+                : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm7");
+        }
+        /* The scalar tail may be vectorized with legacy SSE */
+        asm volatile ("vzeroupper");
+
+        if (pixel_size == 1)
+        {
+            for (; x < width; x++) {
+                dstu[x] = src[2*x+0];
+                dstv[x] = src[2*x+1];
+            }
+        }
+        else
+        {
+            for (; x < width; x+= 2) {
+                dstu[x] = src[2*x+0];
+                dstu[x+1] = src[2*x+1];
+                dstv[x] = src[2*x+2];
+                dstv[x+1] = src[2*x+3];
+            }
+        }
+        src  += src_pitch;
+        dstu += dstu_pitch;
+        dstv += dstv_pitch;
+    }
+}
+#undef COPY128_AVX_S
+#undef COPY32_AVX_S
+#endif /* CAN_COMPILE_AVX2 */
+
+#ifdef CAN_COMPILE_AVX512
+/* Copy 64/256 bytes from srcp to dstp with the AVX-512 instructions load and
+ * store.
+ */
+
+#define AVX512_SHIFT1(op, x) \
+    op " " x ", %%zmm1, %%zmm1\n"
+#define AVX512_SHIFT4(op, x) \
+    op " " x ", %%zmm1, %%zmm1\n" \
+    op " " x ", %%zmm2, %%zmm2\n" \
+    op " " x ", %%zmm3, %%zmm3\n" \
+    op " " x ", %%zmm4, %%zmm4\n"
+
+#define COPY64_AVX512_S(dstp, srcp, load, store, shiftstr) \
+    asm volatile (                      \
+        load "  0(%[src]), %%zmm1\n"    \
+        shiftstr                        \
+        store " %%zmm1,    0(%[dst])\n" \
+        : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1")
+
+#define COPY256_AVX512_S(dstp, srcp, load, store, shiftstr) \
+    asm volatile (                      \
+        load "   0(%[src]), %%zmm1\n"   \
+        load "  64(%[src]), %%zmm2\n"   \
+        load " 128(%[src]), %%zmm3\n"   \
+        load " 192(%[src]), %%zmm4\n"   \
+        shiftstr                        \
+        store " %%zmm1,     0(%[dst])\n"\
+        store " %%zmm2,    64(%[dst])\n"\
+        store " %%zmm3,   128(%[dst])\n"\
+        store " %%zmm4,   192(%[dst])\n"\
+        : : [dst]"r"(dstp), [src]"r"(srcp) : "memory", "xmm1", "xmm2", "xmm3", "xmm4")
+
+VLC_SSE
+static void AVX512_CopyFromUswc(uint8_t *dst, size_t dst_pitch,
+                                const uint8_t *src, size_t src_pitch,
+                                unsigned width, unsigned height, int bitshift)
+{
+    asm volatile ("mfence");
+
+#define AVX512_USWC_COPY(shiftstr64, shiftstr256) \
+    for (unsigned y = 0; y < height; y++) { \
+        unsigned x = 0; \
+        if (width >= 64) { \
+            /* 512-bits streaming loads need aligned sources */ \
+            const unsigned unaligned = (-(uintptr_t)src) & 0x3f; \
+            if (unaligned) { \
+                COPY64_AVX512_S(dst, src, "vmovdqu64", "vmovdqu64", shiftstr64); \
+                x = unaligned; \
+            } \
+            for (; x+255 < width; x += 256) \
+                COPY256_AVX512_S(&dst[x], &src[x], "vmovntdqa", "vmovdqu64", shiftstr256); \
+            /* CopyPlane() may run legacy SSE code */ \
+            asm volatile ("vzeroupper"); \
+        } \
+        if (x < width) \
+            CopyPlane(&dst[x], dst_pitch - x, &src[x], src_pitch - x, 1, bitshift); \
+        src += src_pitch; \
+        dst += dst_pitch; \
+    }
+
+    switch (bitshift)
+    {
+        case 0:
+            AVX512_USWC_COPY("", "")
+            break;
+        case -6:
+            AVX512_USWC_COPY(AVX512_SHIFT1("vpsllw", "$6"), AVX512_SHIFT4("vpsllw", "$6"))
+            break;
+        case 6:
+            AVX512_USWC_COPY(AVX512_SHIFT1("vpsrlw", "$6"), AVX512_SHIFT4("vpsrlw", "$6"))
+            break;
+        case 2:
+            AVX512_USWC_COPY(AVX512_SHIFT1("vpsrlw", "$2"), AVX512_SHIFT4("vpsrlw", "$2"))
+            break;
+        case -2:
+            AVX512_USWC_COPY(AVX512_SHIFT1("vpsllw", "$2"), AVX512_SHIFT4("vpsllw", "$2"))
+            break;
+        case 4:
+            AVX512_USWC_COPY(AVX512_SHIFT1("vpsrlw", "$4"), AVX512_SHIFT4("vpsrlw", "$4"))
+            break;
+        case -4:
+            AVX512_USWC_COPY(AVX512_SHIFT1("vpsllw", "$4"), AVX512_SHIFT4("vpsllw", "$4"))
+            break;
+        default:
+            vlc_assert_unreachable();
+    }
+#undef AVX512_USWC_COPY
+
+    asm volatile ("mfence");
+}
+
+VLC_SSE
+static void AVX512_Copy2d(uint8_t *dst, size_t dst_pitch,
+                          const uint8_t *src, size_t src_pitch,
+                          unsigned width, unsigned height)
+{
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x = 0;
+
+        bool unaligned = ((intptr_t)dst & 0x3f) != 0;
+        if (!unaligned) {
+            for (; x+255 < width; x += 256)
+                COPY256_AVX512_S(&dst[x], &src[x], "vmovdqu64", "vmovntdq", "");
+        } else {
+            for (; x+255 < width; x += 256)
+                COPY256_AVX512_S(&dst[x], &src[x], "vmovdqu64", "vmovdqu64", "");
+        }
+        /* The scalar tail may be vectorized with legacy SSE */
+        asm volatile ("vzeroupper");
+
+        for (; x < width; x++)
+            dst[x] = src[x];
+
+        src += src_pitch;
+        dst += dst_pitch;
+    }
+}
+#undef COPY256_AVX512_S
+#undef COPY64_AVX512_S
+#endif /* CAN_COMPILE_AVX512 */
+
 /* Optimized copy from "Uncacheable Speculative Write Combining" memory
  * as used by some video surface.
  * XXX It is really efficient only when SSE4.1 is available.
@@ -143,6 +531,23 @@ static void CopyFromUswc(uint8_t *dst, size_t dst_pitch,
 {
     assert(((intptr_t)dst & 0x0f) == 0 && (dst_pitch & 0x0f) == 0);
 
+#ifdef CAN_COMPILE_AVX512
+    if (vlc_CPU_AVX512())
+    {
+        AVX512_CopyFromUswc(dst, dst_pitch, src, src_pitch, width, height,
+                            bitshift);
+        return;
+    }
+#endif
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        AVX2_CopyFromUswc(dst, dst_pitch, src, src_pitch, width, height,
+                          bitshift);
+        return;
+    }
+#endif
+
     asm volatile ("mfence");
 
 #define SSE_USWC_COPY(shiftstr16, shiftstr64) \
@@ -196,7 +601,7 @@ static void CopyFromUswc(uint8_t *dst, size_t dst_pitch,
             SSE_USWC_COPY(COPY16_SHIFTR("$4"), COPY64_SHIFTR("$4"))
             break;
         case -4:
-            SSE_USWC_COPY(COPY16_SHIFTL("$2"), COPY64_SHIFTL("$2"))
+            SSE_USWC_COPY(COPY16_SHIFTL("$4"), COPY64_SHIFTL("$4"))
             break;
         default:
             vlc_assert_unreachable();
@@ -213,6 +618,21 @@ static void Copy2d(uint8_t *dst, size_t dst_pitch,
 {
     assert(((intptr_t)src & 0x0f) == 0 && (src_pitch & 0x0f) == 0);
 
+#ifdef CAN_COMPILE_AVX512
+    if (vlc_CPU_AVX512())
+    {
+        AVX512_Copy2d(dst, dst_pitch, src, src_pitch, width, height);
+        return;
+    }
+#endif
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        AVX2_Copy2d(dst, dst_pitch, src, src_pitch, width, height);
+        return;
+    }
+#endif
+
     for (unsigned y = 0; y < height; y++) {
         unsigned x = 0;
 
@@ -243,6 +663,15 @@ SSE_InterleaveUV(uint8_t *dst, size_t dst_pitch,
     assert(!((intptr_t)srcu & 0xf) && !(srcu_pitch & 0x0f) &&
            !((intptr_t)srcv & 0xf) && !(srcv_pitch & 0x0f));
 
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        AVX2_InterleaveUV(dst, dst_pitch, srcu, srcu_pitch, srcv, srcv_pitch,
+                          width, height, pixel_size);
+        return;
+    }
+#endif
+
     static const uint8_t shuffle_8[] = { 0, 8,
                                          1, 9,
                                          2, 10,
@@ -358,6 +787,15 @@ static void SSE_SplitUV(uint8_t *dstu, size_t dstu_pitch,
     assert(pixel_size == 1 || pixel_size == 2);
     assert(((intptr_t)src & 0xf) == 0 && (src_pitch & 0x0f) == 0);
 
+#ifdef CAN_COMPILE_AVX2
+    if (vlc_CPU_AVX2())
+    {
+        AVX2_SplitUV(dstu, dstu_pitch, dstv, dstv_pitch, src, src_pitch,
+                     width, height, pixel_size);
+        return;
+    }
+#endif
+
 #define LOAD64 \
     "movdqa  0(%[src]), %%xmm0\n" \
     "movdqa 16(%[src]), %%xmm1\n" \
@@ -1103,18 +1541,128 @@ static picture_t *pic_new_unaligned(const video_format_t *fmt)
     return picture_NewFromResource(fmt, &rsc);
 }
 
-int main(void)
+static picture_t *pic_new_src(const struct test_conv *conv,
+                              const struct test_size *size)
 {
-    alarm(10);
+    const vlc_chroma_description_t *src_dsc =
+        vlc_fourcc_GetChromaDescription(conv->src_chroma);
+    assert(src_dsc);
+
+    video_format_t fmt;
+    video_format_Init(&fmt, 0);
+    video_format_Setup(&fmt, conv->src_chroma,
+                       size->i_width, size->i_height,
+                       size->i_visible_width, size->i_visible_height,
+                       1, 1);
+    picture_t *src = pic_new_unaligned(&fmt);
+    assert(src);
+    piccheck(src, src_dsc, true);
+    return src;
+}
+
+static void run_conv(const struct test_dst *test_dst, picture_t *dst,
+                     picture_t *src, const copy_cache_t *cache)
+{
+    const uint8_t * src_planes[3] = { src->p[Y_PLANE].p_pixels,
+                                      src->p[U_PLANE].p_pixels,
+                                      src->p[V_PLANE].p_pixels };
+    const size_t    src_pitches[3] = { src->p[Y_PLANE].i_pitch,
+                                       src->p[U_PLANE].i_pitch,
+                                       src->p[V_PLANE].i_pitch };
+
+    if (test_dst->bitshift == 0)
+        test_dst->conv(dst, src_planes, src_pitches,
+                       src->format.i_visible_height, cache);
+    else
+        test_dst->conv16(dst, src_planes, src_pitches,
+                       src->format.i_visible_height, test_dst->bitshift,
+                       cache);
+}
 
 #ifndef COPY_TEST_NOOPTIM
-    if (!vlc_CPU_SSE2())
+/* Instruction set levels, each one including the previous ones */
+static const struct
+{
+    const char *name;
+    unsigned flags;
+} isas[] = {
+    { "SSE2",    VLC_CPU_SSE2 },
+    { "SSSE3",   VLC_CPU_SSE2|VLC_CPU_SSE3|VLC_CPU_SSSE3 },
+    { "SSE4.1",  VLC_CPU_SSE2|VLC_CPU_SSE3|VLC_CPU_SSSE3|VLC_CPU_SSE4_1 },
+    { "AVX2",    VLC_CPU_SSE2|VLC_CPU_SSE3|VLC_CPU_SSSE3|VLC_CPU_SSE4_1
+                 |VLC_CPU_AVX2 },
+    { "AVX-512", VLC_CPU_SSE2|VLC_CPU_SSE3|VLC_CPU_SSSE3|VLC_CPU_SSE4_1
+                 |VLC_CPU_AVX2|VLC_CPU_AVX512 },
+};
+#endif
+
+#ifdef COPY_BENCH
+static const struct test_size bench_sizes[] = {
+    { 1920, 1088, 1920, 1080 },
+    { 3840, 2160, 3840, 2160 },
+};
+
+/* Run each conversion for a while and print the source bandwidth */
+static void bench_convs(const char *isa)
+{
+    for (size_t i = 0; i < NB_CONVS; ++i)
     {
-        fprintf(stderr, "WARNING: could not test SSE\n");
-        return 77;
+        const struct test_conv *conv = &convs[i];
+
+        for (size_t j = 0; j < ARRAY_SIZE(bench_sizes); ++j)
+        {
+            const struct test_size *size = &bench_sizes[j];
+            picture_t *src = pic_new_src(conv, size);
+            const vlc_chroma_description_t *src_dsc =
+                vlc_fourcc_GetChromaDescription(conv->src_chroma);
+
+            size_t bytes = 0;
+            for (int p = 0; p < src->i_planes; p++)
+                bytes += (size_t)src->p[p].i_visible_pitch
+                         * src->p[p].i_visible_lines;
+
+            copy_cache_t cache;
+            int ret = CopyInitCache(&cache, src->format.i_width
+                                    * src_dsc->pixel_size);
+            assert(ret == VLC_SUCCESS);
+
+            for (size_t f = 0; conv->dsts[f].chroma != 0; ++f)
+            {
+                const struct test_dst *test_dst = &conv->dsts[f];
+                video_format_t fmt = src->format;
+                fmt.i_chroma = test_dst->chroma;
+                picture_t *dst = picture_NewFromFormat(&fmt);
+                assert(dst);
+
+                unsigned count = 0;
+                vlc_tick_t start = vlc_tick_now(), elapsed;
+                do
+                {
+                    run_conv(test_dst, dst, src, &cache);
+                    count++;
+                    elapsed = vlc_tick_now() - start;
+                }
+                while (elapsed < VLC_TICK_FROM_MS(200));
+
+                printf("%-8s %4.4s -> %4.4s %4ux%-4u %2u bits: %6.2f GB/s\n",
+                       isa, (const char *) &src->format.i_chroma,
+                       (const char *) &dst->format.i_chroma,
+                       size->i_visible_width, size->i_visible_height,
+                       src_dsc->pixel_bits,
+                       (double)bytes * count
+                       / secf_from_vlc_tick(elapsed) / 1e9);
+                picture_Release(dst);
+            }
+            picture_Release(src);
+            CopyCleanCache(&cache);
+        }
     }
+}
 #endif
 
+#ifndef COPY_BENCH
+static void test_convs(void)
+{
     for (size_t i = 0; i < NB_CONVS; ++i)
     {
         const struct test_conv *conv = &convs[i];
@@ -1122,20 +1670,9 @@ int main(void)
         for (size_t j = 0; j < NB_SIZES; ++j)
         {
             const struct test_size *size = &sizes[j];
-
+            picture_t *src = pic_new_src(conv, size);
             const vlc_chroma_description_t *src_dsc =
                 vlc_fourcc_GetChromaDescription(conv->src_chroma);
-            assert(src_dsc);
-
-            video_format_t fmt;
-            video_format_Init(&fmt, 0);
-            video_format_Setup(&fmt, conv->src_chroma,
-                               size->i_width, size->i_height,
-                               size->i_visible_width, size->i_visible_height,
-                               1, 1);
-            picture_t *src = pic_new_unaligned(&fmt);
-            assert(src);
-            piccheck(src, src_dsc, true);
 
             copy_cache_t cache;
             int ret = CopyInitCache(&cache, src->format.i_width
@@ -1149,29 +1686,17 @@ int main(void)
                 const vlc_chroma_description_t *dst_dsc =
                     vlc_fourcc_GetChromaDescription(test_dst->chroma);
                 assert(dst_dsc);
+                video_format_t fmt = src->format;
                 fmt.i_chroma = test_dst->chroma;
                 picture_t *dst = picture_NewFromFormat(&fmt);
                 assert(dst);
 
-                const uint8_t * src_planes[3] = { src->p[Y_PLANE].p_pixels,
-                                                  src->p[U_PLANE].p_pixels,
-                                                  src->p[V_PLANE].p_pixels };
-                const size_t    src_pitches[3] = { src->p[Y_PLANE].i_pitch,
-                                                   src->p[U_PLANE].i_pitch,
-                                                   src->p[V_PLANE].i_pitch };
-
                 fprintf(stderr, "testing: %u x %u (vis: %u x %u) %4.4s -> %4.4s\n",
                         size->i_width, size->i_height,
                         size->i_visible_width, size->i_visible_height,
                         (const char *) &src->format.i_chroma,
                         (const char *) &dst->format.i_chroma);
-                if (test_dst->bitshift == 0)
-                    test_dst->conv(dst, src_planes, src_pitches,
-                                   src->format.i_visible_height, &cache);
-                else
-                    test_dst->conv16(dst, src_planes, src_pitches,
-                                   src->format.i_visible_height, test_dst->bitshift,
-                                   &cache);
+                run_conv(test_dst, dst, src, &cache);
                 piccheck(dst, dst_dsc, false);
                 picture_Release(dst);
             }
@@ -1179,6 +1704,39 @@ int main(void)
             CopyCleanCache(&cache);
         }
     }
+}
+#endif
+
+int main(void)
+{
+#ifdef COPY_TEST_NOOPTIM
+    alarm(10);
+    test_convs();
+#else
+    if (!vlc_CPU_SSE2())
+    {
+        fprintf(stderr, "WARNING: could not test SSE\n");
+        return 77;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(isas); ++i)
+    {
+        if ((vlc_CPU() & isas[i].flags) != isas[i].flags)
+        {
+            fprintf(stderr, "WARNING: could not test %s\n", isas[i].name);
+            continue;
+        }
+        copy_cpu_mask = isas[i].flags;
+
+# ifdef COPY_BENCH
+        bench_convs(isas[i].name);
+# else
+        fprintf(stderr, "testing %s\n", isas[i].name);
+        alarm(10);
+        test_convs();
+# endif
+    }
+#endif
     return 0;
 }
 
@@ -49,9 +49,12 @@
  *****************************************************************************/
 static int  Activate ( vlc_object_t * );
 
-static void I422_YUY2               ( filter_t *, picture_t *, picture_t * );
-static void I422_YVYU               ( filter_t *, picture_t *, picture_t * );
-static void I422_UYVY               ( filter_t *, picture_t *, picture_t * );
+static void I422_YUY2               ( filter_t *, picture_t *, picture_t *,
+                                      unsigned, unsigned );
+static void I422_YVYU               ( filter_t *, picture_t *, picture_t *,
+                                      unsigned, unsigned );
+static void I422_UYVY               ( filter_t *, picture_t *, picture_t *,
+                                      unsigned, unsigned );
 static void I422_IUYV               ( filter_t *, picture_t *, picture_t * );
 static picture_t *I422_YUY2_Filter  ( filter_t *, picture_t * );
 static picture_t *I422_YVYU_Filter  ( filter_t *, picture_t * );
@@ -147,9 +150,9 @@ static int Activate( vlc_object_t *p_this )
 
 /* Following functions are local */
 
-VIDEO_FILTER_WRAPPER( I422_YUY2 )
-VIDEO_FILTER_WRAPPER( I422_YVYU )
-VIDEO_FILTER_WRAPPER( I422_UYVY )
+VIDEO_FILTER_WRAPPER_SLICED( I422_YUY2 )
+VIDEO_FILTER_WRAPPER_SLICED( I422_YVYU )
+VIDEO_FILTER_WRAPPER_SLICED( I422_UYVY )
 VIDEO_FILTER_WRAPPER( I422_IUYV )
 #if defined (MODULE_NAME_IS_i422_yuy2)
 VIDEO_FILTER_WRAPPER( I422_Y211 )
@@ -160,12 +163,12 @@ VIDEO_FILTER_WRAPPER( I422_Y211 )
  *****************************************************************************/
 VLC_TARGET
 static void I422_YUY2( filter_t *p_filter, picture_t *p_source,
-                                           picture_t *p_dest )
+                       picture_t *p_dest, unsigned first, unsigned count )
 {
-    uint8_t *p_line = p_dest->p->p_pixels;
-    uint8_t *p_y = p_source->Y_PIXELS;
-    uint8_t *p_u = p_source->U_PIXELS;
-    uint8_t *p_v = p_source->V_PIXELS;
+    uint8_t *p_line = p_dest->p->p_pixels + first * p_dest->p->i_pitch;
+    uint8_t *p_y = p_source->Y_PIXELS + first * p_source->p[Y_PLANE].i_pitch;
+    uint8_t *p_u = p_source->U_PIXELS + first * p_source->p[U_PLANE].i_pitch;
+    uint8_t *p_v = p_source->V_PIXELS + first * p_source->p[V_PLANE].i_pitch;
 
     int i_x, i_y;
 
@@ -185,7 +188,7 @@ static void I422_YUY2( filter_t *p_filter, picture_t *p_source,
         ((intptr_t)p_line|(intptr_t)p_y))) )
     {
         /* use faster SSE2 aligned fetch and store */
-        for( i_y = (p_filter->fmt_in.video.i_y_offset + p_filter->fmt_in.video.i_visible_height) ; i_y-- ; )
+        for( i_y = count ; i_y-- ; )
         {
             for( i_x = (p_filter->fmt_in.video.i_x_offset + p_filter->fmt_in.video.i_visible_width) / 16 ; i_x-- ; )
             {
@@ -203,7 +206,7 @@ static void I422_YUY2( filter_t *p_filter, picture_t *p_source,
     }
     else {
         /* use slower SSE2 unaligned fetch and store */
-        for( i_y = (p_filter->fmt_in.video.i_y_offset + p_filter->fmt_in.video.i_visible_height) ; i_y-- ; )
+        for( i_y = count ; i_y-- ; )
         {
             for( i_x = (p_filter->fmt_in.video.i_x_offset + p_filter->fmt_in.video.i_visible_width) / 16 ; i_x-- ; )
             {
@@ -223,7 +226,7 @@ static void I422_YUY2( filter_t *p_filter, picture_t *p_source,
 
 #else
 
-    for( i_y = (p_filter->fmt_in.video.i_y_offset + p_filter->fmt_in.video.i_visible_height) ; i_y-- ; )
+    for( i_y = count ; i_y-- ; )
     {
         for( i_x = (p_filter->fmt_in.video.i_x_offset + p_filter->fmt_in.video.i_visible_width) / 8 ; i_x-- ; )
         {
@@ -257,12 +260,12 @@ static void I422_YUY2( filter_t *p_filter, picture_t *p_source,
  *****************************************************************************/
 VLC_TARGET
 static void I422_YVYU( filter_t *p_filter, picture_t *p_source,
-                                           picture_t *p_dest )
+                       picture_t *p_dest, unsigned first, unsigned count )
 {
-    uint8_t *p_line = p_dest->p->p_pixels;
-    uint8_t *p_y = p_source->Y_PIXELS;
-    uint8_t *p_u = p_source->U_PIXELS;
-    uint8_t *p_v = p_source->V_PIXELS;
+    uint8_t *p_line = p_dest->p->p_pixels + first * p_dest->p->i_pitch;
+    uint8_t *p_y = p_source->Y_PIXELS + first * p_source->p[Y_PLANE].i_pitch;
+    uint8_t *p_u = p_source->U_PIXELS + first * p_source->p[U_PLANE].i_pitch;
+    uint8_t *p_v = p_source->V_PIXELS + first * p_source->p[V_PLANE].i_pitch;
 
     int i_x, i_y;
 
@@ -282,7 +285,7 @@ static void I422_YVYU( filter_t *p_filter, picture_t *p_source,
         ((intptr_t)p_line|(intptr_t)p_y))) )
     {
         /* use faster SSE2 aligned fetch and store */
-        for( i_y = (p_filter->fmt_in.video.i_y_offset + p_filter->fmt_in.video.i_visible_height) ; i_y-- ; )
+        for( i_y = count ; i_y-- ; )
         {
             for( i_x = (p_filter->fmt_in.video.i_x_offset + p_filter->fmt_in.video.i_visible_width) / 16 ; i_x-- ; )
             {
@@ -300,7 +303,7 @@ static void I422_YVYU( filter_t *p_filter, picture_t *p_source,
     }
     else {
         /* use slower SSE2 unaligned fetch and store */
-        for( i_y = (p_filter->fmt_in.video.i_y_offset + p_filter->fmt_in.video.i_visible_height) ; i_y-- ; )
+        for( i_y = count ; i_y-- ; )
         {
             for( i_x = (p_filter->fmt_in.video.i_x_offset + p_filter->fmt_in.video.i_visible_width) / 16 ; i_x-- ; )
             {
@@ -320,7 +323,7 @@ static void I422_YVYU( filter_t *p_filter, picture_t *p_source,
 
 #else
 
-    for( i_y = (p_filter->fmt_in.video.i_y_offset + p_filter->fmt_in.video.i_visible_height) ; i_y-- ; )
+    for( i_y = count ; i_y-- ; )
     {
         for( i_x = (p_filter->fmt_in.video.i_x_offset + p_filter->fmt_in.video.i_visible_width) / 8 ; i_x-- ; )
         {
@@ -354,12 +357,12 @@ static void I422_YVYU( filter_t *p_filter, picture_t *p_source,
  *****************************************************************************/
 VLC_TARGET
 static void I422_UYVY( filter_t *p_filter, picture_t *p_source,
-                                           picture_t *p_dest )
+                       picture_t *p_dest, unsigned first, unsigned count )
 {
-    uint8_t *p_line = p_dest->p->p_pixels;
-    uint8_t *p_y = p_source->Y_PIXELS;
-    uint8_t *p_u = p_source->U_PIXELS;
-    uint8_t *p_v = p_source->V_PIXELS;
+    uint8_t *p_line = p_dest->p->p_pixels + first * p_dest->p->i_pitch;
+    uint8_t *p_y = p_source->Y_PIXELS + first * p_source->p[Y_PLANE].i_pitch;
+    uint8_t *p_u = p_source->U_PIXELS + first * p_source->p[U_PLANE].i_pitch;
+    uint8_t *p_v = p_source->V_PIXELS + first * p_source->p[V_PLANE].i_pitch;
 
     int i_x, i_y;
 
@@ -379,7 +382,7 @@ static void I422_UYVY( filter_t *p_filter, picture_t *p_source,
         ((intptr_t)p_line|(intptr_t)p_y))) )
     {
         /* use faster SSE2 aligned fetch and store */
-        for( i_y = (p_filter->fmt_in.video.i_y_offset + p_filter->fmt_in.video.i_visible_height) ; i_y-- ; )
+        for( i_y = count ; i_y-- ; )
         {
             for( i_x = (p_filter->fmt_in.video.i_x_offset + p_filter->fmt_in.video.i_visible_width) / 16 ; i_x-- ; )
             {
@@ -397,7 +400,7 @@ static void I422_UYVY( filter_t *p_filter, picture_t *p_source,
     }
     else {
         /* use slower SSE2 unaligned fetch and store */
-        for( i_y = (p_filter->fmt_in.video.i_y_offset + p_filter->fmt_in.video.i_visible_height) ; i_y-- ; )
+        for( i_y = count ; i_y-- ; )
         {
             for( i_x = (p_filter->fmt_in.video.i_x_offset + p_filter->fmt_in.video.i_visible_width) / 16 ; i_x-- ; )
             {
@@ -417,7 +420,7 @@ static void I422_UYVY( filter_t *p_filter, picture_t *p_source,
 
 #else
 
-    for( i_y = (p_filter->fmt_in.video.i_y_offset + p_filter->fmt_in.video.i_visible_height) ; i_y-- ; )
+    for( i_y = count ; i_y-- ; )
     {
         for( i_x = (p_filter->fmt_in.video.i_x_offset + p_filter->fmt_in.video.i_visible_width) / 8 ; i_x-- ; )
         {
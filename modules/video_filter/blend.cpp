@@ -27,15 +27,22 @@
 # include "config.h"
 #endif
 
+#ifdef BLEND_TEST
+# undef NDEBUG
+#endif
+
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
+#include "blend_simd.h"
 
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
+#ifndef BLEND_TEST
 static int  Open (vlc_object_t *);
 static void Close(vlc_object_t *);
 
@@ -44,6 +51,7 @@ vlc_module_begin()
     set_capability("video blending", 100)
     set_callbacks(Open, Close)
 vlc_module_end()
+#endif
 
 static inline unsigned div255(unsigned v)
 {
@@ -80,6 +88,20 @@ public:
     {
         return fmt;
     }
+    unsigned getX() const
+    {
+        return x;
+    }
+    unsigned getY() const
+    {
+        return y;
+    }
+    /* Raw access, for the vectorized blends */
+    uint8_t *getPixels(unsigned plane, unsigned offset, unsigned line) const
+    {
+        const plane_t *p = &picture->p[plane];
+        return &p->p_pixels[line * p->i_pitch + offset];
+    }
     bool isFull(unsigned) const
     {
         return true;
@@ -556,6 +578,104 @@ void Blend(const CPicture &dst_data, const CPicture &src_data,
 typedef void (*blend_function_t)(const CPicture &dst_data, const CPicture &src_data,
                                  unsigned width, unsigned height, int alpha);
 
+/* Vectorized blends of the most common subpicture formats. They use row
+ * kernels and produce exactly the same output as the generic ones. */
+template <const blend_kernels_t *k, bool swap_uv>
+void BlendYUVAToI420(const CPicture &dst, const CPicture &src,
+                     unsigned width, unsigned height, int alpha)
+{
+    const unsigned dx = dst.getX(), dy = dst.getY();
+    const unsigned sx = src.getX(), sy = src.getY();
+    /* The first source column landing on a chroma sample */
+    const unsigned odd = dx & 1;
+    const unsigned cwidth = (width - odd + 1) / 2;
+
+    for (unsigned y = 0; y < height; y++) {
+        const uint8_t *a = src.getPixels(3, sx, sy + y);
+
+        k->merge(dst.getPixels(0, dx, dy + y), src.getPixels(0, sx, sy + y),
+                 a, width, alpha);
+        if (((dy + y) % 2) != 0 || cwidth == 0)
+            continue;
+        k->merge_sub2(dst.getPixels(swap_uv ? 2 : 1, (dx + odd) / 2, (dy + y) / 2),
+                      src.getPixels(1, sx + odd, sy + y), a + odd,
+                      cwidth, alpha);
+        k->merge_sub2(dst.getPixels(swap_uv ? 1 : 2, (dx + odd) / 2, (dy + y) / 2),
+                      src.getPixels(2, sx + odd, sy + y), a + odd,
+                      cwidth, alpha);
+    }
+}
+
+template <const blend_kernels_t *k, bool swap_uv>
+void BlendYUVAToNV12(const CPicture &dst, const CPicture &src,
+                     unsigned width, unsigned height, int alpha)
+{
+    const unsigned dx = dst.getX(), dy = dst.getY();
+    const unsigned sx = src.getX(), sy = src.getY();
+    const unsigned odd = dx & 1;
+    const unsigned cwidth = (width - odd + 1) / 2;
+
+    for (unsigned y = 0; y < height; y++) {
+        const uint8_t *a = src.getPixels(3, sx, sy + y);
+
+        k->merge(dst.getPixels(0, dx, dy + y), src.getPixels(0, sx, sy + y),
+                 a, width, alpha);
+        if (((dy + y) % 2) != 0 || cwidth == 0)
+            continue;
+        k->merge_uv(dst.getPixels(1, dx + odd, (dy + y) / 2),
+                    src.getPixels(swap_uv ? 2 : 1, sx + odd, sy + y),
+                    src.getPixels(swap_uv ? 1 : 2, sx + odd, sy + y),
+                    a + odd, cwidth, alpha);
+    }
+}
+
+template <const blend_kernels_t *k, bool swap_rb>
+void BlendRGBAToRGBA(const CPicture &dst, const CPicture &src,
+                     unsigned width, unsigned height, int alpha)
+{
+    const unsigned dx = dst.getX(), dy = dst.getY();
+    const unsigned sx = src.getX(), sy = src.getY();
+
+    for (unsigned y = 0; y < height; y++)
+        k->merge_rgba(dst.getPixels(0, 4 * dx, dy + y),
+                      src.getPixels(0, 4 * sx, sy + y), width, alpha, swap_rb);
+}
+
+template <const blend_kernels_t *k, bool swap_uv>
+void BlendRGBAToI420(const CPicture &dst, const CPicture &src,
+                     unsigned width, unsigned height, int alpha)
+{
+    /* Even, so that the chroma phase is the same for all the chunks */
+    enum { CHUNK = 256 };
+    uint8_t yuva[4][CHUNK];
+    const unsigned dx = dst.getX(), dy = dst.getY();
+    const unsigned sx = src.getX(), sy = src.getY();
+    const unsigned odd = dx & 1;
+
+    for (unsigned y = 0; y < height; y++) {
+        const bool chroma = ((dy + y) % 2) == 0;
+
+        for (unsigned x = 0; x < width; x += CHUNK) {
+            const unsigned n = __MIN(width - x, (unsigned)CHUNK);
+            const unsigned cn = (n - odd + 1) / 2;
+
+            /* The global alpha is applied here: div255(255 * a) == a */
+            k->rgba_to_yuva(yuva[0], yuva[1], yuva[2], yuva[3],
+                            src.getPixels(0, 4 * (sx + x), sy + y), n, alpha);
+            k->merge(dst.getPixels(0, dx + x, dy + y), yuva[0], yuva[3],
+                     n, 255);
+            if (!chroma || cn == 0)
+                continue;
+            k->merge_sub2(dst.getPixels(swap_uv ? 2 : 1, (dx + x + odd) / 2,
+                                        (dy + y) / 2),
+                          yuva[1] + odd, yuva[3] + odd, cn, 255);
+            k->merge_sub2(dst.getPixels(swap_uv ? 1 : 2, (dx + x + odd) / 2,
+                                        (dy + y) / 2),
+                          yuva[2] + odd, yuva[3] + odd, cn, 255);
+        }
+    }
+}
+
 namespace {
 
 static const struct {
@@ -632,6 +752,53 @@ static const struct {
 #undef YUV
 };
 
+static const struct {
+    vlc_fourcc_t     dst;
+    vlc_fourcc_t     src;
+    unsigned         cpu;
+    blend_function_t blend;
+} simd_blends[] = {
+#define SIMD(kernels, flags) \
+    { VLC_CODEC_I420, VLC_CODEC_YUVA, flags, BlendYUVAToI420<&kernels, false> }, \
+    { VLC_CODEC_J420, VLC_CODEC_YUVA, flags, BlendYUVAToI420<&kernels, false> }, \
+    { VLC_CODEC_YV12, VLC_CODEC_YUVA, flags, BlendYUVAToI420<&kernels, true> }, \
+    { VLC_CODEC_NV12, VLC_CODEC_YUVA, flags, BlendYUVAToNV12<&kernels, false> }, \
+    { VLC_CODEC_NV21, VLC_CODEC_YUVA, flags, BlendYUVAToNV12<&kernels, true> }, \
+    { VLC_CODEC_RGBA, VLC_CODEC_RGBA, flags, BlendRGBAToRGBA<&kernels, false> }, \
+    { VLC_CODEC_BGRA, VLC_CODEC_RGBA, flags, BlendRGBAToRGBA<&kernels, true> }, \
+    { VLC_CODEC_I420, VLC_CODEC_RGBA, flags, BlendRGBAToI420<&kernels, false> }, \
+    { VLC_CODEC_J420, VLC_CODEC_RGBA, flags, BlendRGBAToI420<&kernels, false> }, \
+    { VLC_CODEC_YV12, VLC_CODEC_RGBA, flags, BlendRGBAToI420<&kernels, true> }
+
+    /* Best first */
+#ifdef HAVE_BLEND_AVX2
+    SIMD(blend_kernels_avx2,   VLC_CPU_AVX2),
+#endif
+#ifdef HAVE_BLEND_SSE4_1
+    SIMD(blend_kernels_sse4_1, VLC_CPU_SSE4_1),
+#endif
+#undef SIMD
+    { 0, 0, 0, NULL }
+};
+
+/* cpu is the set of usable vlc_CPU() flags, 0 for the generic blends only */
+static blend_function_t FindBlend(vlc_fourcc_t dst, vlc_fourcc_t src,
+                                  unsigned cpu)
+{
+    for (size_t i = 0; simd_blends[i].blend != NULL; i++) {
+        if (simd_blends[i].src == src && simd_blends[i].dst == dst
+         && (simd_blends[i].cpu & cpu) == simd_blends[i].cpu)
+            return simd_blends[i].blend;
+    }
+
+    blend_function_t blend = NULL;
+    for (size_t i = 0; i < sizeof(blends) / sizeof(*blends); i++) {
+        if (blends[i].src == src && blends[i].dst == dst)
+            blend = blends[i].blend;
+    }
+    return blend;
+}
+
 struct filter_sys_t {
     filter_sys_t() : blend(NULL)
     {
@@ -641,6 +808,7 @@ struct filter_sys_t {
 
 } // namespace
 
+#ifndef BLEND_TEST
 /**
  * It blends 2 picture together.
  */
@@ -682,10 +850,7 @@ static int Open(vlc_object_t *object)
     const vlc_fourcc_t dst = filter->fmt_out.video.i_chroma;
 
     filter_sys_t *sys = new filter_sys_t();
-    for (size_t i = 0; i < sizeof(blends) / sizeof(*blends); i++) {
-        if (blends[i].src == src && blends[i].dst == dst)
-            sys->blend = blends[i].blend;
-    }
+    sys->blend = FindBlend(dst, src, vlc_CPU());
 
     if (!sys->blend) {
        msg_Err(filter, "no matching alpha blending routine (chroma: %4.4s -> %4.4s)",
@@ -706,3 +871,189 @@ static void Close(vlc_object_t *object)
     delete p_sys;
 }
 
+#else /* BLEND_TEST */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *IsaName(unsigned cpu)
+{
+#ifdef HAVE_BLEND_AVX2
+    if (cpu == VLC_CPU_AVX2)
+        return "AVX2";
+#endif
+#ifdef HAVE_BLEND_SSE4_1
+    if (cpu == VLC_CPU_SSE4_1)
+        return "SSE4.1";
+#endif
+    return cpu == 0 ? "C" : "?";
+}
+
+/* Random content, with plenty of fully transparent and opaque samples */
+static picture_t *NewPicture(vlc_fourcc_t chroma, unsigned width,
+                             unsigned height)
+{
+    video_format_t fmt;
+
+    video_format_Init(&fmt, chroma);
+    fmt.i_width = fmt.i_visible_width = width;
+    fmt.i_height = fmt.i_visible_height = height;
+
+    picture_t *pic = picture_NewFromFormat(&fmt);
+    assert(pic != NULL);
+    for (int i = 0; i < pic->i_planes; i++) {
+        plane_t *p = &pic->p[i];
+
+        for (int j = 0; j < p->i_pitch * p->i_lines; j++) {
+            unsigned v = rand();
+            switch ((v >> 8) & 3) {
+                case 0:  p->p_pixels[j] = 0;   break;
+                case 1:  p->p_pixels[j] = 255; break;
+                default: p->p_pixels[j] = v;   break;
+            }
+        }
+    }
+    return pic;
+}
+
+static void Run(blend_function_t blend, picture_t *dst, const picture_t *src,
+                unsigned dx, unsigned dy, unsigned sx, unsigned sy, int alpha)
+{
+    unsigned width  = __MIN(dst->format.i_visible_width - dx,
+                            src->format.i_visible_width - sx);
+    unsigned height = __MIN(dst->format.i_visible_height - dy,
+                            src->format.i_visible_height - sy);
+
+    blend(CPicture(dst, &dst->format, dx, dy),
+          CPicture(src, &src->format, sx, sy), width, height, alpha);
+}
+
+#ifndef BLEND_BENCH
+static const struct {
+    unsigned dst_width, dst_height;
+    unsigned src_width, src_height;
+    unsigned dx, dy, sx, sy;
+} tests[] = {
+    {   67, 41,   50, 30,   0, 0,  0, 0 },
+    {   67, 41,   50, 30,   1, 1,  0, 0 },
+    {   67, 41,   50, 30,   3, 2,  1, 1 },
+    {   67, 41,   50, 30,  66, 40, 0, 0 },
+    { 1001, 12,  700,  7,   0, 3,  0, 0 },
+    { 1001, 12,  700,  7, 301, 4,  3, 2 },
+    { 1001, 12, 1001, 12,   0, 0,  0, 0 },
+};
+
+static const int alphas[] = { 255, 128, 1 };
+
+/* Compare the vectorized blends with the generic ones */
+static unsigned TestBlends(void)
+{
+    unsigned count = 0;
+
+    for (size_t i = 0; simd_blends[i].blend != NULL; i++) {
+        const vlc_fourcc_t dchroma = simd_blends[i].dst;
+        const vlc_fourcc_t schroma = simd_blends[i].src;
+
+        if ((vlc_CPU() & simd_blends[i].cpu) != simd_blends[i].cpu) {
+            fprintf(stderr, "WARNING: could not test %s\n",
+                    IsaName(simd_blends[i].cpu));
+            continue;
+        }
+
+        blend_function_t ref = FindBlend(dchroma, schroma, 0);
+        assert(ref != NULL && ref != simd_blends[i].blend);
+
+        fprintf(stderr, "testing %s: %4.4s -> %4.4s\n",
+                IsaName(simd_blends[i].cpu), (const char *)&schroma,
+                (const char *)&dchroma);
+
+        for (size_t j = 0; j < ARRAY_SIZE(tests); j++) {
+            for (size_t k = 0; k < ARRAY_SIZE(alphas); k++) {
+                picture_t *src = NewPicture(schroma, tests[j].src_width,
+                                            tests[j].src_height);
+                picture_t *dst = NewPicture(dchroma, tests[j].dst_width,
+                                            tests[j].dst_height);
+                picture_t *exp = NewPicture(dchroma, tests[j].dst_width,
+                                            tests[j].dst_height);
+                picture_CopyPixels(exp, dst);
+
+                Run(ref, exp, src, tests[j].dx, tests[j].dy,
+                    tests[j].sx, tests[j].sy, alphas[k]);
+                Run(simd_blends[i].blend, dst, src, tests[j].dx, tests[j].dy,
+                    tests[j].sx, tests[j].sy, alphas[k]);
+
+                for (int p = 0; p < dst->i_planes; p++) {
+                    for (int l = 0; l < dst->p[p].i_visible_lines; l++) {
+                        const uint8_t *a = &dst->p[p].p_pixels[l * dst->p[p].i_pitch];
+                        const uint8_t *b = &exp->p[p].p_pixels[l * exp->p[p].i_pitch];
+
+                        if (memcmp(a, b, dst->p[p].i_visible_pitch) != 0) {
+                            fprintf(stderr, "mismatch: plane %d line %d "
+                                    "(test %zu, alpha %d)\n", p, l, j,
+                                    alphas[k]);
+                            abort();
+                        }
+                    }
+                }
+                picture_Release(exp);
+                picture_Release(dst);
+                picture_Release(src);
+            }
+        }
+        count++;
+    }
+    return count;
+}
+#else
+/* Blend a 720p subpicture at the center of a 1080p picture, for a while */
+static void BenchBlend(blend_function_t blend, unsigned cpu,
+                       vlc_fourcc_t dchroma, vlc_fourcc_t schroma)
+{
+    picture_t *src = NewPicture(schroma, 1280, 720);
+    picture_t *dst = NewPicture(dchroma, 1920, 1080);
+    unsigned count = 0;
+    vlc_tick_t start = vlc_tick_now(), elapsed;
+
+    do {
+        Run(blend, dst, src, 320, 180, 0, 0, 255);
+        count++;
+        elapsed = vlc_tick_now() - start;
+    } while (elapsed < VLC_TICK_FROM_MS(500));
+
+    printf("%-8s %4.4s -> %4.4s: %8.1f Mpixels/s\n", IsaName(cpu),
+           (const char *)&schroma, (const char *)&dchroma,
+           1280. * 720. * count / secf_from_vlc_tick(elapsed) / 1e6);
+    picture_Release(dst);
+    picture_Release(src);
+}
+#endif
+
+int main(void)
+{
+#ifndef BLEND_BENCH
+    alarm(30);
+    if (TestBlends() == 0) {
+        fprintf(stderr, "WARNING: no vectorized blend to test\n");
+        return 77;
+    }
+#else
+    for (size_t i = 0; simd_blends[i].blend != NULL; i++) {
+        const vlc_fourcc_t dchroma = simd_blends[i].dst;
+        const vlc_fourcc_t schroma = simd_blends[i].src;
+
+        if ((vlc_CPU() & simd_blends[i].cpu) != simd_blends[i].cpu)
+            continue;
+
+        /* The generic blend once per format pair, before the best ISA */
+        if (FindBlend(dchroma, schroma, vlc_CPU()) == simd_blends[i].blend)
+            BenchBlend(FindBlend(dchroma, schroma, 0), 0, dchroma, schroma);
+        BenchBlend(simd_blends[i].blend, simd_blends[i].cpu,
+                   dchroma, schroma);
+    }
+#endif
+    return 0;
+}
+
+#endif /* BLEND_TEST */
@@ -0,0 +1,573 @@
+/*****************************************************************************
+ * blend_simd.h: vectorized row kernels for the blend module
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_BLEND_SIMD_H
+#define VLC_BLEND_SIMD_H
+
+/* All kernels compute exactly the same values as the generic templates:
+ *   f   = div255(alpha * a)
+ *   dst = div255((255 - f) * dst + src * f)
+ * with div255(v) = ((v >> 8) + v + 1) >> 8. Every intermediate value fits in
+ * 16 bits, so that 8 (SSE) or 16 (AVX2) pixels are processed at once.
+ */
+typedef struct
+{
+    /* dst[i] = merge(dst[i], src[i], a[i]) */
+    void (*merge)(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                  unsigned n, unsigned alpha);
+    /* dst[i] = merge(dst[i], src[2i], a[2i]), for 2:1 subsampled chroma */
+    void (*merge_sub2)(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                       unsigned n, unsigned alpha);
+    /* dst[2i] = merge(dst[2i], u[2i], a[2i]), same for dst[2i+1] and v */
+    void (*merge_uv)(uint8_t *dst, const uint8_t *u, const uint8_t *v,
+                     const uint8_t *a, unsigned n, unsigned alpha);
+    /* RGBA over RGBA (or BGRA if swap_rb), with destination alpha;
+     * fully transparent source pixels are skipped */
+    void (*merge_rgba)(uint8_t *dst, const uint8_t *src, unsigned n,
+                       unsigned alpha, bool swap_rb);
+    /* RGBA to planar Y, U, V and div255(alpha * a) */
+    void (*rgba_to_yuva)(uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a,
+                         const uint8_t *src, unsigned n, unsigned alpha);
+} blend_kernels_t;
+
+static inline unsigned blend_div255(unsigned v)
+{
+    return ((v >> 8) + v + 1) >> 8;
+}
+
+static inline uint8_t blend_merge(unsigned dst, unsigned src, unsigned f)
+{
+    return blend_div255((255 - f) * dst + src * f);
+}
+
+/* Scalar tails, shared by all the kernels */
+static inline void blend_merge_c(uint8_t *dst, const uint8_t *src,
+                                 const uint8_t *a, unsigned n, unsigned alpha)
+{
+    for (unsigned i = 0; i < n; i++)
+        dst[i] = blend_merge(dst[i], src[i], blend_div255(alpha * a[i]));
+}
+
+static inline void blend_merge_sub2_c(uint8_t *dst, const uint8_t *src,
+                                      const uint8_t *a, unsigned n,
+                                      unsigned alpha)
+{
+    for (unsigned i = 0; i < n; i++)
+        dst[i] = blend_merge(dst[i], src[2 * i],
+                             blend_div255(alpha * a[2 * i]));
+}
+
+static inline void blend_merge_uv_c(uint8_t *dst, const uint8_t *u,
+                                    const uint8_t *v, const uint8_t *a,
+                                    unsigned n, unsigned alpha)
+{
+    for (unsigned i = 0; i < n; i++)
+    {
+        unsigned f = blend_div255(alpha * a[2 * i]);
+        dst[2 * i + 0] = blend_merge(dst[2 * i + 0], u[2 * i], f);
+        dst[2 * i + 1] = blend_merge(dst[2 * i + 1], v[2 * i], f);
+    }
+}
+
+static inline void blend_merge_rgba_c(uint8_t *dst, const uint8_t *src,
+                                      unsigned n, unsigned alpha, bool swap_rb)
+{
+    const unsigned r = swap_rb ? 2 : 0, b = swap_rb ? 0 : 2;
+
+    for (unsigned i = 0; i < n; i++, dst += 4, src += 4)
+    {
+        unsigned f = blend_div255(alpha * src[3]);
+        unsigned inv = 255 - dst[3];
+
+        if (f == 0)
+            continue;
+
+        dst[r] = blend_merge(blend_merge(dst[r], src[0], inv), src[0], f);
+        dst[1] = blend_merge(blend_merge(dst[1], src[1], inv), src[1], f);
+        dst[b] = blend_merge(blend_merge(dst[b], src[2], inv), src[2], f);
+        dst[3] = blend_merge(dst[3], 255, f);
+    }
+}
+
+static inline void blend_rgba_to_yuva_c(uint8_t *y, uint8_t *u, uint8_t *v,
+                                        uint8_t *a, const uint8_t *src,
+                                        unsigned n, unsigned alpha)
+{
+    for (unsigned i = 0; i < n; i++, src += 4)
+    {
+        int r = src[0], g = src[1], b = src[2];
+
+        y[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        u[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        v[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        a[i] = blend_div255(alpha * src[3]);
+    }
+}
+
+#if defined(HAVE_AVX2_INTRINSICS)
+// ================ SSE4.1 / AVX2 =================
+#include <immintrin.h>
+#define HAVE_BLEND_SSE4_1
+#define HAVE_BLEND_AVX2
+#define BLEND_SSE4_1 __attribute__ ((__target__ ("sse4.1")))
+#define BLEND_AVX2 __attribute__ ((__target__ ("avx2")))
+
+BLEND_SSE4_1 static inline __m128i blend_sse_div255(__m128i v)
+{
+    v = _mm_add_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)),
+                      _mm_set1_epi16(1));
+    return _mm_srli_epi16(v, 8);
+}
+
+/* 8 pixels, widened to 16-bit lanes */
+BLEND_SSE4_1 static inline __m128i blend_sse_merge8(__m128i d, __m128i s,
+                                                    __m128i f)
+{
+    __m128i v = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(
+                                  _mm_set1_epi16(255), f), d),
+                              _mm_mullo_epi16(s, f));
+    return blend_sse_div255(v);
+}
+
+/* 16 pixels, with per-byte blending factors */
+BLEND_SSE4_1 static inline __m128i blend_sse_merge16(__m128i d, __m128i s,
+                                                     __m128i f)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = blend_sse_merge8(_mm_unpacklo_epi8(d, zero),
+                                  _mm_unpacklo_epi8(s, zero),
+                                  _mm_unpacklo_epi8(f, zero));
+    __m128i hi = blend_sse_merge8(_mm_unpackhi_epi8(d, zero),
+                                  _mm_unpackhi_epi8(s, zero),
+                                  _mm_unpackhi_epi8(f, zero));
+    return _mm_packus_epi16(lo, hi);
+}
+
+/* div255(alpha * a) for 16 bytes */
+BLEND_SSE4_1 static inline __m128i blend_sse_factor16(__m128i a, __m128i alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = blend_sse_div255(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero),
+                                                  alpha));
+    __m128i hi = blend_sse_div255(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero),
+                                                  alpha));
+    return _mm_packus_epi16(lo, hi);
+}
+
+/* Even bytes of 32 bytes */
+BLEND_SSE4_1 static inline __m128i blend_sse_even32(const uint8_t *p)
+{
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    return _mm_packus_epi16(
+        _mm_and_si128(_mm_loadu_si128((const __m128i *)p), mask),
+        _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + 16)), mask));
+}
+
+BLEND_SSE4_1
+static void blend_merge_sse4_1(uint8_t *dst, const uint8_t *src,
+                               const uint8_t *a, unsigned n, unsigned alpha)
+{
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    unsigned i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i f = blend_sse_factor16(_mm_loadu_si128((const __m128i *)&a[i]),
+                                       valpha);
+        __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+        _mm_storeu_si128((__m128i *)&dst[i], blend_sse_merge16(d, s, f));
+    }
+    blend_merge_c(&dst[i], &src[i], &a[i], n - i, alpha);
+}
+
+BLEND_SSE4_1
+static void blend_merge_sub2_sse4_1(uint8_t *dst, const uint8_t *src,
+                                    const uint8_t *a, unsigned n,
+                                    unsigned alpha)
+{
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    unsigned i = 0;
+
+    /* Only src[0..2n-2] can be read */
+    for (; i + 17 <= n; i += 16)
+    {
+        __m128i f = blend_sse_factor16(blend_sse_even32(&a[2 * i]), valpha);
+        __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+        __m128i s = blend_sse_even32(&src[2 * i]);
+        _mm_storeu_si128((__m128i *)&dst[i], blend_sse_merge16(d, s, f));
+    }
+    blend_merge_sub2_c(&dst[i], &src[2 * i], &a[2 * i], n - i, alpha);
+}
+
+BLEND_SSE4_1
+static void blend_merge_uv_sse4_1(uint8_t *dst, const uint8_t *u,
+                                  const uint8_t *v, const uint8_t *a,
+                                  unsigned n, unsigned alpha)
+{
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    unsigned i = 0;
+
+    for (; i + 9 <= n; i += 8)
+    {
+        __m128i vu = _mm_and_si128(_mm_loadu_si128((const __m128i *)&u[2 * i]),
+                                   mask);
+        __m128i vv = _mm_and_si128(_mm_loadu_si128((const __m128i *)&v[2 * i]),
+                                   mask);
+        __m128i va = _mm_and_si128(_mm_loadu_si128((const __m128i *)&a[2 * i]),
+                                   mask);
+        __m128i s = _mm_or_si128(vu, _mm_slli_epi16(vv, 8));
+        __m128i f = blend_sse_factor16(_mm_or_si128(va, _mm_slli_epi16(va, 8)),
+                                       valpha);
+        __m128i d = _mm_loadu_si128((const __m128i *)&dst[2 * i]);
+        _mm_storeu_si128((__m128i *)&dst[2 * i], blend_sse_merge16(d, s, f));
+    }
+    blend_merge_uv_c(&dst[2 * i], &u[2 * i], &v[2 * i], &a[2 * i], n - i,
+                     alpha);
+}
+
+BLEND_SSE4_1
+static void blend_merge_rgba_sse4_1(uint8_t *dst, const uint8_t *src,
+                                    unsigned n, unsigned alpha, bool swap_rb)
+{
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    const __m128i opaque = _mm_set1_epi32(0xFF000000);
+    const __m128i bcast_a = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7,
+                                          11, 11, 11, 11, 15, 15, 15, 15);
+    /* 255 - dst alpha on the color bytes, 0 (no-op) on the alpha byte */
+    const __m128i bcast_rgb = _mm_setr_epi8(3, 3, 3, -1, 7, 7, 7, -1,
+                                            11, 11, 11, -1, 15, 15, 15, -1);
+    const __m128i order = swap_rb
+        ? _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15)
+        : _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    unsigned i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[4 * i]);
+        __m128i d = _mm_loadu_si128((const __m128i *)&dst[4 * i]);
+        __m128i f = blend_sse_factor16(_mm_shuffle_epi8(s, bcast_a), valpha);
+        __m128i inv = _mm_shuffle_epi8(_mm_xor_si128(d, _mm_set1_epi8(-1)),
+                                       bcast_rgb);
+
+        /* Fully transparent source pixels are left untouched */
+        inv = _mm_andnot_si128(_mm_cmpeq_epi8(f, _mm_setzero_si128()), inv);
+
+        s = _mm_or_si128(_mm_shuffle_epi8(s, order), opaque);
+        d = blend_sse_merge16(d, s, inv);
+        d = blend_sse_merge16(d, s, f);
+        _mm_storeu_si128((__m128i *)&dst[4 * i], d);
+    }
+    blend_merge_rgba_c(&dst[4 * i], &src[4 * i], n - i, alpha, swap_rb);
+}
+
+BLEND_SSE4_1
+static void blend_rgba_to_yuva_sse4_1(uint8_t *y, uint8_t *u, uint8_t *v,
+                                      uint8_t *a, const uint8_t *src,
+                                      unsigned n, unsigned alpha)
+{
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128i round = _mm_set1_epi16(128);
+    unsigned i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i p0 = _mm_loadu_si128((const __m128i *)&src[4 * i]);
+        __m128i p1 = _mm_loadu_si128((const __m128i *)&src[4 * i + 16]);
+        __m128i r = _mm_packs_epi32(_mm_and_si128(p0, mask),
+                                    _mm_and_si128(p1, mask));
+        __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+                                    _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+        __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+                                    _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+        __m128i al = _mm_packs_epi32(_mm_srli_epi32(p0, 24),
+                                     _mm_srli_epi32(p1, 24));
+
+        /* The luma sum fits in 16 unsigned bits, the chroma ones in 16
+         * signed bits */
+        __m128i vy = _mm_add_epi16(_mm_add_epi16(
+                         _mm_mullo_epi16(r, _mm_set1_epi16(66)),
+                         _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+                     _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)),
+                                   round));
+        vy = _mm_add_epi16(_mm_srli_epi16(vy, 8), _mm_set1_epi16(16));
+        __m128i vu = _mm_add_epi16(_mm_sub_epi16(
+                         _mm_mullo_epi16(b, _mm_set1_epi16(112)),
+                         _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(38)),
+                                       _mm_mullo_epi16(g, _mm_set1_epi16(74)))),
+                     round);
+        vu = _mm_add_epi16(_mm_srai_epi16(vu, 8), round);
+        __m128i vv = _mm_add_epi16(_mm_sub_epi16(
+                         _mm_mullo_epi16(r, _mm_set1_epi16(112)),
+                         _mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(94)),
+                                       _mm_mullo_epi16(b, _mm_set1_epi16(18)))),
+                     round);
+        vv = _mm_add_epi16(_mm_srai_epi16(vv, 8), round);
+        al = blend_sse_div255(_mm_mullo_epi16(al, valpha));
+
+        _mm_storel_epi64((__m128i *)&y[i], _mm_packus_epi16(vy, vy));
+        _mm_storel_epi64((__m128i *)&u[i], _mm_packus_epi16(vu, vu));
+        _mm_storel_epi64((__m128i *)&v[i], _mm_packus_epi16(vv, vv));
+        _mm_storel_epi64((__m128i *)&a[i], _mm_packus_epi16(al, al));
+    }
+    blend_rgba_to_yuva_c(&y[i], &u[i], &v[i], &a[i], &src[4 * i], n - i,
+                         alpha);
+}
+
+static const blend_kernels_t blend_kernels_sse4_1 = {
+    blend_merge_sse4_1,
+    blend_merge_sub2_sse4_1,
+    blend_merge_uv_sse4_1,
+    blend_merge_rgba_sse4_1,
+    blend_rgba_to_yuva_sse4_1,
+};
+
+/* The AVX2 kernels are the same, on 256-bit registers. Packing instructions
+ * work within 128-bit lanes, hence the extra permutations. The tails are
+ * handled by the SSE kernels: clear the upper halves first, or every legacy
+ * SSE instruction pays for a state transition. */
+BLEND_AVX2 static inline __m256i blend_avx2_div255(__m256i v)
+{
+    v = _mm256_add_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)),
+                         _mm256_set1_epi16(1));
+    return _mm256_srli_epi16(v, 8);
+}
+
+BLEND_AVX2 static inline __m256i blend_avx2_merge16(__m256i d, __m256i s,
+                                                    __m256i f)
+{
+    __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(
+                                     _mm256_set1_epi16(255), f), d),
+                                 _mm256_mullo_epi16(s, f));
+    return blend_avx2_div255(v);
+}
+
+BLEND_AVX2 static inline __m256i blend_avx2_merge32(__m256i d, __m256i s,
+                                                    __m256i f)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = blend_avx2_merge16(_mm256_unpacklo_epi8(d, zero),
+                                    _mm256_unpacklo_epi8(s, zero),
+                                    _mm256_unpacklo_epi8(f, zero));
+    __m256i hi = blend_avx2_merge16(_mm256_unpackhi_epi8(d, zero),
+                                    _mm256_unpackhi_epi8(s, zero),
+                                    _mm256_unpackhi_epi8(f, zero));
+    return _mm256_packus_epi16(lo, hi);
+}
+
+BLEND_AVX2 static inline __m256i blend_avx2_factor32(__m256i a, __m256i alpha)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = blend_avx2_div255(_mm256_mullo_epi16(
+                                       _mm256_unpacklo_epi8(a, zero), alpha));
+    __m256i hi = blend_avx2_div255(_mm256_mullo_epi16(
+                                       _mm256_unpackhi_epi8(a, zero), alpha));
+    return _mm256_packus_epi16(lo, hi);
+}
+
+BLEND_AVX2 static inline __m256i blend_avx2_even64(const uint8_t *p)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    __m256i v = _mm256_packus_epi16(
+        _mm256_and_si256(_mm256_loadu_si256((const __m256i *)p), mask),
+        _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + 32)), mask));
+    return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+BLEND_AVX2
+static void blend_merge_avx2(uint8_t *dst, const uint8_t *src,
+                             const uint8_t *a, unsigned n, unsigned alpha)
+{
+    const __m256i valpha = _mm256_set1_epi16(alpha);
+    unsigned i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i f = blend_avx2_factor32(
+                        _mm256_loadu_si256((const __m256i *)&a[i]), valpha);
+        __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+        __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+        _mm256_storeu_si256((__m256i *)&dst[i], blend_avx2_merge32(d, s, f));
+    }
+    _mm256_zeroupper();
+    blend_merge_sse4_1(&dst[i], &src[i], &a[i], n - i, alpha);
+}
+
+BLEND_AVX2
+static void blend_merge_sub2_avx2(uint8_t *dst, const uint8_t *src,
+                                  const uint8_t *a, unsigned n, unsigned alpha)
+{
+    const __m256i valpha = _mm256_set1_epi16(alpha);
+    unsigned i = 0;
+
+    for (; i + 33 <= n; i += 32)
+    {
+        __m256i f = blend_avx2_factor32(blend_avx2_even64(&a[2 * i]), valpha);
+        __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+        __m256i s = blend_avx2_even64(&src[2 * i]);
+        _mm256_storeu_si256((__m256i *)&dst[i], blend_avx2_merge32(d, s, f));
+    }
+    _mm256_zeroupper();
+    blend_merge_sub2_sse4_1(&dst[i], &src[2 * i], &a[2 * i], n - i, alpha);
+}
+
+BLEND_AVX2
+static void blend_merge_uv_avx2(uint8_t *dst, const uint8_t *u,
+                                const uint8_t *v, const uint8_t *a,
+                                unsigned n, unsigned alpha)
+{
+    const __m256i valpha = _mm256_set1_epi16(alpha);
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    unsigned i = 0;
+
+    for (; i + 17 <= n; i += 16)
+    {
+        __m256i vu = _mm256_and_si256(
+                         _mm256_loadu_si256((const __m256i *)&u[2 * i]), mask);
+        __m256i vv = _mm256_and_si256(
+                         _mm256_loadu_si256((const __m256i *)&v[2 * i]), mask);
+        __m256i va = _mm256_and_si256(
+                         _mm256_loadu_si256((const __m256i *)&a[2 * i]), mask);
+        __m256i s = _mm256_or_si256(vu, _mm256_slli_epi16(vv, 8));
+        __m256i f = blend_avx2_factor32(
+                        _mm256_or_si256(va, _mm256_slli_epi16(va, 8)), valpha);
+        __m256i d = _mm256_loadu_si256((const __m256i *)&dst[2 * i]);
+        _mm256_storeu_si256((__m256i *)&dst[2 * i],
+                            blend_avx2_merge32(d, s, f));
+    }
+    _mm256_zeroupper();
+    blend_merge_uv_sse4_1(&dst[2 * i], &u[2 * i], &v[2 * i], &a[2 * i], n - i,
+                          alpha);
+}
+
+BLEND_AVX2
+static void blend_merge_rgba_avx2(uint8_t *dst, const uint8_t *src,
+                                  unsigned n, unsigned alpha, bool swap_rb)
+{
+    const __m256i valpha = _mm256_set1_epi16(alpha);
+    const __m256i opaque = _mm256_set1_epi32(0xFF000000);
+    const __m256i bcast_a = _mm256_setr_epi8(
+        3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+        3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+    const __m256i bcast_rgb = _mm256_setr_epi8(
+        3, 3, 3, -1, 7, 7, 7, -1, 11, 11, 11, -1, 15, 15, 15, -1,
+        3, 3, 3, -1, 7, 7, 7, -1, 11, 11, 11, -1, 15, 15, 15, -1);
+    const __m256i order = swap_rb
+        ? _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                           2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15)
+        : _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                           0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    unsigned i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i *)&src[4 * i]);
+        __m256i d = _mm256_loadu_si256((const __m256i *)&dst[4 * i]);
+        __m256i f = blend_avx2_factor32(_mm256_shuffle_epi8(s, bcast_a),
+                                        valpha);
+        __m256i inv = _mm256_shuffle_epi8(
+                          _mm256_xor_si256(d, _mm256_set1_epi8(-1)), bcast_rgb);
+
+        inv = _mm256_andnot_si256(
+                  _mm256_cmpeq_epi8(f, _mm256_setzero_si256()), inv);
+
+        s = _mm256_or_si256(_mm256_shuffle_epi8(s, order), opaque);
+        d = blend_avx2_merge32(d, s, inv);
+        d = blend_avx2_merge32(d, s, f);
+        _mm256_storeu_si256((__m256i *)&dst[4 * i], d);
+    }
+    _mm256_zeroupper();
+    blend_merge_rgba_sse4_1(&dst[4 * i], &src[4 * i], n - i, alpha, swap_rb);
+}
+
+BLEND_AVX2 static inline __m128i blend_avx2_pack_bytes(__m256i v)
+{
+    v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v),
+                                 _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm256_castsi256_si128(v);
+}
+
+BLEND_AVX2
+static void blend_rgba_to_yuva_avx2(uint8_t *y, uint8_t *u, uint8_t *v,
+                                    uint8_t *a, const uint8_t *src,
+                                    unsigned n, unsigned alpha)
+{
+    const __m256i valpha = _mm256_set1_epi16(alpha);
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    const __m256i round = _mm256_set1_epi16(128);
+    unsigned i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i p0 = _mm256_loadu_si256((const __m256i *)&src[4 * i]);
+        __m256i p1 = _mm256_loadu_si256((const __m256i *)&src[4 * i + 32]);
+#define BLEND_AVX2_CHANNEL(shift) \
+        _mm256_permute4x64_epi64(_mm256_packs_epi32( \
+            _mm256_and_si256(_mm256_srli_epi32(p0, shift), mask), \
+            _mm256_and_si256(_mm256_srli_epi32(p1, shift), mask)), \
+            _MM_SHUFFLE(3, 1, 2, 0))
+        __m256i r = BLEND_AVX2_CHANNEL(0);
+        __m256i g = BLEND_AVX2_CHANNEL(8);
+        __m256i b = BLEND_AVX2_CHANNEL(16);
+        __m256i al = BLEND_AVX2_CHANNEL(24);
+#undef BLEND_AVX2_CHANNEL
+
+        __m256i vy = _mm256_add_epi16(_mm256_add_epi16(
+                         _mm256_mullo_epi16(r, _mm256_set1_epi16(66)),
+                         _mm256_mullo_epi16(g, _mm256_set1_epi16(129))),
+                     _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(25)),
+                                      round));
+        vy = _mm256_add_epi16(_mm256_srli_epi16(vy, 8), _mm256_set1_epi16(16));
+        __m256i vu = _mm256_add_epi16(_mm256_sub_epi16(
+                         _mm256_mullo_epi16(b, _mm256_set1_epi16(112)),
+                         _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(38)),
+                                          _mm256_mullo_epi16(g, _mm256_set1_epi16(74)))),
+                     round);
+        vu = _mm256_add_epi16(_mm256_srai_epi16(vu, 8), round);
+        __m256i vv = _mm256_add_epi16(_mm256_sub_epi16(
+                         _mm256_mullo_epi16(r, _mm256_set1_epi16(112)),
+                         _mm256_add_epi16(_mm256_mullo_epi16(g, _mm256_set1_epi16(94)),
+                                          _mm256_mullo_epi16(b, _mm256_set1_epi16(18)))),
+                     round);
+        vv = _mm256_add_epi16(_mm256_srai_epi16(vv, 8), round);
+        al = blend_avx2_div255(_mm256_mullo_epi16(al, valpha));
+
+        _mm_storeu_si128((__m128i *)&y[i], blend_avx2_pack_bytes(vy));
+        _mm_storeu_si128((__m128i *)&u[i], blend_avx2_pack_bytes(vu));
+        _mm_storeu_si128((__m128i *)&v[i], blend_avx2_pack_bytes(vv));
+        _mm_storeu_si128((__m128i *)&a[i], blend_avx2_pack_bytes(al));
+    }
+    _mm256_zeroupper();
+    blend_rgba_to_yuva_sse4_1(&y[i], &u[i], &v[i], &a[i], &src[4 * i], n - i,
+                              alpha);
+}
+
+static const blend_kernels_t blend_kernels_avx2 = {
+    blend_merge_avx2,
+    blend_merge_sub2_avx2,
+    blend_merge_uv_avx2,
+    blend_merge_rgba_avx2,
+    blend_rgba_to_yuva_avx2,
+};
+#endif
+
+#endif
@@ -46,6 +46,87 @@
    Necessary preprocessor macros are defined in common.h. */
 #include "yadif.h"
 
+typedef void (*yadif_filter_line)(uint8_t *dst, uint8_t *prev, uint8_t *cur,
+                                  uint8_t *next, int w, int prefs, int mrefs,
+                                  int parity, int mode);
+
+struct yadif_slice
+{
+    yadif_filter_line filter;
+    picture_t *p_dst;
+    const picture_t *p_prev;
+    const picture_t *p_cur;
+    const picture_t *p_next;
+    unsigned i_pixel_size;
+    int i_field;
+    int i_parity;
+};
+
+/* Filters the lines of every plane matching the band of luma lines
+ * [first, first + count[. Bands only write their own lines, so that they can
+ * run concurrently. */
+static void YadifSlice( filter_t *p_filter, void *opaque,
+                        unsigned first, unsigned count )
+{
+    const struct yadif_slice *slice = opaque;
+    picture_t *p_dst = slice->p_dst;
+    const unsigned i_lines = p_dst->p[0].i_visible_lines;
+    VLC_UNUSED(p_filter);
+
+    for( int n = 0; n < p_dst->i_planes; n++ )
+    {
+        const plane_t *prevp = &slice->p_prev->p[n];
+        const plane_t *curp  = &slice->p_cur->p[n];
+        const plane_t *nextp = &slice->p_next->p[n];
+        plane_t *dstp        = &p_dst->p[n];
+
+        /* Same proportional split for all planes, so that the bands of a
+         * plane cover it exactly once. */
+        int y_start = (uint64_t)first * dstp->i_visible_lines / i_lines;
+        int y_end = (uint64_t)(first + count) * dstp->i_visible_lines / i_lines;
+        if( y_start < 1 )
+            y_start = 1;
+        if( y_end > dstp->i_visible_lines - 1 )
+            y_end = dstp->i_visible_lines - 1;
+
+        for( int y = y_start; y < y_end; y++ )
+        {
+            if( (y % 2) == slice->i_field  ||  slice->i_parity == 2 )
+            {
+                memcpy( &dstp->p_pixels[y * dstp->i_pitch],
+                            &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
+            }
+            else
+            {
+                int mode;
+                /* Spatial checks only when enough data */
+                mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
+
+                assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
+                slice->filter( &dstp->p_pixels[y * dstp->i_pitch],
+                        &prevp->p_pixels[y * prevp->i_pitch],
+                        &curp->p_pixels[y * curp->i_pitch],
+                        &nextp->p_pixels[y * nextp->i_pitch],
+                        dstp->i_visible_pitch / slice->i_pixel_size,
+                        y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
+                        y  - 1  ?  -curp->i_pitch : curp->i_pitch,
+                        slice->i_parity,
+                        mode );
+            }
+
+            /* We duplicate the first and last lines */
+            if( y == 1 )
+                memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+            else if( y == dstp->i_visible_lines - 2 )
+                memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+        }
+    }
+}
+
 int RenderYadifSingle( filter_t *p_filter, picture_t *p_dst, picture_t *p_src )
 {
     return RenderYadif( p_filter, p_dst, p_src, 0, 0 );
@@ -108,10 +189,23 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
     /* Filter if we have all the pictures we need */
     if( p_prev && p_cur && p_next )
     {
-        /* */
-        void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
-                       int w, int prefs, int mrefs, int parity, int mode);
+        yadif_filter_line filter;
 
+        if( p_sys->chroma->pixel_size == 2 )
+        {
+#if defined(HAVE_YADIF_AVX2)
+            if( vlc_CPU_AVX2() )
+                filter = yadif_filter_line_avx2_16bit;
+            else
+#endif
+                filter = yadif_filter_line_c_16bit;
+        }
+        else
+#if defined(HAVE_YADIF_AVX2)
+        if( vlc_CPU_AVX2() )
+            filter = yadif_filter_line_avx2;
+        else
+#endif
 /* android clang build for x86 fails as not enough registers are available */
 #if !defined(__ANDROID__)
 # if defined(HAVE_YADIF_SSSE3)
@@ -132,52 +226,18 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
 #endif
             filter = yadif_filter_line_c;
 
-        if( p_sys->chroma->pixel_size == 2 )
-            filter = yadif_filter_line_c_16bit;
-
-        for( int n = 0; n < p_dst->i_planes; n++ )
-        {
-            const plane_t *prevp = &p_prev->p[n];
-            const plane_t *curp  = &p_cur->p[n];
-            const plane_t *nextp = &p_next->p[n];
-            plane_t *dstp        = &p_dst->p[n];
-
-            for( int y = 1; y < dstp->i_visible_lines - 1; y++ )
-            {
-                if( (y % 2) == i_field  ||  yadif_parity == 2 )
-                {
-                    memcpy( &dstp->p_pixels[y * dstp->i_pitch],
-                                &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
-                }
-                else
-                {
-                    int mode;
-                    /* Spatial checks only when enough data */
-                    mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
-
-                    assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
-                    filter( &dstp->p_pixels[y * dstp->i_pitch],
-                            &prevp->p_pixels[y * prevp->i_pitch],
-                            &curp->p_pixels[y * curp->i_pitch],
-                            &nextp->p_pixels[y * nextp->i_pitch],
-                            dstp->i_visible_pitch,
-                            y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
-                            y  - 1  ?  -curp->i_pitch : curp->i_pitch,
-                            yadif_parity,
-                            mode );
-                }
-
-                /* We duplicate the first and last lines */
-                if( y == 1 )
-                    memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-                else if( y == dstp->i_visible_lines - 2 )
-                    memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-            }
-        }
+        struct yadif_slice slice = {
+            .filter = filter,
+            .p_dst = p_dst,
+            .p_prev = p_prev,
+            .p_cur = p_cur,
+            .p_next = p_next,
+            .i_pixel_size = p_sys->chroma->pixel_size,
+            .i_field = i_field,
+            .i_parity = yadif_parity,
+        };
+        filter_RunSlices( p_filter, YadifSlice, &slice,
+                          p_dst->p[0].i_visible_lines );
 
         p_sys->context.i_frame_offset = 1; /* p_cur will be rendered at next frame, too */
 
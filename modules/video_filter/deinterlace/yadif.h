@@ -151,3 +151,211 @@ static void yadif_filter_line_c_16bit(uint8_t *dst8, uint8_t *prev8, uint8_t *cu
     prefs /= 2;
     FILTER
 }
+
+#if defined(HAVE_AVX2_INTRINSICS)
+// ================ AVX2 =================
+/* Same algorithm as FILTER, on 16 8-bit samples or 8 16-bit samples at once,
+ * widened to 16-bit and 32-bit lanes respectively. The wide flag is always a
+ * constant, so that the helpers below are resolved at compile time. */
+#include <immintrin.h>
+#define HAVE_YADIF_AVX2
+#define YADIF_AVX2 __attribute__ ((__target__ ("avx2")))
+
+YADIF_AVX2 static inline __m256i yadif_avx2_load(const uint8_t *p, bool wide)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return wide ? _mm256_cvtepu16_epi32(v) : _mm256_cvtepu8_epi16(v);
+}
+
+YADIF_AVX2 static inline __m256i yadif_avx2_add(__m256i a, __m256i b, bool wide)
+{
+    return wide ? _mm256_add_epi32(a, b) : _mm256_add_epi16(a, b);
+}
+
+YADIF_AVX2 static inline __m256i yadif_avx2_sub(__m256i a, __m256i b, bool wide)
+{
+    return wide ? _mm256_sub_epi32(a, b) : _mm256_sub_epi16(a, b);
+}
+
+YADIF_AVX2 static inline __m256i yadif_avx2_min(__m256i a, __m256i b, bool wide)
+{
+    return wide ? _mm256_min_epi32(a, b) : _mm256_min_epi16(a, b);
+}
+
+YADIF_AVX2 static inline __m256i yadif_avx2_max(__m256i a, __m256i b, bool wide)
+{
+    return wide ? _mm256_max_epi32(a, b) : _mm256_max_epi16(a, b);
+}
+
+YADIF_AVX2 static inline __m256i yadif_avx2_gt(__m256i a, __m256i b, bool wide)
+{
+    return wide ? _mm256_cmpgt_epi32(a, b) : _mm256_cmpgt_epi16(a, b);
+}
+
+/* |a - b| */
+YADIF_AVX2 static inline __m256i yadif_avx2_absdiff(__m256i a, __m256i b, bool wide)
+{
+    __m256i d = yadif_avx2_sub(a, b, wide);
+    return wide ? _mm256_abs_epi32(d) : _mm256_abs_epi16(d);
+}
+
+/* (a + b) >> 1, for non-negative a and b */
+YADIF_AVX2 static inline __m256i yadif_avx2_avg(__m256i a, __m256i b, bool wide)
+{
+    __m256i s = yadif_avx2_add(a, b, wide);
+    return wide ? _mm256_srli_epi32(s, 1) : _mm256_srli_epi16(s, 1);
+}
+
+YADIF_AVX2 static inline __m256i yadif_avx2_srl1(__m256i a, bool wide)
+{
+    return wide ? _mm256_srli_epi32(a, 1) : _mm256_srli_epi16(a, 1);
+}
+
+/* Score of the edge direction j, see CHECK() */
+YADIF_AVX2 static inline __m256i yadif_avx2_score(const uint8_t *cur,
+                                                  int mrefs, int prefs,
+                                                  int j, bool wide)
+{
+    const int s = wide ? 2 : 1;
+    __m256i a = yadif_avx2_absdiff(yadif_avx2_load(&cur[mrefs + (j - 1) * s], wide),
+                                   yadif_avx2_load(&cur[prefs - (j + 1) * s], wide), wide);
+    __m256i b = yadif_avx2_absdiff(yadif_avx2_load(&cur[mrefs + j * s], wide),
+                                   yadif_avx2_load(&cur[prefs - j * s], wide), wide);
+    __m256i c = yadif_avx2_absdiff(yadif_avx2_load(&cur[mrefs + (j + 1) * s], wide),
+                                   yadif_avx2_load(&cur[prefs - (j - 1) * s], wide), wide);
+    return yadif_avx2_add(yadif_avx2_add(a, b, wide), c, wide);
+}
+
+YADIF_AVX2 static inline __m256i yadif_avx2_pred(const uint8_t *cur,
+                                                 int mrefs, int prefs,
+                                                 int j, bool wide)
+{
+    const int s = wide ? 2 : 1;
+    return yadif_avx2_avg(yadif_avx2_load(&cur[mrefs + j * s], wide),
+                          yadif_avx2_load(&cur[prefs - j * s], wide), wide);
+}
+
+YADIF_AVX2 static inline __m256i yadif_avx2_pixels(const uint8_t *prev,
+                                                   const uint8_t *cur,
+                                                   const uint8_t *next,
+                                                   const uint8_t *prev2,
+                                                   const uint8_t *next2,
+                                                   int prefs, int mrefs,
+                                                   int mode, bool wide)
+{
+    __m256i c = yadif_avx2_load(&cur[mrefs], wide);
+    __m256i e = yadif_avx2_load(&cur[prefs], wide);
+    __m256i p2 = yadif_avx2_load(prev2, wide);
+    __m256i n2 = yadif_avx2_load(next2, wide);
+    __m256i d = yadif_avx2_avg(p2, n2, wide);
+
+    __m256i temporal_diff0 = yadif_avx2_absdiff(p2, n2, wide);
+    __m256i temporal_diff1 = yadif_avx2_srl1(yadif_avx2_add(
+        yadif_avx2_absdiff(yadif_avx2_load(&prev[mrefs], wide), c, wide),
+        yadif_avx2_absdiff(yadif_avx2_load(&prev[prefs], wide), e, wide),
+        wide), wide);
+    __m256i temporal_diff2 = yadif_avx2_srl1(yadif_avx2_add(
+        yadif_avx2_absdiff(yadif_avx2_load(&next[mrefs], wide), c, wide),
+        yadif_avx2_absdiff(yadif_avx2_load(&next[prefs], wide), e, wide),
+        wide), wide);
+    __m256i diff = yadif_avx2_max(yadif_avx2_srl1(temporal_diff0, wide),
+                       yadif_avx2_max(temporal_diff1, temporal_diff2, wide),
+                       wide);
+
+    __m256i spatial_pred = yadif_avx2_avg(c, e, wide);
+    __m256i spatial_score = yadif_avx2_sub(yadif_avx2_score(cur, mrefs, prefs,
+                                                            0, wide),
+                                           wide ? _mm256_set1_epi32(1)
+                                                : _mm256_set1_epi16(1), wide);
+
+    /* CHECK(-1) CHECK(-2), then CHECK(1) CHECK(2): the second direction of
+     * each side is only tried if the first one was better */
+    for (int side = -1; side <= 1; side += 2)
+    {
+        __m256i score = yadif_avx2_score(cur, mrefs, prefs, side, wide);
+        __m256i better = yadif_avx2_gt(spatial_score, score, wide);
+        spatial_score = _mm256_blendv_epi8(spatial_score, score, better);
+        spatial_pred = _mm256_blendv_epi8(spatial_pred,
+                            yadif_avx2_pred(cur, mrefs, prefs, side, wide),
+                            better);
+
+        score = yadif_avx2_score(cur, mrefs, prefs, 2 * side, wide);
+        better = _mm256_and_si256(better,
+                                  yadif_avx2_gt(spatial_score, score, wide));
+        spatial_score = _mm256_blendv_epi8(spatial_score, score, better);
+        spatial_pred = _mm256_blendv_epi8(spatial_pred,
+                            yadif_avx2_pred(cur, mrefs, prefs, 2 * side, wide),
+                            better);
+    }
+
+    if (mode < 2)
+    {
+        __m256i b = yadif_avx2_avg(yadif_avx2_load(&prev2[2 * mrefs], wide),
+                                   yadif_avx2_load(&next2[2 * mrefs], wide), wide);
+        __m256i f = yadif_avx2_avg(yadif_avx2_load(&prev2[2 * prefs], wide),
+                                   yadif_avx2_load(&next2[2 * prefs], wide), wide);
+        __m256i de = yadif_avx2_sub(d, e, wide);
+        __m256i dc = yadif_avx2_sub(d, c, wide);
+        __m256i bc = yadif_avx2_sub(b, c, wide);
+        __m256i fe = yadif_avx2_sub(f, e, wide);
+        __m256i max = yadif_avx2_max(yadif_avx2_max(de, dc, wide),
+                                     yadif_avx2_min(bc, fe, wide), wide);
+        __m256i min = yadif_avx2_min(yadif_avx2_min(de, dc, wide),
+                                     yadif_avx2_max(bc, fe, wide), wide);
+
+        diff = yadif_avx2_max(yadif_avx2_max(diff, min, wide),
+                              yadif_avx2_sub(_mm256_setzero_si256(), max, wide),
+                              wide);
+    }
+
+    /* diff is never negative, so that the clipping below is a clamp */
+    spatial_pred = yadif_avx2_min(spatial_pred, yadif_avx2_add(d, diff, wide),
+                                  wide);
+    spatial_pred = yadif_avx2_max(spatial_pred, yadif_avx2_sub(d, diff, wide),
+                                  wide);
+    return spatial_pred;
+}
+
+YADIF_AVX2
+static void yadif_filter_line_avx2(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode) {
+    uint8_t *prev2= parity ? prev : cur ;
+    uint8_t *next2= parity ? cur  : next;
+    int x;
+
+    for (x = 0; x + 16 <= w; x += 16) {
+        __m256i v = yadif_avx2_pixels(&prev[x], &cur[x], &next[x], &prev2[x],
+                                      &next2[x], prefs, mrefs, mode, false);
+        _mm_storeu_si128((__m128i *)&dst[x],
+                         _mm_packus_epi16(_mm256_castsi256_si128(v),
+                                          _mm256_extracti128_si256(v, 1)));
+    }
+
+    w -= x;
+    if (w > 0)
+        yadif_filter_line_c(&dst[x], &prev[x], &cur[x], &next[x], w,
+                            prefs, mrefs, parity, mode);
+}
+
+YADIF_AVX2
+static void yadif_filter_line_avx2_16bit(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode) {
+    uint8_t *prev2= parity ? prev : cur ;
+    uint8_t *next2= parity ? cur  : next;
+    int x;
+
+    /* x counts samples, the offsets are in bytes */
+    for (x = 0; x + 8 <= w; x += 8) {
+        __m256i v = yadif_avx2_pixels(&prev[2*x], &cur[2*x], &next[2*x],
+                                      &prev2[2*x], &next2[2*x],
+                                      prefs, mrefs, mode, true);
+        _mm_storeu_si128((__m128i *)&dst[2*x],
+                         _mm_packus_epi32(_mm256_castsi256_si128(v),
+                                          _mm256_extracti128_si256(v, 1)));
+    }
+
+    w -= x;
+    if (w > 0)
+        yadif_filter_line_c_16bit(&dst[2*x], &prev[2*x], &cur[2*x], &next[2*x],
+                                  w, prefs, mrefs, parity, mode);
+}
+#undef YADIF_AVX2
+#endif
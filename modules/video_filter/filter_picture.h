@@ -162,3 +162,30 @@ static inline picture_t *CopyInfoAndRelease( picture_t *p_outpic, picture_t *p_i
 
     return p_outpic;
 }
+
+/*****************************************************************************
+ * PictureBand: view of a horizontal band of a picture
+ *****************************************************************************
+ * Fills p_band with the planes of lines [first, first + count) of p_pic,
+ * counted out of lines, scaled to each plane height. Consecutive bands cover
+ * every line of every plane exactly once. The view only holds the format and
+ * the planes, and must not be released.
+ *****************************************************************************/
+static inline void PictureBand( picture_t *p_band, const picture_t *p_pic,
+                                unsigned first, unsigned count,
+                                unsigned lines )
+{
+    p_band->format = p_pic->format;
+    p_band->i_planes = p_pic->i_planes;
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        const plane_t *p = &p_pic->p[i];
+        unsigned start = (uint64_t)first * p->i_visible_lines / lines;
+        unsigned end = (uint64_t)(first + count) * p->i_visible_lines / lines;
+
+        p_band->p[i] = *p;
+        p_band->p[i].p_pixels = p->p_pixels + start * p->i_pitch;
+        p_band->p[i].i_lines = end - start;
+        p_band->p[i].i_visible_lines = end - start;
+    }
+}
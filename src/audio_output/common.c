@@ -29,8 +29,13 @@
 
 #include <vlc_common.h>
 #include <vlc_aout.h>
+#include <vlc_cpu.h>
 #include "aout_internal.h"
 
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
+
 /*
  * Formats management (internal and external)
  */
@@ -353,6 +358,92 @@ do { \
     }
 }
 
+/* Stereo is by far the most common planar decoder output, and the only
+ * layout that maps to plain vector (un)packing. These return how many
+ * samples per channel they processed. */
+#ifdef HAVE_SSE2_INTRINSICS
+__attribute__((__target__("sse2")))
+static unsigned Interleave2_SSE2( void *restrict dst, const void *const *srcv,
+                                  unsigned samples, unsigned size )
+{
+    const uint8_t *l = srcv[0], *r = srcv[1];
+    uint8_t *d = dst;
+    unsigned i = 0;
+
+    if( size == 4 )
+        for( ; i + 4 <= samples; i += 4, l += 16, r += 16, d += 32 )
+        {
+            __m128 a = _mm_loadu_ps( (const float *)l );
+            __m128 b = _mm_loadu_ps( (const float *)r );
+            _mm_storeu_ps( (float *)d, _mm_unpacklo_ps( a, b ) );
+            _mm_storeu_ps( (float *)(d + 16), _mm_unpackhi_ps( a, b ) );
+        }
+    else if( size == 2 )
+        for( ; i + 8 <= samples; i += 8, l += 16, r += 16, d += 32 )
+        {
+            __m128i a = _mm_loadu_si128( (const __m128i *)l );
+            __m128i b = _mm_loadu_si128( (const __m128i *)r );
+            _mm_storeu_si128( (__m128i *)d, _mm_unpacklo_epi16( a, b ) );
+            _mm_storeu_si128( (__m128i *)(d + 16), _mm_unpackhi_epi16( a, b ) );
+        }
+    return i;
+}
+
+__attribute__((__target__("sse2")))
+static unsigned Deinterleave2_SSE2( void *restrict dst, const void *restrict src,
+                                    unsigned samples, unsigned size )
+{
+    const uint8_t *s = src;
+    uint8_t *l = dst, *r = l + samples * size;
+    unsigned i = 0;
+
+    if( size == 4 )
+        for( ; i + 4 <= samples; i += 4, s += 32, l += 16, r += 16 )
+        {
+            __m128 a = _mm_loadu_ps( (const float *)s );
+            __m128 b = _mm_loadu_ps( (const float *)(s + 16) );
+            _mm_storeu_ps( (float *)l, _mm_shuffle_ps( a, b, _MM_SHUFFLE(2, 0, 2, 0) ) );
+            _mm_storeu_ps( (float *)r, _mm_shuffle_ps( a, b, _MM_SHUFFLE(3, 1, 3, 1) ) );
+        }
+    else if( size == 2 )
+        for( ; i + 8 <= samples; i += 8, s += 32, l += 16, r += 16 )
+        {
+            __m128i a = _mm_loadu_si128( (const __m128i *)s );
+            __m128i b = _mm_loadu_si128( (const __m128i *)(s + 16) );
+            /* sign extended halves, so that packs does not saturate */
+            __m128i la = _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 );
+            __m128i lb = _mm_srai_epi32( _mm_slli_epi32( b, 16 ), 16 );
+            __m128i ra = _mm_srai_epi32( a, 16 );
+            __m128i rb = _mm_srai_epi32( b, 16 );
+            _mm_storeu_si128( (__m128i *)l, _mm_packs_epi32( la, lb ) );
+            _mm_storeu_si128( (__m128i *)r, _mm_packs_epi32( ra, rb ) );
+        }
+    return i;
+}
+#endif
+
+static unsigned Interleave2( void *restrict dst, const void *const *srcv,
+                             unsigned samples, unsigned size )
+{
+#ifdef HAVE_SSE2_INTRINSICS
+    if( vlc_CPU_SSE2() )
+        return Interleave2_SSE2( dst, srcv, samples, size );
+#endif
+    VLC_UNUSED(dst); VLC_UNUSED(srcv); VLC_UNUSED(samples); VLC_UNUSED(size);
+    return 0;
+}
+
+static unsigned Deinterleave2( void *restrict dst, const void *restrict src,
+                               unsigned samples, unsigned size )
+{
+#ifdef HAVE_SSE2_INTRINSICS
+    if( vlc_CPU_SSE2() )
+        return Deinterleave2_SSE2( dst, src, samples, size );
+#endif
+    VLC_UNUSED(dst); VLC_UNUSED(src); VLC_UNUSED(samples); VLC_UNUSED(size);
+    return 0;
+}
+
 /**
  * Interleaves audio samples within a block of samples.
  * \param dst destination buffer for interleaved samples
@@ -366,12 +457,18 @@ do { \
 void aout_Interleave( void *restrict dst, const void *const *srcv,
                       unsigned samples, unsigned chans, vlc_fourcc_t fourcc )
 {
+    unsigned done = 0;
+
+    if( chans == 2 )
+        done = Interleave2( dst, srcv, samples,
+                            aout_BitsPerSample( fourcc ) / 8 );
+
 #define INTERLEAVE_TYPE(type) \
 do { \
-    type *d = dst; \
+    type *d = (type *)dst + done * chans; \
     for( size_t i = 0; i < chans; i++ ) { \
-        const type *s = srcv[i]; \
-        for( size_t j = 0, k = 0; j < samples; j++, k += chans ) \
+        const type *s = (const type *)srcv[i] + done; \
+        for( size_t j = done, k = 0; j < samples; j++, k += chans ) \
             d[k] = *(s++); \
         d++; \
     } \
@@ -402,12 +499,18 @@ do { \
 void aout_Deinterleave( void *restrict dst, const void *restrict src,
                       unsigned samples, unsigned chans, vlc_fourcc_t fourcc )
 {
+    unsigned done = 0;
+
+    if( chans == 2 )
+        done = Deinterleave2( dst, src, samples,
+                              aout_BitsPerSample( fourcc ) / 8 );
+
 #define DEINTERLEAVE_TYPE(type) \
 do { \
-    type *d = dst; \
-    const type *s = src; \
+    const type *s = (const type *)src + done * chans; \
     for( size_t i = 0; i < chans; i++ ) { \
-        for( size_t j = 0, k = 0; j < samples; j++, k += chans ) \
+        type *d = (type *)dst + i * samples + done; \
+        for( size_t j = done, k = 0; j < samples; j++, k += chans ) \
             *(d++) = s[k]; \
         s++; \
     } \
@@ -38,6 +38,7 @@
 #include <vlc_filter.h>
 #include <libvlc.h>
 #include "aout_internal.h"
+#include "filters_pool.h"
 #include "../video_output/vout_internal.h" /* for vout_Request */
 
 static filter_t *CreateFilter(vlc_object_t *obj, const char *type,
@@ -339,6 +340,16 @@ static void aout_FiltersPipelineChangeViewpoint(filter_t *const *filters,
         filter_ChangeViewpoint (filters[i], vp);
 }
 
+static block_t *aout_filter_NewBuffer(filter_t *filter, size_t size)
+{
+    return aout_filters_pool_Get(filter->owner.sys, size);
+}
+
+static const struct filter_audio_callbacks aout_filter_cbs =
+{
+    aout_filter_NewBuffer,
+};
+
 #define AOUT_MAX_FILTERS 10
 
 struct aout_filters
@@ -351,8 +362,54 @@ struct aout_filters
     unsigned count; /**< Number of filters */
     filter_t *tab[AOUT_MAX_FILTERS]; /**< Configured user filters
         (e.g. equalization) and their conversions */
+
+    vlc_object_t *obj;
+    aout_filters_pool_t *pool; /**< Output buffers of the filters */
+    vlc_tick_t stats_date; /**< Last update of the allocations rate */
+    uint_least64_t stats_allocs; /**< Pool allocations at stats_date */
 };
 
+/** Makes the filters allocate their output buffers from the pipeline pool */
+static void aout_FiltersSetOwner(aout_filters_t *filters)
+{
+    for (unsigned i = 0; i < filters->count; i++)
+    {
+        filters->tab[i]->owner.audio = &aout_filter_cbs;
+        filters->tab[i]->owner.sys = filters->pool;
+    }
+    if (filters->resampler != NULL)
+    {
+        filters->resampler->owner.audio = &aout_filter_cbs;
+        filters->resampler->owner.sys = filters->pool;
+    }
+}
+
+/**
+ * Publishes the heap allocations of the pool per second, which should drop
+ * to zero once the pool holds enough buffers for the steady state.
+ */
+static void aout_FiltersUpdateStats(aout_filters_t *filters)
+{
+    vlc_tick_t now = vlc_tick_now();
+    vlc_tick_t elapsed = now - filters->stats_date;
+
+    if (elapsed < VLC_TICK_FROM_SEC(1))
+        return;
+
+    uint_least64_t allocs = aout_filters_pool_Allocs(filters->pool);
+    int64_t rate = ((allocs - filters->stats_allocs) * CLOCK_FREQ
+                    + elapsed / 2) / elapsed;
+
+    if (rate != var_GetInteger(filters->obj, "audio-filter-allocs"))
+    {
+        var_SetInteger(filters->obj, "audio-filter-allocs", rate);
+        msg_Dbg(filters->obj, "filters buffer allocations: %"PRId64"/s",
+                rate);
+    }
+    filters->stats_date = now;
+    filters->stats_allocs = allocs;
+}
+
 /** Callback for visualization selection */
 static int VisualizationCallback (vlc_object_t *obj, const char *var,
                                   vlc_value_t oldval, vlc_value_t newval,
@@ -492,10 +549,21 @@ aout_filters_t *aout_FiltersNew(vlc_object_t *obj,
     if (unlikely(filters == NULL))
         return NULL;
 
+    filters->pool = aout_filters_pool_New();
+    if (unlikely(filters->pool == NULL))
+    {
+        free (filters);
+        return NULL;
+    }
+
     filters->rate_filter = NULL;
     filters->resampler = NULL;
     filters->resampling = 0;
     filters->count = 0;
+    filters->obj = obj;
+    filters->stats_date = vlc_tick_now();
+    filters->stats_allocs = 0;
+    var_Create (obj, "audio-filter-allocs", VLC_VAR_INTEGER);
 
     /* Prepare format structure */
     aout_FormatPrint (obj, "input", infmt);
@@ -518,6 +586,7 @@ aout_filters_t *aout_FiltersNew(vlc_object_t *obj,
             }
             filters->count++;
         }
+        aout_FiltersSetOwner (filters);
         return filters;
     }
     if (aout_FormatNbChannels(outfmt) == 0)
@@ -631,11 +700,14 @@ aout_filters_t *aout_FiltersNew(vlc_object_t *obj,
     if (filters->rate_filter == NULL)
         filters->rate_filter = filters->resampler;
 
+    aout_FiltersSetOwner (filters);
     return filters;
 
 error:
     aout_FiltersPipelineDestroy (filters->tab, filters->count);
     var_DelCallback(obj, "visual", VisualizationCallback, NULL);
+    var_Destroy (obj, "audio-filter-allocs");
+    aout_filters_pool_Release (filters->pool);
     free (filters);
     return NULL;
 }
@@ -652,6 +724,8 @@ void aout_FiltersDelete (vlc_object_t *obj, aout_filters_t *filters)
         aout_FiltersPipelineDestroy (&filters->resampler, 1);
     aout_FiltersPipelineDestroy (filters->tab, filters->count);
     var_DelCallback(obj, "visual", VisualizationCallback, NULL);
+    var_Destroy (obj, "audio-filter-allocs");
+    aout_filters_pool_Release (filters->pool);
     free (filters);
 }
 
@@ -702,6 +776,7 @@ block_t *aout_FiltersPlay(aout_filters_t *filters, block_t *block, float rate)
         assert (filters->rate_filter != NULL);
         filters->rate_filter->fmt_in.audio.i_rate = nominal_rate;
     }
+    aout_FiltersUpdateStats (filters);
     return block;
 
 drop:
@@ -0,0 +1,175 @@
+/*****************************************************************************
+ * filters_pool.c: output buffers of the audio filters
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#include "filters_pool.h"
+
+typedef struct aout_buffer aout_buffer_t;
+
+struct aout_filters_pool
+{
+    vlc_mutex_t lock;
+    aout_buffer_t *free; /**< Recycled buffers, last released first */
+    unsigned free_count;
+    unsigned refs;
+    bool dead; /**< The pipeline is gone, do not recycle anymore */
+    atomic_uint_least64_t allocs; /**< Buffers allocated from the heap */
+};
+
+struct aout_buffer
+{
+    block_t self;
+    aout_filters_pool_t *pool;
+    aout_buffer_t *next;
+    size_t capacity;
+    uint8_t *payload;
+};
+
+static void aout_filters_pool_Destroy(aout_filters_pool_t *pool)
+{
+    assert(pool->refs == 0 && pool->free == NULL);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+static void aout_buffer_Release(block_t *block)
+{
+    aout_buffer_t *buf = container_of(block, aout_buffer_t, self);
+    aout_filters_pool_t *pool = buf->pool;
+
+    vlc_mutex_lock(&pool->lock);
+    if (!pool->dead && pool->free_count < AOUT_POOL_DEPTH)
+    {
+        buf->next = pool->free;
+        pool->free = buf;
+        pool->free_count++;
+        buf = NULL;
+    }
+    bool last = --pool->refs == 0;
+    vlc_mutex_unlock(&pool->lock);
+
+    free(buf);
+    if (last)
+        aout_filters_pool_Destroy(pool);
+}
+
+static const struct vlc_block_callbacks aout_buffer_cbs =
+{
+    aout_buffer_Release,
+};
+
+aout_filters_pool_t *aout_filters_pool_New(void)
+{
+    aout_filters_pool_t *pool = malloc(sizeof (*pool));
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    vlc_mutex_init(&pool->lock);
+    pool->free = NULL;
+    pool->free_count = 0;
+    pool->refs = 1;
+    pool->dead = false;
+    atomic_init(&pool->allocs, 0);
+    return pool;
+}
+
+void aout_filters_pool_Release(aout_filters_pool_t *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    aout_buffer_t *list = pool->free;
+
+    pool->free = NULL;
+    pool->free_count = 0;
+    pool->dead = true;
+    bool last = --pool->refs == 0;
+    vlc_mutex_unlock(&pool->lock);
+
+    while (list != NULL)
+    {
+        aout_buffer_t *next = list->next;
+        free(list);
+        list = next;
+    }
+    if (last)
+        aout_filters_pool_Destroy(pool);
+}
+
+block_t *aout_filters_pool_Get(aout_filters_pool_t *pool, size_t size)
+{
+    aout_buffer_t *buf = NULL;
+
+    vlc_mutex_lock(&pool->lock);
+    for (aout_buffer_t **pp = &pool->free; *pp != NULL; pp = &(*pp)->next)
+        if ((*pp)->capacity >= size)
+        {
+            buf = *pp;
+            *pp = buf->next;
+            pool->free_count--;
+            break;
+        }
+    pool->refs++;
+    vlc_mutex_unlock(&pool->lock);
+
+    if (buf == NULL)
+    {
+        size_t capacity = AOUT_POOL_MIN_SIZE;
+        while (capacity < size && capacity <= (SIZE_MAX / 2))
+            capacity *= 2;
+
+        if (likely(capacity >= size))
+            buf = malloc(sizeof (*buf) + AOUT_POOL_ALIGN + capacity);
+        if (unlikely(buf == NULL))
+        {
+            /* The pipeline still holds its reference */
+            vlc_mutex_lock(&pool->lock);
+            assert(pool->refs > 1);
+            pool->refs--;
+            vlc_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        atomic_fetch_add_explicit(&pool->allocs, 1, memory_order_relaxed);
+
+        uintptr_t payload = (uintptr_t)(buf + 1);
+        payload = (payload + AOUT_POOL_ALIGN - 1) & ~(uintptr_t)(AOUT_POOL_ALIGN - 1);
+        buf->pool = pool;
+        buf->capacity = capacity;
+        buf->payload = (uint8_t *)payload;
+    }
+
+    block_Init(&buf->self, &aout_buffer_cbs, buf->payload, buf->capacity);
+    buf->self.i_buffer = size;
+    return &buf->self;
+}
+
+uint_least64_t aout_filters_pool_Allocs(aout_filters_pool_t *pool)
+{
+    return atomic_load_explicit(&pool->allocs, memory_order_relaxed);
+}
@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * filters_pool.h: output buffers of the audio filters
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef LIBVLC_AOUT_FILTERS_POOL_H
+#define LIBVLC_AOUT_FILTERS_POOL_H 1
+
+/** Smallest buffer of the pool, sizes are rounded up to powers of two */
+#define AOUT_POOL_MIN_SIZE 4096
+/** Maximum number of recycled buffers kept by the pool */
+#define AOUT_POOL_DEPTH 16
+/** Payload alignment of the pool buffers (as block_Alloc()) */
+#define AOUT_POOL_ALIGN 32
+
+/**
+ * Pool of output buffers, shared by the filters of a pipeline.
+ *
+ * The buffers outlive the pipeline when the audio output or the encoder
+ * still holds them: the pool is refcounted by the pipeline and by each
+ * buffer in use.
+ */
+typedef struct aout_filters_pool aout_filters_pool_t;
+
+/**
+ * Creates a pool, with a reference for the pipeline.
+ *
+ * \return the pool, or NULL on error
+ */
+aout_filters_pool_t *aout_filters_pool_New(void);
+
+/**
+ * Releases the pipeline reference.
+ *
+ * The recycled buffers are freed, and the buffers in use are freed rather
+ * than recycled once released.
+ */
+void aout_filters_pool_Release(aout_filters_pool_t *);
+
+/**
+ * Gets an output buffer, recycled if possible.
+ *
+ * \param size size of the buffer in bytes
+ * \return a block with i_buffer set to size, or NULL on error
+ */
+block_t *aout_filters_pool_Get(aout_filters_pool_t *, size_t size);
+
+/**
+ * Returns the number of buffers allocated from the heap so far.
+ */
+uint_least64_t aout_filters_pool_Allocs(aout_filters_pool_t *);
+
+#endif
@@ -47,6 +47,7 @@
 #include "input_internal.h"
 #include "../clock/input_clock.h"
 #include "decoder.h"
+#include "decoder_pool.h"
 #include "event.h"
 #include "resource.h"
 
@@ -77,6 +78,8 @@ struct decoder_owner
     sout_packetizer_input_t *p_sout_input;
 
     vlc_thread_t     thread;
+    struct vlc_decoder_pool *pool; /* shared pool, NULL if threaded */
+    struct vlc_decoder_task task;
 
     void (*pf_update_stat)( struct decoder_owner *, unsigned decoded, unsigned lost );
 
@@ -116,6 +119,9 @@ struct decoder_owner
     float rate;
     unsigned frames_countdown;
     bool paused;
+    /* State of the output, only accessed by the decoding thread or task */
+    float output_rate;
+    bool output_paused;
 
     bool error;
 
@@ -129,6 +135,7 @@ struct decoder_owner
     bool b_draining;
     atomic_bool drained;
     bool b_idle;
+    bool deleting; /* pooled decoders only */
 
     /* CC */
 #define MAX_CC_DECODERS 64 /* The es_out only creates one type of es */
@@ -163,6 +170,31 @@ static inline struct decoder_owner *dec_get_owner( decoder_t *p_dec )
     return container_of( p_dec, struct decoder_owner, dec );
 }
 
+/**
+ * Wakes the decoding thread or task up. Must be called with the fifo locked.
+ */
+static void DecoderSignal( struct decoder_owner *p_owner )
+{
+    vlc_fifo_Signal( p_owner->p_fifo );
+    if( p_owner->pool != NULL )
+        vlc_decoder_pool_Wake( p_owner->pool, &p_owner->task );
+}
+
+/* A pooled decoder must not sleep on a shared thread without telling the
+ * pool, otherwise it could starve the other decoders (or even itself, if the
+ * wake up depends on another pooled decoder making progress). */
+static void DecoderBlockBegin( struct decoder_owner *p_owner )
+{
+    if( p_owner->pool != NULL )
+        vlc_decoder_pool_BlockBegin( p_owner->pool );
+}
+
+static void DecoderBlockEnd( struct decoder_owner *p_owner )
+{
+    if( p_owner->pool != NULL )
+        vlc_decoder_pool_BlockEnd( p_owner->pool );
+}
+
 /**
  * Load a decoder module
  */
@@ -610,6 +642,8 @@ static picture_t *vout_new_buffer( decoder_t *p_dec )
     return vout_GetPicture( p_owner->p_vout );
 }
 
+static int DecoderTimedWait( decoder_t *p_dec, vlc_tick_t deadline );
+
 static subpicture_t *spu_new_buffer( decoder_t *p_dec,
                                      const subpicture_updater_t *p_updater )
 {
@@ -627,7 +661,10 @@ static subpicture_t *spu_new_buffer( decoder_t *p_dec,
         if( p_vout )
             break;
 
-        vlc_tick_sleep( DECODER_SPU_VOUT_WAIT_DURATION );
+        /* Give up on flush or deletion: pooled decoders cannot be cancelled */
+        if( DecoderTimedWait( p_dec, vlc_tick_now()
+                                     + DECODER_SPU_VOUT_WAIT_DURATION ) )
+            break;
     }
 
     if( !p_vout )
@@ -757,12 +794,14 @@ static void DecoderWaitUnblock( decoder_t *p_dec )
 
     vlc_mutex_assert( &p_owner->lock );
 
-    for( ;; )
-    {
-        if( !p_owner->b_waiting || !p_owner->b_has_data )
-            break;
+    if( !p_owner->b_waiting || !p_owner->b_has_data )
+        return;
+
+    DecoderBlockBegin( p_owner );
+    do
         vlc_cond_wait( &p_owner->wait_request, &p_owner->lock );
-    }
+    while( p_owner->b_waiting && p_owner->b_has_data );
+    DecoderBlockEnd( p_owner );
 }
 
 /* DecoderTimedWait: Interruptible wait
@@ -774,12 +813,14 @@ static int DecoderTimedWait( decoder_t *p_dec, vlc_tick_t deadline )
     if (deadline <= vlc_tick_now())
         return VLC_SUCCESS;
 
+    DecoderBlockBegin( p_owner );
     vlc_fifo_Lock( p_owner->p_fifo );
     while( !p_owner->flushing
         && vlc_fifo_TimedWaitCond( p_owner->p_fifo, &p_owner->wait_timed,
                                    deadline ) == 0 );
     int ret = p_owner->flushing ? VLC_EGENERIC : VLC_SUCCESS;
     vlc_fifo_Unlock( p_owner->p_fifo );
+    DecoderBlockEnd( p_owner );
     return ret;
 }
 
@@ -994,15 +1035,19 @@ static void DecoderPlayCc( decoder_t *p_dec, block_t *p_cc,
         if( !p_ccdec )
             continue;
 
+        vlc_fifo_Lock( p_ccowner->p_fifo );
         if( i_bitmap > 1 )
         {
-            block_FifoPut( p_ccowner->p_fifo, block_Duplicate(p_cc) );
+            vlc_fifo_QueueUnlocked( p_ccowner->p_fifo, block_Duplicate(p_cc) );
         }
         else
         {
-            block_FifoPut( p_ccowner->p_fifo, p_cc );
+            vlc_fifo_QueueUnlocked( p_ccowner->p_fifo, p_cc );
             p_cc = NULL; /* was last dec */
         }
+        if( p_ccowner->pool != NULL )
+            vlc_decoder_pool_Wake( p_ccowner->pool, &p_ccowner->task );
+        vlc_fifo_Unlock( p_ccowner->p_fifo );
     }
 
     vlc_mutex_unlock( &p_owner->lock );
@@ -1151,6 +1196,9 @@ static void DecoderUpdateStatVideo( struct decoder_owner *p_owner,
 {
     input_thread_t *p_input = p_owner->p_input;
     unsigned displayed = 0;
+    unsigned late = 0;
+    unsigned stages = 0;
+    unsigned timing[VOUT_TIMING_COUNT][VOUT_TIMING_BUCKETS] = { { 0 } };
 
     /* Update ugly stat */
     if( p_input == NULL )
@@ -1161,6 +1209,7 @@ static void DecoderUpdateStatVideo( struct decoder_owner *p_owner,
         unsigned vout_lost = 0;
 
         vout_GetResetStatistic( p_owner->p_vout, &displayed, &vout_lost );
+        stages = vout_GetResetTiming( p_owner->p_vout, &late, timing );
         lost += vout_lost;
     }
 
@@ -1174,6 +1223,18 @@ static void DecoderUpdateStatVideo( struct decoder_owner *p_owner,
                                   memory_order_relaxed);
         atomic_fetch_add_explicit(&stats->displayed_pictures, displayed,
                                   memory_order_relaxed);
+        atomic_fetch_add_explicit(&stats->late_pictures, late,
+                                  memory_order_relaxed);
+        for( unsigned i = 0; i < VOUT_TIMING_COUNT; i++ )
+        {
+            if( !(stages & (1u << i)) )
+                continue;
+            for( unsigned j = 0; j < VOUT_TIMING_BUCKETS; j++ )
+                if( timing[i][j] != 0 )
+                    atomic_fetch_add_explicit(&stats->vout_timing[i][j],
+                                              timing[i][j],
+                                              memory_order_relaxed);
+        }
     }
 }
 
@@ -1641,141 +1702,188 @@ static void OutputChangeRate( decoder_t *p_dec, float rate )
 }
 
 /**
- * The decoding main loop
+ * Runs one step of the decoding loop
+ *
+ * This is called with the fifo locked, and returns with the fifo locked.
  *
  * \param p_dec the decoder
+ * \retval true if another step can be run immediately
+ * \retval false if the decoder is idle until the fifo is signaled
  */
-static void *DecoderThread( void *p_data )
+static bool DecoderStep( decoder_t *p_dec )
 {
-    decoder_t *p_dec = (decoder_t *)p_data;
     struct decoder_owner *p_owner = dec_get_owner( p_dec );
-    float rate = 1.f;
-    bool paused = false;
 
-    /* The decoder's main loop */
-    vlc_fifo_Lock( p_owner->p_fifo );
-    vlc_fifo_CleanupPush( p_owner->p_fifo );
+    if( p_owner->flushing )
+    {   /* Flush before/regardless of pause. We do not want to resume just
+         * for the sake of flushing (glitches could otherwise happen). */
+        int canc = vlc_savecancel();
 
-    for( ;; )
-    {
-        if( p_owner->flushing )
-        {   /* Flush before/regardless of pause. We do not want to resume just
-             * for the sake of flushing (glitches could otherwise happen). */
-            int canc = vlc_savecancel();
+        vlc_fifo_Unlock( p_owner->p_fifo );
 
-            vlc_fifo_Unlock( p_owner->p_fifo );
+        /* Flush the decoder (and the output) */
+        DecoderProcessFlush( p_dec );
+
+        vlc_fifo_Lock( p_owner->p_fifo );
+        vlc_restorecancel( canc );
 
-            /* Flush the decoder (and the output) */
-            DecoderProcessFlush( p_dec );
+        /* Reset flushing after DecoderProcess in case input_DecoderFlush
+         * is called again. This will avoid a second useless flush (but
+         * harmless). */
+        p_owner->flushing = false;
 
-            vlc_fifo_Lock( p_owner->p_fifo );
-            vlc_restorecancel( canc );
+        return true;
+    }
 
-            /* Reset flushing after DecoderProcess in case input_DecoderFlush
-             * is called again. This will avoid a second useless flush (but
-             * harmless). */
-            p_owner->flushing = false;
+    /* Reset the original pause/rate state when a new aout/vout is created:
+     * this will trigger the OutputChangePause/OutputChangeRate code path
+     * if needed. */
+    if( p_owner->reset_out_state )
+    {
+        p_owner->output_rate = 1.f;
+        p_owner->output_paused = false;
+        p_owner->reset_out_state = false;
+    }
 
-            continue;
-        }
+    if( p_owner->output_paused != p_owner->paused )
+    {   /* Update playing/paused status of the output */
+        int canc = vlc_savecancel();
+        vlc_tick_t date = p_owner->pause_date;
+        bool paused = p_owner->paused;
 
-        /* Reset the original pause/rate state when a new aout/vout is created:
-         * this will trigger the OutputChangePause/OutputChangeRate code path
-         * if needed. */
-        if( p_owner->reset_out_state )
-        {
-            rate = 1.f;
-            paused = false;
-            p_owner->reset_out_state = false;
-        }
+        p_owner->output_paused = paused;
+        vlc_fifo_Unlock( p_owner->p_fifo );
 
-        if( paused != p_owner->paused )
-        {   /* Update playing/paused status of the output */
-            int canc = vlc_savecancel();
-            vlc_tick_t date = p_owner->pause_date;
+        vlc_mutex_lock( &p_owner->lock );
+        OutputChangePause( p_dec, paused, date );
+        vlc_mutex_unlock( &p_owner->lock );
 
-            paused = p_owner->paused;
-            vlc_fifo_Unlock( p_owner->p_fifo );
+        vlc_restorecancel( canc );
+        vlc_fifo_Lock( p_owner->p_fifo );
+        return true;
+    }
 
-            vlc_mutex_lock( &p_owner->lock );
-            OutputChangePause( p_dec, paused, date );
-            vlc_mutex_unlock( &p_owner->lock );
+    if( p_owner->output_rate != p_owner->rate )
+    {
+        int canc = vlc_savecancel();
+        float rate = p_owner->rate;
 
-            vlc_restorecancel( canc );
-            vlc_fifo_Lock( p_owner->p_fifo );
-            continue;
-        }
+        p_owner->output_rate = rate;
+        vlc_fifo_Unlock( p_owner->p_fifo );
 
-        if( rate != p_owner->rate )
-        {
-            int canc = vlc_savecancel();
+        vlc_mutex_lock( &p_owner->lock );
+        OutputChangeRate( p_dec, rate );
+        vlc_mutex_unlock( &p_owner->lock );
 
-            rate = p_owner->rate;
-            vlc_fifo_Unlock( p_owner->p_fifo );
+        vlc_restorecancel( canc );
+        vlc_fifo_Lock( p_owner->p_fifo );
+    }
 
-            vlc_mutex_lock( &p_owner->lock );
-            OutputChangeRate( p_dec, rate );
-            vlc_mutex_unlock( &p_owner->lock );
+    if( p_owner->paused && p_owner->frames_countdown == 0 )
+    {   /* Wait for resumption from pause */
+        p_owner->b_idle = true;
+        vlc_cond_signal( &p_owner->wait_acknowledge );
+        return false;
+    }
 
-            vlc_restorecancel( canc );
-            vlc_fifo_Lock( p_owner->p_fifo );
-        }
+    vlc_cond_signal( &p_owner->wait_fifo );
+    vlc_testcancel(); /* forced expedited cancellation in case of stop */
 
-        if( p_owner->paused && p_owner->frames_countdown == 0 )
-        {   /* Wait for resumption from pause */
+    block_t *p_block = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
+    if( p_block == NULL )
+    {
+        if( likely(!p_owner->b_draining) )
+        {   /* Wait for a block to decode (or a request to drain) */
             p_owner->b_idle = true;
             vlc_cond_signal( &p_owner->wait_acknowledge );
-            vlc_fifo_Wait( p_owner->p_fifo );
-            p_owner->b_idle = false;
-            continue;
+            return false;
         }
+        /* We have emptied the FIFO and there is a pending request to
+         * drain. Pass p_block = NULL to decoder just once. */
+    }
 
-        vlc_cond_signal( &p_owner->wait_fifo );
-        vlc_testcancel(); /* forced expedited cancellation in case of stop */
+    vlc_fifo_Unlock( p_owner->p_fifo );
 
-        block_t *p_block = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
-        if( p_block == NULL )
-        {
-            if( likely(!p_owner->b_draining) )
-            {   /* Wait for a block to decode (or a request to drain) */
-                p_owner->b_idle = true;
-                vlc_cond_signal( &p_owner->wait_acknowledge );
-                vlc_fifo_Wait( p_owner->p_fifo );
-                p_owner->b_idle = false;
-                continue;
-            }
-            /* We have emptied the FIFO and there is a pending request to
-             * drain. Pass p_block = NULL to decoder just once. */
-        }
+    int canc = vlc_savecancel();
+    DecoderProcess( p_dec, p_block );
 
-        vlc_fifo_Unlock( p_owner->p_fifo );
+    if( p_block == NULL && p_dec->fmt_out.i_cat == AUDIO_ES )
+    {   /* Draining: the decoder is drained and all decoded buffers are
+         * queued to the output at this point. Now drain the output. */
+        if( p_owner->p_aout != NULL )
+            aout_DecFlush( p_owner->p_aout, true );
+    }
+    vlc_restorecancel( canc );
 
-        int canc = vlc_savecancel();
-        DecoderProcess( p_dec, p_block );
+    /* TODO? Wait for draining instead of polling. */
+    vlc_mutex_lock( &p_owner->lock );
+    vlc_fifo_Lock( p_owner->p_fifo );
+    if( p_owner->b_draining && (p_block == NULL) )
+    {
+        p_owner->b_draining = false;
+        p_owner->drained = true;
+    }
+    vlc_cond_signal( &p_owner->wait_acknowledge );
+    vlc_mutex_unlock( &p_owner->lock );
+    return true;
+}
 
-        if( p_block == NULL && p_dec->fmt_out.i_cat == AUDIO_ES )
-        {   /* Draining: the decoder is drained and all decoded buffers are
-             * queued to the output at this point. Now drain the output. */
-            if( p_owner->p_aout != NULL )
-                aout_DecFlush( p_owner->p_aout, true );
-        }
-        vlc_restorecancel( canc );
+/**
+ * The decoding main loop
+ *
+ * \param p_dec the decoder
+ */
+static void *DecoderThread( void *p_data )
+{
+    decoder_t *p_dec = (decoder_t *)p_data;
+    struct decoder_owner *p_owner = dec_get_owner( p_dec );
 
-        /* TODO? Wait for draining instead of polling. */
-        vlc_mutex_lock( &p_owner->lock );
-        vlc_fifo_Lock( p_owner->p_fifo );
-        if( p_owner->b_draining && (p_block == NULL) )
+    /* The decoder's main loop */
+    vlc_fifo_Lock( p_owner->p_fifo );
+    vlc_fifo_CleanupPush( p_owner->p_fifo );
+
+    for( ;; )
+    {
+        if( !DecoderStep( p_dec ) )
         {
-            p_owner->b_draining = false;
-            p_owner->drained = true;
+            vlc_fifo_Wait( p_owner->p_fifo );
+            p_owner->b_idle = false;
         }
-        vlc_cond_signal( &p_owner->wait_acknowledge );
-        vlc_mutex_unlock( &p_owner->lock );
     }
     vlc_cleanup_pop();
     vlc_assert_unreachable();
 }
 
+/* Steps run by a pooled decoder before yielding to the other decoders */
+#define DECODER_TASK_MAX_STEPS 16
+
+/**
+ * The decoding task, for decoders running on the shared pool
+ */
+static bool DecoderRunTask( struct vlc_decoder_task *task )
+{
+    struct decoder_owner *p_owner =
+        container_of( task, struct decoder_owner, task );
+    decoder_t *p_dec = &p_owner->dec;
+    bool again = false;
+
+    vlc_fifo_Lock( p_owner->p_fifo );
+    p_owner->b_idle = false;
+
+    for( unsigned i = 0; !p_owner->deleting; i++ )
+    {
+        if( i == DECODER_TASK_MAX_STEPS )
+        {
+            again = true;
+            break;
+        }
+        if( !DecoderStep( p_dec ) )
+            break;
+    }
+    vlc_fifo_Unlock( p_owner->p_fifo );
+    return again;
+}
+
 static const struct decoder_owner_callbacks dec_video_cbs =
 {
     .video = {
@@ -1856,6 +1964,8 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     p_owner->paused = false;
     p_owner->pause_date = VLC_TICK_INVALID;
     p_owner->frames_countdown = 0;
+    p_owner->output_rate = 1.f;
+    p_owner->output_paused = false;
 
     p_owner->b_waiting = false;
     p_owner->b_first = true;
@@ -1868,6 +1978,10 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     p_owner->drained = false;
     atomic_init( &p_owner->reload, RELOAD_NO_REQUEST );
     p_owner->b_idle = false;
+    p_owner->deleting = false;
+
+    p_owner->pool = NULL;
+    vlc_decoder_task_Init( &p_owner->task, DecoderRunTask );
 
     p_owner->mouse_event = NULL;
     p_owner->opaque = NULL;
@@ -2126,6 +2240,17 @@ static decoder_t *decoder_New( vlc_object_t *p_parent, input_thread_t *p_input,
     }
 #endif
 
+    /* Video decoders are heavy and may block on picture buffers: they always
+     * get their own thread. The others can share the pool, if enabled, and
+     * get their own thread too if the pool has none to run them. */
+    int i_pool_threads = var_InheritInteger( p_parent, "decoder-pool-threads" );
+    if( p_dec->fmt_in.i_cat != VIDEO_ES && i_pool_threads > 0 )
+    {
+        p_owner->pool = vlc_decoder_pool_Hold( i_priority, i_pool_threads );
+        if( p_owner->pool != NULL )
+            return p_dec;
+    }
+
     /* Spawn the decoder thread */
     if( vlc_clone( &p_owner->thread, DecoderThread, p_dec, i_priority ) )
     {
@@ -2174,11 +2299,14 @@ void input_DecoderDelete( decoder_t *p_dec )
 {
     struct decoder_owner *p_owner = dec_get_owner( p_dec );
 
-    vlc_cancel( p_owner->thread );
+    if( p_owner->pool == NULL )
+        vlc_cancel( p_owner->thread );
 
     vlc_fifo_Lock( p_owner->p_fifo );
     /* Signal DecoderTimedWait */
     p_owner->flushing = true;
+    /* Pooled decoders cannot be cancelled: stop after the current step */
+    p_owner->deleting = true;
     vlc_cond_signal( &p_owner->wait_timed );
     vlc_fifo_Unlock( p_owner->p_fifo );
 
@@ -2198,7 +2326,13 @@ void input_DecoderDelete( decoder_t *p_dec )
         vout_Cancel( p_owner->p_vout, true );
     vlc_mutex_unlock( &p_owner->lock );
 
-    vlc_join( p_owner->thread, NULL );
+    if( p_owner->pool != NULL )
+    {
+        vlc_decoder_pool_Remove( p_owner->pool, &p_owner->task );
+        vlc_decoder_pool_Release( p_owner->pool );
+    }
+    else
+        vlc_join( p_owner->thread, NULL );
 
     /* */
     if( p_owner->cc.b_supported )
@@ -2246,6 +2380,8 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
     }
 
     vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_block );
+    if( p_owner->pool != NULL )
+        vlc_decoder_pool_Wake( p_owner->pool, &p_owner->task );
     vlc_fifo_Unlock( p_owner->p_fifo );
 }
 
@@ -2296,7 +2432,7 @@ void input_DecoderDrain( decoder_t *p_dec )
 
     vlc_fifo_Lock( p_owner->p_fifo );
     p_owner->b_draining = true;
-    vlc_fifo_Signal( p_owner->p_fifo );
+    DecoderSignal( p_owner );
     vlc_fifo_Unlock( p_owner->p_fifo );
 }
 
@@ -2326,7 +2462,7 @@ void input_DecoderFlush( decoder_t *p_dec )
      && p_owner->frames_countdown == 0 )
         p_owner->frames_countdown++;
 
-    vlc_fifo_Signal( p_owner->p_fifo );
+    DecoderSignal( p_owner );
     vlc_cond_signal( &p_owner->wait_timed );
 
     vlc_fifo_Unlock( p_owner->p_fifo );
@@ -2445,7 +2581,7 @@ void input_DecoderChangePause( decoder_t *p_dec, bool b_paused, vlc_tick_t i_dat
     p_owner->paused = b_paused;
     p_owner->pause_date = i_date;
     p_owner->frames_countdown = 0;
-    vlc_fifo_Signal( p_owner->p_fifo );
+    DecoderSignal( p_owner );
     vlc_fifo_Unlock( p_owner->p_fifo );
 }
 
@@ -2455,7 +2591,7 @@ void input_DecoderChangeRate( decoder_t *dec, float rate )
 
     vlc_fifo_Lock( owner->p_fifo );
     owner->rate = rate;
-    vlc_fifo_Signal( owner->p_fifo );
+    DecoderSignal( owner );
     vlc_fifo_Unlock( owner->p_fifo );
 }
 
@@ -2529,7 +2665,7 @@ void input_DecoderFrameNext( decoder_t *p_dec, vlc_tick_t *pi_duration )
 
     vlc_fifo_Lock( p_owner->p_fifo );
     p_owner->frames_countdown++;
-    vlc_fifo_Signal( p_owner->p_fifo );
+    DecoderSignal( p_owner );
     vlc_fifo_Unlock( p_owner->p_fifo );
 
     vlc_mutex_lock( &p_owner->lock );
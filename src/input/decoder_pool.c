@@ -0,0 +1,307 @@
+/*****************************************************************************
+ * decoder_pool.c: shared pool of threads for lightweight decoders
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_list.h>
+#include <vlc_threads.h>
+
+#include "libvlc.h"
+#include "decoder_pool.h"
+
+/* Idle threads exit after this delay */
+#define DECODER_POOL_IDLE_TIMEOUT VLC_TICK_FROM_SEC(5)
+
+enum
+{
+    TASK_IDLE,
+    TASK_QUEUED,
+    TASK_RUNNING,
+    TASK_RUNNING_WOKEN, /**< woken up while running, run it again */
+};
+
+struct vlc_decoder_pool
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait; /**< wait for a queued task or closing */
+    vlc_cond_t done_wait; /**< wait for a removed task to return */
+    vlc_cond_t nothreads_wait; /**< wait for threads == 0 */
+    struct vlc_list tasks; /**< tasks ready to be run */
+    unsigned queued; /**< number of tasks in the list */
+    unsigned threads; /**< number of threads */
+    unsigned idle; /**< number of threads waiting for a task */
+    unsigned blocked; /**< number of threads running a blocked task */
+    unsigned max_threads; /**< maximum number of unblocked threads */
+    int priority; /**< priority of the threads */
+    bool closing;
+
+    /* Protected by decoder_pools_lock */
+    unsigned refs;
+    struct vlc_list node; /**< in decoder_pools */
+};
+
+/* One pool per thread priority */
+static vlc_mutex_t decoder_pools_lock = VLC_STATIC_MUTEX;
+static struct vlc_list decoder_pools = VLC_LIST_INITIALIZER(&decoder_pools);
+
+static void *Thread(void *data);
+
+/**
+ * Makes sure a queued task will be picked up. Must be called with the pool
+ * lock held.
+ */
+static void PoolSchedule(struct vlc_decoder_pool *pool)
+{
+    if (pool->idle > 0)
+        vlc_cond_signal(&pool->wait);
+
+    if (pool->queued <= pool->idle
+     || pool->threads - pool->blocked >= pool->max_threads)
+        return;
+
+    if (vlc_clone_detach(NULL, Thread, pool, pool->priority))
+        return;
+    pool->threads++;
+}
+
+static void TaskQueue(struct vlc_decoder_pool *pool,
+                      struct vlc_decoder_task *task)
+{
+    task->state = TASK_QUEUED;
+    vlc_list_append(&task->node, &pool->tasks);
+    pool->queued++;
+}
+
+static void *Thread(void *data)
+{
+    struct vlc_decoder_pool *pool = data;
+
+    vlc_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        struct vlc_decoder_task *task =
+            vlc_list_first_entry_or_null(&pool->tasks,
+                                         struct vlc_decoder_task, node);
+        if (task != NULL)
+        {
+            vlc_list_remove(&task->node);
+            pool->queued--;
+            task->state = TASK_RUNNING;
+            vlc_mutex_unlock(&pool->lock);
+
+            bool again = task->run(task);
+
+            vlc_mutex_lock(&pool->lock);
+            if (task->removing)
+            {   /* The task can be destroyed as soon as the lock is released */
+                task->state = TASK_IDLE;
+                vlc_cond_broadcast(&pool->done_wait);
+            }
+            else if (again || task->state == TASK_RUNNING_WOKEN)
+                TaskQueue(pool, task);
+            else
+                task->state = TASK_IDLE;
+            continue;
+        }
+
+        /* Tasks that were blocked have resumed: drop the extra threads */
+        if (pool->closing || pool->threads - pool->blocked > pool->max_threads)
+            break;
+
+        pool->idle++;
+        int timeout = vlc_cond_timedwait(&pool->wait, &pool->lock,
+                                         vlc_tick_now()
+                                         + DECODER_POOL_IDLE_TIMEOUT);
+        pool->idle--;
+        /* Keep one unblocked thread, in case no other one can be spawned
+         * when a task is woken up */
+        if (timeout && vlc_list_is_empty(&pool->tasks)
+         && pool->threads - pool->blocked > 1)
+            break;
+    }
+
+    assert(pool->threads > 0);
+    if (--pool->threads == 0)
+        vlc_cond_signal(&pool->nothreads_wait);
+    vlc_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static struct vlc_decoder_pool *PoolCreate(int priority,
+                                           unsigned max_threads)
+{
+    struct vlc_decoder_pool *pool = malloc(sizeof (*pool));
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    vlc_mutex_init(&pool->lock);
+    vlc_cond_init(&pool->wait);
+    vlc_cond_init(&pool->done_wait);
+    vlc_cond_init(&pool->nothreads_wait);
+    vlc_list_init(&pool->tasks);
+    pool->queued = 0;
+    pool->threads = 0;
+    pool->idle = 0;
+    pool->blocked = 0;
+    pool->max_threads = max_threads > 0 ? max_threads : 1;
+    pool->priority = priority;
+    pool->closing = false;
+    pool->refs = 1;
+    return pool;
+}
+
+static void PoolDestroy(struct vlc_decoder_pool *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    assert(vlc_list_is_empty(&pool->tasks));
+    assert(pool->blocked == 0);
+    pool->closing = true;
+    vlc_cond_broadcast(&pool->wait);
+    while (pool->threads > 0)
+        vlc_cond_wait(&pool->nothreads_wait, &pool->lock);
+    vlc_mutex_unlock(&pool->lock);
+
+    vlc_cond_destroy(&pool->nothreads_wait);
+    vlc_cond_destroy(&pool->done_wait);
+    vlc_cond_destroy(&pool->wait);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+struct vlc_decoder_pool *vlc_decoder_pool_Hold(int priority,
+                                               unsigned max_threads)
+{
+    struct vlc_decoder_pool *pool;
+
+    vlc_mutex_lock(&decoder_pools_lock);
+    vlc_list_foreach(pool, &decoder_pools, node)
+        if (pool->priority == priority)
+        {
+            pool->refs++;
+
+            /* Honor the largest limit requested by any holder */
+            vlc_mutex_lock(&pool->lock);
+            if (max_threads > pool->max_threads)
+            {
+                pool->max_threads = max_threads;
+                if (pool->queued > 0)
+                    PoolSchedule(pool);
+            }
+            vlc_mutex_unlock(&pool->lock);
+            goto out;
+        }
+
+    pool = PoolCreate(priority, max_threads);
+    if (unlikely(pool == NULL))
+        goto out;
+
+    /* Without any thread, a woken task would never run: fail now, so that
+     * the caller can run its task on a thread of its own instead */
+    if (vlc_clone_detach(NULL, Thread, pool, priority))
+    {
+        PoolDestroy(pool);
+        pool = NULL;
+        goto out;
+    }
+    pool->threads = 1;
+    vlc_list_append(&pool->node, &decoder_pools);
+out:
+    vlc_mutex_unlock(&decoder_pools_lock);
+    return pool;
+}
+
+void vlc_decoder_pool_Release(struct vlc_decoder_pool *pool)
+{
+    vlc_mutex_lock(&decoder_pools_lock);
+    if (--pool->refs == 0)
+        vlc_list_remove(&pool->node);
+    else
+        pool = NULL;
+    vlc_mutex_unlock(&decoder_pools_lock);
+
+    if (pool != NULL)
+        PoolDestroy(pool);
+}
+
+void vlc_decoder_task_Init(struct vlc_decoder_task *task,
+                           bool (*run)(struct vlc_decoder_task *))
+{
+    task->run = run;
+    task->state = TASK_IDLE;
+    task->removing = false;
+}
+
+void vlc_decoder_pool_Wake(struct vlc_decoder_pool *pool,
+                           struct vlc_decoder_task *task)
+{
+    vlc_mutex_lock(&pool->lock);
+    if (!task->removing)
+        switch (task->state)
+        {
+            case TASK_IDLE:
+                TaskQueue(pool, task);
+                PoolSchedule(pool);
+                break;
+            case TASK_RUNNING:
+                task->state = TASK_RUNNING_WOKEN;
+                break;
+        }
+    vlc_mutex_unlock(&pool->lock);
+}
+
+void vlc_decoder_pool_Remove(struct vlc_decoder_pool *pool,
+                             struct vlc_decoder_task *task)
+{
+    vlc_mutex_lock(&pool->lock);
+    task->removing = true;
+    if (task->state == TASK_QUEUED)
+    {
+        vlc_list_remove(&task->node);
+        pool->queued--;
+        task->state = TASK_IDLE;
+    }
+    while (task->state != TASK_IDLE)
+        vlc_cond_wait(&pool->done_wait, &pool->lock);
+    vlc_mutex_unlock(&pool->lock);
+}
+
+void vlc_decoder_pool_BlockBegin(struct vlc_decoder_pool *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    pool->blocked++;
+    assert(pool->blocked <= pool->threads);
+    if (pool->queued > 0)
+        PoolSchedule(pool);
+    vlc_mutex_unlock(&pool->lock);
+}
+
+void vlc_decoder_pool_BlockEnd(struct vlc_decoder_pool *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    assert(pool->blocked > 0);
+    pool->blocked--;
+    vlc_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,109 @@
+/*****************************************************************************
+ * decoder_pool.h: shared pool of threads for lightweight decoders
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef LIBVLC_DECODER_POOL_H
+#define LIBVLC_DECODER_POOL_H 1
+
+#include <vlc_list.h>
+
+/**
+ * Process-wide pool of threads running decoder tasks.
+ *
+ * Audio and subtitle decoders spend most of their life waiting for data.
+ * Rather than owning a thread each, they are scheduled as tasks on a small
+ * number of shared threads, which are spawned on demand and exit when idle.
+ * One thread is kept as long as the pool is held, so that a woken task always
+ * runs eventually, even if no more threads can be spawned.
+ */
+struct vlc_decoder_pool;
+
+struct vlc_decoder_task
+{
+    /**
+     * Runs the task until it has nothing left to do.
+     *
+     * \retval true the task yielded and should be run again
+     * \retval false the task is idle until woken up
+     */
+    bool (*run)(struct vlc_decoder_task *);
+
+    /* Private */
+    struct vlc_list node;
+    unsigned state;
+    bool removing;
+};
+
+/**
+ * Get a reference to the shared pool of a given priority, creating it if
+ * needed.
+ *
+ * \param priority priority of the pool threads (VLC_THREAD_PRIORITY_*)
+ * \param max_threads maximum number of threads running tasks concurrently;
+ *                    an existing pool is grown to the largest requested value
+ * \return the pool, or NULL on error, including if the first pool thread
+ *         could not be spawned
+ */
+struct vlc_decoder_pool *vlc_decoder_pool_Hold(int priority,
+                                               unsigned max_threads);
+
+/**
+ * Release a reference to the shared pool.
+ *
+ * All tasks must have been removed. The threads are waited for when the last
+ * reference is released.
+ */
+void vlc_decoder_pool_Release(struct vlc_decoder_pool *pool);
+
+/**
+ * Initialize a task.
+ */
+void vlc_decoder_task_Init(struct vlc_decoder_task *task,
+                           bool (*run)(struct vlc_decoder_task *));
+
+/**
+ * Schedule a task.
+ *
+ * If the task is running, it will be run again once it returns. This can be
+ * called from any thread, including with the task's own locks held.
+ */
+void vlc_decoder_pool_Wake(struct vlc_decoder_pool *pool,
+                           struct vlc_decoder_task *task);
+
+/**
+ * Unschedule a task.
+ *
+ * Waits for the task to return if it is running. The task is never run
+ * again, even if woken up.
+ */
+void vlc_decoder_pool_Remove(struct vlc_decoder_pool *pool,
+                             struct vlc_decoder_task *task);
+
+/**
+ * Mark the calling task as blocked.
+ *
+ * A task about to sleep on something other than its input (e.g. buffering or
+ * pause) must call this first, so that the pool can run other tasks on an
+ * extra thread meanwhile. It must call vlc_decoder_pool_BlockEnd() once
+ * woken up.
+ */
+void vlc_decoder_pool_BlockBegin(struct vlc_decoder_pool *pool);
+void vlc_decoder_pool_BlockEnd(struct vlc_decoder_pool *pool);
+
+#endif
@@ -36,6 +36,12 @@
 #endif
 #include <sys/stat.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_UIO_H
+#  include <sys/uio.h>
+#endif
+#ifdef HAVE_MMAP
+#  include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_fs.h>
@@ -46,6 +52,7 @@
 #include <vlc_input.h>
 #include <vlc_es_out.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "input_internal.h"
 #include "es_out.h"
 #include "es_out_timeshift.h"
@@ -161,23 +168,57 @@ typedef struct attribute_packed
     } u;
 } ts_cmd_t;
 
+/* Header of a block spilled to a segment file. Records are aligned so that
+ * the payloads of a mapped segment are aligned too. */
+typedef struct
+{
+    size_t     i_buffer;
+    uint32_t   i_flags;
+    unsigned   i_nb_samples;
+    vlc_tick_t i_pts;
+    vlc_tick_t i_dts;
+    vlc_tick_t i_length;
+} ts_record_t;
+
+#define TS_RECORD_ALIGN     32
+#define TS_RECORD_ALIGNED(n) (((n) + TS_RECORD_ALIGN - 1) & ~(size_t)(TS_RECORD_ALIGN - 1))
+#define TS_RECORD_HEADER    TS_RECORD_ALIGNED(sizeof (ts_record_t))
+
+#ifdef HAVE_MMAP
+/* Read-only view of a complete segment file, shared by the blocks read
+ * from it */
+typedef struct
+{
+    vlc_atomic_rc_t rc;
+    uint8_t        *p_base;
+    size_t          i_size;
+} ts_map_t;
+#endif
+
 typedef struct ts_storage_t ts_storage_t;
 struct ts_storage_t
 {
     ts_storage_t *p_next;
 
     /* */
+    const char *psz_tmp_path; /* Directory for the segment file */
 #ifdef _WIN32
     char    *psz_file;  /* Filename */
 #endif
     size_t  i_file_max; /* Max size in bytes */
     int64_t i_file_size;/* Current size in bytes */
-    FILE    *p_filew;   /* FILE handle for data writing */
-    FILE    *p_filer;   /* FILE handle for data reading */
+    int     fd;         /* Segment file, created when first needed */
+    bool    b_sealed;   /* No more commands will be pushed */
+#ifdef HAVE_MMAP
+    bool     b_map_failed;
+    ts_map_t *p_map;    /* Mapping of the segment file once complete */
+#endif
+    int64_t i_mem_size; /* Size of the blocks still held in memory */
 
     /* */
     int      i_cmd_r;
     int      i_cmd_w;
+    int      i_cmd_m;   /* First command that may still hold its block */
     int      i_cmd_max;
     ts_cmd_t *p_cmd;
 };
@@ -189,6 +230,7 @@ typedef struct
     es_out_t       *p_out;
     int64_t        i_tmp_size_max;
     const char     *psz_tmp_path;
+    vlc_tick_t     i_mem_delay;
 
     /* Lock for all following fields */
     vlc_mutex_t    lock;
@@ -210,6 +252,7 @@ typedef struct
     /* */
     ts_storage_t   *p_storage_r;
     ts_storage_t   *p_storage_w;
+    bool           b_spill_failed; /* Data cannot be written to disk */
 
     vlc_tick_t     i_cmd_delay;
 
@@ -228,6 +271,7 @@ typedef struct
     /* Configuration */
     int64_t        i_tmp_size_max;    /* Maximal temporary file size in byte */
     char           *psz_tmp_path;     /* Path for temporary files */
+    vlc_tick_t     i_mem_delay;       /* Age of the data kept in memory */
 
     /* Lock for all following fields */
     vlc_mutex_t    lock;
@@ -269,7 +313,9 @@ static void         TsStorageDelete( ts_storage_t * );
 static void         TsStoragePack( ts_storage_t *p_storage );
 static bool         TsStorageIsFull( ts_storage_t *, const ts_cmd_t *p_cmd );
 static bool         TsStorageIsEmpty( ts_storage_t * );
-static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
+static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd );
+static int          TsStorageSpillCmd( ts_storage_t *, ts_cmd_t *p_cmd );
+static void         TsStorageDropCmd( ts_storage_t *, ts_cmd_t *p_cmd );
 static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
 
 static void CmdClean( ts_cmd_t * );
@@ -331,6 +377,9 @@ es_out_t *input_EsOutTimeshiftNew( input_thread_t *p_input, es_out_t *p_next_out
     msg_Dbg( p_input, "using timeshift granularity of %d MiB",
              (int)p_sys->i_tmp_size_max/(1024*1024) );
 
+    const int i_mem_delay = var_CreateGetInteger( p_input, "input-timeshift-memory" );
+    p_sys->i_mem_delay = VLC_TICK_FROM_SEC( __MAX( i_mem_delay, 0 ) );
+
     p_sys->psz_tmp_path = var_InheritString( p_input, "input-timeshift-path" );
 #if defined (_WIN32) && !VLC_WINSTORE_APP
     if( p_sys->psz_tmp_path == NULL )
@@ -800,6 +849,7 @@ static int TsStart( es_out_t *p_out )
 
     p_ts->i_tmp_size_max = p_sys->i_tmp_size_max;
     p_ts->psz_tmp_path = p_sys->psz_tmp_path;
+    p_ts->i_mem_delay = p_sys->i_mem_delay;
     p_ts->p_input = p_sys->p_input;
     p_ts->p_out = p_sys->p_out;
     vlc_mutex_init( &p_ts->lock );
@@ -814,6 +864,7 @@ static int TsStart( es_out_t *p_out )
     p_ts->i_cmd_delay = 0;
     p_ts->p_storage_r = NULL;
     p_ts->p_storage_w = NULL;
+    p_ts->b_spill_failed = false;
 
     p_sys->b_delayed = true;
     if( vlc_clone( &p_ts->thread, TsRun, p_ts, VLC_THREAD_PRIORITY_INPUT ) )
@@ -862,6 +913,59 @@ static void TsStop( ts_thread_t *p_ts )
 
     TsDestroy( p_ts );
 }
+/**
+ * Writes the oldest blocks held in memory to the segment files, until the
+ * remaining ones are recent enough and fit within one segment.
+ *
+ * If the data cannot be written, the oldest blocks are dropped instead once
+ * the memory used exceeds one segment.
+ */
+static void TsSpillLocked( ts_thread_t *p_ts )
+{
+    vlc_mutex_assert( &p_ts->lock );
+
+    int64_t i_mem_size = 0;
+    for( ts_storage_t *p_storage = p_ts->p_storage_r; p_storage != NULL;
+         p_storage = p_storage->p_next )
+        i_mem_size += p_storage->i_mem_size;
+
+    const vlc_tick_t i_date_min = vlc_tick_now() - p_ts->i_mem_delay;
+
+    for( ts_storage_t *p_storage = p_ts->p_storage_r; p_storage != NULL;
+         p_storage = p_storage->p_next )
+    {
+        while( p_storage->i_cmd_m < p_storage->i_cmd_w )
+        {
+            ts_cmd_t *p_cmd = &p_storage->p_cmd[p_storage->i_cmd_m];
+
+            if( p_cmd->i_type == C_SEND && p_cmd->u.send.p_block != NULL )
+            {
+                if( i_mem_size < p_ts->i_tmp_size_max
+                 && p_cmd->i_date >= i_date_min )
+                    return;
+
+                const size_t i_size =
+                    TS_RECORD_HEADER + TS_RECORD_ALIGNED(p_cmd->u.send.p_block->i_buffer);
+
+                if( !p_ts->b_spill_failed && TsStorageSpillCmd( p_storage, p_cmd ) )
+                {
+                    msg_Err( p_ts->p_input, "timeshift: cannot write to "
+                             "temporary file, old data will be dropped" );
+                    p_ts->b_spill_failed = true;
+                }
+
+                if( p_ts->b_spill_failed )
+                {
+                    if( i_mem_size < p_ts->i_tmp_size_max )
+                        return;
+                    TsStorageDropCmd( p_storage, p_cmd );
+                }
+                i_mem_size -= i_size;
+            }
+            p_storage->i_cmd_m++;
+        }
+    }
+}
 static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 {
     vlc_mutex_lock( &p_ts->lock );
@@ -890,8 +994,8 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
         }
     }
 
-    /* TODO return error and warn the user (but only once) */
-    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w );
+    TsStoragePushCmd( p_ts->p_storage_w, p_cmd );
+    TsSpillLocked( p_ts );
 
     vlc_cond_signal( &p_ts->wait );
 
@@ -1112,51 +1216,90 @@ static void *TsRun( void *p_data )
 /*****************************************************************************
  *
  *****************************************************************************/
-static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_max )
+#ifdef HAVE_MMAP
+static void TsMapRelease( ts_map_t *p_map )
 {
-    ts_storage_t *p_storage = malloc( sizeof (*p_storage) );
-    if( unlikely(p_storage == NULL) )
-        return NULL;
-
-    char *psz_file;
-    int fd = GetTmpFile( &psz_file, psz_tmp_path );
-    if( fd == -1 )
+    if( vlc_atomic_rc_dec( &p_map->rc ) )
     {
-        free( p_storage );
-        return NULL;
+        munmap( p_map->p_base, p_map->i_size );
+        free( p_map );
     }
+}
 
-    p_storage->p_filew = fdopen( fd, "w+b" );
-    if( p_storage->p_filew == NULL )
-    {
-        vlc_close( fd );
-        vlc_unlink( psz_file );
-        goto error;
-    }
+typedef struct
+{
+    block_t  self;
+    ts_map_t *p_map;
+} ts_map_block_t;
 
-    p_storage->p_filer = vlc_fopen( psz_file, "rb" );
-    if( p_storage->p_filer == NULL )
+static void TsMapBlockRelease( block_t *p_block )
+{
+    ts_map_block_t *p_mb = container_of( p_block, ts_map_block_t, self );
+
+    TsMapRelease( p_mb->p_map );
+    free( p_mb );
+}
+
+static const struct vlc_block_callbacks ts_map_block_cbs =
+{
+    TsMapBlockRelease,
+};
+
+static ts_map_t *TsMapNew( int fd, size_t i_size )
+{
+    ts_map_t *p_map = malloc( sizeof (*p_map) );
+    if( unlikely(p_map == NULL) )
+        return NULL;
+
+    /* Private writable mapping: decoders may modify blocks in place */
+    void *p_base = mmap( NULL, i_size, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+                         fd, 0 );
+    if( p_base == MAP_FAILED )
     {
-        fclose( p_storage->p_filew );
-        vlc_unlink( psz_file );
-        goto error;
+        free( p_map );
+        return NULL;
     }
-
-#ifndef _WIN32
-    vlc_unlink( psz_file );
-    free( psz_file );
-#else
-    p_storage->psz_file = psz_file;
+#ifdef HAVE_POSIX_MADVISE
+    posix_madvise( p_base, i_size, POSIX_MADV_SEQUENTIAL );
+#endif
+    vlc_atomic_rc_init( &p_map->rc );
+    p_map->p_base = p_base;
+    p_map->i_size = i_size;
+    return p_map;
+}
 #endif
+
+/*****************************************************************************
+ *
+ *****************************************************************************/
+static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_max )
+{
+    ts_storage_t *p_storage = malloc( sizeof (*p_storage) );
+    if( unlikely(p_storage == NULL) )
+        return NULL;
+
+    /* The segment file is only created if blocks have to leave memory */
     p_storage->p_next = NULL;
+    p_storage->psz_tmp_path = psz_tmp_path;
+#ifdef _WIN32
+    p_storage->psz_file = NULL;
+#endif
+    p_storage->fd = -1;
+    p_storage->b_sealed = false;
+#ifdef HAVE_MMAP
+    p_storage->b_map_failed = false;
+    p_storage->p_map = NULL;
+#endif
 
     /* */
     p_storage->i_file_max = i_tmp_size_max;
     p_storage->i_file_size = 0;
+    p_storage->i_mem_size = 0;
 
     /* */
     p_storage->i_cmd_w = 0;
     p_storage->i_cmd_r = 0;
+    p_storage->i_cmd_m = 0;
     p_storage->i_cmd_max = 30000;
     p_storage->p_cmd = vlc_alloc( p_storage->i_cmd_max, sizeof(*p_storage->p_cmd) );
     //fprintf( stderr, "\nSTORAGE name=%s size=%d KiB\n", p_storage->psz_file, p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) /1024 );
@@ -1167,10 +1310,23 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
         return NULL;
     }
     return p_storage;
-error:
+}
+
+static int TsStorageOpenFile( ts_storage_t *p_storage )
+{
+    char *psz_file;
+    int fd = GetTmpFile( &psz_file, p_storage->psz_tmp_path );
+    if( fd == -1 )
+        return VLC_EGENERIC;
+
+#ifndef _WIN32
+    vlc_unlink( psz_file );
     free( psz_file );
-    free( p_storage );
-    return NULL;
+#else
+    p_storage->psz_file = psz_file;
+#endif
+    p_storage->fd = fd;
+    return VLC_SUCCESS;
 }
 
 static void TsStorageDelete( ts_storage_t *p_storage )
@@ -1185,17 +1341,26 @@ static void TsStorageDelete( ts_storage_t *p_storage )
     }
     free( p_storage->p_cmd );
 
-    fclose( p_storage->p_filer );
-    fclose( p_storage->p_filew );
+#ifdef HAVE_MMAP
+    if( p_storage->p_map )
+        TsMapRelease( p_storage->p_map );
+#endif
+    if( p_storage->fd != -1 )
+        vlc_close( p_storage->fd );
 #ifdef _WIN32
-    vlc_unlink( p_storage->psz_file );
-    free( p_storage->psz_file );
+    if( p_storage->psz_file )
+    {
+        vlc_unlink( p_storage->psz_file );
+        free( p_storage->psz_file );
+    }
 #endif
     free( p_storage );
 }
 
 static void TsStoragePack( ts_storage_t *p_storage )
 {
+    p_storage->b_sealed = true;
+
     /* Try to release a bit of memory */
     if( p_storage->i_cmd_w >= p_storage->i_cmd_max )
         return;
@@ -1210,9 +1375,9 @@ static bool TsStorageIsFull( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
     if( p_cmd && p_cmd->i_type == C_SEND && p_storage->i_cmd_w > 0 )
     {
-        size_t i_size = sizeof(*p_cmd->u.send.p_block) + p_cmd->u.send.p_block->i_buffer;
+        size_t i_size = TS_RECORD_HEADER + TS_RECORD_ALIGNED(p_cmd->u.send.p_block->i_buffer);
 
-        if( p_storage->i_file_size + i_size >= p_storage->i_file_max )
+        if( p_storage->i_file_size + p_storage->i_mem_size + i_size >= p_storage->i_file_max )
             return true;
     }
     return p_storage->i_cmd_w >= p_storage->i_cmd_max;
@@ -1221,7 +1386,7 @@ static bool TsStorageIsEmpty( ts_storage_t *p_storage )
 {
     return !p_storage || p_storage->i_cmd_r >= p_storage->i_cmd_w;
 }
-static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
+static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
     ts_cmd_t cmd = *p_cmd;
 
@@ -1229,63 +1394,199 @@ static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bo
 
     if( cmd.i_type == C_SEND )
     {
-        block_t *p_block = cmd.u.send.p_block;
+        /* The block stays in memory until it is either consumed or spilled */
+        cmd.u.send.i_offset = -1;
+        p_storage->i_mem_size += TS_RECORD_HEADER + TS_RECORD_ALIGNED(cmd.u.send.p_block->i_buffer);
+    }
+    p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
+}
+static ssize_t TsStorageWrite( int fd, const struct iovec *iov, int count )
+{
+#ifdef HAVE_SYS_UIO_H
+    return writev( fd, iov, count );
+#else
+    ssize_t i_total = 0;
+
+    for( int i = 0; i < count; i++ )
+    {
+        ssize_t i_ret = write( fd, iov[i].iov_base, iov[i].iov_len );
+        if( i_ret < 0 )
+            return i_ret;
+        i_total += i_ret;
+        if( (size_t)i_ret < iov[i].iov_len )
+            break;
+    }
+    return i_total;
+#endif
+}
+static int TsStorageSpillCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd )
+{
+    static const uint8_t p_zero[TS_RECORD_ALIGN];
+    block_t *p_block = p_cmd->u.send.p_block;
+    const size_t i_size = TS_RECORD_HEADER + TS_RECORD_ALIGNED(p_block->i_buffer);
 
-        cmd.u.send.p_block = NULL;
-        cmd.u.send.i_offset = ftell( p_storage->p_filew );
+    assert( p_cmd->i_type == C_SEND && p_block != NULL );
 
-        if( fwrite( p_block, sizeof(*p_block), 1, p_storage->p_filew ) != 1 )
-        {
-            block_Release( p_block );
-            return;
-        }
-        p_storage->i_file_size += sizeof(*p_block);
-        if( p_block->i_buffer > 0 )
-        {
-            if( fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_storage->p_filew ) != 1 )
-            {
-                block_Release( p_block );
-                return;
-            }
-        }
-        p_storage->i_file_size += p_block->i_buffer;
-        block_Release( p_block );
+    if( p_storage->fd == -1 && TsStorageOpenFile( p_storage ) )
+        return VLC_EGENERIC;
 
-        if( b_flush )
-            fflush( p_storage->p_filew );
+    union
+    {
+        ts_record_t record;
+        uint8_t     p_header[TS_RECORD_HEADER];
+    } u;
+    memset( &u, 0, sizeof (u) );
+    u.record.i_buffer     = p_block->i_buffer;
+    u.record.i_flags      = p_block->i_flags;
+    u.record.i_nb_samples = p_block->i_nb_samples;
+    u.record.i_pts        = p_block->i_pts;
+    u.record.i_dts        = p_block->i_dts;
+    u.record.i_length     = p_block->i_length;
+
+    struct iovec iov[3] = {
+        { u.p_header, TS_RECORD_HEADER },
+        { p_block->p_buffer, p_block->i_buffer },
+        { (void *)p_zero, TS_RECORD_ALIGNED(p_block->i_buffer) - p_block->i_buffer },
+    };
+
+#ifndef HAVE_PREAD
+    /* Reads move the file offset */
+    if( lseek( p_storage->fd, p_storage->i_file_size, SEEK_SET ) == -1 )
+        return VLC_EGENERIC;
+#endif
+    if( TsStorageWrite( p_storage->fd, iov, 3 ) != (ssize_t)i_size )
+    {
+        /* Drop whatever was partially written */
+        if( ftruncate( p_storage->fd, p_storage->i_file_size ) == 0 )
+            lseek( p_storage->fd, p_storage->i_file_size, SEEK_SET );
+        return VLC_EGENERIC;
     }
-    p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
+
+    p_cmd->u.send.p_block = NULL;
+    p_cmd->u.send.i_offset = p_storage->i_file_size;
+    p_storage->i_file_size += i_size;
+    p_storage->i_mem_size -= i_size;
+    block_Release( p_block );
+    return VLC_SUCCESS;
+}
+static void TsStorageDropCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd )
+{
+    block_t *p_block = p_cmd->u.send.p_block;
+
+    assert( p_cmd->i_type == C_SEND && p_block != NULL );
+
+    /* Neither in memory nor in the file: nothing will be sent */
+    p_cmd->u.send.p_block = NULL;
+    p_cmd->u.send.i_offset = -1;
+    p_storage->i_mem_size -= TS_RECORD_HEADER + TS_RECORD_ALIGNED(p_block->i_buffer);
+    block_Release( p_block );
+}
+static ssize_t TsStorageRead( ts_storage_t *p_storage, void *p_buf,
+                              size_t i_size, int64_t i_offset )
+{
+#ifdef HAVE_PREAD
+    return pread( p_storage->fd, p_buf, i_size, i_offset );
+#else
+    if( lseek( p_storage->fd, i_offset, SEEK_SET ) == -1 )
+        return -1;
+    return read( p_storage->fd, p_buf, i_size );
+#endif
+}
+static block_t *TsStorageReadBlock( ts_storage_t *p_storage, int64_t i_offset )
+{
+    ts_record_t record;
+
+    if( i_offset < 0 || i_offset + (int64_t)TS_RECORD_HEADER > p_storage->i_file_size )
+        return NULL;
+
+#ifdef HAVE_MMAP
+    /* Once nothing will be written to the segment any more, map it: blocks
+     * then point straight into the page cache instead of being copied. */
+    if( p_storage->p_map == NULL && !p_storage->b_map_failed
+     && p_storage->b_sealed && p_storage->i_cmd_m >= p_storage->i_cmd_w )
+    {
+        p_storage->p_map = TsMapNew( p_storage->fd, p_storage->i_file_size );
+        p_storage->b_map_failed = p_storage->p_map == NULL;
+    }
+
+    if( p_storage->p_map != NULL )
+    {
+        ts_map_t *p_map = p_storage->p_map;
+
+        memcpy( &record, &p_map->p_base[i_offset], sizeof (record) );
+        if( record.i_buffer > p_map->i_size - i_offset - TS_RECORD_HEADER )
+            return NULL;
+
+        ts_map_block_t *p_mb = malloc( sizeof (*p_mb) );
+        if( unlikely(p_mb == NULL) )
+            return NULL;
+
+        block_t *p_block = block_Init( &p_mb->self, &ts_map_block_cbs,
+                                       &p_map->p_base[i_offset + TS_RECORD_HEADER],
+                                       record.i_buffer );
+        vlc_atomic_rc_inc( &p_map->rc );
+        p_mb->p_map = p_map;
+
+        p_block->i_dts        = record.i_dts;
+        p_block->i_pts        = record.i_pts;
+        p_block->i_flags      = record.i_flags;
+        p_block->i_length     = record.i_length;
+        p_block->i_nb_samples = record.i_nb_samples;
+        return p_block;
+    }
+#endif
+
+    if( TsStorageRead( p_storage, &record, sizeof (record), i_offset ) != sizeof (record)
+     || record.i_buffer > (uint64_t)(p_storage->i_file_size - i_offset - TS_RECORD_HEADER) )
+        return NULL;
+
+    block_t *p_block = block_Alloc( record.i_buffer );
+    if( unlikely(p_block == NULL) )
+        return NULL;
+
+    p_block->i_dts        = record.i_dts;
+    p_block->i_pts        = record.i_pts;
+    p_block->i_flags      = record.i_flags;
+    p_block->i_length     = record.i_length;
+    p_block->i_nb_samples = record.i_nb_samples;
+
+    ssize_t i_read = 0;
+    if( record.i_buffer > 0 )
+    {
+        i_read = TsStorageRead( p_storage, p_block->p_buffer, record.i_buffer,
+                                i_offset + TS_RECORD_HEADER );
+    }
+    p_block->i_buffer = i_read > 0 ? (size_t)i_read : 0;
+    return p_block;
 }
 static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
 {
     assert( !TsStorageIsEmpty( p_storage ) );
 
     *p_cmd = p_storage->p_cmd[p_storage->i_cmd_r++];
+    if( p_storage->i_cmd_m < p_storage->i_cmd_r )
+        p_storage->i_cmd_m = p_storage->i_cmd_r;
+
     if( p_cmd->i_type == C_SEND )
     {
-        block_t block;
+        block_t *p_block = p_cmd->u.send.p_block;
 
-        if( !b_flush &&
-            !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
-            fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 )
-        {
-            block_t *p_block = block_Alloc( block.i_buffer );
-            if( p_block )
-            {
-                p_block->i_dts      = block.i_dts;
-                p_block->i_pts      = block.i_pts;
-                p_block->i_flags    = block.i_flags;
-                p_block->i_length   = block.i_length;
-                p_block->i_nb_samples = block.i_nb_samples;
-                p_block->i_buffer = fread( p_block->p_buffer, 1, block.i_buffer, p_storage->p_filer );
-            }
-            p_cmd->u.send.p_block = p_block;
+        if( p_block != NULL )
+        {   /* Still in memory */
+            p_storage->i_mem_size -= TS_RECORD_HEADER + TS_RECORD_ALIGNED(p_block->i_buffer);
+            return;
         }
-        else
+        if( p_cmd->u.send.i_offset < 0 )
+            return; /* Dropped */
+
+        if( !b_flush )
+            p_block = TsStorageReadBlock( p_storage, p_cmd->u.send.i_offset );
+        if( p_block == NULL )
         {
             //perror( "TsStoragePopCmd" );
-            p_cmd->u.send.p_block = block_Alloc( 1 );
+            p_block = block_Alloc( 1 );
         }
+        p_cmd->u.send.p_block = p_block;
     }
 }
 
@@ -33,6 +33,7 @@
 #include <libvlc.h>
 #include "input_interface.h"
 #include "misc/interrupt.h"
+#include "video_output/statistic.h"
 
 struct input_stats;
 
@@ -355,6 +356,8 @@ struct input_stats {
     atomic_uintmax_t lost_abuffers;
     atomic_uintmax_t displayed_pictures;
     atomic_uintmax_t lost_pictures;
+    atomic_uintmax_t late_pictures;
+    atomic_uintmax_t vout_timing[VOUT_TIMING_COUNT][VOUT_TIMING_BUCKETS];
 };
 
 struct input_stats *input_stats_Create(void);
@@ -67,6 +67,10 @@ struct input_stats *input_stats_Create(void)
     atomic_init(&stats->lost_abuffers, 0);
     atomic_init(&stats->displayed_pictures, 0);
     atomic_init(&stats->lost_pictures, 0);
+    atomic_init(&stats->late_pictures, 0);
+    for (unsigned i = 0; i < VOUT_TIMING_COUNT; i++)
+        for (unsigned j = 0; j < VOUT_TIMING_BUCKETS; j++)
+            atomic_init(&stats->vout_timing[i][j], 0);
     return stats;
 }
 
@@ -77,6 +81,42 @@ void input_stats_Destroy(struct input_stats *stats)
     free(stats);
 }
 
+/**
+ * Computes the median and 99th percentile of a vout timing histogram, as the
+ * upper bounds of the buckets they fall in.
+ */
+static void stats_ComputeTiming(struct input_stats *stats,
+                                enum vout_statistic_timing stage,
+                                struct input_stats_timing *timing)
+{
+    uintmax_t counts[VOUT_TIMING_BUCKETS];
+    uintmax_t total = 0;
+
+    for (unsigned i = 0; i < VOUT_TIMING_BUCKETS; i++)
+    {
+        counts[i] = atomic_load_explicit(&stats->vout_timing[stage][i],
+                                         memory_order_relaxed);
+        total += counts[i];
+    }
+
+    timing->p50 = timing->p99 = 0;
+    if (total == 0)
+        return;
+
+    uintmax_t sum = 0;
+    for (unsigned i = 0; i < VOUT_TIMING_BUCKETS; i++)
+    {
+        sum += counts[i];
+        if (timing->p50 == 0 && sum * 2 >= total)
+            timing->p50 = vout_statistic_TimingBucketMax(i);
+        if (sum * 100 >= total * 99)
+        {
+            timing->p99 = vout_statistic_TimingBucketMax(i);
+            break;
+        }
+    }
+}
+
 void input_stats_Compute(struct input_stats *stats, input_stats_t *st)
 {
     /* Input */
@@ -110,6 +150,13 @@ void input_stats_Compute(struct input_stats *stats, input_stats_t *st)
                                                     memory_order_relaxed);
     st->i_lost_pictures = atomic_load_explicit(&stats->lost_pictures,
                                                memory_order_relaxed);
+    st->i_late_pictures = atomic_load_explicit(&stats->late_pictures,
+                                               memory_order_relaxed);
+    stats_ComputeTiming(stats, VOUT_TIMING_QUEUE, &st->vout_queue);
+    stats_ComputeTiming(stats, VOUT_TIMING_FILTER, &st->vout_filter);
+    stats_ComputeTiming(stats, VOUT_TIMING_PREPARE, &st->vout_prepare);
+    stats_ComputeTiming(stats, VOUT_TIMING_DISPLAY, &st->vout_display);
+    stats_ComputeTiming(stats, VOUT_TIMING_JITTER, &st->vout_jitter);
 }
 
 /** Update a counter element with new values
@@ -201,7 +201,9 @@ thumbnailer_RequestCommon( vlc_thumbnailer_t* thumbnailer,
     int timeout = params->timeout == VLC_TICK_INVALID ?
                 0 : MS_FROM_VLC_TICK( params->timeout );
     if ( background_worker_Push( thumbnailer->worker, request, request,
-                                  timeout ) != VLC_SUCCESS )
+                                 timeout,
+                                 BACKGROUND_WORKER_PRIORITY_INTERACTIVE )
+         != VLC_SUCCESS )
     {
         thumbnailer_request_Release( request );
         return NULL;
@@ -476,6 +476,12 @@ static const char *const ppsz_pos_descriptions[] =
     "This drops frames that are late (arrive to the video output after " \
     "their intended display date)." )
 
+#define VOUT_TIMING_TRACE_TEXT N_("Video output timing trace")
+#define VOUT_TIMING_TRACE_LONGTEXT N_( \
+    "Dumps the timestamps of every displayed frame to this CSV file: " \
+    "deadline, decoder queue exit, filtering time, display preparation " \
+    "and display call." )
+
 #define QUIET_SYNCHRO_TEXT N_("Quiet synchro")
 #define QUIET_SYNCHRO_LONGTEXT N_( \
     "This avoids flooding the message log with debug output from the " \
@@ -696,6 +702,12 @@ static const char *const ppsz_prefres[] = {
     "This is the maximum size in bytes of the temporary files " \
     "that will be used to store the timeshifted streams." )
 
+#define INPUT_TIMESHIFT_MEMORY_TEXT N_("Timeshift memory duration (s)")
+#define INPUT_TIMESHIFT_MEMORY_LONGTEXT N_( \
+    "The most recent seconds of the timeshifted streams are kept in " \
+    "memory, up to the timeshift granularity, before they are written " \
+    "to the temporary files." )
+
 #define INPUT_TITLE_FORMAT_TEXT N_( "Change title according to current media" )
 #define INPUT_TITLE_FORMAT_LONGTEXT N_( "This option allows you to set the title according to what's being played<br>"  \
     "$a: Artist<br>$b: Album<br>$c: Copyright<br>$t: Title<br>$g: Genre<br>"  \
@@ -935,6 +947,13 @@ static const char *const ppsz_prefres[] = {
     "This allows you to select a list of encoders that VLC will use in " \
     "priority.")
 
+#define DECODER_POOL_THREADS_TEXT N_("Shared decoder threads")
+#define DECODER_POOL_THREADS_LONGTEXT N_( \
+    "Maximum number of threads shared by the audio decoders of all the " \
+    "inputs, and likewise by the subtitle and data decoders. Video " \
+    "decoders always use their own thread. 0 gives every decoder its own " \
+    "thread.")
+
 /*****************************************************************************
  * Sout
  ****************************************************************************/
@@ -1592,6 +1611,8 @@ vlc_module_begin ()
         change_private ()
     add_bool( "drop-late-frames", 1, DROP_LATE_FRAMES_TEXT,
               DROP_LATE_FRAMES_LONGTEXT, true )
+    add_savefile( "vout-timing-trace", NULL, VOUT_TIMING_TRACE_TEXT,
+                  VOUT_TIMING_TRACE_LONGTEXT )
     /* Used in vout_synchro */
     add_bool( "skip-frames", 1, SKIP_FRAMES_TEXT,
               SKIP_FRAMES_LONGTEXT, true )
@@ -1955,6 +1976,9 @@ vlc_module_begin ()
                   INPUT_TIMESHIFT_PATH_TEXT, INPUT_TIMESHIFT_PATH_LONGTEXT)
     add_integer( "input-timeshift-granularity", -1, INPUT_TIMESHIFT_GRANULARITY_TEXT,
                  INPUT_TIMESHIFT_GRANULARITY_LONGTEXT, true )
+    add_integer( "input-timeshift-memory", 10, INPUT_TIMESHIFT_MEMORY_TEXT,
+                 INPUT_TIMESHIFT_MEMORY_LONGTEXT, true )
+        change_integer_range( 0, 3600 )
 
     add_string( "input-title-format", "$Z", INPUT_TITLE_FORMAT_TEXT, INPUT_TITLE_FORMAT_LONGTEXT, false );
 
@@ -1967,6 +1991,9 @@ vlc_module_begin ()
                 CODEC_LONGTEXT, true )
     add_string( "encoder",  NULL, ENCODER_TEXT,
                 ENCODER_LONGTEXT, true )
+    add_integer( "decoder-pool-threads", 0, DECODER_POOL_THREADS_TEXT,
+                 DECODER_POOL_THREADS_LONGTEXT, true )
+        change_integer_range( 0, 64 )
 
     set_subcategory( SUBCAT_INPUT_ACCESS )
     add_category_hint(N_("Input"), INPUT_CAT_LONGTEXT)
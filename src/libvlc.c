@@ -502,6 +502,7 @@ void libvlc_InternalDestroy( libvlc_int_t *p_libvlc )
 
     assert( atomic_load(&(vlc_internals(p_libvlc)->refs)) == 1 );
     vlc_object_release( p_libvlc );
+    block_PoolCleanup();
 }
 
 /*****************************************************************************
@@ -43,6 +43,15 @@ int EnumClockSource( const char *, char ***, char *** );
 #endif
 void vlc_CPU_dump(vlc_object_t *);
 
+/*
+ * Blocks
+ */
+
+/**
+ * Frees the blocks cached by the calling thread and by the shared depot.
+ */
+void block_PoolCleanup(void);
+
 /*
  * Threads subsystem
  */
@@ -29,11 +29,15 @@
 #include "libvlc.h"
 #include "background_worker.h"
 
+#define BACKGROUND_WORKER_BUCKETS 64
+
 struct task {
-    struct vlc_list node;
+    struct vlc_list node; /**< node in the queue of its priority class */
+    struct vlc_list id_node; /**< node in the bucket of its id */
     void* id; /**< id associated with entity */
     void* entity; /**< the entity to process */
     vlc_tick_t timeout; /**< timeout duration in vlc_tick_t */
+    enum background_worker_priority priority;
 };
 
 struct background_worker;
@@ -55,17 +59,23 @@ struct background_worker {
 
     int uncompleted; /**< number of tasks requested but not completed */
     int nthreads; /**< number of threads in the threads list */
+    int bulk_running; /**< number of threads running a bulk task */
     struct vlc_list threads; /**< list of active background_thread instances */
 
-    struct vlc_list queue; /**< queue of tasks */
-    vlc_cond_t queue_wait; /**< wait for the queue to be non-empty */
+    /** queues of tasks, one per priority class */
+    struct vlc_list queues[BACKGROUND_WORKER_PRIORITY_COUNT];
+    /** queued tasks, hashed by id, so that cancelling an id does not need
+     * to walk the whole queue */
+    struct vlc_list buckets[BACKGROUND_WORKER_BUCKETS];
+    vlc_cond_t queue_wait; /**< wait for a task to be available */
 
     vlc_cond_t nothreads_wait; /**< wait for nthreads == 0 */
     bool closing; /**< true if background worker deletion is requested */
 };
 
 static struct task *task_Create(struct background_worker *worker, void *id,
-                                void *entity, int timeout)
+                                void *entity, int timeout,
+                                enum background_worker_priority priority)
 {
     struct task *task = malloc(sizeof(*task));
     if (unlikely(!task))
@@ -74,6 +84,7 @@ static struct task *task_Create(struct background_worker *worker, void *id,
     task->id = id;
     task->entity = entity;
     task->timeout = timeout < 0 ? worker->conf.default_timeout : VLC_TICK_FROM_MS(timeout);
+    task->priority = priority;
     worker->conf.pf_hold(task->entity);
     return task;
 }
@@ -84,23 +95,62 @@ static void task_Destroy(struct background_worker *worker, struct task *task)
     free(task);
 }
 
+static struct vlc_list *QueueBucket(struct background_worker *worker,
+                                    const void *id)
+{
+    uintptr_t h = (uintptr_t) id;
+    /* ids are mostly heap pointers: drop the alignment bits */
+    h ^= h >> 4;
+    h ^= h >> 12;
+    return &worker->buckets[h % BACKGROUND_WORKER_BUCKETS];
+}
+
+/**
+ * Tell whether a task of the given class can be started now.
+ *
+ * Bulk tasks may not occupy more than max_threads threads, so that the extra
+ * thread spawned for interactive requests is never taken by the bulk queue.
+ */
+static bool QueueCanTake(struct background_worker *worker,
+                         enum background_worker_priority priority)
+{
+    if (vlc_list_is_empty(&worker->queues[priority]))
+        return false;
+    return priority != BACKGROUND_WORKER_PRIORITY_BULK
+        || worker->bulk_running < worker->conf.max_threads;
+}
+
+static struct task *QueueFirst(struct background_worker *worker)
+{
+    vlc_mutex_assert(&worker->lock);
+
+    for (int i = BACKGROUND_WORKER_PRIORITY_COUNT - 1; i >= 0; i--)
+        if (QueueCanTake(worker, i))
+            return vlc_list_first_entry_or_null(&worker->queues[i],
+                                                struct task, node);
+    return NULL;
+}
+
 static struct task *QueueTake(struct background_worker *worker, int timeout_ms)
 {
     vlc_mutex_assert(&worker->lock);
 
     vlc_tick_t deadline = vlc_tick_now() + VLC_TICK_FROM_MS(timeout_ms);
     bool timeout = false;
-    while (!timeout && !worker->closing && vlc_list_is_empty(&worker->queue))
+    struct task *task;
+    while (!timeout && !worker->closing
+        && (task = QueueFirst(worker)) == NULL)
         timeout = vlc_cond_timedwait(&worker->queue_wait,
                                      &worker->lock, deadline) != 0;
 
     if (worker->closing || timeout)
         return NULL;
 
-    struct task *task = vlc_list_first_entry_or_null(&worker->queue,
-                                                     struct task, node);
     assert(task);
     vlc_list_remove(&task->node);
+    vlc_list_remove(&task->id_node);
+    if (task->priority == BACKGROUND_WORKER_PRIORITY_BULK)
+        worker->bulk_running++;
 
     return task;
 }
@@ -108,7 +158,8 @@ static struct task *QueueTake(struct background_worker *worker, int timeout_ms)
 static void QueuePush(struct background_worker *worker, struct task *task)
 {
     vlc_mutex_assert(&worker->lock);
-    vlc_list_append(&task->node, &worker->queue);
+    vlc_list_append(&task->node, &worker->queues[task->priority]);
+    vlc_list_append(&task->id_node, QueueBucket(worker, task->id));
     vlc_cond_signal(&worker->queue_wait);
 }
 
@@ -116,12 +167,30 @@ static void QueueRemoveAll(struct background_worker *worker, void *id)
 {
     vlc_mutex_assert(&worker->lock);
     struct task *task;
-    vlc_list_foreach(task, &worker->queue, node)
+
+    if (id)
+    {
+        vlc_list_foreach(task, QueueBucket(worker, id), id_node)
+        {
+            if (task->id == id)
+            {
+                vlc_list_remove(&task->node);
+                vlc_list_remove(&task->id_node);
+                task_Destroy(worker, task);
+                worker->uncompleted--;
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < BACKGROUND_WORKER_PRIORITY_COUNT; i++)
     {
-        if (!id || task->id == id)
+        vlc_list_foreach(task, &worker->queues[i], node)
         {
             vlc_list_remove(&task->node);
+            vlc_list_remove(&task->id_node);
             task_Destroy(worker, task);
+            worker->uncompleted--;
         }
     }
 }
@@ -160,8 +229,12 @@ static struct background_worker *background_worker_Create(void *owner,
     vlc_mutex_init(&worker->lock);
     worker->uncompleted = 0;
     worker->nthreads = 0;
+    worker->bulk_running = 0;
     vlc_list_init(&worker->threads);
-    vlc_list_init(&worker->queue);
+    for (int i = 0; i < BACKGROUND_WORKER_PRIORITY_COUNT; i++)
+        vlc_list_init(&worker->queues[i]);
+    for (int i = 0; i < BACKGROUND_WORKER_BUCKETS; i++)
+        vlc_list_init(&worker->buckets[i]);
     vlc_cond_init(&worker->queue_wait);
     vlc_cond_init(&worker->nothreads_wait);
     worker->closing = false;
@@ -178,12 +251,21 @@ static void background_worker_Destroy(struct background_worker *worker)
 static void TerminateTask(struct background_thread *thread, struct task *task)
 {
     struct background_worker *worker = thread->owner;
+    enum background_worker_priority priority = task->priority;
     task_Destroy(worker, task);
 
     vlc_mutex_lock(&worker->lock);
     thread->task = NULL;
     worker->uncompleted--;
     assert(worker->uncompleted >= 0);
+    if (priority == BACKGROUND_WORKER_PRIORITY_BULK)
+    {
+        worker->bulk_running--;
+        assert(worker->bulk_running >= 0);
+        /* a bulk task may have been held back by the limit */
+        if (!vlc_list_is_empty(&worker->queues[priority]))
+            vlc_cond_signal(&worker->queue_wait);
+    }
     vlc_mutex_unlock(&worker->lock);
 }
 
@@ -292,16 +374,23 @@ struct background_worker* background_worker_New( void* owner,
 }
 
 int background_worker_Push( struct background_worker* worker, void* entity,
-                        void* id, int timeout )
+                        void* id, int timeout,
+                        enum background_worker_priority priority )
 {
-    struct task *task = task_Create(worker, id, entity, timeout);
+    struct task *task = task_Create(worker, id, entity, timeout, priority);
     if (unlikely(!task))
         return VLC_ENOMEM;
 
+    /* Interactive requests may use one thread more than configured, so that
+     * they never wait for a long bulk task to terminate. */
+    int max_threads = worker->conf.max_threads;
+    if (priority == BACKGROUND_WORKER_PRIORITY_INTERACTIVE)
+        max_threads++;
+
     vlc_mutex_lock(&worker->lock);
     QueuePush(worker, task);
     if (++worker->uncompleted > worker->nthreads
-            && worker->nthreads < worker->conf.max_threads)
+            && worker->nthreads < max_threads)
         SpawnThread(worker);
     vlc_mutex_unlock(&worker->lock);
 
@@ -19,6 +19,22 @@
 #ifndef BACKGROUND_WORKER_H__
 #define BACKGROUND_WORKER_H__
 
+/**
+ * Priority class of a background-worker task
+ *
+ * Tasks of a higher class are always started before queued tasks of a lower
+ * class, whatever their order of submission.
+ */
+enum background_worker_priority {
+    /** Batch requests, such as a media library scan */
+    BACKGROUND_WORKER_PRIORITY_BULK,
+    /** Requests a user is waiting for */
+    BACKGROUND_WORKER_PRIORITY_INTERACTIVE,
+};
+
+#define BACKGROUND_WORKER_PRIORITY_COUNT \
+    (BACKGROUND_WORKER_PRIORITY_INTERACTIVE + 1)
+
 struct background_worker_config {
     /**
      * Default timeout for completing a task
@@ -31,6 +47,9 @@ struct background_worker_config {
 
     /**
      * Maximum number of threads used to execute tasks.
+     *
+     * One more thread may be started to serve interactive tasks while all
+     * threads are busy with bulk ones.
      */
     int max_threads;
 
@@ -156,8 +175,9 @@ void background_worker_RequestProbe( struct background_worker* worker );
  * Push an entity into the background-worker
  *
  * This function is used to push an entity into the queue of pending work. The
- * entities will be processed in the order in which they are received (in terms
- * of the order of invocations in a single-threaded environment).
+ * entities of a same priority class will be processed in the order in which
+ * they are received (in terms of the order of invocations in a
+ * single-threaded environment).
  *
  * \param worker the background-worker
  * \param entity the entity which is to be queued
@@ -165,11 +185,13 @@ void background_worker_RequestProbe( struct background_worker* worker );
  * \param timeout the timeout of the entity in milliseconds, `0` denotes no
  *                timeout, a negative value will use the default timeout
  *                associated with the background-worker.
+ * \param priority the priority class of the entity; entities of the same
+ *                 class are processed in order.
  * \return VLC_SUCCESS if the entity was successfully queued, an error-code on
  *         failure.
  **/
 int background_worker_Push( struct background_worker* worker, void* entity,
-    void* id, int timeout );
+    void* id, int timeout, enum background_worker_priority priority );
 
 /**
  * Remove entities from the background-worker
@@ -33,7 +33,10 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include <vlc_fs.h>
+#include <vlc_list.h>
+#include "../libvlc.h"
 
 #ifndef NDEBUG
 static void block_Check (block_t *block)
@@ -105,6 +108,311 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
+/** Payload sizes of the pooled blocks.
+ * These cover TS packets, RTP/UDP datagrams, audio frames and small PES. */
+static const size_t block_pool_sizes[] = {
+    256, 384, 512, 768, 1024, 1536, 2048, 3072,
+    4096, 6144, 8192, 12288, 16384,
+};
+
+#define BLOCK_POOL_CLASSES ARRAY_SIZE(block_pool_sizes)
+
+/** Number of blocks moved at once between a thread and the shared depot */
+#define BLOCK_MAG_SIZE     16
+/** Maximum amount of cached memory per thread */
+#define BLOCK_CACHE_BYTES  (64 * 1024)
+/** Maximum number of magazines per size class in the shared depot */
+#define BLOCK_DEPOT_DEPTH  8
+/** Maximum amount of memory in the shared depot */
+#define BLOCK_DEPOT_BYTES  (1024 * 1024)
+
+static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
+               "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
+
+/* A batch of free blocks of one size class */
+struct block_magazine
+{
+    unsigned count;
+    block_t *blocks[BLOCK_MAG_SIZE];
+};
+
+/* Per-thread cache of released blocks */
+struct block_cache
+{
+    struct vlc_list node;
+    size_t bytes;
+    struct block_magazine mags[BLOCK_POOL_CLASSES];
+
+    /* Only written by the owner thread, read by block_PoolGetStats() */
+    atomic_uint_least64_t allocs;
+    atomic_uint_least64_t hits;
+    atomic_uint_least64_t releases;
+    atomic_uint_least64_t recycled;
+};
+
+/* Blocks usually flow from one thread to another (e.g. from the demuxer to
+ * a decoder), so the thread releasing a block is rarely the next one to
+ * allocate that size. Full magazines of released blocks are exchanged
+ * through a shared depot, where the allocating threads pick them up. */
+static struct
+{
+    vlc_mutex_t lock;
+    struct vlc_list caches;
+    struct vlc_block_pool_stats exited; /* counters of terminated threads */
+    vlc_threadvar_t key;
+    vlc_once_t once;
+    bool usable;
+
+    /* Shared depot, protected by the lock */
+    size_t bytes;
+    atomic_uint count[BLOCK_POOL_CLASSES]; /* also peeked without the lock */
+    struct block_magazine depot[BLOCK_POOL_CLASSES][BLOCK_DEPOT_DEPTH];
+} block_pool = {
+    VLC_STATIC_MUTEX, VLC_LIST_INITIALIZER(&block_pool.caches),
+    { 0, 0, 0, 0 }, 0, VLC_STATIC_ONCE, false,
+    0, { 0 }, { { { 0, { NULL } } } },
+};
+
+static thread_local struct block_cache *block_cache_var;
+
+static size_t block_pool_AllocSize(size_t size)
+{
+    /* 2 * BLOCK_PADDING: pre + post padding */
+    return sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING) + size;
+}
+
+static void block_magazine_Free(struct block_magazine *mag)
+{
+    for (unsigned i = 0; i < mag->count; i++)
+        free(mag->blocks[i]);
+    mag->count = 0;
+}
+
+/** Moves the blocks of one size class of a cache to the depot, or frees
+ * them if the depot is full. The magazine of the cache is emptied. */
+static void block_depot_Put(struct block_cache *cache, size_t i)
+{
+    struct block_magazine *mag = &cache->mags[i];
+    size_t bytes = mag->count * block_pool_AllocSize(block_pool_sizes[i]);
+
+    if (mag->count == 0)
+        return;
+    cache->bytes -= bytes;
+
+    vlc_mutex_lock(&block_pool.lock);
+    unsigned count = atomic_load_explicit(&block_pool.count[i],
+                                          memory_order_relaxed);
+    if (count < BLOCK_DEPOT_DEPTH
+     && block_pool.bytes + bytes <= BLOCK_DEPOT_BYTES)
+    {
+        block_pool.depot[i][count] = *mag;
+        atomic_store_explicit(&block_pool.count[i], count + 1,
+                              memory_order_relaxed);
+        block_pool.bytes += bytes;
+        mag->count = 0;
+    }
+    vlc_mutex_unlock(&block_pool.lock);
+
+    block_magazine_Free(mag);
+}
+
+/** Refills the empty magazine of one size class of a cache from the depot.
+ * Returns false if the depot has no blocks of that class. */
+static bool block_depot_Get(struct block_cache *cache, size_t i)
+{
+    struct block_magazine *mag = &cache->mags[i];
+
+    assert(mag->count == 0);
+
+    /* Unlocked peek: a miss only costs a malloc() */
+    if (atomic_load_explicit(&block_pool.count[i],
+                             memory_order_relaxed) == 0)
+        return false;
+
+    vlc_mutex_lock(&block_pool.lock);
+    unsigned count = atomic_load_explicit(&block_pool.count[i],
+                                          memory_order_relaxed);
+    if (count > 0)
+    {
+        *mag = block_pool.depot[i][--count];
+        atomic_store_explicit(&block_pool.count[i], count,
+                              memory_order_relaxed);
+        block_pool.bytes -= mag->count
+                          * block_pool_AllocSize(block_pool_sizes[i]);
+    }
+    vlc_mutex_unlock(&block_pool.lock);
+
+    cache->bytes += mag->count * block_pool_AllocSize(block_pool_sizes[i]);
+    return mag->count > 0;
+}
+
+static void block_cache_Destroy(void *data)
+{
+    struct block_cache *cache = data;
+
+    /* Hand the cached blocks over to the threads still running */
+    for (size_t i = 0; i < BLOCK_POOL_CLASSES; i++)
+        block_depot_Put(cache, i);
+
+    vlc_mutex_lock(&block_pool.lock);
+    vlc_list_remove(&cache->node);
+    block_pool.exited.allocs += atomic_load_explicit(&cache->allocs,
+                                                     memory_order_relaxed);
+    block_pool.exited.hits += atomic_load_explicit(&cache->hits,
+                                                   memory_order_relaxed);
+    block_pool.exited.releases += atomic_load_explicit(&cache->releases,
+                                                       memory_order_relaxed);
+    block_pool.exited.recycled += atomic_load_explicit(&cache->recycled,
+                                                       memory_order_relaxed);
+    vlc_mutex_unlock(&block_pool.lock);
+
+    block_cache_var = NULL;
+    free(cache);
+}
+
+static void block_pool_Init(void)
+{
+    block_pool.usable =
+        vlc_threadvar_create(&block_pool.key, block_cache_Destroy) == 0;
+}
+
+/** Returns the cache of the calling thread, creating it if needed. */
+static struct block_cache *block_cache_Get(void)
+{
+    struct block_cache *cache = block_cache_var;
+    if (likely(cache != NULL))
+        return cache;
+
+    vlc_once(&block_pool.once, block_pool_Init);
+    if (unlikely(!block_pool.usable))
+        return NULL;
+
+    cache = malloc(sizeof (*cache));
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    cache->bytes = 0;
+    for (size_t i = 0; i < BLOCK_POOL_CLASSES; i++)
+        cache->mags[i].count = 0;
+    atomic_init(&cache->allocs, 0);
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->releases, 0);
+    atomic_init(&cache->recycled, 0);
+
+    /* The thread variable is only used to destroy the cache on exit */
+    if (vlc_threadvar_set(block_pool.key, cache))
+    {
+        free(cache);
+        return NULL;
+    }
+
+    vlc_mutex_lock(&block_pool.lock);
+    vlc_list_append(&cache->node, &block_pool.caches);
+    vlc_mutex_unlock(&block_pool.lock);
+
+    block_cache_var = cache;
+    return cache;
+}
+
+static void block_cache_Count(atomic_uint_least64_t *counter)
+{
+    /* Single writer: no need for an atomic read-modify-write */
+    atomic_store_explicit(counter,
+                          atomic_load_explicit(counter, memory_order_relaxed)
+                          + 1, memory_order_relaxed);
+}
+
+/** Returns the size class of a payload size, or BLOCK_POOL_CLASSES. */
+static size_t block_pool_Class(size_t size)
+{
+    size_t i = 0;
+
+    while (i < BLOCK_POOL_CLASSES && block_pool_sizes[i] < size)
+        i++;
+    return i;
+}
+
+static void block_pool_Release(block_t *block)
+{
+    assert (block->p_start == (unsigned char *)(block + 1));
+
+    struct block_cache *cache = block_cache_Get();
+    if (likely(cache != NULL))
+    {
+        size_t alloc = sizeof (*block) + block->i_size;
+        size_t i = block_pool_Class(alloc - block_pool_AllocSize(0));
+        struct block_magazine *mag = &cache->mags[i];
+
+        assert (i < BLOCK_POOL_CLASSES);
+        assert (alloc == block_pool_AllocSize(block_pool_sizes[i]));
+        block_cache_Count(&cache->releases);
+
+        /* Pass full magazines on to the depot */
+        if (mag->count == BLOCK_MAG_SIZE
+         || cache->bytes + alloc > BLOCK_CACHE_BYTES)
+            block_depot_Put(cache, i);
+
+        if (cache->bytes + alloc <= BLOCK_CACHE_BYTES)
+        {
+            mag->blocks[mag->count++] = block;
+            cache->bytes += alloc;
+            block_cache_Count(&cache->recycled);
+            return;
+        }
+    }
+    free (block);
+}
+
+static const struct vlc_block_callbacks block_pool_cbs =
+{
+    block_pool_Release,
+};
+
+void block_PoolCleanup(void)
+{
+    /* The main thread usually outlives LibVLC, so its cache is not
+     * destroyed by the thread variable destructor. */
+    struct block_cache *cache = block_cache_var;
+    if (cache != NULL)
+    {
+        vlc_threadvar_set(block_pool.key, NULL);
+        block_cache_Destroy(cache);
+    }
+
+    vlc_mutex_lock(&block_pool.lock);
+    for (size_t i = 0; i < BLOCK_POOL_CLASSES; i++)
+    {
+        unsigned count = atomic_load_explicit(&block_pool.count[i],
+                                              memory_order_relaxed);
+
+        while (count > 0)
+            block_magazine_Free(&block_pool.depot[i][--count]);
+        atomic_store_explicit(&block_pool.count[i], 0, memory_order_relaxed);
+    }
+    block_pool.bytes = 0;
+    vlc_mutex_unlock(&block_pool.lock);
+}
+
+void block_PoolGetStats(struct vlc_block_pool_stats *stats)
+{
+    struct block_cache *cache;
+
+    vlc_mutex_lock(&block_pool.lock);
+    *stats = block_pool.exited;
+    vlc_list_foreach(cache, &block_pool.caches, node)
+    {
+        stats->allocs += atomic_load_explicit(&cache->allocs,
+                                              memory_order_relaxed);
+        stats->hits += atomic_load_explicit(&cache->hits,
+                                            memory_order_relaxed);
+        stats->releases += atomic_load_explicit(&cache->releases,
+                                                memory_order_relaxed);
+        stats->recycled += atomic_load_explicit(&cache->recycled,
+                                                memory_order_relaxed);
+    }
+    vlc_mutex_unlock(&block_pool.lock);
+}
+
 block_t *block_Alloc (size_t size)
 {
     if (unlikely(size >> 27))
@@ -113,19 +421,44 @@ block_t *block_Alloc (size_t size)
         return NULL;
     }
 
-    /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
-    if (unlikely(alloc <= size))
-        return NULL;
+    const struct vlc_block_callbacks *cbs = &block_generic_cbs;
+    size_t alloc;
+    block_t *b = NULL;
 
-    block_t *b = malloc (alloc);
-    if (unlikely(b == NULL))
-        return NULL;
+    /* Small blocks come from the size classes of the thread cache */
+    size_t i = block_pool_Class(size);
+    struct block_cache *cache;
+
+    if (i < BLOCK_POOL_CLASSES && (cache = block_cache_Get()) != NULL)
+    {
+        alloc = block_pool_AllocSize(block_pool_sizes[i]);
+        cbs = &block_pool_cbs;
+        block_cache_Count(&cache->allocs);
+
+        struct block_magazine *mag = &cache->mags[i];
+
+        if (mag->count > 0 || block_depot_Get(cache, i))
+        {
+            b = mag->blocks[--mag->count];
+            cache->bytes -= alloc;
+            block_cache_Count(&cache->hits);
+        }
+    }
+    else
+    {
+        alloc = block_pool_AllocSize(size);
+        if (unlikely(alloc <= size))
+            return NULL;
+    }
+
+    if (b == NULL)
+    {
+        b = malloc (alloc);
+        if (unlikely(b == NULL))
+            return NULL;
+    }
 
-    block_Init(b, &block_generic_cbs, b + 1, alloc - sizeof (*b));
-    static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
-                   "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
+    block_Init(b, cbs, b + 1, alloc - sizeof (*b));
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
@@ -122,24 +122,26 @@ static void vlc_CPU_init(void)
 
 #if defined( __i386__ ) || defined( __x86_64__ )
      unsigned int i_eax, i_ebx, i_ecx, i_edx;
+     unsigned int i_max_leaf;
      bool b_amd;
 
     /* Needed for x86 CPU capabilities detection */
 # if defined (__i386__) && defined (__PIC__)
-#  define cpuid(reg) \
+#  define cpuid_count(reg, count) \
      asm volatile ("xchgl %%ebx,%1\n\t" \
                    "cpuid\n\t" \
                    "xchgl %%ebx,%1\n\t" \
                    : "=a" (i_eax), "=r" (i_ebx), "=c" (i_ecx), "=d" (i_edx) \
-                   : "a" (reg) \
+                   : "a" (reg), "c" (count) \
                    : "cc");
 # else
-#  define cpuid(reg) \
+#  define cpuid_count(reg, count) \
      asm volatile ("cpuid\n\t" \
                    : "=a" (i_eax), "=b" (i_ebx), "=c" (i_ecx), "=d" (i_edx) \
-                   : "a" (reg) \
+                   : "a" (reg), "c" (count) \
                    : "cc");
 # endif
+# define cpuid(reg) cpuid_count(reg, 0)
      /* Check if the OS really supports the requested instructions */
 # if defined (__i386__) && !defined (__i486__) && !defined (__i586__) \
   && !defined (__i686__) && !defined (__pentium4__) \
@@ -167,6 +169,7 @@ static void vlc_CPU_init(void)
 
     /* the CPU supports the CPUID instruction - get its level */
     cpuid( 0x00000000 );
+    i_max_leaf = i_eax;
 
 # if defined (__i386__) && !defined (__i586__) \
   && !defined (__i686__) && !defined (__pentium4__) \
@@ -207,6 +210,32 @@ static void vlc_CPU_init(void)
             i_capabilities |= VLC_CPU_SSE4_2;
     }
 
+    /* AVX needs the OS to save the YMM (and ZMM) state: check OSXSAVE, then
+     * the enabled state components in XCR0 */
+    if ((i_capabilities & VLC_CPU_SSE2)
+     && (i_ecx & 0x18000000) == 0x18000000)
+    {
+        uint32_t xcr0_lo, xcr0_hi;
+
+        asm volatile ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+        if ((xcr0_lo & 0x06) == 0x06)
+        {
+            i_capabilities |= VLC_CPU_AVX;
+
+            if (i_max_leaf >= 7)
+            {
+                bool zmm = (xcr0_lo & 0xe6) == 0xe6;
+
+                cpuid_count( 0x00000007, 0 );
+                if (i_ebx & 0x00000020)
+                    i_capabilities |= VLC_CPU_AVX2;
+                /* AVX-512 Foundation and Byte/Word */
+                if (zmm && (i_ebx & 0x40010000) == 0x40010000)
+                    i_capabilities |= VLC_CPU_AVX512;
+            }
+        }
+    }
+
     /* test for additional capabilities */
     cpuid( 0x80000000 );
 
@@ -291,6 +320,8 @@ void vlc_CPU_dump (vlc_object_t *obj)
         vlc_memstream_puts(&stream, "AVX ");
     if (vlc_CPU_AVX2())
         vlc_memstream_puts(&stream, "AVX2 ");
+    if (vlc_CPU_AVX512())
+        vlc_memstream_puts(&stream, "AVX-512 ");
     if (vlc_CPU_3dNOW())
         vlc_memstream_puts(&stream, "3DNow! ");
     if (vlc_CPU_XOP())
@@ -31,6 +31,7 @@
 #include <vlc_spu.h>
 #include <libvlc.h>
 #include <assert.h>
+#include "slice_pool.h"
 
 typedef struct chained_filter_t
 {
@@ -61,6 +62,8 @@ struct filter_chain_t
     bool b_allow_fmt_out_change; /**< Can the output format be changed? */
     const char *filter_cap; /**< Filter modules capability */
     const char *conv_cap; /**< Converter modules capability */
+    struct vlc_slice_pool *slices; /**< Threads for sliced filters, or NULL */
+    bool slices_failed; /**< The threads could not be started */
 };
 
 /**
@@ -89,6 +92,8 @@ static filter_chain_t *filter_chain_NewInner( const filter_owner_t *callbacks,
     chain->b_allow_fmt_out_change = fmt_out_change;
     chain->filter_cap = cap;
     chain->conv_cap = conv_cap;
+    chain->slices = NULL;
+    chain->slices_failed = false;
     return chain;
 }
 
@@ -128,9 +133,27 @@ static picture_t *filter_chain_VideoBufferNew( filter_t *filter )
     }
 }
 
+/** Chained filter slices runner function */
+static void filter_chain_VideoRunSlices( filter_t *filter, filter_slice_cb cb,
+                                         void *opaque, unsigned lines )
+{
+    filter_chain_t *chain = filter->owner.sys;
+
+    /* The pool is only started once a filter of the chain uses it. If that
+     * fails, the chain keeps running its filters in a single thread. */
+    if( chain->slices == NULL && !chain->slices_failed )
+    {
+        chain->slices = vlc_slice_pool_Hold();
+        chain->slices_failed = chain->slices == NULL;
+    }
+
+    vlc_slice_pool_Run( chain->slices, filter, cb, opaque, lines );
+}
+
 static const struct filter_video_callbacks filter_chain_video_cbs =
 {
     .buffer_new = filter_chain_VideoBufferNew,
+    .run_slices = filter_chain_VideoRunSlices,
 };
 
 #undef filter_chain_NewVideo
@@ -157,6 +180,8 @@ void filter_chain_Delete( filter_chain_t *p_chain )
     es_format_Clean( &p_chain->fmt_in );
     es_format_Clean( &p_chain->fmt_out );
 
+    if( p_chain->slices != NULL )
+        vlc_slice_pool_Release( p_chain->slices );
     free( p_chain );
 }
 /**
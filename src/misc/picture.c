@@ -94,6 +94,7 @@ void picture_Reset( picture_t *p_picture )
     p_picture->b_progressive = false;
     p_picture->i_nb_fields = 2;
     p_picture->b_top_field_first = false;
+    picture_SetDequeued( p_picture, VLC_TICK_INVALID );
     PictureDestroyContext( p_picture );
 }
 
@@ -215,6 +216,7 @@ static picture_priv_t *picture_NewPrivate(const video_format_t *restrict p_fmt,
 
     atomic_init(&p_picture->refs, 1);
     priv->gc.opaque = NULL;
+    priv->dequeued = VLC_TICK_INVALID;
 
     return priv;
 }
@@ -379,6 +381,8 @@ void picture_CopyProperties( picture_t *p_dst, const picture_t *p_src )
     p_dst->b_progressive = p_src->b_progressive;
     p_dst->i_nb_fields = p_src->i_nb_fields;
     p_dst->b_top_field_first = p_src->b_top_field_first;
+
+    picture_SetDequeued( p_dst, picture_GetDequeued( p_src ) );
 }
 
 void picture_CopyPixels( picture_t *p_dst, const picture_t *p_src )
@@ -31,9 +31,22 @@ typedef struct
         void (*destroy)(picture_t *);
         void *opaque;
     } gc;
+    /** When the video output took the source picture from its queue,
+     * carried over by picture_CopyProperties() */
+    vlc_tick_t dequeued;
 
     max_align_t extra[];
 } picture_priv_t;
 
+static inline void picture_SetDequeued(picture_t *picture, vlc_tick_t date)
+{
+    ((picture_priv_t *)picture)->dequeued = date;
+}
+
+static inline vlc_tick_t picture_GetDequeued(const picture_t *picture)
+{
+    return ((const picture_priv_t *)picture)->dequeued;
+}
+
 void *picture_Allocate(int *, size_t);
 void picture_Deallocate(int, void *, size_t);
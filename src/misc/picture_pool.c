@@ -38,14 +38,21 @@
 
 static_assert ((POOL_MAX & (POOL_MAX - 1)) == 0, "Not a power of two");
 
+/*
+ * The bitmap of available pictures is only ever changed with atomic
+ * operations, so that getting and releasing pictures is lock-free. The lock
+ * and condition variable only serve picture_pool_Wait(): releasing threads
+ * take the lock to wake waiters up if there are any.
+ */
 struct picture_pool_t {
     int       (*pic_lock)(picture_t *);
     void      (*pic_unlock)(picture_t *);
     vlc_mutex_t lock;
     vlc_cond_t  wait;
 
-    bool               canceled;
-    unsigned long long available;
+    atomic_bool        canceled;
+    atomic_ullong      available;
+    atomic_uint        waiters; /**< threads in picture_pool_Wait() */
     atomic_ushort      refs;
     unsigned short     picture_count;
     picture_t  *picture[];
@@ -62,6 +69,44 @@ static void picture_pool_Destroy(picture_pool_t *pool)
     aligned_free(pool);
 }
 
+/**
+ * Makes a picture available again, and wakes a waiting thread up if needed.
+ */
+static void picture_pool_PutBack(picture_pool_t *pool, unsigned offset)
+{
+    unsigned long long prev = atomic_fetch_or(&pool->available, 1ULL << offset);
+
+    assert(!(prev & (1ULL << offset)));
+    (void) prev;
+
+    /* Sequential consistency: either the waiter sees the picture, or we see
+     * the waiter. */
+    if (atomic_load(&pool->waiters) != 0) {
+        vlc_mutex_lock(&pool->lock);
+        vlc_cond_signal(&pool->wait);
+        vlc_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * Takes the first available picture out of the bitmap.
+ * @param mask pictures that may be taken
+ * @return the picture offset, or -1 if none was available
+ */
+static int picture_pool_Take(picture_pool_t *pool, unsigned long long mask)
+{
+    unsigned long long available = atomic_load(&pool->available);
+
+    while ((available & mask) != 0) {
+        int i = ctz(available & mask);
+
+        if (atomic_compare_exchange_weak(&pool->available, &available,
+                                         available & ~(1ULL << i)))
+            return i;
+    }
+    return -1;
+}
+
 void picture_pool_Release(picture_pool_t *pool)
 {
     for (unsigned i = 0; i < pool->picture_count; i++)
@@ -81,12 +126,7 @@ static void picture_pool_ReleasePicture(picture_t *clone)
         pool->pic_unlock(picture);
     picture_Release(picture);
 
-    vlc_mutex_lock(&pool->lock);
-    assert(!(pool->available & (1ULL << offset)));
-    pool->available |= 1ULL << offset;
-    vlc_cond_signal(&pool->wait);
-    vlc_mutex_unlock(&pool->lock);
-
+    picture_pool_PutBack(pool, offset);
     picture_pool_Destroy(pool);
 }
 
@@ -132,14 +172,15 @@ picture_pool_t *picture_pool_NewExtended(const picture_pool_configuration_t *cfg
     vlc_mutex_init(&pool->lock);
     vlc_cond_init(&pool->wait);
     if (cfg->picture_count == POOL_MAX)
-        pool->available = ~0ULL;
+        atomic_init(&pool->available, ~0ULL);
     else
-        pool->available = (1ULL << cfg->picture_count) - 1;
+        atomic_init(&pool->available, (1ULL << cfg->picture_count) - 1);
+    atomic_init(&pool->waiters, 0);
     atomic_init(&pool->refs,  1);
     pool->picture_count = cfg->picture_count;
     memcpy(pool->picture, cfg->picture,
            cfg->picture_count * sizeof (picture_t *));
-    pool->canceled = false;
+    atomic_init(&pool->canceled, false);
     return pool;
 }
 
@@ -202,28 +243,19 @@ error:
 
 picture_t *picture_pool_Get(picture_pool_t *pool)
 {
-    unsigned long long available;
+    unsigned long long mask = ~0ULL;
+    int i;
 
-    vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
-    available = pool->available;
+    assert(atomic_load_explicit(&pool->refs, memory_order_relaxed) > 0);
 
-    while (available != 0)
+    while (!atomic_load_explicit(&pool->canceled, memory_order_relaxed)
+        && (i = picture_pool_Take(pool, mask)) >= 0)
     {
-        int i = ctz(available);
-
-        if (unlikely(pool->canceled))
-            break;
-
-        pool->available &= ~(1ULL << i);
-        vlc_mutex_unlock(&pool->lock);
-        available &= ~(1ULL << i);
-
         picture_t *picture = pool->picture[i];
 
         if (pool->pic_lock != NULL && pool->pic_lock(picture) != VLC_SUCCESS) {
-            vlc_mutex_lock(&pool->lock);
-            pool->available |= 1ULL << i;
+            picture_pool_PutBack(pool, i);
+            mask &= ~(1ULL << i); /* do not try the same picture again */
             continue;
         }
 
@@ -234,37 +266,38 @@ picture_t *picture_pool_Get(picture_pool_t *pool)
         }
         return clone;
     }
-
-    vlc_mutex_unlock(&pool->lock);
     return NULL;
 }
 
 picture_t *picture_pool_Wait(picture_pool_t *pool)
 {
-    vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
+    int i;
 
-    while (pool->available == 0)
-    {
-        if (pool->canceled)
+    assert(atomic_load_explicit(&pool->refs, memory_order_relaxed) > 0);
+
+    /* Fast path: no need for the lock if a picture is available */
+    i = picture_pool_Take(pool, ~0ULL);
+    if (i < 0) {
+        vlc_mutex_lock(&pool->lock);
+        atomic_fetch_add(&pool->waiters, 1);
+
+        while ((i = picture_pool_Take(pool, ~0ULL)) < 0)
         {
-            vlc_mutex_unlock(&pool->lock);
-            return NULL;
+            if (atomic_load_explicit(&pool->canceled, memory_order_relaxed))
+                break;
+            vlc_cond_wait(&pool->wait, &pool->lock);
         }
-        vlc_cond_wait(&pool->wait, &pool->lock);
-    }
 
-    int i = ctz(pool->available);
-    pool->available &= ~(1ULL << i);
-    vlc_mutex_unlock(&pool->lock);
+        atomic_fetch_sub(&pool->waiters, 1);
+        vlc_mutex_unlock(&pool->lock);
+        if (i < 0)
+            return NULL;
+    }
 
     picture_t *picture = pool->picture[i];
 
     if (pool->pic_lock != NULL && pool->pic_lock(picture) != VLC_SUCCESS) {
-        vlc_mutex_lock(&pool->lock);
-        pool->available |= 1ULL << i;
-        vlc_cond_signal(&pool->wait);
-        vlc_mutex_unlock(&pool->lock);
+        picture_pool_PutBack(pool, i);
         return NULL;
     }
 
@@ -279,9 +312,9 @@ picture_t *picture_pool_Wait(picture_pool_t *pool)
 void picture_pool_Cancel(picture_pool_t *pool, bool canceled)
 {
     vlc_mutex_lock(&pool->lock);
-    assert(pool->refs > 0);
+    assert(atomic_load_explicit(&pool->refs, memory_order_relaxed) > 0);
 
-    pool->canceled = canceled;
+    atomic_store_explicit(&pool->canceled, canceled, memory_order_relaxed);
     if (canceled)
         vlc_cond_broadcast(&pool->wait);
     vlc_mutex_unlock(&pool->lock);
@@ -0,0 +1,234 @@
+/*****************************************************************************
+ * slice_pool.c: shared pool of threads for sliced video filtering
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_list.h>
+#include <vlc_threads.h>
+
+#include "slice_pool.h"
+
+/* Bands shorter than this are not worth a context switch */
+#define SLICE_MIN_LINES 16
+/* Bands per thread, so that a slow thread does not delay the whole frame */
+#define SLICE_BANDS_PER_THREAD 4
+#define SLICE_MAX_THREADS 64
+
+struct vlc_slice_job
+{
+    struct vlc_list node; /**< node in the pool list of pending jobs */
+    filter_t *filter;
+    filter_slice_cb cb;
+    void *opaque;
+    unsigned lines; /**< total number of lines */
+    unsigned bands; /**< number of bands */
+    unsigned next; /**< next band to be run */
+    unsigned done; /**< number of bands run */
+};
+
+struct vlc_slice_pool
+{
+    vlc_mutex_t lock;
+    vlc_cond_t wait; /**< wait for a pending job or closing */
+    vlc_cond_t done_wait; /**< wait for a job to be completed */
+    struct vlc_list jobs; /**< jobs with bands not started yet */
+    bool closing;
+
+    unsigned refs; /**< protected by slice_pool_lock */
+    unsigned nthreads;
+    vlc_thread_t threads[];
+};
+
+static vlc_mutex_t slice_pool_lock = VLC_STATIC_MUTEX;
+static struct vlc_slice_pool *slice_pool = NULL;
+
+/**
+ * Starts the next band of a job. Must be called with the pool lock held, and
+ * only if the job has bands left.
+ */
+static void JobRunBand(struct vlc_slice_pool *pool, struct vlc_slice_job *job)
+{
+    unsigned band = job->next++;
+
+    assert(band < job->bands);
+    if (job->next == job->bands)
+        vlc_list_remove(&job->node);
+    vlc_mutex_unlock(&pool->lock);
+
+    unsigned first = (uint64_t)band * job->lines / job->bands;
+    unsigned last = (uint64_t)(band + 1) * job->lines / job->bands;
+
+    job->cb(job->filter, job->opaque, first, last - first);
+
+    vlc_mutex_lock(&pool->lock);
+    if (++job->done == job->bands)
+        vlc_cond_broadcast(&pool->done_wait);
+}
+
+static void *Thread(void *data)
+{
+    struct vlc_slice_pool *pool = data;
+
+    vlc_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        struct vlc_slice_job *job =
+            vlc_list_first_entry_or_null(&pool->jobs, struct vlc_slice_job,
+                                         node);
+        if (job != NULL)
+        {
+            JobRunBand(pool, job);
+            continue;
+        }
+
+        if (pool->closing)
+            break;
+        vlc_cond_wait(&pool->wait, &pool->lock);
+    }
+    vlc_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static struct vlc_slice_pool *PoolCreate(void)
+{
+    unsigned nthreads = vlc_GetCPUCount();
+
+    /* The calling thread runs bands too */
+    nthreads = nthreads > 1 ? nthreads - 1 : 0;
+    if (nthreads > SLICE_MAX_THREADS)
+        nthreads = SLICE_MAX_THREADS;
+
+    struct vlc_slice_pool *pool =
+        malloc(sizeof (*pool) + nthreads * sizeof (pool->threads[0]));
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    vlc_mutex_init(&pool->lock);
+    vlc_cond_init(&pool->wait);
+    vlc_cond_init(&pool->done_wait);
+    vlc_list_init(&pool->jobs);
+    pool->closing = false;
+    pool->refs = 1;
+    pool->nthreads = 0;
+
+    for (unsigned i = 0; i < nthreads; i++)
+    {
+        if (vlc_clone(&pool->threads[i], Thread, pool,
+                      VLC_THREAD_PRIORITY_VIDEO))
+            break;
+        pool->nthreads++;
+    }
+    return pool;
+}
+
+static void PoolDestroy(struct vlc_slice_pool *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    assert(vlc_list_is_empty(&pool->jobs));
+    pool->closing = true;
+    vlc_cond_broadcast(&pool->wait);
+    vlc_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->nthreads; i++)
+        vlc_join(pool->threads[i], NULL);
+
+    vlc_cond_destroy(&pool->done_wait);
+    vlc_cond_destroy(&pool->wait);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+struct vlc_slice_pool *vlc_slice_pool_Hold(void)
+{
+    vlc_mutex_lock(&slice_pool_lock);
+    struct vlc_slice_pool *pool = slice_pool;
+    if (pool != NULL)
+        pool->refs++;
+    else
+        slice_pool = pool = PoolCreate();
+    vlc_mutex_unlock(&slice_pool_lock);
+    return pool;
+}
+
+void vlc_slice_pool_Release(struct vlc_slice_pool *pool)
+{
+    vlc_mutex_lock(&slice_pool_lock);
+    assert(pool == slice_pool);
+    if (--pool->refs == 0)
+        slice_pool = NULL;
+    else
+        pool = NULL;
+    vlc_mutex_unlock(&slice_pool_lock);
+
+    if (pool != NULL)
+        PoolDestroy(pool);
+}
+
+void vlc_slice_pool_Run(struct vlc_slice_pool *pool, filter_t *filter,
+                        filter_slice_cb cb, void *opaque, unsigned lines)
+{
+    unsigned bands = lines / SLICE_MIN_LINES;
+
+    if (pool != NULL
+     && bands > (pool->nthreads + 1) * SLICE_BANDS_PER_THREAD)
+        bands = (pool->nthreads + 1) * SLICE_BANDS_PER_THREAD;
+
+    if (pool == NULL || pool->nthreads == 0 || bands <= 1)
+    {
+        cb(filter, opaque, 0, lines);
+        return;
+    }
+
+    struct vlc_slice_job job = {
+        .filter = filter,
+        .cb = cb,
+        .opaque = opaque,
+        .lines = lines,
+        .bands = bands,
+        .next = 0,
+        .done = 0,
+    };
+
+    /* The job lives on this stack: do not let it go away under the pool. */
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock(&pool->lock);
+    vlc_list_append(&job.node, &pool->jobs);
+    if (bands - 1 < pool->nthreads)
+        for (unsigned i = 0; i < bands - 1; i++)
+            vlc_cond_signal(&pool->wait);
+    else
+        vlc_cond_broadcast(&pool->wait);
+
+    while (job.next < job.bands)
+        JobRunBand(pool, &job);
+    while (job.done < job.bands)
+        vlc_cond_wait(&pool->done_wait, &pool->lock);
+    vlc_mutex_unlock(&pool->lock);
+
+    vlc_restorecancel(canc);
+}
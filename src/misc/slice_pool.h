@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * slice_pool.h: shared pool of threads for sliced video filtering
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef SLICE_POOL_H__
+#define SLICE_POOL_H__
+
+#include <vlc_filter.h>
+
+/**
+ * Process-wide pool of threads running bands of pictures.
+ *
+ * The pool is shared by all the video filter chains of the process: a
+ * single heavy stream can use every core, while many light streams do not
+ * create one thread per core each.
+ */
+struct vlc_slice_pool;
+
+/**
+ * Get a reference to the shared pool, creating it if needed.
+ *
+ * \return the pool, or NULL on error
+ */
+struct vlc_slice_pool *vlc_slice_pool_Hold(void);
+
+/**
+ * Release a reference to the shared pool.
+ *
+ * The threads are joined when the last reference is released.
+ */
+void vlc_slice_pool_Release(struct vlc_slice_pool *pool);
+
+/**
+ * Run a slice callback over all the lines of a picture.
+ *
+ * The lines are split in bands, which are run concurrently by the pool
+ * threads and the calling thread. The function returns once all the bands
+ * have been run.
+ *
+ * \param pool the pool (can be NULL, then the bands are run serially)
+ * \param filter the filter passed to the callback
+ * \param cb the callback
+ * \param opaque the opaque pointer passed to the callback
+ * \param lines the number of lines to split
+ */
+void vlc_slice_pool_Run(struct vlc_slice_pool *pool, filter_t *filter,
+                        filter_slice_cb cb, void *opaque, unsigned lines);
+
+#endif
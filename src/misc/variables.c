@@ -54,6 +54,34 @@ typedef struct callback_entry_t
     void *         p_data;
 } callback_entry_t;
 
+/**
+ * Lock-free view of a variable, indexed by name.
+ *
+ * Slots are created the first time a name is used on an object and are only
+ * freed with the object, so that readers never see one disappear. The slot
+ * mirrors the type and the value of the variable currently bearing its name,
+ * if any; it is only modified with the variable lock held. The sequence
+ * number is odd while the slot is being modified, so that readers never
+ * pair the type of a variable with the value of another.
+ */
+typedef struct var_slot_t
+{
+    char               *psz_name;
+    uint32_t            i_hash;
+    atomic_uint         seq;
+    atomic_int          i_type; /**< Variable class, or 0 if none */
+    _Atomic uint64_t    val;    /**< Value bits (scalar classes only) */
+} var_slot_t;
+
+/** Open addressing hash table of slots, replaced when it grows */
+typedef struct var_index_t
+{
+    struct var_index_t *prev; /**< Smaller tables, freed with the object */
+    size_t              mask;
+    size_t              count;
+    _Atomic(var_slot_t *) slots[];
+} var_index_t;
+
 typedef struct variable_ops_t
 {
     int  (*pf_cmp) ( vlc_value_t, vlc_value_t );
@@ -96,6 +124,9 @@ struct variable_t
     callback_entry_t    *value_callbacks;
     /** Registered list callbacks */
     callback_entry_t    *list_callbacks;
+
+    /** Lock-free view of this variable */
+    var_slot_t          *slot;
 };
 
 static int CmpBool( vlc_value_t v, vlc_value_t w )
@@ -145,6 +176,201 @@ static int varcmp( const void *a, const void *b )
     return strcmp( va->psz_name, vb->psz_name );
 }
 
+static uint32_t VarHash( const char *psz_name )
+{
+    uint32_t h = 2166136261u; /* FNV-1a */
+
+    for( const unsigned char *p = (const unsigned char *)psz_name; *p; p++ )
+        h = (h ^ *p) * 16777619u;
+    return h;
+}
+
+static var_slot_t *IndexFind( const var_index_t *idx, const char *psz_name,
+                              uint32_t i_hash )
+{
+    if( idx == NULL )
+        return NULL;
+
+    for( size_t i = i_hash & idx->mask;; i = (i + 1) & idx->mask )
+    {
+        var_slot_t *slot = atomic_load_explicit( &idx->slots[i],
+                                                 memory_order_acquire );
+        if( slot == NULL )
+            return NULL;
+        if( slot->i_hash == i_hash && !strcmp( slot->psz_name, psz_name ) )
+            return slot;
+    }
+}
+
+static void IndexInsert( var_index_t *idx, var_slot_t *slot )
+{
+    size_t i = slot->i_hash & idx->mask;
+
+    while( atomic_load_explicit( &idx->slots[i], memory_order_relaxed ) )
+        i = (i + 1) & idx->mask;
+    atomic_store_explicit( &idx->slots[i], slot, memory_order_release );
+    idx->count++;
+}
+
+/**
+ * Finds or creates the slot for a variable name.
+ * The variable lock must be held.
+ */
+static var_slot_t *IndexGet( vlc_object_internals_t *priv,
+                             const char *psz_name )
+{
+    var_index_t *idx = atomic_load_explicit( &priv->var_index,
+                                             memory_order_relaxed );
+    const uint32_t i_hash = VarHash( psz_name );
+    var_slot_t *slot = IndexFind( idx, psz_name, i_hash );
+
+    if( slot != NULL )
+        return slot;
+
+    /* Keep the load factor under 3/4 so that probing always terminates */
+    if( idx == NULL || (idx->count + 1) * 4 > (idx->mask + 1) * 3 )
+    {
+        size_t size = idx ? 2 * (idx->mask + 1) : 16;
+        var_index_t *grown = malloc( sizeof (*grown)
+                                     + size * sizeof (grown->slots[0]) );
+        if( unlikely(grown == NULL) )
+            return NULL;
+
+        grown->prev = idx;
+        grown->mask = size - 1;
+        grown->count = 0;
+        for( size_t i = 0; i < size; i++ )
+            atomic_init( &grown->slots[i], NULL );
+        if( idx != NULL )
+            for( size_t i = 0; i <= idx->mask; i++ )
+            {
+                var_slot_t *old = atomic_load_explicit( &idx->slots[i],
+                                                        memory_order_relaxed );
+                if( old != NULL )
+                    IndexInsert( grown, old );
+            }
+
+        /* Readers still walking the old table will find the same slots */
+        atomic_store_explicit( &priv->var_index, grown, memory_order_release );
+        idx = grown;
+    }
+
+    slot = malloc( sizeof (*slot) );
+    if( unlikely(slot == NULL) )
+        return NULL;
+    slot->psz_name = strdup( psz_name );
+    if( unlikely(slot->psz_name == NULL) )
+    {
+        free( slot );
+        return NULL;
+    }
+    slot->i_hash = i_hash;
+    atomic_init( &slot->seq, 0 );
+    atomic_init( &slot->i_type, 0 );
+    atomic_init( &slot->val, 0 );
+    IndexInsert( idx, slot );
+    return slot;
+}
+
+/**
+ * Updates the type and the value of a slot.
+ * The variable lock must be held, so that there is only one writer.
+ */
+static void SlotStore( var_slot_t *slot, int i_type, uint64_t bits )
+{
+    unsigned seq = atomic_load_explicit( &slot->seq, memory_order_relaxed );
+
+    atomic_store_explicit( &slot->seq, seq + 1, memory_order_relaxed );
+    atomic_thread_fence( memory_order_release );
+    atomic_store_explicit( &slot->i_type, i_type, memory_order_relaxed );
+    atomic_store_explicit( &slot->val, bits, memory_order_relaxed );
+    atomic_store_explicit( &slot->seq, seq + 2, memory_order_release );
+}
+
+/**
+ * Reads a consistent type and value from a slot.
+ * @return the type, or -1 if a writer kept the slot busy
+ */
+static int SlotLoad( var_slot_t *slot, uint64_t *bits )
+{
+    /* Writers hold the variable lock: rather than spinning after one, let
+     * the caller wait for that lock */
+    for( unsigned i = 0; i < 4; i++ )
+    {
+        unsigned seq = atomic_load_explicit( &slot->seq, memory_order_acquire );
+        if( seq & 1 )
+            continue;
+
+        int i_type = atomic_load_explicit( &slot->i_type, memory_order_relaxed );
+        *bits = atomic_load_explicit( &slot->val, memory_order_relaxed );
+        atomic_thread_fence( memory_order_acquire );
+        if( atomic_load_explicit( &slot->seq, memory_order_relaxed ) == seq )
+            return i_type;
+    }
+    return -1;
+}
+
+static uint64_t ValueBits( const variable_t *p_var )
+{
+    uint64_t bits = 0;
+
+    static_assert( sizeof (p_var->val) <= sizeof (bits),
+                   "Value does not fit in slot" );
+    memcpy( &bits, &p_var->val, sizeof (p_var->val) );
+    return bits;
+}
+
+/**
+ * Mirrors the current value of a variable to its slot.
+ * The variable lock must be held.
+ */
+static void Publish( variable_t *p_var )
+{
+    if( p_var->slot != NULL )
+        SlotStore( p_var->slot, p_var->i_type & VLC_VAR_CLASS,
+                   ValueBits( p_var ) );
+}
+
+/**
+ * Gets the value of a scalar variable without taking the variable lock.
+ *
+ * @retval VLC_SUCCESS the value was read
+ * @retval VLC_ENOVAR there is no variable by that name
+ * @retval VLC_EGENERIC the variable must be read with the lock held
+ */
+static int LookupFast( vlc_object_t *obj, const char *psz_name,
+                       int expected_type, vlc_value_t *p_val )
+{
+    vlc_object_internals_t *priv = vlc_internals( obj );
+    const var_index_t *idx = atomic_load_explicit( &priv->var_index,
+                                                   memory_order_acquire );
+    var_slot_t *slot = IndexFind( idx, psz_name, VarHash( psz_name ) );
+
+    if( slot == NULL )
+        return VLC_ENOVAR;
+
+    uint64_t bits;
+    int i_type = SlotLoad( slot, &bits );
+    switch( i_type )
+    {
+        case 0:
+            return VLC_ENOVAR;
+        case VLC_VAR_BOOL:
+        case VLC_VAR_INTEGER:
+        case VLC_VAR_FLOAT:
+        case VLC_VAR_COORDS:
+        case VLC_VAR_ADDRESS:
+            break;
+        default: /* Values that need to be duplicated, or busy slot */
+            return VLC_EGENERIC;
+    }
+    if( expected_type != 0 && i_type != expected_type )
+        return VLC_EGENERIC;
+
+    memcpy( p_val, &bits, sizeof (*p_val) );
+    return VLC_SUCCESS;
+}
+
 static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
@@ -169,6 +395,9 @@ static void Destroy( variable_t *p_var )
 
     free( p_var->psz_name );
     free( p_var->psz_text );
+    assert( p_var->slot == NULL
+         || atomic_load_explicit( &p_var->slot->i_type,
+                                  memory_order_relaxed ) == 0 );
     while (unlikely(p_var->value_callbacks != NULL))
     {
         callback_entry_t *next = p_var->value_callbacks->next;
@@ -361,7 +590,19 @@ int (var_Create)( vlc_object_t *p_this, const char *psz_name, int i_type )
     if( unlikely(pp_var == NULL) )
         ret = VLC_ENOMEM;
     else if( (p_oldvar = *pp_var) == p_var ) /* Variable create */
-        p_var = NULL; /* Variable created */
+    {
+        p_var->slot = IndexGet( p_priv, psz_name );
+        if( likely(p_var->slot != NULL) )
+        {
+            Publish( p_var );
+            p_var = NULL; /* Variable created */
+        }
+        else
+        {
+            tdelete( p_var, &p_priv->var_root, varcmp );
+            ret = VLC_ENOMEM;
+        }
+    }
     else /* Variable already exists */
     {
         assert (((i_type ^ p_oldvar->i_type) & VLC_VAR_CLASS) == 0);
@@ -392,6 +633,8 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
     {
         assert(!p_var->b_incallback);
         tdelete( p_var, &p_priv->var_root, varcmp );
+        if( p_var->slot != NULL )
+            SlotStore( p_var->slot, 0, 0 );
     }
     else
     {
@@ -412,9 +655,45 @@ static void CleanupVar( void *var )
 void var_DestroyAll( vlc_object_t *obj )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
+    var_index_t *idx = atomic_load_explicit( &priv->var_index,
+                                             memory_order_relaxed );
+
+    /* No other threads can use the object any longer */
+    if( idx != NULL )
+        for( size_t i = 0; i <= idx->mask; i++ )
+        {
+            var_slot_t *slot = atomic_load_explicit( &idx->slots[i],
+                                                     memory_order_relaxed );
+            if( slot != NULL )
+                atomic_store_explicit( &slot->i_type, 0,
+                                       memory_order_relaxed );
+        }
 
     tdestroy( priv->var_root, CleanupVar );
     priv->var_root = NULL;
+
+    if( idx != NULL )
+    {
+        for( size_t i = 0; i <= idx->mask; i++ )
+        {
+            var_slot_t *slot = atomic_load_explicit( &idx->slots[i],
+                                                     memory_order_relaxed );
+            if( slot != NULL )
+            {
+                free( slot->psz_name );
+                free( slot );
+            }
+        }
+
+        do
+        {
+            var_index_t *prev = idx->prev;
+            free( idx );
+            idx = prev;
+        }
+        while( idx != NULL );
+        atomic_store_explicit( &priv->var_index, NULL, memory_order_relaxed );
+    }
 }
 
 int (var_Change)(vlc_object_t *p_this, const char *psz_name, int i_action, ...)
@@ -454,6 +733,7 @@ int (var_Change)(vlc_object_t *p_this, const char *psz_name, int i_action, ...)
             assert(p_var->ops->pf_free == FreeDummy);
             p_var->step = va_arg(ap, vlc_value_t);
             CheckValue( p_var, &p_var->val );
+            Publish( p_var );
             break;
         case VLC_VAR_GETSTEP:
             switch (p_var->i_type & VLC_VAR_TYPE)
@@ -538,6 +818,7 @@ int (var_Change)(vlc_object_t *p_this, const char *psz_name, int i_action, ...)
             CheckValue( p_var, &newval );
             /* Set the variable */
             p_var->val = newval;
+            Publish( p_var );
             /* Free data if needed */
             p_var->ops->pf_free( &oldval );
             break;
@@ -640,6 +921,7 @@ int (var_GetAndSet)(vlc_object_t *p_this, const char *psz_name, int i_action,
 
     /*  Check boundaries */
     CheckValue( p_var, &p_var->val );
+    Publish( p_var );
     *p_val = p_var->val;
 
     /* Deal with callbacks.*/
@@ -704,6 +986,7 @@ int (var_SetChecked)(vlc_object_t *p_this, const char *psz_name,
 
     /* Set the variable */
     p_var->val = val;
+    Publish( p_var );
 
     /* Deal with callbacks */
     TriggerCallback( p_this, p_var, psz_name, oldval );
@@ -727,8 +1010,14 @@ int (var_GetChecked)(vlc_object_t *p_this, const char *psz_name,
 
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
     variable_t *p_var;
-    int err = VLC_SUCCESS;
+    int err;
+
+    /* Scalar values can be read without locking */
+    err = LookupFast( p_this, psz_name, expected_type, p_val );
+    if( err != VLC_EGENERIC )
+        return err;
 
+    err = VLC_SUCCESS;
     p_var = Lookup( p_this, psz_name );
     if( p_var != NULL )
     {
@@ -28,6 +28,7 @@
 # include <vlc_list.h>
 
 struct vlc_res;
+struct var_index_t;
 
 /**
  * Private LibVLC data for each object.
@@ -41,6 +42,7 @@ struct vlc_object_internals
 
     /* Object variables */
     void           *var_root;
+    _Atomic(struct var_index_t *) var_index; /* lock-free lookup */
     vlc_mutex_t     var_lock;
     vlc_cond_t      var_wait;
 
@@ -257,7 +257,7 @@ typedef struct module_bank
 
     size_t        size;
     vlc_plugin_t **plugins;
-    vlc_plugin_t *cache;
+    vlc_plugin_cache_t *cache;
 } module_bank_t;
 
 /**
@@ -269,9 +269,9 @@ static int AllocatePluginFile (module_bank_t *bank, const char *abspath,
     vlc_plugin_t *plugin = NULL;
 
     /* Check our plugins cache first then load plugin if needed */
-    if (bank->mode & CACHE_READ_FILE)
+    if (bank->cache != NULL)
     {
-        plugin = vlc_cache_lookup(&bank->cache, relpath);
+        plugin = vlc_cache_lookup(bank->cache, relpath);
 
         if (plugin != NULL
          && (plugin->mtime != (int64_t)st->st_mtime
@@ -417,16 +417,23 @@ static void AllocatePluginPath(vlc_object_t *obj, const char *path,
         AllocatePluginDir(&bank, 5, path, NULL);
     }
 
-    /* Deal with unmatched cache entries from cache file */
-    while (bank.cache != NULL)
+    /* Deal with unmatched cache entries from cache file: they are only
+     * deserialised if the directory was not scanned. */
+    if (bank.cache != NULL)
     {
-        vlc_plugin_t *plugin = bank.cache;
+        if (!(mode & CACHE_SCAN_DIR))
+        {
+            vlc_plugin_t *plugin = vlc_cache_load_all(bank.cache);
 
-        bank.cache = plugin->next;
-        if (mode & CACHE_SCAN_DIR)
-            vlc_plugin_destroy(plugin);
-        else
-            vlc_plugin_store(plugin);
+            while (plugin != NULL)
+            {
+                vlc_plugin_t *next = plugin->next;
+
+                vlc_plugin_store(plugin);
+                plugin = next;
+            }
+        }
+        vlc_cache_free(bank.cache);
     }
 
     if (mode & CACHE_WRITE_FILE)
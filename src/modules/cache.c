@@ -56,13 +56,38 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 35
+#define CACHE_SUBVERSION_NUM 36
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
 /* Magic for the cache filename */
 #define CACHE_STRING "cache "PACKAGE_NAME" "PACKAGE_VERSION
 
+/*
+ * The plugin records are followed by an index of the plugins sorted by
+ * relative path, so that records can be looked up in place and deserialised
+ * only when the corresponding plugin file is found:
+ *
+ *   uint32_t count;
+ *   struct vlc_cache_entry entries[count];
+ *   uint32_t offset; (of count, from the start of the file)
+ */
+struct vlc_cache_entry
+{
+    uint32_t path; /**< Offset of the nul-terminated relative path */
+    uint32_t record; /**< Offset of the plugin record */
+};
+
+struct vlc_plugin_cache
+{
+    const char *dir;
+    const uint8_t *base;
+    size_t end; /**< End of the plugin records */
+    size_t count;
+    const struct vlc_cache_entry *entries;
+    bool *used;
+};
+
 
 static int vlc_cache_load_immediate(void *out, block_t *in, size_t size)
 {
@@ -228,7 +253,8 @@ static int vlc_cache_load_config(module_config_t *cfg, block_t *file)
         LOAD_ARRAY(cfg->list.i, cfg->list_count);
     }
 
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
+    cfg->list_text = cfg->list_count
+                   ? xmalloc (cfg->list_count * sizeof (char *)) : NULL;
     for (unsigned i = 0; i < cfg->list_count; i++)
     {
         LOAD_STRING (cfg->list_text[i]);
@@ -357,6 +383,44 @@ error:
     return NULL;
 }
 
+static int vlc_cache_entry_cmp(const void *key, const void *elem)
+{
+    const struct vlc_plugin_cache *cache = ((const void **)key)[0];
+    const char *path = ((const void **)key)[1];
+    const struct vlc_cache_entry *entry = elem;
+
+    return strcmp(path, (const char *)cache->base + entry->path);
+}
+
+/**
+ * Deserialises the plugin record of a cache entry.
+ */
+static vlc_plugin_t *vlc_cache_load_entry(vlc_plugin_cache_t *cache,
+                                          size_t i)
+{
+    const struct vlc_cache_entry *entry = cache->entries + i;
+    block_t view;
+
+    assert(!cache->used[i]);
+    cache->used[i] = true;
+
+    block_Init(&view, NULL, (uint8_t *)cache->base + entry->record,
+               cache->end - entry->record);
+
+    vlc_plugin_t *plugin = vlc_cache_load_plugin(&view);
+    if (plugin == NULL)
+        return NULL;
+
+    if (unlikely(asprintf(&plugin->abspath, "%s" DIR_SEP "%s", cache->dir,
+                          plugin->path) == -1))
+    {
+        plugin->abspath = NULL;
+        vlc_plugin_destroy(plugin);
+        return NULL;
+    }
+    return plugin;
+}
+
 /**
  * Loads a plugins cache file.
  *
@@ -364,9 +428,12 @@ error:
  * will in turn be queried by AllocateAllPlugins() to see if it needs to
  * actually load the dynamically loadable module.
  * This allows us to only fully load plugins when they are actually used.
+ *
+ * The file is mapped and only its index is validated here: plugin records
+ * are deserialised by vlc_cache_lookup() and vlc_cache_load_all().
  */
-vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
-                             block_t **backingp)
+vlc_plugin_cache_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
+                                   block_t **backingp)
 {
     char *psz_filename;
 
@@ -385,6 +452,9 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
     if (file == NULL)
         return NULL;
 
+    const uint8_t *base = file->p_buffer;
+    const size_t size = file->i_buffer;
+
     /* Check the file is a plugins cache */
     char cachestr[sizeof (CACHE_STRING) - 1];
 
@@ -436,24 +506,54 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
         return NULL;
     }
 
-    vlc_plugin_t *cache = NULL;
+    /* Locate and check the index */
+    const size_t start = file->p_buffer - base;
+    uint32_t offset, count;
+
+    if (size < start + 2 * sizeof (uint32_t))
+        goto error;
+    memcpy(&offset, base + size - sizeof (offset), sizeof (offset));
+    if (offset < start || (offset % alignof (struct vlc_cache_entry))
+     || size - sizeof (offset) - sizeof (count) < offset)
+        goto error;
+    memcpy(&count, base + offset, sizeof (count));
+    if (count > (size - offset - sizeof (count) - sizeof (offset))
+                / sizeof (struct vlc_cache_entry))
+        goto error;
+
+    vlc_plugin_cache_t *cache = malloc(sizeof (*cache));
+    if (unlikely(cache == NULL))
+    {
+        block_Release(file);
+        return NULL;
+    }
+
+    cache->dir = dir;
+    cache->base = base;
+    cache->end = offset;
+    cache->count = count;
+    cache->entries = (const void *)(base + offset + sizeof (count));
+    cache->used = calloc(count ? count : 1, sizeof (*cache->used));
+    if (unlikely(cache->used == NULL))
+    {
+        free(cache);
+        block_Release(file);
+        return NULL;
+    }
 
-    while (file->i_buffer > 0)
+    for (size_t i = 0; i < count; i++)
     {
-        vlc_plugin_t *plugin = vlc_cache_load_plugin(file);
-        if (plugin == NULL)
-            goto error;
+        const struct vlc_cache_entry *entry = cache->entries + i;
 
-        if (unlikely(asprintf(&plugin->abspath, "%s" DIR_SEP "%s", dir,
-                              plugin->path) == -1))
+        if (entry->path < start || entry->path >= offset
+         || entry->record < start || entry->record >= offset
+         || memchr(base + entry->path, '\0', offset - entry->path) == NULL
+         || (i > 0 && strcmp((const char *)base + entry[-1].path,
+                             (const char *)base + entry->path) >= 0))
         {
-            plugin->abspath = NULL;
-            vlc_plugin_destroy(plugin);
+            vlc_cache_free(cache);
             goto error;
         }
-
-        plugin->next = cache;
-        cache = plugin;
     }
 
     file->p_next = *backingp;
@@ -462,12 +562,58 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
 
 error:
     msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
-
-    /* TODO: cleanup */
     block_Release(file);
     return NULL;
 }
 
+void vlc_cache_free(vlc_plugin_cache_t *cache)
+{
+    free(cache->used);
+    free(cache);
+}
+
+/**
+ * Looks up a plugin file in a plugins cache.
+ *
+ * The plugin is deserialised from the cache, at most once per cache entry.
+ */
+vlc_plugin_t *vlc_cache_lookup(vlc_plugin_cache_t *cache, const char *path)
+{
+    const void *key[2] = { cache, path };
+    const struct vlc_cache_entry *entry =
+        bsearch(key, cache->entries, cache->count, sizeof (*entry),
+                vlc_cache_entry_cmp);
+
+    if (entry == NULL || cache->used[entry - cache->entries])
+        return NULL;
+
+    return vlc_cache_load_entry(cache, entry - cache->entries);
+}
+
+/**
+ * Deserialises all the plugins that have not been looked up yet.
+ *
+ * @return a list of plugins linked with their next pointers
+ */
+vlc_plugin_t *vlc_cache_load_all(vlc_plugin_cache_t *cache)
+{
+    vlc_plugin_t *list = NULL;
+
+    for (size_t i = cache->count; i > 0; i--)
+    {
+        if (cache->used[i - 1])
+            continue;
+
+        vlc_plugin_t *plugin = vlc_cache_load_entry(cache, i - 1);
+        if (plugin == NULL)
+            continue;
+
+        plugin->next = list;
+        list = plugin;
+    }
+    return list;
+}
+
 #define SAVE_IMMEDIATE( a ) \
     if (fwrite (&(a), sizeof(a), 1, file) != 1) \
         goto error
@@ -591,9 +737,48 @@ error:
     return -1;
 }
 
+struct vlc_cache_save_entry
+{
+    const char *path;
+    struct vlc_cache_entry entry;
+};
+
+static int vlc_cache_save_cmp(const void *a, const void *b)
+{
+    const struct vlc_cache_save_entry *ea = a, *eb = b;
+
+    return strcmp(ea->path, eb->path);
+}
+
+static int CacheSaveIndex(FILE *file, struct vlc_cache_save_entry *index,
+                          size_t n)
+{
+    qsort(index, n, sizeof (*index), vlc_cache_save_cmp);
+
+    SAVE_ALIGNOF(struct vlc_cache_entry);
+
+    long pos = ftell(file);
+    if (pos < 0 || (unsigned long)pos > UINT32_MAX)
+        goto error;
+
+    uint32_t offset = pos, count = n;
+
+    SAVE_IMMEDIATE(count);
+    for (size_t i = 0; i < n; i++)
+        SAVE_IMMEDIATE(index[i].entry);
+    SAVE_IMMEDIATE(offset);
+    return 0;
+error:
+    return -1;
+}
+
 static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
 {
     uint32_t i_file_size = 0;
+    struct vlc_cache_save_entry *index = vlc_alloc(n ? n : 1, sizeof (*index));
+
+    if (unlikely(index == NULL))
+        return -1;
 
     /* Contains version number */
     if (fputs (CACHE_STRING, file) == EOF)
@@ -618,6 +803,12 @@ static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
     {
         const vlc_plugin_t *plugin = cache[i];
         uint32_t count = plugin->modules_count;
+        long pos = ftell(file);
+
+        if (pos < 0 || (unsigned long)pos > UINT32_MAX)
+            goto error;
+        index[i].path = plugin->path;
+        index[i].entry.record = pos;
 
         SAVE_IMMEDIATE(count);
 
@@ -633,17 +824,26 @@ static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
 
         /* Save common info */
         SAVE_STRING(plugin->textdomain);
+        pos = ftell(file);
+        if (pos < 0 || (unsigned long)pos + sizeof (uint16_t) > UINT32_MAX)
+            goto error;
+        index[i].entry.path = pos + sizeof (uint16_t);
         SAVE_STRING(plugin->path);
         SAVE_FLAG(plugin->unloadable);
         SAVE_IMMEDIATE(plugin->mtime);
         SAVE_IMMEDIATE(plugin->size);
     }
 
-    if (fflush (file)) /* flush libc buffers */
+    if (CacheSaveIndex(file, index, n))
         goto error;
+    free(index);
+
+    if (fflush (file)) /* flush libc buffers */
+        return -1;
     return 0; /* success! */
 
 error:
+    free(index);
     return -1;
 }
 
@@ -694,25 +894,4 @@ out:
     free (tmpname);
 }
 
-/**
- * Looks up a plugin file in a table of cached plugins.
- */
-vlc_plugin_t *vlc_cache_lookup(vlc_plugin_t **cache, const char *path)
-{
-    vlc_plugin_t **pp = cache, *plugin;
-
-    while ((plugin = *pp) != NULL)
-    {
-        if (plugin->path != NULL && !strcmp(plugin->path, path))
-        {
-            *pp = plugin->next;
-            plugin->next = NULL;
-            return plugin;
-        }
-
-        pp = &plugin->next;
-    }
-
-    return NULL;
-}
 #endif /* HAVE_DYNAMIC_PLUGINS */
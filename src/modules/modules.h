@@ -161,8 +161,12 @@ void *vlc_dlsym(void *handle, const char *) VLC_USED;
 char *vlc_dlerror(void) VLC_USED;
 
 /* Plugins cache */
-vlc_plugin_t *vlc_cache_load(vlc_object_t *, const char *, block_t **);
-vlc_plugin_t *vlc_cache_lookup(vlc_plugin_t **, const char *relpath);
+typedef struct vlc_plugin_cache vlc_plugin_cache_t;
+
+vlc_plugin_cache_t *vlc_cache_load(vlc_object_t *, const char *, block_t **);
+vlc_plugin_t *vlc_cache_lookup(vlc_plugin_cache_t *, const char *relpath);
+vlc_plugin_t *vlc_cache_load_all(vlc_plugin_cache_t *);
+void vlc_cache_free(vlc_plugin_cache_t *);
 
 void CacheSave(vlc_object_t *, const char *, vlc_plugin_t *const *, size_t);
 
@@ -42,6 +42,7 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
 #include <string.h>
@@ -54,6 +55,9 @@
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -68,8 +72,45 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* maximum number of ready sockets handled per host loop iteration */
+#define HTTPD_MAX_EVENTS 64
+/* how often idle clients are checked for their activity timeout */
+#define HTTPD_TIMEOUT_SCAN VLC_TICK_FROM_SEC(1)
+
+#ifdef HAVE_SYS_EPOLL_H
+/* What an epoll registration of a host refers to */
+struct httpd_poll_ref
+{
+    enum { HTTPD_POLL_LISTEN, HTTPD_POLL_CLIENT } kind;
+    int fd; /* listening socket */
+};
+#endif
+
+/* maximum number of stream chunks sent by a single client write */
+#define HTTPD_CL_IOVMAX 16
+
+/* Stream data, shared by all the clients of an httpd_stream_t */
+typedef struct httpd_chunk_t
+{
+    vlc_atomic_rc_t rc;
+    struct httpd_chunk_t *next; /* protected by the stream lock */
+
+    int64_t i_pos; /* absolute position of the first byte in the stream */
+    size_t  i_size;
+    uint8_t p_data[];
+} httpd_chunk_t;
+
+static void httpd_ChunkRelease(httpd_chunk_t *chunk)
+{
+    if (vlc_atomic_rc_dec(&chunk->rc))
+        free(chunk);
+}
+
 static void httpd_ClientDestroy(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
+#ifdef HAVE_SYS_EPOLL_H
+static void httpd_ClientUnpoll(httpd_host_t *host, httpd_client_t *cl);
+static void httpd_ClientActivate(httpd_host_t *host, httpd_client_t *cl);
+#endif
 
 /* each host run in his own thread */
 struct httpd_host_t
@@ -84,6 +125,10 @@ struct httpd_host_t
     int         *fds;
     unsigned     nfd;
     unsigned     port;
+#ifdef HAVE_SYS_EPOLL_H
+    int          epfd;
+    struct httpd_poll_ref *listen_refs;
+#endif
 
     vlc_thread_t thread;
     vlc_mutex_t lock;
@@ -97,6 +142,11 @@ struct httpd_host_t
 
     size_t client_count;
     struct vlc_list clients;
+#ifdef HAVE_SYS_EPOLL_H
+    /* clients whose poll events must be recomputed */
+    struct vlc_list active;
+    vlc_tick_t i_timeout_scan;
+#endif
 
     /* TLS data */
     vlc_tls_server_t *p_tls;
@@ -146,6 +196,12 @@ struct httpd_client_t
 
     bool    b_stream_mode;
     uint8_t i_state;
+#ifdef HAVE_SYS_EPOLL_H
+    short   i_poll_events; /* events registered with the host epoll */
+    bool    b_active;
+    struct vlc_list active_node;
+    struct httpd_poll_ref poll_ref;
+#endif
 
     vlc_tick_t i_activity_date;
     vlc_tick_t i_activity_timeout;
@@ -162,6 +218,14 @@ struct httpd_client_t
      */
     int64_t i_keyframe_wait_to_pass;
 
+    /* Stream chunks being sent, written straight from the shared data.
+     * The first one has already been sent up to i_chunk_offset. */
+    httpd_chunk_t *pp_chunks[HTTPD_CL_IOVMAX];
+    unsigned       i_chunks;
+    size_t         i_chunk_offset;
+    /* Last chunk handed to that client, to find the next one quickly */
+    httpd_chunk_t *p_chunk_cursor;
+
     /* */
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
@@ -607,9 +671,13 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    httpd_chunk_t *p_last_keyframe; /* only valid while still queued */
+
+    /* queue of the most recent data */
+    size_t      i_buffer_size;      /* maximum amount of queued data */
+    size_t      i_buffer_queued;    /* amount of queued data */
+    httpd_chunk_t *p_first;
+    httpd_chunk_t **pp_last;
     int64_t     i_buffer_pos;       /* absolute position from beginning */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
@@ -628,47 +696,75 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
+        vlc_mutex_lock(&stream->lock);
 
         if (answer->i_body_offset >= stream->i_buffer_pos)
-            return VLC_EGENERIC;    /* wait, no data available */
+            goto wait;    /* wait, no data available */
+
+        httpd_chunk_t *chunk = NULL;
+        httpd_chunk_t *cursor = cl->p_chunk_cursor;
 
         if (cl->i_keyframe_wait_to_pass >= 0) {
             if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
                 /* still waiting for the next keyframe */
-                return VLC_EGENERIC;
+                goto wait;
 
             /* seek to the new keyframe */
             answer->i_body_offset = stream->i_last_keyframe_seen_pos;
             cl->i_keyframe_wait_to_pass = -1;
+            cursor = NULL;
         }
 
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
+        if (answer->i_body_offset < stream->p_first->i_pos)
             answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
 
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
-
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
-
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
+        /* Chunks are queued in order: the follower of the chunk ending at
+         * the current position is still valid if that position is. */
+        if (cursor != NULL && cursor->next != NULL
+         && cursor->i_pos + (int64_t)cursor->i_size == answer->i_body_offset)
+            chunk = cursor->next;
+        else if (stream->p_last_keyframe != NULL
+              && stream->p_last_keyframe->i_pos == answer->i_body_offset)
+            chunk = stream->p_last_keyframe;
+        else
+            for (chunk = stream->p_first;
+                 chunk->i_pos + (int64_t)chunk->i_size <= answer->i_body_offset;
+                 chunk = chunk->next)
+                assert(chunk->next != NULL);
+
+        assert(cl->i_chunks == 0);
+        cl->i_chunk_offset = answer->i_body_offset - chunk->i_pos;
+
+        int64_t i_write = -(int64_t)cl->i_chunk_offset;
+        do {
+            vlc_atomic_rc_inc(&chunk->rc);
+            cl->pp_chunks[cl->i_chunks++] = chunk;
+            i_write += chunk->i_size;
+        } while (cl->i_chunks < HTTPD_CL_IOVMAX
+              && (chunk = chunk->next) != NULL);
+
+        chunk = cl->pp_chunks[cl->i_chunks - 1];
+        vlc_atomic_rc_inc(&chunk->rc);
+        if (cl->p_chunk_cursor != NULL)
+            httpd_ChunkRelease(cl->p_chunk_cursor);
+        cl->p_chunk_cursor = chunk;
+        vlc_mutex_unlock(&stream->lock);
 
         /* using HTTPD_MSG_ANSWER -> data available */
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
         answer->i_type   = HTTPD_MSG_ANSWER;
 
+        /* The body is sent from the client chunks, see httpd_ClientSend() */
         answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
+        answer->p_body = NULL;
 
         answer->i_body_offset += i_write;
 
         return VLC_SUCCESS;
+wait:
+        vlc_mutex_unlock(&stream->lock);
+        return VLC_EGENERIC;
     } else {
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
@@ -765,13 +861,16 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
     stream->i_header = 0;
     stream->p_header = NULL;
     stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->i_buffer_queued = 0;
+    stream->p_first = NULL;
+    stream->pp_last = &stream->p_first;
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
     stream->i_buffer_last_pos = 1;
     stream->b_has_keyframes = false;
     stream->i_last_keyframe_seen_pos = 0;
+    stream->p_last_keyframe = NULL;
     stream->i_http_headers = 0;
     stream->p_http_headers = NULL;
 
@@ -801,40 +900,50 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
-{
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
-
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
-
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
-    }
-
-    stream->i_buffer_pos += i_data;
-}
-
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    if (!p_block || !p_block->p_buffer)
+    if (!p_block || !p_block->p_buffer || p_block->i_buffer == 0)
         return VLC_SUCCESS;
 
+    /* The data is copied once here, then shared by all clients */
+    httpd_chunk_t *chunk = malloc(sizeof (*chunk) + p_block->i_buffer);
+    if (unlikely(chunk == NULL))
+        return VLC_ENOMEM;
+
+    vlc_atomic_rc_init(&chunk->rc);
+    chunk->next = NULL;
+    chunk->i_size = p_block->i_buffer;
+    memcpy(chunk->p_data, p_block->p_buffer, p_block->i_buffer);
+
     vlc_mutex_lock(&stream->lock);
 
     /* save this pointer (to be used by new connection) */
     stream->i_buffer_last_pos = stream->i_buffer_pos;
+    chunk->i_pos = stream->i_buffer_pos;
 
     if (p_block->i_flags & BLOCK_FLAG_TYPE_I) {
         stream->b_has_keyframes = true;
         stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
+        stream->p_last_keyframe = chunk;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    *stream->pp_last = chunk;
+    stream->pp_last = &chunk->next;
+    stream->i_buffer_pos += chunk->i_size;
+    stream->i_buffer_queued += chunk->i_size;
+
+    /* Drop the oldest data, clients still sending it hold their own
+     * references */
+    while (stream->i_buffer_queued > stream->i_buffer_size
+        && stream->p_first != chunk) {
+        httpd_chunk_t *first = stream->p_first;
+
+        stream->p_first = first->next;
+        stream->i_buffer_queued -= first->i_size;
+        if (stream->p_last_keyframe == first)
+            stream->p_last_keyframe = NULL;
+        httpd_ChunkRelease(first);
+    }
 
     vlc_mutex_unlock(&stream->lock);
     return VLC_SUCCESS;
@@ -851,7 +960,12 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    while (stream->p_first != NULL) {
+        httpd_chunk_t *chunk = stream->p_first;
+
+        stream->p_first = chunk->next;
+        httpd_ChunkRelease(chunk);
+    }
     free(stream);
 }
 
@@ -938,6 +1052,10 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     vlc_mutex_init(&host->lock);
     vlc_cond_init(&host->wait);
     atomic_init(&host->ref, 1);
+#ifdef HAVE_SYS_EPOLL_H
+    host->epfd = -1;
+    host->listen_refs = NULL;
+#endif
 
     char *hostname = var_InheritString(p_this, hostvar);
 
@@ -950,10 +1068,43 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     }
     for (host->nfd = 0; host->fds[host->nfd] != -1; host->nfd++);
 
+#ifdef HAVE_SYS_EPOLL_H
+    host->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (host->epfd == -1) {
+        msg_Err(p_this, "cannot create HTTP host poller: %s",
+                vlc_strerror_c(errno));
+        goto error;
+    }
+
+    host->listen_refs = vlc_alloc(host->nfd, sizeof (*host->listen_refs));
+    if (unlikely(host->listen_refs == NULL))
+        goto error;
+
+    for (unsigned i = 0; i < host->nfd; i++) {
+        struct epoll_event ev = {
+            .events = EPOLLIN,
+            .data.ptr = &host->listen_refs[i],
+        };
+
+        host->listen_refs[i].kind = HTTPD_POLL_LISTEN;
+        host->listen_refs[i].fd = host->fds[i];
+
+        if (epoll_ctl(host->epfd, EPOLL_CTL_ADD, host->fds[i], &ev)) {
+            msg_Err(p_this, "cannot poll HTTP host socket: %s",
+                    vlc_strerror_c(errno));
+            goto error;
+        }
+    }
+#endif
+
     host->port     = port;
     vlc_list_init(&host->urls);
     host->client_count = 0;
     vlc_list_init(&host->clients);
+#ifdef HAVE_SYS_EPOLL_H
+    vlc_list_init(&host->active);
+    host->i_timeout_scan = 0;
+#endif
     host->p_tls    = p_tls;
 
     /* create the thread */
@@ -973,6 +1124,11 @@ error:
     vlc_mutex_unlock(&httpd.mutex);
 
     if (host) {
+#ifdef HAVE_SYS_EPOLL_H
+        if (host->epfd != -1)
+            vlc_close(host->epfd);
+        free(host->listen_refs);
+#endif
         net_ListenClose(host->fds);
         vlc_cond_destroy(&host->wait);
         vlc_mutex_destroy(&host->lock);
@@ -1010,6 +1166,10 @@ void httpd_HostDelete(httpd_host_t *host)
 
     assert(vlc_list_is_empty(&host->urls));
     vlc_tls_ServerDelete(host->p_tls);
+#ifdef HAVE_SYS_EPOLL_H
+    vlc_close(host->epfd);
+    free(host->listen_refs);
+#endif
     net_ListenClose(host->fds);
     vlc_cond_destroy(&host->wait);
     vlc_mutex_destroy(&host->lock);
@@ -1089,8 +1249,19 @@ void httpd_UrlDelete(httpd_url_t *url)
 
         /* TODO complete it */
         msg_Warn(host, "force closing connections");
+#ifdef HAVE_SYS_EPOLL_H
+        /* The host thread may still hold pending events for that client:
+         * close the connection now but let the thread free the client. */
+        httpd_ClientUnpoll(host, client);
+        vlc_tls_Close(client->sock);
+        client->sock = NULL;
+        client->url = NULL;
+        client->i_state = HTTPD_CLIENT_DEAD;
+        httpd_ClientActivate(host, client);
+#else
         host->client_count--;
         httpd_ClientDestroy(client);
+#endif
     }
     free(url);
     vlc_mutex_unlock(&host->lock);
@@ -1174,7 +1345,16 @@ static void httpd_ClientInit(httpd_client_t *cl, vlc_tick_t now)
     cl->i_buffer = 0;
     cl->p_buffer = xmalloc(cl->i_buffer_size);
     cl->i_keyframe_wait_to_pass = -1;
+    cl->i_chunks = 0;
+    cl->i_chunk_offset = 0;
+    cl->p_chunk_cursor = NULL;
     cl->b_stream_mode = false;
+#ifdef HAVE_SYS_EPOLL_H
+    cl->i_poll_events = 0;
+    cl->b_active = false;
+    cl->poll_ref.kind = HTTPD_POLL_CLIENT;
+    cl->poll_ref.fd = -1;
+#endif
 
     httpd_MsgInit(&cl->query);
     httpd_MsgInit(&cl->answer);
@@ -1193,10 +1373,15 @@ char* httpd_ServerIP(const httpd_client_t *cl, char *ip, int *port)
 static void httpd_ClientDestroy(httpd_client_t *cl)
 {
     vlc_list_remove(&cl->node);
-    vlc_tls_Close(cl->sock);
+    if (cl->sock != NULL)
+        vlc_tls_Close(cl->sock);
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
 
+    for (unsigned i = 0; i < cl->i_chunks; i++)
+        httpd_ChunkRelease(cl->pp_chunks[i]);
+    if (cl->p_chunk_cursor != NULL)
+        httpd_ChunkRelease(cl->p_chunk_cursor);
     free(cl->p_buffer);
     free(cl);
 }
@@ -1231,6 +1416,38 @@ ssize_t httpd_NetSend (httpd_client_t *cl, const uint8_t *p, size_t i_len)
 }
 
 
+/* Sends queued stream chunks and releases the ones fully written */
+static ssize_t httpd_ClientSendChunks(httpd_client_t *cl)
+{
+    vlc_tls_t *sock = cl->sock;
+    struct iovec iov[HTTPD_CL_IOVMAX];
+
+    for (unsigned i = 0; i < cl->i_chunks; i++) {
+        iov[i].iov_base = cl->pp_chunks[i]->p_data;
+        iov[i].iov_len = cl->pp_chunks[i]->i_size;
+    }
+    iov[0].iov_base = (uint8_t *)iov[0].iov_base + cl->i_chunk_offset;
+    iov[0].iov_len -= cl->i_chunk_offset;
+
+    ssize_t val = sock->ops->writev(sock, iov, cl->i_chunks);
+    if (val <= 0)
+        return val;
+
+    size_t i_len = val;
+    unsigned i_done = 0;
+
+    while (i_done < cl->i_chunks && i_len >= iov[i_done].iov_len) {
+        i_len -= iov[i_done].iov_len;
+        httpd_ChunkRelease(cl->pp_chunks[i_done++]);
+    }
+
+    cl->i_chunks -= i_done;
+    memmove(cl->pp_chunks, cl->pp_chunks + i_done,
+            cl->i_chunks * sizeof (cl->pp_chunks[0]));
+    cl->i_chunk_offset = (i_done > 0 ? 0 : cl->i_chunk_offset) + i_len;
+    return val;
+}
+
 static const struct
 {
     const char name[16];
@@ -1572,8 +1789,11 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer_size = (uint8_t*)p - cl->p_buffer;
     }
 
-    i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
-                           cl->i_buffer_size - cl->i_buffer);
+    if (cl->i_chunks > 0)
+        i_len = httpd_ClientSendChunks(cl);
+    else
+        i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
+                               cl->i_buffer_size - cl->i_buffer);
     if (i_len >= 0) {
         cl->i_buffer += i_len;
 
@@ -1666,265 +1886,485 @@ auth_failed:
     return false;
 }
 
-static void httpdLoop(httpd_host_t *host)
+/* Runs the client state machine and returns the events to wait for */
+static short httpd_ClientPrepare(httpd_host_t *host, httpd_client_t *cl,
+                                 int *fd)
 {
-    struct pollfd ufd[host->nfd + host->client_count];
-    unsigned nfd;
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        ufd[nfd].fd = host->fds[nfd];
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
-    }
-
-    vlc_mutex_lock(&host->lock);
-    /* add all socket that should be read/write and close dead connection */
-    while (vlc_list_is_empty(&host->urls)) {
-        mutex_cleanup_push(&host->lock);
-        vlc_cond_wait(&host->wait, &host->lock);
-        vlc_cleanup_pop();
-    }
+    int64_t i_offset;
+    short events = 0;
 
-    vlc_tick_t now = vlc_tick_now();
-    bool b_low_delay = false;
-    httpd_client_t *cl;
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING:
+        case HTTPD_CLIENT_TLS_HS_IN:
+            events = POLLIN;
+            break;
 
-    int canc = vlc_savecancel();
-    vlc_list_foreach(cl, &host->clients, node) {
-        int64_t i_offset;
+        case HTTPD_CLIENT_SENDING:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            events = POLLOUT;
+            break;
 
-        if (cl->i_state == HTTPD_CLIENT_DEAD
-         || (cl->i_activity_timeout > 0
-          && cl->i_activity_date + cl->i_activity_timeout < now)) {
-            host->client_count--;
-            httpd_ClientDestroy(cl);
-            continue;
-        }
+        case HTTPD_CLIENT_RECEIVE_DONE: {
+            httpd_message_t *answer = &cl->answer;
+            httpd_message_t *query  = &cl->query;
+
+            httpd_MsgInit(answer);
+
+            /* Handle what we received */
+            switch (query->i_type) {
+                case HTTPD_MSG_ANSWER:
+                    cl->url     = NULL;
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    break;
+
+                case HTTPD_MSG_OPTIONS:
+                    answer->i_type   = HTTPD_MSG_ANSWER;
+                    answer->i_proto  = query->i_proto;
+                    answer->i_status = 200;
+                    answer->i_body = 0;
+                    answer->p_body = NULL;
+
+                    httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
+                    httpd_MsgAdd(answer, "Content-Length", "0");
+
+                    switch(query->i_proto) {
+                    case HTTPD_PROTO_HTTP:
+                        answer->i_version = 1;
+                        httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
+                        break;
 
-        struct pollfd *pufd = ufd + nfd;
-        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
+                    case HTTPD_PROTO_RTSP:
+                        answer->i_version = 0;
 
-        pufd->events = pufd->revents = 0;
+                        const char *p = httpd_MsgGet(query, "Cseq");
+                        if (p)
+                            httpd_MsgAdd(answer, "Cseq", "%s", p);
+                        p = httpd_MsgGet(query, "Timestamp");
+                        if (p)
+                            httpd_MsgAdd(answer, "Timestamp", "%s", p);
 
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING:
-            case HTTPD_CLIENT_TLS_HS_IN:
-                pufd->events = POLLIN;
-                break;
+                        p = httpd_MsgGet(query, "Require");
+                        if (p) {
+                            answer->i_status = 551;
+                            httpd_MsgAdd(query, "Unsupported", "%s", p);
+                        }
 
-            case HTTPD_CLIENT_SENDING:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                pufd->events = POLLOUT;
-                break;
+                        httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
+                                "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
+                        break;
+                    }
 
-            case HTTPD_CLIENT_RECEIVE_DONE: {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
+                    if (httpd_MsgGet(&cl->query, "Connection") != NULL)
+                        httpd_MsgAdd(answer, "Connection", "close");
 
-                httpd_MsgInit(answer);
+                    cl->i_buffer = -1;  /* Force the creation of the answer in
+                                         * httpd_ClientSend */
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
 
-                /* Handle what we received */
-                switch (query->i_type) {
-                    case HTTPD_MSG_ANSWER:
-                        cl->url     = NULL;
+                case HTTPD_MSG_NONE:
+                    if (query->i_proto == HTTPD_PROTO_NONE) {
+                        cl->url = NULL;
                         cl->i_state = HTTPD_CLIENT_DEAD;
-                        break;
-
-                    case HTTPD_MSG_OPTIONS:
+                    } else {
+                        /* unimplemented */
+                        answer->i_proto  = query->i_proto ;
                         answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_proto  = query->i_proto;
-                        answer->i_status = 200;
-                        answer->i_body = 0;
-                        answer->p_body = NULL;
+                        answer->i_version= 0;
+                        answer->i_status = 501;
 
-                        httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
-                        httpd_MsgAdd(answer, "Content-Length", "0");
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
+                        answer->p_body = (uint8_t *)p;
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Connection", "close");
 
-                        switch(query->i_proto) {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
-                            break;
-
-                        case HTTPD_PROTO_RTSP:
-                            answer->i_version = 0;
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    }
+                    break;
 
-                            const char *p = httpd_MsgGet(query, "Cseq");
-                            if (p)
-                                httpd_MsgAdd(answer, "Cseq", "%s", p);
-                            p = httpd_MsgGet(query, "Timestamp");
-                            if (p)
-                                httpd_MsgAdd(answer, "Timestamp", "%s", p);
+                default: {
+                    httpd_url_t *url;
+                    int i_msg = query->i_type;
+                    bool b_auth_failed = false;
 
-                            p = httpd_MsgGet(query, "Require");
-                            if (p) {
-                                answer->i_status = 551;
-                                httpd_MsgAdd(query, "Unsupported", "%s", p);
-                            }
+                    /* Search the url and trigger callbacks */
+                    vlc_list_foreach(url, &host->urls, node) {
+                        if (strcmp(url->psz_url, query->psz_url))
+                            continue;
+                        if (!url->catch[i_msg].cb)
+                            continue;
 
-                            httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
-                                    "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
-                            break;
+                        if (answer) {
+                            b_auth_failed = !httpdAuthOk(url->psz_user,
+                               url->psz_password,
+                               httpd_MsgGet(query, "Authorization")); /* BASIC id */
+                            if (b_auth_failed)
+                               break;
                         }
 
-                        if (httpd_MsgGet(&cl->query, "Connection") != NULL)
-                            httpd_MsgAdd(answer, "Connection", "close");
+                        if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
+                            continue;
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in
-                                             * httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                        break;
+                        if (answer->i_proto == HTTPD_PROTO_NONE)
+                            cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
+                        else
+                            cl->i_buffer = -1;
 
-                    case HTTPD_MSG_NONE:
-                        if (query->i_proto == HTTPD_PROTO_NONE) {
-                            cl->url = NULL;
-                            cl->i_state = HTTPD_CLIENT_DEAD;
-                        } else {
-                            /* unimplemented */
-                            answer->i_proto  = query->i_proto ;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-                            answer->i_status = 501;
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                            answer->p_body = (uint8_t *)p;
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        /* only one url can answer */
+                        answer = NULL;
+                        if (!cl->url)
+                            cl->url = url;
+                    }
+
+                    if (answer) {
+                        answer->i_proto  = query->i_proto;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+
+                       if (b_auth_failed) {
+                            httpd_MsgAdd(answer, "WWW-Authenticate",
+                                    "Basic realm=\"VLC stream\"");
+                            answer->i_status = 401;
+                        } else
+                            answer->i_status = 404; /* no url registered */
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, answer->i_status,
+                                query->psz_url);
+                        answer->p_body = (uint8_t *)p;
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
+                        if (httpd_MsgGet(&cl->query, "Connection") != NULL)
                             httpd_MsgAdd(answer, "Connection", "close");
+                    }
 
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            cl->i_state = HTTPD_CLIENT_SENDING;
-                        }
-                        break;
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                }
+            }
+            break;
+        }
 
-                    default: {
-                        httpd_url_t *url;
-                        int i_msg = query->i_type;
-                        bool b_auth_failed = false;
-
-                        /* Search the url and trigger callbacks */
-                        vlc_list_foreach(url, &host->urls, node) {
-                            if (strcmp(url->psz_url, query->psz_url))
-                                continue;
-                            if (!url->catch[i_msg].cb)
-                                continue;
-
-                            if (answer) {
-                                b_auth_failed = !httpdAuthOk(url->psz_user,
-                                   url->psz_password,
-                                   httpd_MsgGet(query, "Authorization")); /* BASIC id */
-                                if (b_auth_failed)
-                                   break;
-                            }
-
-                            if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
-                                continue;
-
-                            if (answer->i_proto == HTTPD_PROTO_NONE)
-                                cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
-                            else
-                                cl->i_buffer = -1;
-
-                            /* only one url can answer */
-                            answer = NULL;
-                            if (!cl->url)
-                                cl->url = url;
-                        }
+        case HTTPD_CLIENT_SEND_DONE:
+            if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
+                bool do_close = false;
 
-                        if (answer) {
-                            answer->i_proto  = query->i_proto;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-
-                           if (b_auth_failed) {
-                                httpd_MsgAdd(answer, "WWW-Authenticate",
-                                        "Basic realm=\"VLC stream\"");
-                                answer->i_status = 401;
-                            } else
-                                answer->i_status = 404; /* no url registered */
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, answer->i_status,
-                                    query->psz_url);
-                            answer->p_body = (uint8_t *)p;
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
-                            if (httpd_MsgGet(&cl->query, "Connection") != NULL)
-                                httpd_MsgAdd(answer, "Connection", "close");
-                        }
+                cl->url = NULL;
 
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                    }
+                if (cl->query.i_proto != HTTPD_PROTO_HTTP
+                 || cl->query.i_version > 0)
+                {
+                    const char *psz_connection = httpd_MsgGet(&cl->answer,
+                                                             "Connection");
+                    if (psz_connection != NULL)
+                        do_close = !strcasecmp(psz_connection, "close");
                 }
-                break;
+                else
+                    do_close = true;
+
+                if (!do_close) {
+                    httpd_MsgClean(&cl->query);
+                    httpd_MsgInit(&cl->query);
+
+                    cl->i_buffer = 0;
+                    cl->i_buffer_size = 1000;
+                    free(cl->p_buffer);
+                    // Allocate an extra byte for the null terminating byte
+                    cl->p_buffer = xmalloc(cl->i_buffer_size + 1);
+                    cl->i_state = HTTPD_CLIENT_RECEIVING;
+                } else
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                httpd_MsgClean(&cl->answer);
+            } else {
+                i_offset = cl->answer.i_body_offset;
+                httpd_MsgClean(&cl->answer);
+
+                cl->answer.i_body_offset = i_offset;
+                free(cl->p_buffer);
+                cl->p_buffer = NULL;
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 0;
+
+                cl->i_state = HTTPD_CLIENT_WAITING;
             }
+            break;
 
-            case HTTPD_CLIENT_SEND_DONE:
-                if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
-                    bool do_close = false;
+        case HTTPD_CLIENT_WAITING:
+            i_offset = cl->answer.i_body_offset;
+            int i_msg = cl->query.i_type;
 
-                    cl->url = NULL;
+            httpd_MsgInit(&cl->answer);
+            cl->answer.i_body_offset = i_offset;
 
-                    if (cl->query.i_proto != HTTPD_PROTO_HTTP
-                     || cl->query.i_version > 0)
-                    {
-                        const char *psz_connection = httpd_MsgGet(&cl->answer,
-                                                                 "Connection");
-                        if (psz_connection != NULL)
-                            do_close = !strcasecmp(psz_connection, "close");
-                    }
-                    else
-                        do_close = true;
-
-                    if (!do_close) {
-                        httpd_MsgClean(&cl->query);
-                        httpd_MsgInit(&cl->query);
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free(cl->p_buffer);
-                        // Allocate an extra byte for the null terminating byte
-                        cl->p_buffer = xmalloc(cl->i_buffer_size + 1);
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    } else
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    httpd_MsgClean(&cl->answer);
-                } else {
-                    i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean(&cl->answer);
+            cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                    &cl->answer, &cl->query);
+            if (cl->answer.i_type != HTTPD_MSG_NONE) {
+                /* we have new data, so re-enter send mode */
+                cl->i_buffer      = 0;
+                cl->p_buffer      = cl->answer.p_body;
+                cl->i_buffer_size = cl->answer.i_body;
+                cl->answer.p_body = NULL;
+                cl->answer.i_body = 0;
+                cl->i_state = HTTPD_CLIENT_SENDING;
+            }
+    }
 
-                    cl->answer.i_body_offset = i_offset;
-                    free(cl->p_buffer);
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
+    *fd = vlc_tls_GetPollFD(cl->sock, &events);
+    return events;
+}
 
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
-                break;
+static void httpd_ClientProcess(httpd_host_t *host, httpd_client_t *cl,
+                                vlc_tick_t now)
+{
+    cl->i_activity_date = now;
 
-            case HTTPD_CLIENT_WAITING:
-                i_offset = cl->answer.i_body_offset;
-                int i_msg = cl->query.i_type;
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
+        case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
+        case HTTPD_CLIENT_TLS_HS_IN:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            httpd_ClientTlsHandshake(host, cl);
+            break;
+    }
+}
 
-                httpd_MsgInit(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
+static void httpd_HostAccept(httpd_host_t *host, int fd, vlc_tick_t now)
+{
+    fd = vlc_accept (fd, NULL, NULL, true);
+    if (fd == -1)
+        return;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+            &(int){ 1 }, sizeof(int));
 
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                        &cl->answer, &cl->query);
-                if (cl->answer.i_type != HTTPD_MSG_NONE) {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
+    vlc_tls_t *sk = vlc_tls_SocketOpen(fd);
+    if (unlikely(sk == NULL))
+    {
+        vlc_close(fd);
+        return;
+    }
+
+    if (host->p_tls != NULL)
+    {
+        const char *alpn[] = { "http/1.1", NULL };
+        vlc_tls_t *tls;
+
+        tls = vlc_tls_ServerSessionCreate(host->p_tls, sk, alpn);
+        if (tls == NULL)
+        {
+            vlc_tls_SessionDelete(sk);
+            return;
+        }
+        sk = tls;
+    }
+
+    httpd_client_t *cl = httpd_ClientNew(sk, now);
+
+    if (host->p_tls != NULL)
+        cl->i_state = HTTPD_CLIENT_TLS_HS_OUT;
+
+    host->client_count++;
+    vlc_list_append(&cl->node, &host->clients);
+#ifdef HAVE_SYS_EPOLL_H
+    httpd_ClientActivate(host, cl);
+#endif
+}
+
+static void httpd_HostWaitUrls(httpd_host_t *host)
+{
+    while (vlc_list_is_empty(&host->urls)) {
+        mutex_cleanup_push(&host->lock);
+        vlc_cond_wait(&host->wait, &host->lock);
+        vlc_cleanup_pop();
+    }
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/* Updates the persistent epoll registration of a client.
+ * Returns 0 on success, or -1 if the registration was left unchanged. */
+static int httpd_ClientPoll(httpd_host_t *host, httpd_client_t *cl,
+                            int fd, short events)
+{
+    if (events == cl->i_poll_events)
+        return 0;
+
+    struct epoll_event ev = {
+        .events = ((events & POLLIN) ? EPOLLIN : 0)
+                | ((events & POLLOUT) ? EPOLLOUT : 0),
+        .data.ptr = &cl->poll_ref,
+    };
+    int op;
+
+    if (events == 0)
+        op = EPOLL_CTL_DEL;
+    else if (cl->i_poll_events == 0)
+        op = EPOLL_CTL_ADD;
+    else
+        op = EPOLL_CTL_MOD;
+
+    if (epoll_ctl(host->epfd, op, fd, &ev)) {
+        msg_Err(host, "cannot update client polling: %s",
+                vlc_strerror_c(errno));
+        return -1;
+    }
+    cl->i_poll_events = events;
+    return 0;
+}
+
+static void httpd_ClientUnpoll(httpd_host_t *host, httpd_client_t *cl)
+{
+    if (cl->i_poll_events != 0)
+        httpd_ClientPoll(host, cl, vlc_tls_GetFD(cl->sock), 0);
+}
+
+/* Queues a client for its poll events to be recomputed */
+static void httpd_ClientActivate(httpd_host_t *host, httpd_client_t *cl)
+{
+    if (cl->b_active)
+        return;
+    vlc_list_append(&cl->active_node, &host->active);
+    cl->b_active = true;
+}
+
+/* Only the clients that were just accepted, that received events, that
+ * wait for stream data or that were closed are visited on each iteration.
+ * The others are checked for their activity timeout every second. */
+static void httpdLoop(httpd_host_t *host)
+{
+    struct epoll_event ev[HTTPD_MAX_EVENTS];
+
+    vlc_mutex_lock(&host->lock);
+    httpd_HostWaitUrls(host);
+
+    vlc_tick_t now = vlc_tick_now();
+    bool b_low_delay = false;
+    httpd_client_t *cl;
+
+    int canc = vlc_savecancel();
+    if (now >= host->i_timeout_scan) {
+        vlc_list_foreach(cl, &host->clients, node)
+            if (cl->i_activity_timeout > 0
+             && cl->i_activity_date + cl->i_activity_timeout < now) {
+                cl->i_state = HTTPD_CLIENT_DEAD;
+                httpd_ClientActivate(host, cl);
+            }
+        host->i_timeout_scan = now + HTTPD_TIMEOUT_SCAN;
+    }
+
+    vlc_list_foreach(cl, &host->active, active_node) {
+        if (cl->i_state != HTTPD_CLIENT_DEAD) {
+            int fd;
+            short events = httpd_ClientPrepare(host, cl, &fd);
+
+            if (httpd_ClientPoll(host, cl, fd, events) == 0) {
+                if (events == 0) {
+                    /* waiting for stream data: check again after a short
+                     * delay */
+                    b_low_delay = true;
+                    continue;
                 }
+                vlc_list_remove(&cl->active_node);
+                cl->b_active = false;
+                continue;
+            }
+
+            /* The client would never be woken up again: close it */
+            cl->i_state = HTTPD_CLIENT_DEAD;
         }
 
-        pufd->fd = vlc_tls_GetPollFD(cl->sock, &pufd->events);
+        if (cl->sock != NULL)
+            httpd_ClientUnpoll(host, cl);
+        vlc_list_remove(&cl->active_node);
+        host->client_count--;
+        httpd_ClientDestroy(cl);
+    }
+    vlc_mutex_unlock(&host->lock);
+    vlc_restorecancel(canc);
+
+    /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING.
+     * Sleep in poll() rather than epoll_wait(): it is the cancellation
+     * point that vlc_poll() emulates where threads cannot be cancelled
+     * while blocked in a system call (Android). */
+    struct pollfd ufd = { .fd = host->epfd, .events = POLLIN };
+    int n;
+    while (poll(&ufd, 1, b_low_delay ? 20 : -1) < 0)
+    {
+        if (errno != EINTR)
+            msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+    }
+
+    while ((n = epoll_wait(host->epfd, ev, ARRAY_SIZE(ev), 0)) < 0)
+    {
+        if (errno != EINTR) {
+            msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+            n = 0;
+            break;
+        }
+    }
+
+    canc = vlc_savecancel();
+    vlc_mutex_lock(&host->lock);
+
+    now = vlc_tick_now();
+
+    for (int i = 0; i < n; i++) {
+        struct httpd_poll_ref *ref = ev[i].data.ptr;
+
+        if (ref->kind == HTTPD_POLL_LISTEN) {
+            /* Handle server sockets (accept new connections) */
+            httpd_HostAccept(host, ref->fd, now);
+            continue;
+        }
+
+        /* Dead clients are only freed at the beginning of the loop, so
+         * pending events can still refer to them safely. */
+        cl = container_of(ref, httpd_client_t, poll_ref);
+        if (cl->i_state == HTTPD_CLIENT_DEAD)
+            continue;
+
+        httpd_ClientProcess(host, cl, now);
+        httpd_ClientActivate(host, cl);
+    }
+
+    vlc_mutex_unlock(&host->lock);
+    vlc_restorecancel(canc);
+}
+#else
+static void httpdLoop(httpd_host_t *host)
+{
+    struct pollfd ufd[host->nfd + host->client_count];
+    unsigned nfd;
+    for (nfd = 0; nfd < host->nfd; nfd++) {
+        ufd[nfd].fd = host->fds[nfd];
+        ufd[nfd].events = POLLIN;
+        ufd[nfd].revents = 0;
+    }
+
+    vlc_mutex_lock(&host->lock);
+    /* add all socket that should be read/write and close dead connection */
+    httpd_HostWaitUrls(host);
+
+    vlc_tick_t now = vlc_tick_now();
+    bool b_low_delay = false;
+    httpd_client_t *cl;
+
+    int canc = vlc_savecancel();
+    vlc_list_foreach(cl, &host->clients, node) {
+        if (cl->i_state == HTTPD_CLIENT_DEAD
+         || (cl->i_activity_timeout > 0
+          && cl->i_activity_date + cl->i_activity_timeout < now)) {
+            host->client_count--;
+            httpd_ClientDestroy(cl);
+            continue;
+        }
+
+        struct pollfd *pufd = ufd + nfd;
+        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
+
+        pufd->revents = 0;
+        pufd->events = httpd_ClientPrepare(host, cl, &pufd->fd);
 
         if (pufd->events != 0)
             nfd++;
@@ -1959,67 +2399,23 @@ static void httpdLoop(httpd_host_t *host)
         if (pufd->revents == 0)
             continue; // no event received
 
-        cl->i_activity_date = now;
-
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
-            case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
-            case HTTPD_CLIENT_TLS_HS_IN:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                httpd_ClientTlsHandshake(host, cl);
-                break;
-        }
+        httpd_ClientProcess(host, cl, now);
     }
 
     /* Handle server sockets (accept new connections) */
     for (nfd = 0; nfd < host->nfd; nfd++) {
-        int fd = ufd[nfd].fd;
-
-        assert (fd == host->fds[nfd]);
+        assert (ufd[nfd].fd == host->fds[nfd]);
 
         if (ufd[nfd].revents == 0)
             continue;
 
-        /* */
-        fd = vlc_accept (fd, NULL, NULL, true);
-        if (fd == -1)
-            continue;
-        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                &(int){ 1 }, sizeof(int));
-
-        vlc_tls_t *sk = vlc_tls_SocketOpen(fd);
-        if (unlikely(sk == NULL))
-        {
-            vlc_close(fd);
-            continue;
-        }
-
-        if (host->p_tls != NULL)
-        {
-            const char *alpn[] = { "http/1.1", NULL };
-            vlc_tls_t *tls;
-
-            tls = vlc_tls_ServerSessionCreate(host->p_tls, sk, alpn);
-            if (tls == NULL)
-            {
-                vlc_tls_SessionDelete(sk);
-                continue;
-            }
-            sk = tls;
-        }
-
-        cl = httpd_ClientNew(sk, now);
-
-        if (host->p_tls != NULL)
-            cl->i_state = HTTPD_CLIENT_TLS_HS_OUT;
-
-        host->client_count++;
-        vlc_list_append(&cl->node, &host->clients);
+        httpd_HostAccept(host, ufd[nfd].fd, now);
     }
 
     vlc_mutex_unlock(&host->lock);
     vlc_restorecancel(canc);
 }
+#endif
 
 static void* httpd_HostThread(void *data)
 {
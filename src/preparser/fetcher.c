@@ -189,6 +189,14 @@ static int SearchArt( input_fetcher_t* fetcher, input_item_t* item, int scope)
     return CheckArt( item );
 }
 
+static enum background_worker_priority
+RequestPriority( const struct fetcher_request* req )
+{
+    return req->options & META_REQUEST_OPTION_DO_INTERACT
+         ? BACKGROUND_WORKER_PRIORITY_INTERACTIVE
+         : BACKGROUND_WORKER_PRIORITY_BULK;
+}
+
 static int SearchByScope( input_fetcher_t* fetcher,
     struct fetcher_request* req, int scope )
 {
@@ -207,7 +215,8 @@ static int SearchByScope( input_fetcher_t* fetcher,
         ! SearchArt( fetcher, item, scope ) )
     {
         AddAlbumCache( fetcher, req->item, false );
-        if( !background_worker_Push( fetcher->downloader, req, NULL, 0 ) )
+        if( !background_worker_Push( fetcher->downloader, req, NULL, 0,
+                                     RequestPriority( req ) ) )
             return VLC_SUCCESS;
     }
 
@@ -294,7 +303,8 @@ static void SearchLocal( input_fetcher_t* fetcher, struct fetcher_request* req )
     if( var_InheritBool( fetcher->owner, "metadata-network-access" ) ||
         req->options & META_REQUEST_OPTION_SCOPE_NETWORK )
     {
-        if( background_worker_Push( fetcher->network, req, NULL, 0 ) )
+        if( background_worker_Push( fetcher->network, req, NULL, 0,
+                                    RequestPriority( req ) ) )
             NotifyArtFetchEnded(req, false);
     }
     else
@@ -462,7 +472,8 @@ int input_fetcher_Push( input_fetcher_t* fetcher, input_item_t* item,
     vlc_atomic_rc_init( &req->rc );
     input_item_Hold( item );
 
-    if( background_worker_Push( fetcher->local, req, NULL, 0 ) )
+    if( background_worker_Push( fetcher->local, req, NULL, 0,
+                                RequestPriority( req ) ) )
         NotifyArtFetchEnded(req, false);
 
     RequestRelease( req );
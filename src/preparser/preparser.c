@@ -42,6 +42,7 @@ struct input_preparser_t
 typedef struct input_preparser_req_t
 {
     input_item_t *item;
+    input_item_meta_request_option_t options;
     const input_preparser_callbacks_t *cbs;
     void *userdata;
     vlc_atomic_rc_t rc;
@@ -58,6 +59,7 @@ typedef struct input_preparser_task_t
 } input_preparser_task_t;
 
 static input_preparser_req_t *ReqCreate(input_item_t *item,
+                                        input_item_meta_request_option_t options,
                                         const input_preparser_callbacks_t *cbs,
                                         void *userdata)
 {
@@ -66,6 +68,7 @@ static input_preparser_req_t *ReqCreate(input_item_t *item,
         return NULL;
 
     req->item = item;
+    req->options = options;
     req->cbs = cbs;
     req->userdata = userdata;
     vlc_atomic_rc_init(&req->rc);
@@ -209,12 +212,12 @@ static void PreparserCloseInput( void* preparser_, void* task_ )
     if( preparser->fetcher )
     {
         task->preparse_status = status;
-        if (!input_fetcher_Push(preparser->fetcher, item, 0,
+        /* The fetcher may end, and release the request, before returning */
+        ReqHold(req);
+        if (!input_fetcher_Push(preparser->fetcher, item, req->options,
                                &input_fetcher_callbacks, task))
-        {
-            ReqHold(task->req);
             return;
-        }
+        ReqRelease(req);
     }
 
     free(task);
@@ -289,9 +292,16 @@ void input_preparser_Push( input_preparser_t *preparser,
             return;
     }
 
-    struct input_preparser_req_t *req = ReqCreate(item, cbs, cbs_userdata);
+    /* Only the priority class carries over to the art fetch */
+    struct input_preparser_req_t *req =
+        ReqCreate(item, i_options & META_REQUEST_OPTION_DO_INTERACT,
+                  cbs, cbs_userdata);
+    enum background_worker_priority priority =
+        i_options & META_REQUEST_OPTION_DO_INTERACT
+            ? BACKGROUND_WORKER_PRIORITY_INTERACTIVE
+            : BACKGROUND_WORKER_PRIORITY_BULK;
 
-    if (background_worker_Push(preparser->worker, req, id, timeout))
+    if (background_worker_Push(preparser->worker, req, id, timeout, priority))
         if (req->cbs && cbs->on_preparse_ended)
             cbs->on_preparse_ended(item, ITEM_PREPARSE_FAILED, cbs_userdata);
 
@@ -0,0 +1,144 @@
+/*****************************************************************************
+ * aout_filters_pool.c: test cases for the audio filters output buffers
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#include "../audio_output/filters_pool.h"
+
+static block_t *get(aout_filters_pool_t *pool, size_t size)
+{
+    block_t *block = aout_filters_pool_Get(pool, size);
+
+    assert(block != NULL);
+    assert(block->i_buffer == size);
+    assert(block->i_size >= size && block->i_size >= AOUT_POOL_MIN_SIZE);
+    assert(((uintptr_t)block->p_buffer % AOUT_POOL_ALIGN) == 0);
+    assert(block->p_next == NULL && block->i_flags == 0);
+    /* The whole buffer is writable */
+    memset(block->p_buffer, 0x5a, block->i_size);
+    return block;
+}
+
+static void test_reuse(void)
+{
+    aout_filters_pool_t *pool = aout_filters_pool_New();
+    assert(pool != NULL);
+
+    /* Steady state: the released buffer is handed out again */
+    block_t *a = get(pool, 1000);
+    block_t *b = get(pool, 1000);
+    assert(aout_filters_pool_Allocs(pool) == 2);
+
+    a->i_pts = 42;
+    a->i_flags = BLOCK_FLAG_DISCONTINUITY;
+    block_Release(a);
+    block_t *c = get(pool, 2000);
+    assert(c == a);
+    assert(c->i_pts == VLC_TICK_INVALID);
+    block_Release(b);
+    block_Release(c);
+
+    /* Last released first */
+    c = get(pool, 3000);
+    assert(c == a);
+    block_Release(c);
+    assert(aout_filters_pool_Allocs(pool) == 2);
+
+    /* A larger buffer is allocated, and can then serve smaller requests */
+    block_t *big = get(pool, 3 * AOUT_POOL_MIN_SIZE);
+    assert(big != a && big != b);
+    assert(big->i_size == 4 * AOUT_POOL_MIN_SIZE);
+    assert(aout_filters_pool_Allocs(pool) == 3);
+    block_Release(big);
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        block_t *small = get(pool, 100);
+        block_Release(small);
+    }
+    c = get(pool, 3 * AOUT_POOL_MIN_SIZE);
+    assert(c == big);
+    block_Release(c);
+    assert(aout_filters_pool_Allocs(pool) == 3);
+
+    aout_filters_pool_Release(pool);
+}
+
+static void test_full(void)
+{
+    aout_filters_pool_t *pool = aout_filters_pool_New();
+    block_t *blocks[AOUT_POOL_DEPTH + 4];
+
+    assert(pool != NULL);
+    for (size_t i = 0; i < ARRAY_SIZE(blocks); i++)
+        blocks[i] = get(pool, 1000);
+    assert(aout_filters_pool_Allocs(pool) == ARRAY_SIZE(blocks));
+
+    /* Only AOUT_POOL_DEPTH buffers are kept, the others are freed */
+    for (size_t i = 0; i < ARRAY_SIZE(blocks); i++)
+        block_Release(blocks[i]);
+    for (size_t i = 0; i < ARRAY_SIZE(blocks); i++)
+        blocks[i] = get(pool, 1000);
+    assert(aout_filters_pool_Allocs(pool)
+           == ARRAY_SIZE(blocks) + ARRAY_SIZE(blocks) - AOUT_POOL_DEPTH);
+
+    for (size_t i = 0; i < ARRAY_SIZE(blocks); i++)
+        block_Release(blocks[i]);
+    aout_filters_pool_Release(pool);
+}
+
+static void test_dead(void)
+{
+    aout_filters_pool_t *pool = aout_filters_pool_New();
+    assert(pool != NULL);
+
+    block_t *recycled = get(pool, 1000);
+    block_Release(recycled);
+
+    /* The buffers in use outlive the pipeline reference */
+    block_t *a = get(pool, 1000);
+    block_t *b = get(pool, 1000);
+    assert(a == recycled);
+    aout_filters_pool_Release(pool);
+
+    memset(a->p_buffer, 0xa5, a->i_size);
+    memset(b->p_buffer, 0xa5, b->i_size);
+    block_Release(a);
+    /* The last buffer destroys the pool */
+    block_Release(b);
+}
+
+int main(void)
+{
+    test_reuse();
+    test_full();
+    test_dead();
+    return 0;
+}
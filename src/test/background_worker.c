@@ -0,0 +1,306 @@
+/*****************************************************************************
+ * background_worker.c: test cases for the background worker
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_threads.h>
+
+#include "../libvlc.h"
+#include "../misc/background_worker.h"
+
+/* vlc_clone_detach() is private to libvlccore: the worker threads are
+ * recorded here instead, and joined once the worker is deleted. */
+#define MAX_THREADS 8
+
+static vlc_thread_t threads[MAX_THREADS];
+static unsigned spawned;
+
+int vlc_clone_detach(vlc_thread_t *th, void *(*entry)(void *), void *data,
+                     int priority)
+{
+    (void) th; (void) priority;
+    assert(spawned < MAX_THREADS);
+    /* Only background_worker_Push() spawns threads, from the main thread */
+    int ret = vlc_clone(&threads[spawned], entry, data, VLC_THREAD_PRIORITY_LOW);
+    if (ret == 0)
+        spawned++;
+    return ret;
+}
+
+static void join_threads(void)
+{
+    for (unsigned i = 0; i < spawned; i++)
+        vlc_join(threads[i], NULL);
+    spawned = 0;
+}
+
+static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+static vlc_cond_t cond;
+
+struct item
+{
+    unsigned index;
+    unsigned refs;
+    bool started;
+    bool done;
+    bool stopped;
+};
+
+#define ITEMS 200 /* more than there are id buckets */
+
+static struct item items[ITEMS];
+static unsigned order[ITEMS];
+static unsigned started;
+
+static void Hold(void *entity)
+{
+    struct item *item = entity;
+
+    vlc_mutex_lock(&lock);
+    item->refs++;
+    vlc_mutex_unlock(&lock);
+}
+
+static void Release(void *entity)
+{
+    struct item *item = entity;
+
+    vlc_mutex_lock(&lock);
+    assert(item->refs > 0);
+    item->refs--;
+    vlc_cond_broadcast(&cond);
+    vlc_mutex_unlock(&lock);
+}
+
+static int Start(void *owner, void *entity, void **out)
+{
+    struct item *item = entity;
+
+    (void) owner;
+    vlc_mutex_lock(&lock);
+    assert(!item->started);
+    item->started = true;
+    order[started++] = item->index;
+    vlc_cond_broadcast(&cond);
+    vlc_mutex_unlock(&lock);
+    *out = item;
+    return VLC_SUCCESS;
+}
+
+static int Probe(void *owner, void *handle)
+{
+    struct item *item = handle;
+
+    (void) owner;
+    vlc_mutex_lock(&lock);
+    bool done = item->done;
+    vlc_mutex_unlock(&lock);
+    return done;
+}
+
+static void Stop(void *owner, void *handle)
+{
+    struct item *item = handle;
+
+    (void) owner;
+    vlc_mutex_lock(&lock);
+    item->stopped = true;
+    vlc_mutex_unlock(&lock);
+}
+
+static struct background_worker *create(int max_threads)
+{
+    struct background_worker_config conf = {
+        .default_timeout = -1,
+        .max_threads = max_threads,
+        .pf_release = Release,
+        .pf_hold = Hold,
+        .pf_start = Start,
+        .pf_probe = Probe,
+        .pf_stop = Stop,
+    };
+
+    for (unsigned i = 0; i < ITEMS; i++)
+        items[i] = (struct item) { .index = i };
+    started = 0;
+
+    struct background_worker *worker = background_worker_New(NULL, &conf);
+    assert(worker != NULL);
+    return worker;
+}
+
+static void push(struct background_worker *worker, unsigned i,
+                 enum background_worker_priority priority)
+{
+    assert(background_worker_Push(worker, &items[i], &items[i], 0,
+                                  priority) == VLC_SUCCESS);
+}
+
+/* Fails rather than hangs if the task is never started */
+static void wait_started(unsigned i)
+{
+    vlc_tick_t deadline = vlc_tick_now() + VLC_TICK_FROM_SEC(5);
+
+    vlc_mutex_lock(&lock);
+    while (!items[i].started)
+        assert(vlc_cond_timedwait(&cond, &lock, deadline) == 0);
+    vlc_mutex_unlock(&lock);
+}
+
+/* Waits until the task is over and its entity released */
+static void wait_released(unsigned i)
+{
+    vlc_mutex_lock(&lock);
+    while (items[i].refs > 0)
+        vlc_cond_wait(&cond, &lock);
+    vlc_mutex_unlock(&lock);
+}
+
+static void finish(struct background_worker *worker, unsigned i)
+{
+    vlc_mutex_lock(&lock);
+    items[i].done = true;
+    vlc_mutex_unlock(&lock);
+    background_worker_RequestProbe(worker);
+    wait_released(i);
+    assert(items[i].stopped);
+}
+
+static void test_priority(void)
+{
+    struct background_worker *worker = create(1);
+
+    /* A long bulk task occupies the only thread */
+    push(worker, 0, BACKGROUND_WORKER_PRIORITY_BULK);
+    wait_started(0);
+
+    /* An interactive task does not wait for it */
+    push(worker, 1, BACKGROUND_WORKER_PRIORITY_BULK);
+    push(worker, 2, BACKGROUND_WORKER_PRIORITY_INTERACTIVE);
+    wait_started(2);
+
+    /* Queued interactive tasks go before earlier bulk ones */
+    push(worker, 3, BACKGROUND_WORKER_PRIORITY_INTERACTIVE);
+    push(worker, 4, BACKGROUND_WORKER_PRIORITY_INTERACTIVE);
+    finish(worker, 2);
+    wait_started(3);
+    finish(worker, 3);
+    wait_started(4);
+    finish(worker, 4);
+
+    /* The extra thread never runs a bulk task */
+    vlc_tick_t deadline = vlc_tick_now() + VLC_TICK_FROM_MS(100);
+
+    vlc_mutex_lock(&lock);
+    while (!items[1].started
+        && vlc_cond_timedwait(&cond, &lock, deadline) == 0);
+    assert(!items[1].started);
+    vlc_mutex_unlock(&lock);
+
+    push(worker, 5, BACKGROUND_WORKER_PRIORITY_INTERACTIVE);
+    wait_started(5);
+    finish(worker, 5);
+    finish(worker, 0);
+    wait_started(1);
+    finish(worker, 1);
+
+    static const unsigned expected[] = { 0, 2, 3, 4, 5, 1 };
+    assert(started == ARRAY_SIZE(expected));
+    for (unsigned i = 0; i < ARRAY_SIZE(expected); i++)
+        assert(order[i] == expected[i]);
+    assert(spawned == 2);
+
+    background_worker_Delete(worker);
+    join_threads();
+}
+
+static void test_cancel(void)
+{
+    struct background_worker *worker = create(1);
+
+    push(worker, 0, BACKGROUND_WORKER_PRIORITY_BULK);
+    wait_started(0);
+
+    for (unsigned i = 1; i < ITEMS; i++)
+        push(worker, i, (i % 3) ? BACKGROUND_WORKER_PRIORITY_BULK
+                                : BACKGROUND_WORKER_PRIORITY_INTERACTIVE);
+
+    /* Cancelled queued tasks are released at once, and only them */
+    for (unsigned i = 2; i < ITEMS; i += 2)
+        background_worker_Cancel(worker, &items[i]);
+
+    vlc_mutex_lock(&lock);
+    for (unsigned i = 1; i < ITEMS; i++)
+    {
+        assert(items[i].refs == (i & 1));
+        assert(!items[i].started || i % 3 == 0);
+    }
+    vlc_mutex_unlock(&lock);
+
+    /* Cancelling the running task stops it */
+    background_worker_Cancel(worker, &items[0]);
+    wait_released(0);
+    assert(items[0].stopped && !items[0].done);
+
+    /* The others run, interactive ones first, each class in order */
+    for (unsigned i = 3; i < ITEMS; i += 6)
+    {
+        wait_started(i);
+        finish(worker, i);
+    }
+    for (unsigned i = 1; i < ITEMS; i += 2)
+        if (i % 3)
+        {
+            wait_started(i);
+            finish(worker, i);
+        }
+
+    vlc_mutex_lock(&lock);
+    assert(started == 1 + ITEMS / 2);
+    unsigned n = 1;
+    for (unsigned i = 3; i < ITEMS; i += 6)
+        assert(order[n++] == i);
+    for (unsigned i = 1; i < ITEMS; i += 2)
+        if (i % 3)
+            assert(order[n++] == i);
+    assert(n == started);
+    vlc_mutex_unlock(&lock);
+
+    background_worker_Delete(worker);
+    join_threads();
+}
+
+int main(void)
+{
+    vlc_cond_init(&cond);
+
+    test_priority();
+    test_cancel();
+
+    vlc_cond_destroy(&cond);
+    return 0;
+}
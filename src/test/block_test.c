@@ -86,11 +86,125 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void test_block_pool (void)
+{
+    struct vlc_block_pool_stats before, after;
+
+    block_PoolGetStats (&before);
+
+    /* A released small block is reused by the next allocation of the same
+     * size class on the same thread */
+    block_t *block = block_Alloc (188);
+    assert (block != NULL);
+    assert (block->i_buffer == 188);
+    assert (((uintptr_t)block->p_buffer % 32) == 0);
+    memset (block->p_buffer, 0x47, block->i_buffer);
+
+    block_t *other = block_Alloc (1316);
+    assert (other != NULL && other != block);
+    block_Release (other);
+
+    void *p = block;
+    block_Release (block);
+
+    block = block_Alloc (200);
+    assert (block != NULL);
+    assert ((void *)block == p);
+    assert (block->i_buffer == 200);
+    assert (block->i_flags == 0 && block->p_next == NULL);
+
+    /* The recycled block can still grow within its buffer */
+    block = block_Realloc (block, 16, 300);
+    assert (block != NULL);
+    block_Release (block);
+
+    /* Large blocks are not pooled */
+    block = block_Alloc (1 << 20);
+    assert (block != NULL);
+    block_Release (block);
+
+    block_PoolGetStats (&after);
+    assert (after.allocs >= before.allocs + 3);
+    assert (after.hits >= before.hits + 1);
+    assert (after.releases >= before.releases + 3);
+    assert (after.recycled >= before.recycled + 3);
+}
+
+#define PIPE_BLOCKS 20000
+#define PIPE_DEPTH  32
+
+/* Blocks allocated by one thread and released by another, as from a
+ * demuxer to a decoder, with a bounded queue in between */
+struct pipe_test
+{
+    vlc_fifo_t *fifo;
+    vlc_cond_t space;
+};
+
+static void *test_block_pipe_producer (void *data)
+{
+    struct pipe_test *pipe = data;
+    static const size_t sizes[] = { 188, 1316, 188 * 7 * 4 };
+
+    for (unsigned i = 0; i < PIPE_BLOCKS; i++)
+    {
+        block_t *block = block_Alloc (sizes[i % ARRAY_SIZE(sizes)]);
+        assert (block != NULL);
+
+        vlc_fifo_Lock (pipe->fifo);
+        while (vlc_fifo_GetCount (pipe->fifo) >= PIPE_DEPTH)
+            vlc_fifo_WaitCond (pipe->fifo, &pipe->space);
+        vlc_fifo_QueueUnlocked (pipe->fifo, block);
+        vlc_fifo_Unlock (pipe->fifo);
+    }
+    return NULL;
+}
+
+static void test_block_pipe (void)
+{
+    struct vlc_block_pool_stats before, after;
+    struct pipe_test pipe;
+    vlc_thread_t th;
+
+    pipe.fifo = block_FifoNew ();
+    assert (pipe.fifo != NULL);
+    vlc_cond_init (&pipe.space);
+
+    block_PoolGetStats (&before);
+    assert (vlc_clone (&th, test_block_pipe_producer, &pipe,
+                       VLC_THREAD_PRIORITY_LOW) == 0);
+
+    for (unsigned i = 0; i < PIPE_BLOCKS; i++)
+    {
+        vlc_fifo_Lock (pipe.fifo);
+        while (vlc_fifo_IsEmpty (pipe.fifo))
+            vlc_fifo_Wait (pipe.fifo);
+        block_t *block = vlc_fifo_DequeueUnlocked (pipe.fifo);
+        vlc_cond_signal (&pipe.space);
+        vlc_fifo_Unlock (pipe.fifo);
+        block_Release (block);
+    }
+
+    vlc_join (th, NULL);
+    block_PoolGetStats (&after);
+
+    /* The released blocks must find their way back to the producer */
+    uint64_t allocs = after.allocs - before.allocs;
+    uint64_t hits = after.hits - before.hits;
+    assert (allocs == PIPE_BLOCKS);
+    assert (hits * 10 >= allocs * 9);
+
+    vlc_cond_destroy (&pipe.space);
+    block_FifoRelease (pipe.fifo);
+}
+
 int main (void)
 {
     test_block_File(false);
     test_block_File(true);
     test_block ();
+    test_block_pool ();
+    test_block_pipe ();
     return 0;
 }
 
@@ -0,0 +1,382 @@
+/*****************************************************************************
+ * decoder_pool.c: test cases for the shared decoder threads pool
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_threads.h>
+
+#include "../libvlc.h"
+#include "../input/decoder_pool.h"
+
+/* vlc_clone_detach() is private to libvlccore: the pool threads are
+ * recorded here instead, with their priority, and joined at the end. */
+#define MAX_THREADS 32
+
+static vlc_mutex_t threads_lock = VLC_STATIC_MUTEX;
+static vlc_thread_t threads[MAX_THREADS];
+static int priorities[MAX_THREADS];
+static unsigned spawned;
+static bool spawn_fails;
+
+int vlc_clone_detach(vlc_thread_t *th, void *(*entry)(void *), void *data,
+                     int priority)
+{
+    int ret;
+
+    (void) th;
+    vlc_mutex_lock(&threads_lock);
+    assert(spawned < MAX_THREADS);
+    if (spawn_fails)
+        ret = EAGAIN;
+    else
+        ret = vlc_clone(&threads[spawned], entry, data,
+                        VLC_THREAD_PRIORITY_LOW);
+    if (ret == 0)
+        priorities[spawned++] = priority;
+    vlc_mutex_unlock(&threads_lock);
+    return ret;
+}
+
+static void set_spawn_fails(bool fails)
+{
+    vlc_mutex_lock(&threads_lock);
+    spawn_fails = fails;
+    vlc_mutex_unlock(&threads_lock);
+}
+
+static unsigned spawned_since(unsigned start, int priority)
+{
+    unsigned count = 0;
+
+    vlc_mutex_lock(&threads_lock);
+    for (unsigned i = start; i < spawned; i++)
+    {
+        assert(priorities[i] == priority);
+        count++;
+    }
+    vlc_mutex_unlock(&threads_lock);
+    return count;
+}
+
+static unsigned spawned_count(void)
+{
+    vlc_mutex_lock(&threads_lock);
+    unsigned count = spawned;
+    vlc_mutex_unlock(&threads_lock);
+    return count;
+}
+
+static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+static vlc_cond_t cond;
+
+struct task
+{
+    struct vlc_decoder_task task;
+    struct vlc_decoder_pool *pool;
+    unsigned runs;
+    bool blocking;
+};
+
+static unsigned running, expected;
+static bool released;
+
+/* Runs until the expected number of tasks run concurrently */
+static bool RunConcurrent(struct vlc_decoder_task *t)
+{
+    struct task *task = container_of(t, struct task, task);
+
+    vlc_mutex_lock(&lock);
+    task->runs++;
+    running++;
+    vlc_cond_broadcast(&cond);
+    while (running < expected)
+        vlc_cond_wait(&cond, &lock);
+    vlc_mutex_unlock(&lock);
+    return false;
+}
+
+/* Waits for the main thread, as a blocked task or not */
+static bool RunWait(struct vlc_decoder_task *t)
+{
+    struct task *task = container_of(t, struct task, task);
+
+    if (task->blocking)
+        vlc_decoder_pool_BlockBegin(task->pool);
+    vlc_mutex_lock(&lock);
+    task->runs++;
+    running++;
+    vlc_cond_broadcast(&cond);
+    while (!released)
+        vlc_cond_wait(&cond, &lock);
+    running--;
+    vlc_mutex_unlock(&lock);
+    if (task->blocking)
+        vlc_decoder_pool_BlockEnd(task->pool);
+    return false;
+}
+
+static bool RunCount(struct vlc_decoder_task *t)
+{
+    struct task *task = container_of(t, struct task, task);
+
+    vlc_mutex_lock(&lock);
+    task->runs++;
+    vlc_cond_broadcast(&cond);
+    vlc_mutex_unlock(&lock);
+    return false;
+}
+
+static void wait_runs(struct task *task, unsigned runs)
+{
+    vlc_mutex_lock(&lock);
+    while (task->runs < runs)
+        vlc_cond_wait(&cond, &lock);
+    vlc_mutex_unlock(&lock);
+}
+
+static void wait_running(unsigned count)
+{
+    vlc_mutex_lock(&lock);
+    while (running < count)
+        vlc_cond_wait(&cond, &lock);
+    vlc_mutex_unlock(&lock);
+}
+
+static void release(void)
+{
+    vlc_mutex_lock(&lock);
+    released = true;
+    vlc_cond_broadcast(&cond);
+    vlc_mutex_unlock(&lock);
+}
+
+static void test_hold(void)
+{
+    unsigned start = spawned_count();
+    struct vlc_decoder_pool *a = vlc_decoder_pool_Hold(1, 1);
+    struct vlc_decoder_pool *b = vlc_decoder_pool_Hold(1, 3);
+
+    assert(a != NULL);
+    assert(a == b);
+    /* A pool starts with one thread, with the priority of the pool */
+    assert(spawned_since(start, 1) == 1);
+
+    start = spawned_count();
+    struct vlc_decoder_pool *c = vlc_decoder_pool_Hold(2, 1);
+
+    assert(c != NULL);
+    assert(a != c);
+    assert(spawned_since(start, 2) == 1);
+
+    /* The second holder raised the limit: three tasks run at once */
+    struct task tasks[3];
+
+    start = spawned_count();
+    running = 0;
+    expected = 3;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        tasks[i].runs = 0;
+        vlc_decoder_task_Init(&tasks[i].task, RunConcurrent);
+        vlc_decoder_pool_Wake(a, &tasks[i].task);
+    }
+    for (unsigned i = 0; i < 3; i++)
+    {
+        wait_runs(&tasks[i], 1);
+        vlc_decoder_pool_Remove(a, &tasks[i].task);
+    }
+    /* The extra threads run with the priority of their pool */
+    assert(spawned_since(start, 1) == 2);
+
+    /* The other pool is unaffected, and its thread runs the task */
+    struct task task = { .runs = 0 };
+
+    start = spawned_count();
+    vlc_decoder_task_Init(&task.task, RunCount);
+    vlc_decoder_pool_Wake(c, &task.task);
+    wait_runs(&task, 1);
+    vlc_decoder_pool_Remove(c, &task.task);
+    assert(spawned_since(start, 2) == 0);
+
+    vlc_decoder_pool_Release(c);
+    vlc_decoder_pool_Release(b);
+    vlc_decoder_pool_Release(a);
+
+    /* The pool is created again after the last release */
+    a = vlc_decoder_pool_Hold(1, 1);
+    assert(a != NULL);
+    vlc_decoder_pool_Release(a);
+}
+
+static void test_blocked(void)
+{
+    struct vlc_decoder_pool *pool = vlc_decoder_pool_Hold(1, 1);
+    struct task blocked = { .pool = pool, .runs = 0, .blocking = true };
+    struct task other = { .pool = pool, .runs = 0 };
+    unsigned start = spawned_count();
+
+    assert(pool != NULL);
+    running = 0;
+    released = false;
+
+    vlc_decoder_task_Init(&blocked.task, RunWait);
+    vlc_decoder_pool_Wake(pool, &blocked.task);
+    wait_running(1);
+
+    /* The only thread is blocked: an extra one runs the other task */
+    vlc_decoder_task_Init(&other.task, RunCount);
+    vlc_decoder_pool_Wake(pool, &other.task);
+    wait_runs(&other, 1);
+    assert(spawned_since(start, 1) == 1);
+
+    release();
+    vlc_decoder_pool_Remove(pool, &blocked.task);
+    vlc_decoder_pool_Remove(pool, &other.task);
+
+    /* An unblocked task does not get an extra thread */
+    blocked.blocking = false;
+    blocked.runs = other.runs = 0;
+    released = false;
+    vlc_decoder_task_Init(&blocked.task, RunWait);
+    vlc_decoder_task_Init(&other.task, RunCount);
+
+    vlc_decoder_pool_Wake(pool, &blocked.task);
+    wait_running(1);
+    start = spawned_count();
+    vlc_decoder_pool_Wake(pool, &other.task);
+    vlc_decoder_pool_Remove(pool, &other.task);
+    assert(other.runs == 0);
+    assert(spawned_since(start, 1) == 0);
+
+    release();
+    vlc_decoder_pool_Remove(pool, &blocked.task);
+    assert(blocked.runs == 1);
+    vlc_decoder_pool_Release(pool);
+}
+
+static void test_close_queued(void)
+{
+    struct vlc_decoder_pool *pool = vlc_decoder_pool_Hold(1, 1);
+    struct task busy = { .pool = pool, .runs = 0, .blocking = false };
+    struct task queued[4];
+
+    assert(pool != NULL);
+    running = 0;
+    released = false;
+
+    vlc_decoder_task_Init(&busy.task, RunWait);
+    vlc_decoder_pool_Wake(pool, &busy.task);
+    wait_running(1);
+
+    /* The only thread is busy: these tasks stay queued */
+    for (unsigned i = 0; i < ARRAY_SIZE(queued); i++)
+    {
+        queued[i].runs = 0;
+        vlc_decoder_task_Init(&queued[i].task, RunCount);
+        vlc_decoder_pool_Wake(pool, &queued[i].task);
+    }
+
+    /* Removed tasks never run, even if woken up again */
+    for (unsigned i = 0; i < ARRAY_SIZE(queued); i++)
+    {
+        vlc_decoder_pool_Remove(pool, &queued[i].task);
+        vlc_decoder_pool_Wake(pool, &queued[i].task);
+    }
+
+    /* Waking the running task up runs it again once it returns */
+    vlc_decoder_pool_Wake(pool, &busy.task);
+    release();
+    wait_runs(&busy, 2);
+    vlc_decoder_pool_Remove(pool, &busy.task);
+
+    vlc_decoder_pool_Release(pool);
+    for (unsigned i = 0; i < ARRAY_SIZE(queued); i++)
+        assert(queued[i].runs == 0);
+}
+
+static void test_spawn_failure(void)
+{
+    /* Without a first thread, there is no pool: the caller runs its task on
+     * a thread of its own */
+    set_spawn_fails(true);
+    assert(vlc_decoder_pool_Hold(1, 1) == NULL);
+    set_spawn_fails(false);
+
+    struct vlc_decoder_pool *pool = vlc_decoder_pool_Hold(1, 1);
+    struct task blocked = { .pool = pool, .runs = 0, .blocking = true };
+    struct task other = { .pool = pool, .runs = 0 };
+
+    assert(pool != NULL);
+    running = 0;
+    released = false;
+
+    vlc_decoder_task_Init(&blocked.task, RunWait);
+    vlc_decoder_pool_Wake(pool, &blocked.task);
+    wait_running(1);
+
+    /* No extra thread for the other task: it waits for the first thread */
+    unsigned start = spawned_count();
+
+    set_spawn_fails(true);
+    vlc_decoder_task_Init(&other.task, RunCount);
+    vlc_decoder_pool_Wake(pool, &other.task);
+
+    vlc_tick_t deadline = vlc_tick_now() + VLC_TICK_FROM_MS(50);
+
+    vlc_mutex_lock(&lock);
+    while (other.runs == 0
+        && vlc_cond_timedwait(&cond, &lock, deadline) == 0);
+    assert(other.runs == 0);
+    vlc_mutex_unlock(&lock);
+
+    release();
+    wait_runs(&other, 1);
+    set_spawn_fails(false);
+    assert(spawned_since(start, 1) == 0);
+
+    vlc_decoder_pool_Remove(pool, &blocked.task);
+    vlc_decoder_pool_Remove(pool, &other.task);
+    vlc_decoder_pool_Release(pool);
+}
+
+int main(void)
+{
+    vlc_cond_init(&cond);
+
+    test_hold();
+    test_blocked();
+    test_close_queued();
+    test_spawn_failure();
+
+    /* The last release waited for the pool threads to exit */
+    for (unsigned i = 0; i < spawned; i++)
+        vlc_join(threads[i], NULL);
+
+    vlc_cond_destroy(&cond);
+    return 0;
+}
@@ -26,11 +26,16 @@
 #undef NDEBUG
 #include <assert.h>
 
+#include <stdatomic.h>
+
 #include <vlc_common.h>
 #include <vlc_es.h>
 #include <vlc_picture_pool.h>
+#include <vlc_threads.h>
 
 #define PICTURES 10
+#define STRESS_THREADS 8
+#define STRESS_ITERATIONS 2000
 
 static video_format_t fmt;
 static picture_pool_t *pool, *reserve;
@@ -106,6 +111,120 @@ static void test(bool zombie)
             picture_Release(pics[i]);
 }
 
+struct stress
+{
+    picture_pool_t *pool;
+    void *planes[PICTURES];
+    atomic_bool in_use[PICTURES];
+    atomic_uint got;
+    bool wait;
+};
+
+static void *stress_thread(void *data)
+{
+    struct stress *st = data;
+
+    for (unsigned i = 0; i < STRESS_ITERATIONS; i++) {
+        picture_t *pic = st->wait ? picture_pool_Wait(st->pool)
+                                  : picture_pool_Get(st->pool);
+        if (pic == NULL) {
+            assert(!st->wait);
+            continue;
+        }
+
+        /* The same picture must never be handed out twice at once */
+        unsigned n = 0;
+        while (st->planes[n] != pic->p[0].p_pixels)
+            assert(++n < PICTURES);
+        assert(!atomic_exchange(&st->in_use[n], true));
+        atomic_fetch_add_explicit(&st->got, 1, memory_order_relaxed);
+        atomic_store(&st->in_use[n], false);
+        picture_Release(pic);
+    }
+    return NULL;
+}
+
+static void test_stress(bool wait)
+{
+    struct stress st = { .wait = wait };
+    vlc_thread_t th[STRESS_THREADS];
+    picture_t *pics[PICTURES];
+
+    st.pool = picture_pool_NewFromFormat(&fmt, PICTURES);
+    assert(st.pool != NULL);
+
+    for (unsigned i = 0; i < PICTURES; i++) {
+        pics[i] = picture_pool_Get(st.pool);
+        assert(pics[i] != NULL);
+        st.planes[i] = pics[i]->p[0].p_pixels;
+        atomic_init(&st.in_use[i], false);
+    }
+    for (unsigned i = 0; i < PICTURES; i++)
+        picture_Release(pics[i]);
+    atomic_init(&st.got, 0);
+
+    for (unsigned i = 0; i < STRESS_THREADS; i++)
+        assert(vlc_clone(&th[i], stress_thread, &st,
+                         VLC_THREAD_PRIORITY_LOW) == 0);
+    for (unsigned i = 0; i < STRESS_THREADS; i++)
+        vlc_join(th[i], NULL);
+
+    if (wait)
+        assert(atomic_load(&st.got) == STRESS_THREADS * STRESS_ITERATIONS);
+
+    /* All pictures must be back */
+    for (unsigned i = 0; i < PICTURES; i++) {
+        pics[i] = picture_pool_Get(st.pool);
+        assert(pics[i] != NULL);
+    }
+    for (unsigned i = 0; i < PICTURES; i++)
+        picture_Release(pics[i]);
+    picture_pool_Release(st.pool);
+}
+
+static void *wait_thread(void *data)
+{
+    return picture_pool_Wait(data);
+}
+
+static void test_cancel(void)
+{
+    picture_t *pics[PICTURES];
+    vlc_thread_t th;
+    void *ret;
+
+    pool = picture_pool_NewFromFormat(&fmt, PICTURES);
+    assert(pool != NULL);
+
+    for (unsigned i = 0; i < PICTURES; i++) {
+        pics[i] = picture_pool_Get(pool);
+        assert(pics[i] != NULL);
+    }
+
+    /* A released picture wakes a waiting thread up */
+    assert(vlc_clone(&th, wait_thread, pool, VLC_THREAD_PRIORITY_LOW) == 0);
+    picture_Release(pics[0]);
+    vlc_join(th, &ret);
+    assert(ret != NULL);
+    pics[0] = ret;
+
+    /* Canceling wakes a waiting thread up */
+    assert(vlc_clone(&th, wait_thread, pool, VLC_THREAD_PRIORITY_LOW) == 0);
+    picture_pool_Cancel(pool, true);
+    vlc_join(th, &ret);
+    assert(ret == NULL);
+
+    picture_Release(pics[0]);
+    assert(picture_pool_Get(pool) == NULL);
+    picture_pool_Cancel(pool, false);
+    pics[0] = picture_pool_Get(pool);
+    assert(pics[0] != NULL);
+
+    for (unsigned i = 0; i < PICTURES; i++)
+        picture_Release(pics[i]);
+    picture_pool_Release(pool);
+}
+
 int main(void)
 {
     video_format_Setup(&fmt, VLC_CODEC_I420, 320, 200, 320, 200, 1, 1);
@@ -122,6 +241,9 @@ int main(void)
 
     test(false);
     test(true);
+    test_cancel();
+    test_stress(false);
+    test_stress(true);
 
     return 0;
 }
@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * picture_pool_bench.c: picture_pool_t contention benchmark
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include <vlc_common.h>
+#include <vlc_es.h>
+#include <vlc_picture_pool.h>
+#include <vlc_threads.h>
+#include <vlc_tick.h>
+
+#define PICTURES 10
+#define BENCH_THREADS 8
+#define BENCH_ITERATIONS 100000
+
+struct bench
+{
+    picture_pool_t *pool;
+    atomic_uint got;
+    bool wait;
+};
+
+static void *bench_thread(void *data)
+{
+    struct bench *b = data;
+    unsigned got = 0;
+
+    for (unsigned i = 0; i < BENCH_ITERATIONS; i++) {
+        picture_t *pic = b->wait ? picture_pool_Wait(b->pool)
+                                 : picture_pool_Get(b->pool);
+        if (pic == NULL)
+            continue;
+        got++;
+        picture_Release(pic);
+    }
+    atomic_fetch_add_explicit(&b->got, got, memory_order_relaxed);
+    return NULL;
+}
+
+static void bench(const video_format_t *fmt, bool wait)
+{
+    struct bench b = { .wait = wait };
+    vlc_thread_t th[BENCH_THREADS];
+
+    b.pool = picture_pool_NewFromFormat(fmt, PICTURES);
+    assert(b.pool != NULL);
+    atomic_init(&b.got, 0);
+
+    vlc_tick_t start = vlc_tick_now();
+
+    for (unsigned i = 0; i < BENCH_THREADS; i++)
+        assert(vlc_clone(&th[i], bench_thread, &b,
+                         VLC_THREAD_PRIORITY_LOW) == 0);
+    for (unsigned i = 0; i < BENCH_THREADS; i++)
+        vlc_join(th[i], NULL);
+
+    vlc_tick_t elapsed = vlc_tick_now() - start;
+    unsigned got = atomic_load(&b.got);
+
+    printf("%s: %u threads, %u pictures in %"PRId64" ms (%.0f/s)\n",
+           wait ? "wait" : "get", BENCH_THREADS, got,
+           MS_FROM_VLC_TICK(elapsed), got / secf_from_vlc_tick(elapsed + 1));
+
+    picture_pool_Release(b.pool);
+}
+
+int main(void)
+{
+    video_format_t fmt;
+
+    video_format_Setup(&fmt, VLC_CODEC_I420, 320, 200, 320, 200, 1, 1);
+    bench(&fmt, false);
+    bench(&fmt, true);
+    return 0;
+}
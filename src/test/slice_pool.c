@@ -0,0 +1,136 @@
+/*****************************************************************************
+ * slice_pool.c: test cases for the sliced video filtering threads pool
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_threads.h>
+
+#include "../misc/slice_pool.h"
+
+/* The pool is sized after the number of CPUs: pretend to have as many as
+ * each test case needs */
+static unsigned cpus;
+
+unsigned vlc_GetCPUCount(void)
+{
+    return cpus;
+}
+
+#define MAX_LINES 2160
+
+static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+static unsigned covered[MAX_LINES];
+static unsigned calls;
+static unsigned max_count;
+static unsigned long threads_seen[64];
+static unsigned threads_count;
+
+static void RunBand(filter_t *filter, void *opaque,
+                    unsigned first, unsigned count)
+{
+    unsigned lines = *(const unsigned *)opaque;
+    unsigned long self = vlc_thread_id();
+
+    assert(filter == NULL);
+    assert(count > 0 || lines == 0);
+    assert(first + count <= lines);
+
+    vlc_mutex_lock(&lock);
+    for (unsigned i = first; i < first + count; i++)
+        covered[i]++;
+    calls++;
+    if (count > max_count)
+        max_count = count;
+
+    bool seen = false;
+    for (unsigned i = 0; i < threads_count; i++)
+        seen |= threads_seen[i] == self;
+    if (!seen && threads_count < ARRAY_SIZE(threads_seen))
+        threads_seen[threads_count++] = self;
+    vlc_mutex_unlock(&lock);
+}
+
+static void test_run(struct vlc_slice_pool *pool, unsigned lines)
+{
+    for (unsigned i = 0; i < MAX_LINES; i++)
+        covered[i] = 0;
+    calls = 0;
+    max_count = 0;
+    threads_count = 0;
+
+    vlc_slice_pool_Run(pool, NULL, RunBand, &lines, lines);
+
+    /* Every line is run exactly once, and nothing else */
+    for (unsigned i = 0; i < lines; i++)
+        assert(covered[i] == 1);
+    for (unsigned i = lines; i < MAX_LINES; i++)
+        assert(covered[i] == 0);
+    assert(calls >= 1);
+
+    /* Small pictures are not split */
+    if (lines < 32)
+        assert(calls == 1);
+    /* Bands are not shorter than needed */
+    if (calls > 1)
+        assert(max_count >= 16);
+    assert(threads_count <= cpus);
+}
+
+static void test_pool(unsigned cpu_count)
+{
+    static const unsigned lines[] = {
+        0, 1, 15, 16, 17, 31, 32, 33, 100, 479, 480, 1080, 1081, MAX_LINES,
+    };
+
+    cpus = cpu_count;
+    struct vlc_slice_pool *pool = vlc_slice_pool_Hold();
+    assert(pool != NULL);
+
+    /* The pool is shared */
+    struct vlc_slice_pool *other = vlc_slice_pool_Hold();
+    assert(other == pool);
+    vlc_slice_pool_Release(other);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(lines); i++)
+        test_run(pool, lines[i]);
+
+    /* Without a pool, the whole picture is run at once */
+    for (unsigned i = 0; i < ARRAY_SIZE(lines); i++)
+    {
+        test_run(NULL, lines[i]);
+        assert(calls == 1);
+    }
+
+    vlc_slice_pool_Release(pool);
+}
+
+int main(void)
+{
+    for (unsigned cpu_count = 1; cpu_count <= 9; cpu_count++)
+        test_pool(cpu_count);
+    return 0;
+}
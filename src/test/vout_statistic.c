@@ -0,0 +1,204 @@
+/*****************************************************************************
+ * vout_statistic.c: test cases for the video output timing statistics
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_picture.h>
+
+#include "../input/input_internal.h"
+#include "../misc/picture.h"
+#include "../video_output/statistic.h"
+
+static void test_buckets(void)
+{
+    /* Bucket 0 holds anything under 1 us */
+    assert(vout_statistic_TimingBucket(-VLC_TICK_FROM_SEC(1)) == 0);
+    assert(vout_statistic_TimingBucket(0) == 0);
+
+    /* Bucket i > 0 holds [2^(i-1), 2^i[ us */
+    for (unsigned i = 1; i < VOUT_TIMING_BUCKETS - 1; i++)
+    {
+        vlc_tick_t min = VLC_TICK_FROM_US(INT64_C(1) << (i - 1));
+        vlc_tick_t max = vout_statistic_TimingBucketMax(i);
+
+        assert(max == VLC_TICK_FROM_US(INT64_C(1) << i));
+        assert(vout_statistic_TimingBucket(min) == i);
+        assert(vout_statistic_TimingBucket(max - VLC_TICK_FROM_US(1)) == i);
+        assert(vout_statistic_TimingBucket(max) == i + 1);
+    }
+
+    /* The last bucket holds anything longer */
+    assert(vout_statistic_TimingBucket(VLC_TICK_FROM_SEC(3600))
+           == VOUT_TIMING_BUCKETS - 1);
+}
+
+static void test_get_reset(void)
+{
+    vout_statistic_t stat;
+    unsigned timing[VOUT_TIMING_COUNT][VOUT_TIMING_BUCKETS] = { { 0 } };
+    unsigned late = 0;
+
+    vout_statistic_Init(&stat);
+    assert(vout_statistic_GetResetTiming(&stat, &late, timing) == 0);
+
+    vout_statistic_AddTiming(&stat, VOUT_TIMING_FILTER, VLC_TICK_FROM_US(3));
+    vout_statistic_AddTiming(&stat, VOUT_TIMING_FILTER, VLC_TICK_FROM_US(2));
+    vout_statistic_AddTiming(&stat, VOUT_TIMING_FILTER, VLC_TICK_FROM_MS(1));
+    vout_statistic_AddTiming(&stat, VOUT_TIMING_JITTER, 0);
+    vout_statistic_AddLate(&stat, 2);
+
+    assert(vout_statistic_GetResetTiming(&stat, &late, timing)
+           == ((1u << VOUT_TIMING_FILTER) | (1u << VOUT_TIMING_JITTER)));
+    assert(late == 2);
+    assert(timing[VOUT_TIMING_FILTER][2] == 2);
+    assert(timing[VOUT_TIMING_FILTER][10] == 1);
+    assert(timing[VOUT_TIMING_JITTER][0] == 1);
+
+    /* Everything was moved out */
+    assert(vout_statistic_GetResetTiming(&stat, &late, timing) == 0);
+    assert(late == 2);
+    assert(timing[VOUT_TIMING_FILTER][2] == 2);
+
+    /* Counts are added to the given ones */
+    vout_statistic_AddTiming(&stat, VOUT_TIMING_FILTER, VLC_TICK_FROM_US(2));
+    assert(vout_statistic_GetResetTiming(&stat, &late, timing)
+           == (1u << VOUT_TIMING_FILTER));
+    assert(timing[VOUT_TIMING_FILTER][2] == 3);
+
+    unsigned total = 0;
+    for (unsigned i = 0; i < VOUT_TIMING_COUNT; i++)
+        for (unsigned j = 0; j < VOUT_TIMING_BUCKETS; j++)
+            total += timing[i][j];
+    assert(total == 5);
+
+    vout_statistic_Clean(&stat);
+}
+
+/* Adds durations to a stage of the input statistics, the way the decoder
+ * moves them out of the video output */
+static void AddTimings(struct input_stats *stats,
+                       enum vout_statistic_timing stage,
+                       unsigned count, vlc_tick_t duration)
+{
+    vout_statistic_t stat;
+    unsigned timing[VOUT_TIMING_COUNT][VOUT_TIMING_BUCKETS] = { { 0 } };
+    unsigned late = 0;
+
+    vout_statistic_Init(&stat);
+    for (unsigned i = 0; i < count; i++)
+        vout_statistic_AddTiming(&stat, stage, duration);
+    vout_statistic_GetResetTiming(&stat, &late, timing);
+    for (unsigned j = 0; j < VOUT_TIMING_BUCKETS; j++)
+        atomic_fetch_add_explicit(&stats->vout_timing[stage][j],
+                                  timing[stage][j], memory_order_relaxed);
+    vout_statistic_Clean(&stat);
+}
+
+static void test_percentiles(void)
+{
+    struct input_stats *stats = input_stats_Create();
+    input_stats_t st;
+
+    assert(stats != NULL);
+
+    /* No samples */
+    input_stats_Compute(stats, &st);
+    assert(st.vout_queue.p50 == 0 && st.vout_queue.p99 == 0);
+    assert(st.vout_jitter.p50 == 0 && st.vout_jitter.p99 == 0);
+
+    /* A single bucket: both are its upper bound */
+    AddTimings(stats, VOUT_TIMING_FILTER, 100, VLC_TICK_FROM_US(100));
+    input_stats_Compute(stats, &st);
+    assert(st.vout_filter.p50 == VLC_TICK_FROM_US(128));
+    assert(st.vout_filter.p99 == VLC_TICK_FROM_US(128));
+    /* The other stages are independent */
+    assert(st.vout_queue.p50 == 0 && st.vout_prepare.p99 == 0);
+
+    /* Exactly 99% in the first bucket */
+    AddTimings(stats, VOUT_TIMING_DISPLAY, 99, VLC_TICK_FROM_US(10));
+    AddTimings(stats, VOUT_TIMING_DISPLAY, 1, VLC_TICK_FROM_MS(10));
+    input_stats_Compute(stats, &st);
+    assert(st.vout_display.p50 == VLC_TICK_FROM_US(16));
+    assert(st.vout_display.p99 == VLC_TICK_FROM_US(16));
+
+    /* Just under 99%: the tail shows up */
+    AddTimings(stats, VOUT_TIMING_PREPARE, 98, VLC_TICK_FROM_US(10));
+    AddTimings(stats, VOUT_TIMING_PREPARE, 2, VLC_TICK_FROM_MS(10));
+    input_stats_Compute(stats, &st);
+    assert(st.vout_prepare.p50 == VLC_TICK_FROM_US(16));
+    assert(st.vout_prepare.p99 == VLC_TICK_FROM_US(16384));
+
+    /* Exactly half below: the median is the lower bucket */
+    AddTimings(stats, VOUT_TIMING_QUEUE, 50, VLC_TICK_FROM_US(1));
+    AddTimings(stats, VOUT_TIMING_QUEUE, 50, VLC_TICK_FROM_MS(1));
+    input_stats_Compute(stats, &st);
+    assert(st.vout_queue.p50 == VLC_TICK_FROM_US(2));
+    assert(st.vout_queue.p99 == VLC_TICK_FROM_US(1024));
+
+    /* Durations beyond the histogram are clamped to the last bucket */
+    AddTimings(stats, VOUT_TIMING_JITTER, 3, VLC_TICK_FROM_SEC(3600));
+    input_stats_Compute(stats, &st);
+    assert(st.vout_jitter.p50
+           == vout_statistic_TimingBucketMax(VOUT_TIMING_BUCKETS - 1));
+    assert(st.vout_jitter.p99 == st.vout_jitter.p50);
+
+    input_stats_Destroy(stats);
+}
+
+/* The time a picture left the video output queue follows it through the
+ * filters, which copy the properties of their input */
+static void test_dequeued(void)
+{
+    video_format_t fmt;
+
+    video_format_Init(&fmt, VLC_CODEC_I420);
+    video_format_Setup(&fmt, VLC_CODEC_I420, 64, 64, 64, 64, 1, 1);
+
+    picture_t *src = picture_NewFromFormat(&fmt);
+    picture_t *dst = picture_NewFromFormat(&fmt);
+    assert(src != NULL && dst != NULL);
+    assert(picture_GetDequeued(src) == VLC_TICK_INVALID);
+
+    picture_SetDequeued(src, VLC_TICK_FROM_SEC(42));
+    picture_CopyProperties(dst, src);
+    assert(picture_GetDequeued(dst) == VLC_TICK_FROM_SEC(42));
+
+    picture_Reset(dst);
+    assert(picture_GetDequeued(dst) == VLC_TICK_INVALID);
+
+    picture_Release(dst);
+    picture_Release(src);
+    video_format_Clean(&fmt);
+}
+
+int main(void)
+{
+    test_buckets();
+    test_get_reset();
+    test_percentiles();
+    test_dequeued();
+    return 0;
+}
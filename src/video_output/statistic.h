@@ -24,18 +24,52 @@
 # define LIBVLC_VOUT_STATISTIC_H
 # include <stdatomic.h>
 
-/* NOTE: Both statistics are atomic on their own, so one might be older than
- * the other one. Currently, only one of them is updated at a time, so this
- * is a non-issue. */
+/**
+ * Per-frame timing stages, each aggregated in a histogram.
+ */
+enum vout_statistic_timing
+{
+    /** Margin left before the deadline when the picture leaves the decoder
+     * queue (0 if the decoder was late) */
+    VOUT_TIMING_QUEUE,
+    /** Time spent in the static and interactive filter chains */
+    VOUT_TIMING_FILTER,
+    /** Time spent rendering subpictures and preparing the display */
+    VOUT_TIMING_PREPARE,
+    /** Time spent in the display call (including any vsync wait) */
+    VOUT_TIMING_DISPLAY,
+    /** Distance between the display start and the deadline */
+    VOUT_TIMING_JITTER,
+};
+#define VOUT_TIMING_COUNT (VOUT_TIMING_JITTER + 1)
+
+/* Bucket 0 counts durations below 1 us, and bucket i > 0 those in
+ * [2^(i-1), 2^i[ us; the last bucket also counts anything longer. */
+#define VOUT_TIMING_BUCKETS 24
+
+/* NOTE: All statistics are atomic on their own, so one might be older than
+ * the other one. They are only written by the video output thread, and
+ * readers only need approximate values. */
 typedef struct {
     atomic_uint displayed;
     atomic_uint lost;
+    atomic_uint late;
+    atomic_uint timing[VOUT_TIMING_COUNT][VOUT_TIMING_BUCKETS];
+    /* Buckets of each stage written since the last reset, one bit each */
+    atomic_uint timing_used[VOUT_TIMING_COUNT];
 } vout_statistic_t;
 
 static inline void vout_statistic_Init(vout_statistic_t *stat)
 {
     atomic_init(&stat->displayed, 0);
     atomic_init(&stat->lost, 0);
+    atomic_init(&stat->late, 0);
+    for (unsigned i = 0; i < VOUT_TIMING_COUNT; i++)
+    {
+        for (unsigned j = 0; j < VOUT_TIMING_BUCKETS; j++)
+            atomic_init(&stat->timing[i][j], 0);
+        atomic_init(&stat->timing_used[i], 0);
+    }
 }
 
 static inline void vout_statistic_Clean(vout_statistic_t *stat)
@@ -52,6 +86,46 @@ static inline void vout_statistic_GetReset(vout_statistic_t *stat,
     *lost = atomic_exchange_explicit(&stat->lost, 0, memory_order_relaxed);
 }
 
+/**
+ * Moves the late pictures count and the timing histograms out of the
+ * statistics, adding them to the given ones.
+ *
+ * Only the buckets written since the previous call are visited, so this is
+ * cheap enough to be called for every decoded picture.
+ *
+ * \return a bit mask of the stages that were updated
+ */
+static inline unsigned vout_statistic_GetResetTiming(vout_statistic_t *stat,
+    unsigned *restrict late,
+    unsigned timing[VOUT_TIMING_COUNT][VOUT_TIMING_BUCKETS])
+{
+    unsigned stages = 0;
+
+    *late += atomic_exchange_explicit(&stat->late, 0, memory_order_relaxed);
+    for (unsigned i = 0; i < VOUT_TIMING_COUNT; i++)
+    {
+        if (atomic_load_explicit(&stat->timing_used[i],
+                                 memory_order_relaxed) == 0)
+            continue;
+
+        /* Pairs with the release in vout_statistic_AddTiming(): a count
+         * added before its bit was set is seen below. A count added after
+         * the exchange sets the bit again, and is moved on the next call. */
+        unsigned used = atomic_exchange_explicit(&stat->timing_used[i], 0,
+                                                 memory_order_acquire);
+        while (used != 0)
+        {
+            unsigned j = ctz(used);
+
+            used &= used - 1;
+            timing[i][j] += atomic_exchange_explicit(&stat->timing[i][j], 0,
+                                                     memory_order_relaxed);
+        }
+        stages |= 1u << i;
+    }
+    return stages;
+}
+
 static inline void vout_statistic_AddDisplayed(vout_statistic_t *stat,
                                                int displayed)
 {
@@ -64,4 +138,43 @@ static inline void vout_statistic_AddLost(vout_statistic_t *stat, int lost)
     atomic_fetch_add_explicit(&stat->lost, lost, memory_order_relaxed);
 }
 
+static inline void vout_statistic_AddLate(vout_statistic_t *stat, int late)
+{
+    atomic_fetch_add_explicit(&stat->late, late, memory_order_relaxed);
+}
+
+/**
+ * Returns the histogram bucket of a duration.
+ */
+static inline unsigned vout_statistic_TimingBucket(vlc_tick_t duration)
+{
+    int64_t us = US_FROM_VLC_TICK(duration);
+
+    if (us <= 0)
+        return 0;
+
+    unsigned bucket = 64 - clz((unsigned long long)us);
+    return bucket < VOUT_TIMING_BUCKETS ? bucket : VOUT_TIMING_BUCKETS - 1;
+}
+
+/**
+ * Returns the upper bound of a histogram bucket.
+ */
+static inline vlc_tick_t vout_statistic_TimingBucketMax(unsigned bucket)
+{
+    return VLC_TICK_FROM_US(UINT64_C(1) << bucket);
+}
+
+static inline void vout_statistic_AddTiming(vout_statistic_t *stat,
+                                            enum vout_statistic_timing stage,
+                                            vlc_tick_t duration)
+{
+    unsigned bucket = vout_statistic_TimingBucket(duration);
+
+    atomic_fetch_add_explicit(&stat->timing[stage][bucket], 1,
+                              memory_order_relaxed);
+    atomic_fetch_or_explicit(&stat->timing_used[stage], 1u << bucket,
+                             memory_order_release);
+}
+
 #endif
@@ -35,6 +35,7 @@
 
 #include <vlc_common.h>
 
+#include <errno.h>
 #include <math.h>
 #include <stdlib.h>                                                /* free() */
 #include <string.h>
@@ -47,6 +48,7 @@
 #include <vlc_vout_osd.h>
 #include <vlc_image.h>
 #include <vlc_plugin.h>
+#include <vlc_fs.h>
 
 #include <libvlc.h>
 #include "vout_internal.h"
@@ -55,6 +57,7 @@
 #include "snapshot.h"
 #include "window.h"
 #include "../misc/variables.h"
+#include "../misc/picture.h"
 
 /* Maximum delay between 2 displayed pictures.
  * XXX it is needed for now but should be removed in the long term.
@@ -214,6 +217,12 @@ void vout_GetResetStatistic(vout_thread_t *vout, unsigned *restrict displayed,
     vout_statistic_GetReset( &vout->p->statistic, displayed, lost );
 }
 
+unsigned vout_GetResetTiming(vout_thread_t *vout, unsigned *restrict late,
+                             unsigned timing[VOUT_TIMING_COUNT][VOUT_TIMING_BUCKETS])
+{
+    return vout_statistic_GetResetTiming(&vout->p->statistic, late, timing);
+}
+
 bool vout_IsEmpty(vout_thread_t *vout)
 {
     picture_t *picture = picture_fifo_Peek(vout->p->decoder_fifo);
@@ -811,6 +820,7 @@ static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool fra
 
     vlc_mutex_lock(&vout->p->filter.lock);
 
+    vlc_tick_t filter_start = vlc_tick_now();
     picture_t *picture = filter_chain_VideoFilter(vout->p->filter.chain_static, NULL);
     assert(!reuse || !picture);
 
@@ -821,6 +831,9 @@ static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool fra
         } else {
             decoded = picture_fifo_Pop(vout->p->decoder_fifo);
             if (decoded) {
+                /* Kept on the picture, as the static filters may output
+                 * it only after later ones were dequeued */
+                picture_SetDequeued(decoded, vlc_tick_now());
                 if (is_late_dropped && !decoded->b_force) {
                     vlc_tick_t late_threshold;
                     if (decoded->format.i_frame_rate && decoded->format.i_frame_rate_base)
@@ -854,6 +867,7 @@ static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool fra
         vout->p->displayed.timestamp     = decoded->date;
         vout->p->displayed.is_interlaced = !decoded->b_progressive;
 
+        filter_start = vlc_tick_now();
         picture = filter_chain_VideoFilter(vout->p->filter.chain_static, decoded);
     }
 
@@ -862,11 +876,19 @@ static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool fra
     if (!picture)
         return VLC_EGENERIC;
 
+    const struct vout_frame_timing timing = {
+        .dequeued = picture_GetDequeued(picture),
+        .filter = vlc_tick_now() - filter_start,
+    };
+
     assert(!vout->p->displayed.next);
-    if (!vout->p->displayed.current)
+    if (!vout->p->displayed.current) {
         vout->p->displayed.current = picture;
-    else
+        vout->p->displayed.current_timing = timing;
+    } else {
         vout->p->displayed.next    = picture;
+        vout->p->displayed.next_timing = timing;
+    }
     return VLC_SUCCESS;
 }
 
@@ -934,9 +956,11 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
 
     vout_chrono_Start(&sys->render);
 
+    const vlc_tick_t filter_start = vlc_tick_now();
     vlc_mutex_lock(&sys->filter.lock);
     picture_t *filtered = filter_chain_VideoFilter(sys->filter.chain_interactive, torender);
     vlc_mutex_unlock(&sys->filter.lock);
+    const vlc_tick_t prepare_start = vlc_tick_now();
 
     if (!filtered)
         return VLC_EGENERIC;
@@ -1082,6 +1106,7 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
     if (vd->prepare != NULL)
         vd->prepare(vd, todisplay, do_dr_spu ? subpic : NULL, todisplay->date);
 
+    const vlc_tick_t prepare_end = vlc_tick_now();
     vout_chrono_Stop(&sys->render);
 #if 0
         {
@@ -1102,13 +1127,44 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
         vlc_tick_wait(todisplay->date);
 
     /* Display the direct buffer returned by vout_RenderPicture */
+    const vlc_tick_t deadline = todisplay->date;
     sys->displayed.date = vlc_tick_now();
     vout_display_Display(vd, todisplay);
     if (subpic)
         subpicture_Delete(subpic);
 
+    const vlc_tick_t display_end = vlc_tick_now();
+    const struct vout_frame_timing *timing = &sys->displayed.current_timing;
+
     vout_statistic_AddDisplayed(&sys->statistic, 1);
 
+    /* Forced pictures (refreshes, frame stepping) have no deadline */
+    if (!is_forced) {
+        const vlc_tick_t jitter = sys->displayed.date - deadline;
+
+        /* Unknown if a filter did not copy the picture properties */
+        if (timing->dequeued != VLC_TICK_INVALID)
+            vout_statistic_AddTiming(&sys->statistic, VOUT_TIMING_QUEUE,
+                                     deadline - timing->dequeued);
+        vout_statistic_AddTiming(&sys->statistic, VOUT_TIMING_FILTER,
+                                 timing->filter + prepare_start - filter_start);
+        vout_statistic_AddTiming(&sys->statistic, VOUT_TIMING_PREPARE,
+                                 prepare_end - prepare_start);
+        vout_statistic_AddTiming(&sys->statistic, VOUT_TIMING_DISPLAY,
+                                 display_end - sys->displayed.date);
+        vout_statistic_AddTiming(&sys->statistic, VOUT_TIMING_JITTER,
+                                 jitter >= 0 ? jitter : -jitter);
+        if (jitter > VOUT_MWAIT_TOLERANCE)
+            vout_statistic_AddLate(&sys->statistic, 1);
+    }
+
+    if (sys->timing_trace != NULL)
+        fprintf(sys->timing_trace,
+                "%"PRId64",%d,%"PRId64",%"PRId64",%"PRId64",%"PRId64",%"PRId64
+                ",%"PRId64"\n", deadline, is_forced, timing->dequeued,
+                timing->filter + prepare_start - filter_start, prepare_start,
+                prepare_end, sys->displayed.date, display_end);
+
     return VLC_SUCCESS;
 }
 
@@ -1169,6 +1225,7 @@ static int ThreadDisplayPicture(vout_thread_t *vout, vlc_tick_t *deadline)
     if (drop_next_frame) {
         picture_Release(sys->displayed.current);
         sys->displayed.current = sys->displayed.next;
+        sys->displayed.current_timing = sys->displayed.next_timing;
         sys->displayed.next    = NULL;
     }
 
@@ -1634,6 +1691,8 @@ static void VoutDestructor(vlc_object_t *object)
 
     /* */
     vout_statistic_Clean(&vout->p->statistic);
+    if (vout->p->timing_trace != NULL)
+        fclose(vout->p->timing_trace);
 
     /* */
     vout_snapshot_Destroy(vout->p->snapshot);
@@ -1681,6 +1740,19 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
     sys->snapshot = vout_snapshot_New();
     vout_statistic_Init(&sys->statistic);
 
+    sys->timing_trace = NULL;
+    char *trace = var_InheritString(vout, "vout-timing-trace");
+    if (trace != NULL) {
+        sys->timing_trace = vlc_fopen(trace, "wt");
+        if (sys->timing_trace != NULL)
+            fputs("deadline,forced,dequeued,filter,prepare_start,prepare_end,"
+                  "display_start,display_end\n", sys->timing_trace);
+        else
+            msg_Err(vout, "cannot open timing trace %s: %s", trace,
+                    vlc_strerror_c(errno));
+        free(trace);
+    }
+
     /* Initialize subpicture unit */
     vlc_mutex_init(&sys->spu_lock);
     sys->spu = spu_Create(vout, vout);
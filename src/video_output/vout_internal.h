@@ -102,6 +102,7 @@ struct vout_thread_sys_t
 
     /* Statistics */
     vout_statistic_t statistic;
+    FILE            *timing_trace; /**< per-frame timing dump, or NULL */
 
     /* Subpicture unit */
     vlc_mutex_t     spu_lock;
@@ -120,6 +121,11 @@ struct vout_thread_sys_t
         picture_t   *decoded;
         picture_t   *current;
         picture_t   *next;
+        /* Timing of the pictures on their way to the display */
+        struct vout_frame_timing {
+            vlc_tick_t dequeued; /**< when the source left the queue */
+            vlc_tick_t filter;   /**< time spent in the static filters */
+        } current_timing, next_timing;
     } displayed;
 
     struct {
@@ -266,6 +272,13 @@ void spu_OffsetSubtitleDate( spu_t *p_spu, vlc_tick_t i_duration );
 void vout_GetResetStatistic( vout_thread_t *p_vout, unsigned *pi_displayed,
                              unsigned *pi_lost );
 
+/**
+ * This function will return and reset the frame timing statistics, adding
+ * them to the provided ones. It returns a bit mask of the updated stages.
+ */
+unsigned vout_GetResetTiming( vout_thread_t *p_vout, unsigned *pi_late,
+                              unsigned timing[VOUT_TIMING_COUNT][VOUT_TIMING_BUCKETS] );
+
 /**
  * This function will ensure that all ready/displayed pictures have at most
  * the provided date.
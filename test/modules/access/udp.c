@@ -0,0 +1,149 @@
+/*****************************************************************************
+ * udp.c: UDP access module test
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_access.h>
+#include <vlc_block.h>
+#include <vlc_network.h>
+#include <vlc_stream.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+#define DATAGRAMS 40 /* more than a batch, and not a multiple of it */
+
+static size_t datagram_size(unsigned i)
+{
+    return 1 + (i * 97) % 1316;
+}
+
+static void datagram_fill(uint8_t *buf, unsigned i, size_t size)
+{
+    for (size_t j = 0; j < size; j++)
+        buf[j] = i + j;
+}
+
+static void check_block(block_t *block, unsigned i, size_t size)
+{
+    uint8_t buf[4096];
+
+    assert(block != NULL);
+    assert(block->i_buffer == size);
+    assert(!(block->i_flags & BLOCK_FLAG_CORRUPTED));
+    datagram_fill(buf, i, size);
+    assert(memcmp(block->p_buffer, buf, size) == 0);
+    block_Release(block);
+}
+
+/* Finds a free local port */
+static unsigned test_port(vlc_object_t *obj)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof (addr);
+    int fd = net_ListenUDP1(obj, "127.0.0.1", 0);
+
+    assert(fd != -1);
+    assert(getsockname(fd, (struct sockaddr *)&addr, &len) == 0);
+    net_Close(fd);
+    return ntohs(((struct sockaddr_in *)&addr)->sin_port);
+}
+
+static void test_udp(const char *batch)
+{
+    const char *argv[] = {
+        "-v", "--ignore-config", "--udp-timeout=1", batch,
+    };
+    /* The batch size option only exists with recvmmsg() */
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv) - (batch == NULL),
+                                        argv);
+    assert(vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    unsigned port = test_port(obj);
+    char mrl[32];
+    uint8_t buf[4096];
+
+    printf("Testing %s\n", batch != NULL ? batch : "single datagrams");
+    sprintf(mrl, "udp://@127.0.0.1:%u", port);
+
+    stream_t *access = vlc_access_NewMRL(obj, mrl);
+    assert(access != NULL);
+
+    int fd = net_ConnectUDP(obj, "127.0.0.1", port, -1);
+    assert(fd != -1);
+
+    /* All datagrams are pending before the first read, so that several are
+     * received at once, and come out one per block in order */
+    for (unsigned i = 0; i < DATAGRAMS; i++)
+    {
+        size_t size = datagram_size(i);
+
+        datagram_fill(buf, i, size);
+        assert(send(fd, buf, size, 0) == (ssize_t)size);
+    }
+
+    for (unsigned i = 0; i < DATAGRAMS; i++)
+        check_block(vlc_stream_ReadBlock(access), i, datagram_size(i));
+
+    /* A datagram larger than the MTU is received whole, and so are the
+     * following ones */
+    for (unsigned i = 0; i < 3; i++)
+    {
+        size_t size = i == 0 ? sizeof (buf) : datagram_size(i);
+
+        datagram_fill(buf, i, size);
+        assert(send(fd, buf, size, 0) == (ssize_t)size);
+    }
+
+    check_block(vlc_stream_ReadBlock(access), 0, sizeof (buf));
+    for (unsigned i = 1; i < 3; i++)
+        check_block(vlc_stream_ReadBlock(access), i, datagram_size(i));
+
+    /* Nothing more to receive: the source times out */
+    assert(vlc_stream_ReadBlock(access) == NULL);
+    assert(vlc_stream_Eof(access));
+
+    net_Close(fd);
+    vlc_stream_Delete(access);
+    libvlc_release(vlc);
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+#ifdef HAVE_RECVMMSG
+    test_udp("--udp-batch=1");
+    test_udp("--udp-batch=16");
+#else
+    test_udp(NULL);
+#endif
+    return 0;
+}
@@ -0,0 +1,138 @@
+/*****************************************************************************
+ * udp.c: UDP access output module test
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_network.h>
+#include <vlc_sout.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+#define TS_SIZE    188
+#define TS_PER_MTU 7
+#define DATAGRAMS  60 /* due at once: several batches */
+#define PACED      5  /* due one after the other */
+#define PACE       VLC_TICK_FROM_MS(50)
+
+/* Writes one MTU worth of numbered TS packets */
+static void write_datagram(sout_access_out_t *access, unsigned *counter,
+                           vlc_tick_t dts)
+{
+    for (unsigned i = 0; i < TS_PER_MTU; i++)
+    {
+        block_t *block = block_Alloc(TS_SIZE);
+        assert(block != NULL);
+
+        memset(block->p_buffer, *counter & 0xff, TS_SIZE);
+        block->i_dts = dts;
+        (*counter)++;
+        assert(sout_AccessOutWrite(access, block) == TS_SIZE);
+    }
+}
+
+/* Receives one datagram, and checks that it holds the next TS packets */
+static vlc_tick_t read_datagram(int fd, unsigned *counter)
+{
+    uint8_t buf[TS_SIZE * TS_PER_MTU + 1];
+    struct pollfd ufd = { .fd = fd, .events = POLLIN };
+
+    assert(poll(&ufd, 1, 5000) == 1);
+    assert(recv(fd, buf, sizeof (buf), 0) == TS_SIZE * TS_PER_MTU);
+
+    vlc_tick_t now = vlc_tick_now();
+
+    for (unsigned i = 0; i < TS_PER_MTU; i++)
+    {
+        for (unsigned j = 0; j < TS_SIZE; j++)
+            assert(buf[i * TS_SIZE + j] == (*counter & 0xff));
+        (*counter)++;
+    }
+    return now;
+}
+
+static void test_udp(const char *batch)
+{
+    const char *argv[] = {
+        "-v", "--ignore-config", "--sout-udp-caching=0", "--mtu=1316", batch,
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    struct sockaddr_in addr;
+    socklen_t len = sizeof (addr);
+    char dst[32];
+
+    printf("Testing %s\n", batch);
+
+    int fd = net_ListenUDP1(obj, "127.0.0.1", 0);
+    assert(fd != -1);
+    assert(getsockname(fd, (struct sockaddr *)&addr, &len) == 0);
+    sprintf(dst, "127.0.0.1:%u", ntohs(addr.sin_port));
+
+    sout_access_out_t *access = sout_AccessOutNew(obj, "udp", dst);
+    assert(access != NULL);
+
+    /* Datagrams due at the same time go out whole and in order, whether
+     * they are batched, segmented by the kernel or not */
+    unsigned written = 0, read = 0;
+    vlc_tick_t dts = vlc_tick_now() + VLC_TICK_FROM_MS(20);
+
+    for (unsigned i = 0; i < DATAGRAMS; i++)
+        write_datagram(access, &written, dts);
+    for (unsigned i = 0; i < DATAGRAMS; i++)
+        read_datagram(fd, &read);
+
+    /* Datagrams due later are not sent ahead of time with earlier ones */
+    dts = vlc_tick_now() + VLC_TICK_FROM_MS(20);
+    for (unsigned i = 0; i < PACED; i++)
+        write_datagram(access, &written, dts + i * PACE);
+
+    for (unsigned i = 0; i < PACED; i++)
+    {
+        vlc_tick_t date = read_datagram(fd, &read);
+        assert(date >= dts + i * PACE - VLC_TICK_FROM_MS(2));
+    }
+
+    sout_AccessOutDelete(access);
+    net_Close(fd);
+    libvlc_release(vlc);
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    test_udp("--sout-udp-batch=1");
+    test_udp("--sout-udp-batch=16");
+    return 0;
+}
@@ -0,0 +1,280 @@
+/*****************************************************************************
+ * bandlimited.c: bandlimited resampler tests and benchmark
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+
+#include "../modules/audio_filter/resampler/bandlimited.c"
+#include "harness.h"
+
+/* The plugin source includes config.h again, which defines NDEBUG */
+#undef NDEBUG
+#include <assert.h>
+
+#define TEST_BLOCK 1024 /* frames per input block */
+
+static filter_t *TestFilter( unsigned i_in_rate, unsigned i_out_rate,
+                             unsigned i_nb_channels )
+{
+    filter_t *p_filter = af_filter_New( i_in_rate, i_out_rate, i_nb_channels );
+
+    assert( OpenFilter( VLC_OBJECT(p_filter) ) == VLC_SUCCESS );
+    return p_filter;
+}
+
+static void TestFilterDelete( filter_t *p_filter )
+{
+    CloseFilter( VLC_OBJECT(p_filter) );
+    af_filter_Delete( p_filter );
+}
+
+/* Uses the generic code, rather than the polyphase kernels */
+static void TestFilterGeneric( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    assert( p_sys->poly.p_coefs != NULL );
+    free( p_sys->poly.p_coefs );
+    p_sys->poly.p_coefs = NULL;
+}
+
+/* Resamples a signal block by block, returns the number of output frames */
+static size_t TestRun( filter_t *p_filter, const float *p_signal,
+                       size_t i_frames, float *p_out, size_t i_out_max,
+                       int i_drift )
+{
+    const unsigned i_nb_channels = p_filter->fmt_in.audio.i_channels;
+    const size_t i_frame_size = i_nb_channels * sizeof (float);
+    size_t i_out = 0;
+
+    for( size_t i = 0; i + TEST_BLOCK <= i_frames; i += TEST_BLOCK )
+    {
+        block_t *p_block = block_Alloc( TEST_BLOCK * i_frame_size );
+        assert( p_block != NULL );
+        memcpy( p_block->p_buffer, p_signal + i * i_nb_channels,
+                TEST_BLOCK * i_frame_size );
+        p_block->i_nb_samples = TEST_BLOCK;
+        p_block->i_pts = VLC_TICK_0 +
+            vlc_tick_from_samples( i, p_filter->fmt_in.audio.i_rate );
+
+        /* as the audio output compensates a drift, on some blocks */
+        bool b_drift = ( i / TEST_BLOCK ) % 4 == 2;
+        if( b_drift )
+            p_filter->fmt_in.audio.i_rate += i_drift;
+        block_t *p_res = Resample( p_filter, p_block );
+        if( b_drift )
+            p_filter->fmt_in.audio.i_rate -= i_drift;
+
+        if( p_res == NULL )
+            continue;
+        assert( i_out + p_res->i_nb_samples <= i_out_max );
+        if( p_out != NULL )
+            memcpy( p_out + i_out * i_nb_channels, p_res->p_buffer,
+                    p_res->i_nb_samples * i_frame_size );
+        i_out += p_res->i_nb_samples;
+        block_Release( p_res );
+    }
+    return i_out;
+}
+
+/* Compares the polyphase kernels with the generic code */
+static void TestRate( unsigned i_in_rate, unsigned i_out_rate,
+                      unsigned i_nb_channels, int i_drift )
+{
+    const size_t i_frames = TEST_BLOCK * 24;
+    const size_t i_out_max = i_frames * 4;
+    float *p_signal = af_signal( i_in_rate, i_nb_channels, i_frames,
+                                 440., .05 );
+    float *p_ref = vlc_alloc( i_out_max * i_nb_channels, sizeof (float) );
+    float *p_out = vlc_alloc( i_out_max * i_nb_channels, sizeof (float) );
+    assert( p_ref != NULL && p_out != NULL );
+
+    filter_t *p_filter = TestFilter( i_in_rate, i_out_rate, i_nb_channels );
+    TestFilterGeneric( p_filter );
+    size_t i_ref = TestRun( p_filter, p_signal, i_frames, p_ref, i_out_max,
+                            i_drift );
+    TestFilterDelete( p_filter );
+    assert( i_ref > 0 );
+
+    for( size_t k = 0; k < ARRAY_SIZE(poly_kernels); k++ )
+    {
+        if( !af_cpu_usable( poly_kernels[k].i_cpu, poly_kernels[k].psz_name ) )
+            continue;
+
+        p_filter = TestFilter( i_in_rate, i_out_rate, i_nb_channels );
+        filter_sys_t *p_sys = p_filter->p_sys;
+        p_sys->poly.pf_dot = poly_kernels[k].pf_dot;
+        size_t i_out = TestRun( p_filter, p_signal, i_frames, p_out,
+                                i_out_max, i_drift );
+        TestFilterDelete( p_filter );
+        assert( i_out == i_ref );
+
+        /* only the summation order differs; the first frames of the
+         * generic code read before the first block */
+        float f_max = 0.f;
+        for( size_t i = 32 * i_nb_channels; i < i_out * i_nb_channels; i++ )
+            f_max = __MAX( f_max, fabsf( p_out[i] - p_ref[i] ) );
+        fprintf( stderr, "%6u -> %6u Hz %u ch drift %+d %-4s: %zu frames, "
+                 "max diff %g\n", i_in_rate, i_out_rate, i_nb_channels,
+                 i_drift, poly_kernels[k].psz_name, i_out, f_max );
+        assert( f_max <= 1e-5f );
+    }
+
+    free( p_out );
+    free( p_ref );
+    free( p_signal );
+}
+
+static void TestRates( void )
+{
+    static const struct
+    {
+        unsigned i_in_rate, i_out_rate;
+    } tests[] =
+    {
+        { 44100, 48000 }, { 48000, 44100 }, { 48000, 96000 }, { 96000, 48000 },
+        { 22050, 48000 }, { 48000, 32000 },
+    };
+
+    for( size_t t = 0; t < ARRAY_SIZE(tests); t++ )
+    {
+        TestRate( tests[t].i_in_rate, tests[t].i_out_rate, 1, 0 );
+        TestRate( tests[t].i_in_rate, tests[t].i_out_rate, 2, 0 );
+        TestRate( tests[t].i_in_rate, tests[t].i_out_rate, 6, 0 );
+        TestRate( tests[t].i_in_rate, tests[t].i_out_rate, 2, 7 );
+    }
+}
+
+static void TestChannels( void )
+{
+    for( unsigned i_nb_channels = 3; i_nb_channels <= 8; i_nb_channels++ )
+        if( i_nb_channels != 6 )
+            TestRate( 44100, 48000, i_nb_channels, 0 );
+}
+
+/* THD+N of a sine: the residual after removing the best fitting sine at
+ * the same frequency, relative to it */
+static double BenchTHDN( const float *p_buf, size_t i_frames,
+                         unsigned i_nb_channels, unsigned i_rate,
+                         double f_freq )
+{
+    double ss = 0., sc = 0., cc = 0., xs = 0., xc = 0., xx = 0.;
+
+    for( size_t i = 0; i < i_frames; i++ )
+    {
+        double t = 2. * M_PI * f_freq * i / i_rate;
+        double s = sin( t ), c = cos( t ), x = p_buf[i * i_nb_channels];
+        ss += s * s; sc += s * c; cc += c * c;
+        xs += x * s; xc += x * c; xx += x * x;
+    }
+
+    /* least squares a.sin + b.cos */
+    double det = ss * cc - sc * sc;
+    double a = ( xs * cc - xc * sc ) / det;
+    double b = ( xc * ss - xs * sc ) / det;
+    double fit = a * xs + b * xc;
+    return 10. * log10( ( xx - fit ) / fit );
+}
+
+struct bench
+{
+    filter_t *p_filter;
+    const float *p_signal;
+    float *p_out;
+    size_t i_frames, i_out_max, i_out;
+};
+
+static void BenchRun( void *opaque )
+{
+    struct bench *b = opaque;
+
+    b->i_out = TestRun( b->p_filter, b->p_signal, b->i_frames, b->p_out,
+                        b->i_out_max, 0 );
+}
+
+static void BenchRate( unsigned i_in_rate, unsigned i_out_rate,
+                       unsigned i_nb_channels )
+{
+    const size_t i_frames = TEST_BLOCK * 64;
+    float *p_signal = af_signal( i_in_rate, i_nb_channels, i_frames,
+                                 997., 0. );
+    struct bench b = {
+        .p_signal = p_signal,
+        .p_out = vlc_alloc( i_frames * 4 * i_nb_channels, sizeof (float) ),
+        .i_frames = i_frames,
+        .i_out_max = i_frames * 4,
+    };
+    assert( b.p_out != NULL );
+
+    for( int k = -1; k < (int)ARRAY_SIZE(poly_kernels); k++ )
+    {
+        if( k >= 0 && !af_cpu_usable( poly_kernels[k].i_cpu,
+                                      poly_kernels[k].psz_name ) )
+            continue;
+
+        b.p_filter = TestFilter( i_in_rate, i_out_rate, i_nb_channels );
+        if( k < 0 )
+            TestFilterGeneric( b.p_filter );
+        else
+        {
+            filter_sys_t *p_sys = b.p_filter->p_sys;
+            p_sys->poly.pf_dot = poly_kernels[k].pf_dot;
+        }
+
+        double f_rate = af_bench( BenchRun, &b );
+        TestFilterDelete( b.p_filter );
+
+        /* skip the start, the filter runs from silence */
+        printf( "%6u -> %6u Hz %u ch %-7s: %7.1fx realtime, THD+N %6.1f dB\n",
+                i_in_rate, i_out_rate, i_nb_channels,
+                k < 0 ? "generic" : poly_kernels[k].psz_name,
+                f_rate * i_frames / i_in_rate,
+                BenchTHDN( b.p_out + 256 * i_nb_channels, b.i_out - 512,
+                           i_nb_channels, i_out_rate, 997. ) );
+    }
+
+    free( b.p_out );
+    free( p_signal );
+}
+
+static void BenchRates( void )
+{
+    BenchRate( 44100, 48000, 2 );
+    BenchRate( 48000, 44100, 2 );
+    BenchRate( 48000, 96000, 2 );
+    BenchRate( 44100, 48000, 6 );
+}
+
+const struct af_case af_tests[] =
+{
+    { "polyphase kernels", TestRates },
+    { "polyphase kernels, other channel counts", TestChannels },
+    { NULL, NULL },
+};
+
+const struct af_case af_benches[] =
+{
+    { "resampling", BenchRates },
+    { NULL, NULL },
+};
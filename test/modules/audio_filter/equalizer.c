@@ -0,0 +1,297 @@
+/*****************************************************************************
+ * equalizer.c: equalizer filters tests and benchmark
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include "../modules/audio_filter/equalizer.c"
+#include "harness.h"
+
+/* The plugin source includes config.h again, which defines NDEBUG */
+#undef NDEBUG
+#include <assert.h>
+
+static const struct
+{
+    eqz_filter_t pf_filter;
+    unsigned     cpu;
+    const char  *name;
+} filters[] =
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    { EqzFilter_avx2, VLC_CPU_AVX2, "avx2" },
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    { EqzFilter_sse2, VLC_CPU_SSE2, "sse2" },
+#endif
+    { EqzFilter_c, 0, "c" },
+};
+
+static filter_t *TestFilter( eqz_filter_t pf_filter, unsigned i_channels,
+                             bool b_2eqz )
+{
+    static const float bands[EQZ_BANDS_MAX] =
+        { 8.f, 5.6f, -3.2f, 0.f, 12.f, -20.f, 4.f, 9.6f, -1.6f, 20.f };
+    filter_t *filter = af_filter_New( 48000, 48000, i_channels );
+    filter_sys_t *p_sys = calloc( 1, sizeof (*p_sys) );
+    assert( p_sys != NULL );
+
+    filter->p_sys = p_sys;
+    vlc_mutex_init( &p_sys->lock );
+    EqzInitState( p_sys, 48000, true );
+    for( int i = 0; i < p_sys->i_band; i++ )
+        p_sys->params[0].f_amp[i] = EqzConvertdB( bands[i] );
+    p_sys->params[0].f_gamp = powf( 10.f, 6.f / 20.f );
+    p_sys->params[0].b_2eqz = b_2eqz;
+    p_sys->pf_filter = pf_filter;
+    return filter;
+}
+
+static void TestFilterDelete( filter_t *filter )
+{
+    filter_sys_t *p_sys = filter->p_sys;
+
+    vlc_mutex_destroy( &p_sys->lock );
+    free( p_sys );
+    af_filter_Delete( filter );
+}
+
+/* The filter as it was written before the state was laid out for vectors:
+ * one channel at a time, through all the bands */
+static void EqzFilter_ref( filter_sys_t *p_sys, const eqz_params_t *p_params,
+                           float *buf, unsigned i_samples, unsigned i_channels )
+{
+    const float gamp = p_params->b_2eqz ? p_params->f_gamp * p_params->f_gamp
+                                        : p_params->f_gamp;
+
+    for( unsigned i = 0; i < i_samples; i++ )
+    {
+        for( unsigned ch = 0; ch < i_channels; ch++ )
+        {
+            float x = buf[ch];
+            float o = 0.0f;
+
+            for( unsigned pass = 0; pass < ( p_params->b_2eqz ? 2 : 1 ); pass++ )
+            {
+                eqz_state_t *st = &p_sys->state[pass];
+
+                if( pass > 0 )
+                {
+                    x = EQZ_IN_FACTOR * x + o;
+                    o = 0.0f;
+                }
+                for( int j = 0; j < p_sys->i_band; j++ )
+                {
+                    float y = p_sys->f_alpha[j] * ( x - st->x[1][ch] ) +
+                              p_sys->f_gamma[j] * st->y[j][0][ch] -
+                              p_sys->f_beta[j]  * st->y[j][1][ch];
+
+                    st->y[j][1][ch] = st->y[j][0][ch];
+                    st->y[j][0][ch] = y;
+
+                    o += y * p_params->f_amp[j];
+                }
+                st->x[1][ch] = st->x[0][ch];
+                st->x[0][ch] = x;
+            }
+
+            buf[ch] = gamp * ( EQZ_IN_FACTOR * x + o );
+        }
+        buf += i_channels;
+    }
+}
+
+/* Compares a filter with the reference one, over several buffers so that
+ * the state is carried over */
+static void TestFilterChannels( size_t f, unsigned i_channels, bool b_2eqz )
+{
+    const unsigned i_samples = 4000;
+    filter_t *ref = TestFilter( EqzFilter_ref, i_channels, b_2eqz );
+    filter_t *flt = TestFilter( filters[f].pf_filter, i_channels, b_2eqz );
+    float *exp = af_signal( 48000, i_channels, i_samples, 100., .1 );
+    float *out = vlc_alloc( i_samples * i_channels, sizeof (float) );
+    assert( out != NULL );
+    memcpy( out, exp, i_samples * i_channels * sizeof (float) );
+
+    for( unsigned i = 0; i < i_samples; i += 1000 )
+    {
+        EqzFilter( ref, &exp[i * i_channels], 1000, i_channels );
+        EqzFilter( flt, &out[i * i_channels], 1000, i_channels );
+    }
+
+    /* Only the rounding may differ, if the compiler contracted or
+     * vectorized the code differently */
+    for( unsigned i = 0; i < i_samples * i_channels; i++ )
+        if( fabsf( out[i] - exp[i] ) > 1e-4f )
+        {
+            fprintf( stderr, "%s %u channels %d pass: sample %u channel %u: "
+                     "%f instead of %f\n", filters[f].name, i_channels,
+                     b_2eqz ? 2 : 1, i / i_channels, i % i_channels,
+                     out[i], exp[i] );
+            abort();
+        }
+
+    free( out );
+    free( exp );
+    TestFilterDelete( flt );
+    TestFilterDelete( ref );
+}
+
+static void TestFilters( void )
+{
+    static const unsigned channels[] = { 1, 2, 3, 4, 6, 8, 9, 12 };
+
+    for( size_t f = 0; f < ARRAY_SIZE(filters); f++ )
+    {
+        if( !af_cpu_usable( filters[f].cpu, filters[f].name ) )
+            continue;
+        for( size_t c = 0; c < ARRAY_SIZE(channels); c++ )
+        {
+            TestFilterChannels( f, channels[c], false );
+            TestFilterChannels( f, channels[c], true );
+        }
+    }
+}
+
+#define TEST_UPDATES 1000000
+
+/* Every update sets all the parameters from the same number, so that the
+ * filter can tell a torn copy */
+static void TestParamsCheck( filter_sys_t *p_sys, const eqz_params_t *p_params,
+                             float *buf, unsigned i_samples,
+                             unsigned i_channels )
+{
+    const float v = p_params->f_gamp;
+
+    for( int j = 0; j < p_sys->i_band; j++ )
+        assert( p_params->f_amp[j] == v );
+    assert( p_params->b_2eqz == ( ( (unsigned)v & 1 ) != 0 ) );
+    /* report the parameters seen */
+    assert( i_samples == 1 && i_channels == 1 );
+    buf[0] = v;
+}
+
+static void *TestParamsThread( void *data )
+{
+    filter_sys_t *p_sys = data;
+
+    for( unsigned k = 1; k <= TEST_UPDATES; k++ )
+    {
+        eqz_params_t *p_params = EqzParamsBegin( p_sys );
+
+        for( int j = 0; j < p_sys->i_band; j++ )
+            p_params->f_amp[j] = k;
+        p_params->f_gamp = k;
+        p_params->b_2eqz = k & 1;
+        EqzParamsCommit( p_sys );
+    }
+    return NULL;
+}
+
+/* The callbacks update the parameters while the audio thread filters */
+static void TestParams( void )
+{
+    filter_t *flt = TestFilter( TestParamsCheck, 1, false );
+    filter_sys_t *p_sys = flt->p_sys;
+    vlc_thread_t th;
+    float seen = 0.f;
+
+    for( int j = 0; j < p_sys->i_band; j++ )
+        p_sys->params[0].f_amp[j] = 0.f;
+    p_sys->params[0].f_gamp = 0.f;
+
+    assert( vlc_clone( &th, TestParamsThread, p_sys,
+                       VLC_THREAD_PRIORITY_LOW ) == 0 );
+    while( seen < TEST_UPDATES )
+    {
+        float v;
+
+        EqzFilter( flt, &v, 1, 1 );
+        /* the updates are seen in order */
+        assert( v >= seen );
+        seen = v;
+    }
+    vlc_join( th, NULL );
+
+    TestFilterDelete( flt );
+}
+
+struct bench
+{
+    filter_t *filter;
+    float *src;
+    float *buf;
+    unsigned i_channels;
+};
+
+static void BenchRun( void *opaque )
+{
+    struct bench *b = opaque;
+
+    memcpy( b->buf, b->src, 480 * b->i_channels * sizeof (float) );
+    EqzFilter( b->filter, b->buf, 480, b->i_channels );
+}
+
+/* 10 ms buffers at 48 kHz, as the audio output usually gets them */
+static void BenchFilters( void )
+{
+    static const unsigned channels[] = { 2, 6, 8 };
+    float buf[480 * EQZ_CHANNELS_MAX];
+
+    for( size_t c = 0; c < ARRAY_SIZE(channels); c++ )
+        for( size_t f = 0; f < ARRAY_SIZE(filters); f++ )
+        {
+            if( !af_cpu_usable( filters[f].cpu, filters[f].name ) )
+                continue;
+
+            for( int pass = 0; pass < 2; pass++ )
+            {
+                struct bench b = {
+                    .filter = TestFilter( filters[f].pf_filter, channels[c],
+                                          pass ),
+                    .src = af_signal( 48000, channels[c], 480, 100., .1 ),
+                    .buf = buf,
+                    .i_channels = channels[c],
+                };
+
+                double rate = af_bench( BenchRun, &b );
+                printf( "%-4s %u channels %d pass: %8.1fx realtime\n",
+                        filters[f].name, channels[c], pass + 1, rate * .010 );
+                free( b.src );
+                TestFilterDelete( b.filter );
+            }
+        }
+}
+
+const struct af_case af_tests[] =
+{
+    { "equalizer filters", TestFilters },
+    { "equalizer parameters updates", TestParams },
+    { NULL, NULL },
+};
+
+const struct af_case af_benches[] =
+{
+    { "equalizer filters", BenchFilters },
+    { NULL, NULL },
+};
@@ -0,0 +1,351 @@
+/*****************************************************************************
+ * format.c: PCM format conversions tests and benchmark
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+
+#include "../modules/audio_filter/converter/format.c"
+#include "harness.h"
+
+/* The plugin source includes config.h again, which defines NDEBUG */
+#undef NDEBUG
+#include <assert.h>
+
+#define TEST_SAMPLES 4099 /* not a multiple of any vector size */
+#define BENCH_SAMPLES 4096 /* 2048 stereo frames, as a decoder block */
+
+static const vlc_fourcc_t test_fourccs[] = {
+    VLC_CODEC_U8, VLC_CODEC_S16N, VLC_CODEC_S32N, VLC_CODEC_FL32, VLC_CODEC_FL64,
+};
+
+/* Full scale signal, with the clipping and rounding edge cases */
+static void *TestSignal(vlc_fourcc_t fourcc, size_t count)
+{
+    static const double edges[] = {
+        0., -0., 1., -1., 1.5, -1.5, 1e10, -1e10,
+        .5 / 32768., -.5 / 32768., 1.5 / 32768., -1.5 / 32768.,
+        32767.5 / 32768., -32768.5 / 32768.,
+        .5 / 2147483648., -.5 / 2147483648., 2.5 / 2147483648.,
+        -2.5 / 2147483648., 2147483647. / 2147483648.,
+        NAN, -NAN, INFINITY, -INFINITY,
+    };
+    const unsigned size = aout_BitsPerSample(fourcc) / 8;
+    uint8_t *buf = malloc(count * size);
+    uint32_t state = 0x12345678;
+
+    assert(buf != NULL);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t r = af_rand(&state);
+        double v = ((int32_t)r) / 2147483648. * 1.05;
+
+        if (i < ARRAY_SIZE(edges))
+            v = edges[i];
+
+        switch (fourcc)
+        {
+            case VLC_CODEC_U8:   buf[i] = r >> 24;                 break;
+            case VLC_CODEC_S16N: ((int16_t *)buf)[i] = r >> 16;    break;
+            case VLC_CODEC_S32N: ((int32_t *)buf)[i] = r;          break;
+            case VLC_CODEC_FL32: ((float *)buf)[i] = v;            break;
+            case VLC_CODEC_FL64: ((double *)buf)[i] = v;           break;
+        }
+    }
+    return buf;
+}
+
+static int FindC(vlc_fourcc_t src, vlc_fourcc_t dst)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(cvt_directs); i++)
+        if (cvt_directs[i].src == src && cvt_directs[i].dst == dst
+         && cvt_directs[i].cpu == 0 && !strcmp(cvt_directs[i].name, "c"))
+            return i;
+    return -1;
+}
+
+/* Converts out of place and in place, as the filter would do */
+static void *TestConvert(size_t idx, const void *src, size_t count)
+{
+    const unsigned src_size = aout_BitsPerSample(cvt_directs[idx].src) / 8;
+    const unsigned dst_size = aout_BitsPerSample(cvt_directs[idx].dst) / 8;
+    const size_t size = count * __MAX(src_size, dst_size);
+    uint8_t *out = malloc(size), *inplace = malloc(size);
+
+    assert(out != NULL && inplace != NULL);
+    cvt_directs[idx].convert(out, src, count);
+    memcpy(inplace, src, count * src_size);
+    cvt_directs[idx].convert(inplace, inplace, count);
+    assert(!memcmp(out, inplace, count * dst_size));
+    free(inplace);
+    return out;
+}
+
+static void TestConversions(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(cvt_directs); i++)
+    {
+        if (!af_cpu_usable(cvt_directs[i].cpu, cvt_directs[i].name))
+            continue;
+
+        int ref = FindC(cvt_directs[i].src, cvt_directs[i].dst);
+        assert(ref >= 0);
+
+        const unsigned dst_size = aout_BitsPerSample(cvt_directs[i].dst) / 8;
+        void *src = TestSignal(cvt_directs[i].src, TEST_SAMPLES);
+
+        for (size_t count = 0; count <= TEST_SAMPLES; count += count < 40 ? 1 : 1021)
+        {
+            void *expected = TestConvert(ref, src, count);
+            void *out = TestConvert(i, src, count);
+
+            assert(!memcmp(out, expected, count * dst_size));
+            free(out);
+            free(expected);
+        }
+        free(src);
+    }
+}
+
+static void TestDithers(void)
+{
+    float *src = TestSignal(VLC_CODEC_FL32, TEST_SAMPLES);
+    int16_t expected[TEST_SAMPLES], out[TEST_SAMPLES];
+    float *inplace = malloc(TEST_SAMPLES * sizeof (float));
+    uint32_t ref_state[DITHER_LANES], state[DITHER_LANES];
+
+    assert(inplace != NULL);
+    for (size_t i = 0; i < ARRAY_SIZE(cvt_dithers); i++)
+    {
+        if (!af_cpu_usable(cvt_dithers[i].cpu, cvt_dithers[i].name))
+            continue;
+
+        InitDither(ref_state);
+        InitDither(state);
+        /* the state carries over from one block to the next */
+        for (size_t count = 1; count <= TEST_SAMPLES; count += 511)
+        {
+            Fl32toS16Dither(expected, src, count, ref_state);
+            memcpy(inplace, src, count * sizeof (float));
+            cvt_dithers[i].dither(inplace, inplace, count, state);
+            assert(!memcmp(inplace, expected, count * sizeof (*out)));
+            assert(!memcmp(state, ref_state, sizeof (state)));
+        }
+
+        /* zero mean, at most one LSB away from the rounded value */
+        double sum = 0.;
+        Fl32toS16(expected, src, TEST_SAMPLES);
+        cvt_dithers[i].dither(out, src, TEST_SAMPLES, state);
+        for (size_t j = 0; j < TEST_SAMPLES; j++)
+        {
+            assert(abs(out[j] - expected[j]) <= 1);
+            sum += out[j] - expected[j];
+        }
+        assert(fabs(sum / TEST_SAMPLES) < .05);
+    }
+    free(inplace);
+    free(src);
+}
+
+static void TestInterleave(void)
+{
+    for (size_t f = 0; f < ARRAY_SIZE(test_fourccs); f++)
+    {
+        const vlc_fourcc_t fourcc = test_fourccs[f];
+        const unsigned size = aout_BitsPerSample(fourcc) / 8;
+
+        for (unsigned chans = 1; chans <= 8; chans++)
+        {
+            const unsigned samples = TEST_SAMPLES / chans;
+            uint8_t *src = TestSignal(fourcc, samples * chans);
+            uint8_t *planar = malloc(samples * chans * size);
+            uint8_t *out = malloc(samples * chans * size);
+            const void *planes[8];
+
+            assert(planar != NULL && out != NULL);
+            aout_Deinterleave(planar, src, samples, chans, fourcc);
+            for (unsigned c = 0; c < chans; c++)
+            {
+                planes[c] = planar + c * samples * size;
+                for (unsigned j = 0; j < samples; j++)
+                    assert(!memcmp(planar + (c * samples + j) * size,
+                                   src + (j * chans + c) * size, size));
+            }
+            aout_Interleave(out, planes, samples, chans, fourcc);
+            assert(!memcmp(out, src, samples * chans * size));
+            free(out);
+            free(planar);
+            free(src);
+        }
+    }
+}
+
+static void BenchReport(const char *name, vlc_fourcc_t src, vlc_fourcc_t dst,
+                        double samples)
+{
+    char pair[16];
+
+    if (src != dst)
+        snprintf(pair, sizeof (pair), "%4.4s->%4.4s", (const char *)&src,
+                 (const char *)&dst);
+    else
+        snprintf(pair, sizeof (pair), "%4.4s", (const char *)&src);
+    printf("%-10s %-13s: %8.1f Msamples/s\n", pair, name, samples / 1e6);
+}
+
+struct bench
+{
+    size_t idx;
+    void *src, *buf;
+    uint32_t state[DITHER_LANES];
+};
+
+static void BenchConvert(void *opaque)
+{
+    struct bench *b = opaque;
+    const vlc_fourcc_t fourcc = cvt_directs[b->idx].src;
+
+    /* in place, as most conversions run */
+    memcpy(b->buf, b->src, BENCH_SAMPLES * aout_BitsPerSample(fourcc) / 8);
+    cvt_directs[b->idx].convert(b->buf, b->buf, BENCH_SAMPLES);
+}
+
+static void BenchConversions(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(cvt_directs); i++)
+    {
+        if (!af_cpu_usable(cvt_directs[i].cpu, cvt_directs[i].name))
+            continue;
+
+        const unsigned src_size = aout_BitsPerSample(cvt_directs[i].src) / 8;
+        const unsigned dst_size = aout_BitsPerSample(cvt_directs[i].dst) / 8;
+        struct bench b = {
+            .idx = i,
+            .src = TestSignal(cvt_directs[i].src, BENCH_SAMPLES),
+            .buf = malloc(BENCH_SAMPLES * __MAX(src_size, dst_size)),
+        };
+
+        assert(b.buf != NULL);
+        BenchReport(cvt_directs[i].name, cvt_directs[i].src,
+                    cvt_directs[i].dst,
+                    af_bench(BenchConvert, &b) * BENCH_SAMPLES);
+        free(b.buf);
+        free(b.src);
+    }
+}
+
+static void BenchDither(void *opaque)
+{
+    struct bench *b = opaque;
+
+    memcpy(b->buf, b->src, BENCH_SAMPLES * sizeof (float));
+    cvt_dithers[b->idx].dither(b->buf, b->buf, BENCH_SAMPLES, b->state);
+}
+
+static void BenchDithers(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(cvt_dithers); i++)
+    {
+        if (!af_cpu_usable(cvt_dithers[i].cpu, cvt_dithers[i].name))
+            continue;
+
+        struct bench b = {
+            .idx = i,
+            .src = TestSignal(VLC_CODEC_FL32, BENCH_SAMPLES),
+            .buf = malloc(BENCH_SAMPLES * sizeof (float)),
+        };
+        char name[16];
+
+        assert(b.buf != NULL);
+        InitDither(b.state);
+        snprintf(name, sizeof (name), "%s dither", cvt_dithers[i].name);
+        BenchReport(name, VLC_CODEC_FL32, VLC_CODEC_S16N,
+                    af_bench(BenchDither, &b) * BENCH_SAMPLES);
+        free(b.buf);
+        free(b.src);
+    }
+}
+
+struct bench_interleave
+{
+    vlc_fourcc_t fourcc;
+    unsigned samples, chans;
+    void *src, *planar;
+    const void *planes[8];
+};
+
+static void BenchInterleaveRun(void *opaque)
+{
+    struct bench_interleave *b = opaque;
+
+    aout_Deinterleave(b->planar, b->src, b->samples, b->chans, b->fourcc);
+    aout_Interleave(b->src, b->planes, b->samples, b->chans, b->fourcc);
+}
+
+static void BenchInterleave(void)
+{
+    static const unsigned channels[] = { 2, 6 };
+
+    for (size_t f = 0; f < ARRAY_SIZE(test_fourccs); f++)
+        for (size_t c = 0; c < ARRAY_SIZE(channels); c++)
+        {
+            const vlc_fourcc_t fourcc = test_fourccs[f];
+            const unsigned size = aout_BitsPerSample(fourcc) / 8;
+            const unsigned chans = channels[c];
+            const unsigned samples = BENCH_SAMPLES / chans;
+            struct bench_interleave b = {
+                .fourcc = fourcc,
+                .samples = samples,
+                .chans = chans,
+                .src = TestSignal(fourcc, samples * chans),
+                .planar = malloc(samples * chans * size),
+            };
+            char name[16];
+
+            assert(b.planar != NULL);
+            for (unsigned i = 0; i < chans; i++)
+                b.planes[i] = (uint8_t *)b.planar + i * samples * size;
+
+            snprintf(name, sizeof (name), "%u ch (de)int", chans);
+            BenchReport(name, fourcc, fourcc,
+                        af_bench(BenchInterleaveRun, &b) * 2 * samples * chans);
+            free(b.planar);
+            free(b.src);
+        }
+}
+
+const struct af_case af_tests[] =
+{
+    { "conversions", TestConversions },
+    { "dithered conversions", TestDithers },
+    { "(de)interleaving", TestInterleave },
+    { NULL, NULL },
+};
+
+const struct af_case af_benches[] =
+{
+    { "conversions", BenchConversions },
+    { "dithered conversions", BenchDithers },
+    { "(de)interleaving", BenchInterleave },
+    { NULL, NULL },
+};
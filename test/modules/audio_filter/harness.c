@@ -0,0 +1,146 @@
+/*****************************************************************************
+ * harness.c: shared harness for the audio filters kernels tests
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#include "harness.h"
+
+#define AF_TEST_TIMEOUT 60 /* seconds */
+#define AF_BENCH_TIME VLC_TICK_FROM_MS(300)
+
+bool af_cpu_usable(unsigned cpu, const char *name)
+{
+    static const char *skipped[16];
+    static size_t skipped_count = 0;
+
+    if ((vlc_CPU() & cpu) == cpu)
+        return true;
+
+    for (size_t i = 0; i < skipped_count; i++)
+        if (!strcmp(skipped[i], name))
+            return false;
+    if (skipped_count < ARRAY_SIZE(skipped))
+        skipped[skipped_count++] = name;
+    fprintf(stderr, "%s: not supported by this CPU, skipped\n", name);
+    return false;
+}
+
+uint32_t af_rand(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+float af_noise(uint32_t *state)
+{
+    return af_rand(state) / 4294967296.f - .5f;
+}
+
+float *af_signal(unsigned rate, unsigned channels, size_t frames,
+                 double freq, double noise)
+{
+    float *buf = vlc_alloc(frames * channels, sizeof (float));
+    uint32_t state = 0x12345678;
+    assert(buf != NULL);
+
+    for (size_t i = 0; i < frames; i++)
+        for (unsigned c = 0; c < channels; c++)
+        {
+            double t = (double)i / rate;
+            double v = .5 * sin(2. * M_PI * freq * (1. + .1 * c) * t);
+            if (noise > 0.)
+                v += .2 * sin(2. * M_PI * 7013. * t)
+                   + noise * af_noise(&state);
+            buf[i * channels + c] = v;
+        }
+    return buf;
+}
+
+filter_t *af_filter_New(unsigned in_rate, unsigned out_rate,
+                        unsigned channels)
+{
+    filter_t *filter = calloc(1, sizeof (*filter));
+    assert(filter != NULL);
+
+    filter->obj.flags = OBJECT_FLAGS_QUIET;
+    es_format_Init(&filter->fmt_in, AUDIO_ES, VLC_CODEC_FL32);
+    filter->fmt_in.audio.i_format = VLC_CODEC_FL32;
+    filter->fmt_in.audio.i_rate = in_rate;
+    filter->fmt_in.audio.i_channels = channels;
+    filter->fmt_in.audio.i_bitspersample = 32;
+    filter->fmt_in.audio.i_bytes_per_frame = 4 * channels;
+    filter->fmt_in.audio.i_frame_length = 1;
+    filter->fmt_out = filter->fmt_in;
+    filter->fmt_out.audio.i_rate = out_rate;
+    return filter;
+}
+
+void af_filter_Delete(filter_t *filter)
+{
+    free(filter);
+}
+
+double af_bench(void (*run)(void *), void *opaque)
+{
+    vlc_tick_t start = vlc_tick_now(), elapsed;
+    unsigned count = 0;
+
+    do {
+        run(opaque);
+        count++;
+        elapsed = vlc_tick_now() - start;
+    } while (elapsed < AF_BENCH_TIME);
+
+    return count / secf_from_vlc_tick(elapsed);
+}
+
+int main(void)
+{
+#ifndef AF_BENCH
+    alarm(AF_TEST_TIMEOUT);
+    for (size_t i = 0; af_tests[i].name != NULL; i++)
+    {
+        fprintf(stderr, "%s\n", af_tests[i].name);
+        af_tests[i].run();
+    }
+#else
+    for (size_t i = 0; af_benches[i].name != NULL; i++)
+    {
+        printf("%s\n", af_benches[i].name);
+        af_benches[i].run();
+    }
+#endif
+    return 0;
+}
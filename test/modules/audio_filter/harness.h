@@ -0,0 +1,88 @@
+/*****************************************************************************
+ * harness.h: shared harness for the audio filters kernels tests
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_TEST_AUDIO_FILTER_HARNESS_H
+#define VLC_TEST_AUDIO_FILTER_HARNESS_H
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_tick.h>
+
+/**
+ * Each program includes the plugin source, and lists its test and benchmark
+ * cases, each list ending with an empty case. The harness provides main():
+ * it runs the tests, or the benchmarks if built with AF_BENCH.
+ */
+struct af_case
+{
+    const char *name;
+    void (*run)(void);
+};
+
+extern const struct af_case af_tests[];
+extern const struct af_case af_benches[];
+
+/**
+ * Checks if the CPU runs a kernel needing the given vlc_CPU() flags.
+ * Unsupported kernels are reported once as skipped.
+ */
+bool af_cpu_usable(unsigned cpu, const char *name);
+
+/**
+ * Pseudo-random numbers, the same on every run (xorshift32).
+ */
+uint32_t af_rand(uint32_t *state);
+
+/**
+ * Uniform noise in [-0.5, 0.5].
+ */
+float af_noise(uint32_t *state);
+
+/**
+ * Interleaved test signal, the same on every run: a sine at freq Hz, a
+ * tenth higher on each channel, plus a 7013 Hz partial and uniform noise of
+ * the given amplitude if that is not zero.
+ *
+ * \return a buffer of frames * channels samples, to be freed with free()
+ */
+float *af_signal(unsigned rate, unsigned channels, size_t frames,
+                 double freq, double noise);
+
+/**
+ * Creates a filter object outside of any module, so that the tests can
+ * call the plugin functions directly. Its input and output are interleaved
+ * float at the given rates, and its messages are not printed.
+ */
+filter_t *af_filter_New(unsigned in_rate, unsigned out_rate,
+                        unsigned channels);
+
+/**
+ * Deletes a filter created with af_filter_New(), but not its private data.
+ */
+void af_filter_Delete(filter_t *);
+
+/**
+ * Runs a function repeatedly for a fixed time.
+ *
+ * \return the number of runs per second
+ */
+double af_bench(void (*run)(void *), void *opaque);
+
+#endif
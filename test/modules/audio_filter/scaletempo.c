@@ -0,0 +1,241 @@
+/*****************************************************************************
+ * scaletempo.c: scaletempo overlap search tests and benchmark
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+
+#include "../modules/audio_filter/scaletempo.c"
+#include "harness.h"
+
+/* The plugin source includes config.h again, which defines NDEBUG */
+#undef NDEBUG
+#include <assert.h>
+
+/* Voiced speech like signals: a gliding fundamental with decaying
+ * harmonics, a little vibrato and some noise */
+static float *TestSpeech( unsigned rate, unsigned channels, unsigned frames,
+                          float f0 )
+{
+    float *buf = vlc_alloc( frames * channels, sizeof (float) );
+    uint32_t state = 0x12345678;
+    assert( buf != NULL );
+
+    double phase = 0.;
+    for( unsigned i = 0; i < frames; i++ )
+    {
+        double t = (double)i / rate;
+        double f = f0 * ( 1. + .2 * t ) * ( 1. + .01 * sin( 2. * M_PI * 5. * t ) );
+        float v = 0.f;
+
+        phase += 2. * M_PI * f / rate;
+        for( unsigned h = 1; h <= 12; h++ )
+            v += sin( h * phase ) / h;
+        for( unsigned c = 0; c < channels; c++ )
+            buf[i * channels + c] = .2f * v * ( 1.f - .3f * c )
+                                  + af_noise( &state ) * .01f;
+    }
+    return buf;
+}
+
+static filter_t *TestFilter( unsigned rate, unsigned channels, double scale,
+                             unsigned decimate )
+{
+    filter_t *filter = af_filter_New( rate, rate, channels );
+    filter_sys_t *p = calloc( 1, sizeof (*p) );
+    assert( p != NULL );
+
+    filter->p_sys = p;
+    p->scale             = scale;
+    p->sample_rate       = rate;
+    p->samples_per_frame = channels;
+    p->bytes_per_sample  = 4;
+    p->bytes_per_frame   = channels * 4;
+    p->ms_stride         = 30;
+    p->percent_overlap   = .20;
+    p->ms_search         = 14;
+    p->frames_decimate   = decimate;
+    assert( reinit_buffers( filter ) == VLC_SUCCESS );
+    return filter;
+}
+
+static void TestFilterDelete( filter_t *filter )
+{
+    Close( VLC_OBJECT(filter) );
+    af_filter_Delete( filter );
+}
+
+/* Loads the queue and the overlap as the main loop would at a given
+ * input position */
+static void TestLoad( filter_sys_t *p, const float *signal, unsigned frame )
+{
+    const float *in = signal + frame * p->samples_per_frame;
+
+    memcpy( p->buf_overlap, in, p->bytes_overlap );
+    in += lround( p->frames_stride_scaled ) * p->samples_per_frame;
+    memcpy( p->buf_queue, in, p->bytes_queue_max );
+}
+
+static float TestCorr( filter_sys_t *p, unsigned bytes_off )
+{
+    return corr_float_c( p->buf_pre_corr,
+                         (float *)( p->buf_queue + bytes_off ) + p->samples_per_frame,
+                         p->samples_overlap - p->samples_per_frame );
+}
+
+static const struct
+{
+    unsigned rate, channels;
+    float    f0;
+    double   scale;
+} tests[] =
+{
+    { 48000, 2, 110.f, 1.25 },
+    { 48000, 2, 220.f, 1.5 },
+    { 44100, 1, 140.f, 2.0 },
+    { 16000, 1, 180.f, 1.25 },
+    { 48000, 6, 120.f, 1.75 },
+};
+
+/* Compares the offsets found with a kernel, exhaustively or on decimated
+ * frames, with those of the exhaustive C search */
+static void TestOffsets( unsigned t, unsigned decimate,
+                         float (*kernel)( const float *, const float *, unsigned ) )
+{
+    const unsigned rate = tests[t].rate, channels = tests[t].channels;
+    const unsigned frames = rate * 2;
+    float *signal = TestSpeech( rate, channels, frames, tests[t].f0 );
+    filter_t *ref = TestFilter( rate, channels, tests[t].scale, 1 );
+    filter_t *flt = TestFilter( rate, channels, tests[t].scale, decimate );
+    filter_sys_t *pr = ref->p_sys, *pf = flt->p_sys;
+    double quality = 0.;
+    unsigned count = 0;
+
+    pr->corr = corr_float_c;
+    pf->corr = kernel;
+    for( unsigned frame = 0;
+         frame + lround( pr->frames_stride_scaled ) +
+             pr->bytes_queue_max / pr->bytes_per_frame < frames;
+         frame += pr->bytes_stride / pr->bytes_per_frame )
+    {
+        TestLoad( pr, signal, frame );
+        TestLoad( pf, signal, frame );
+
+        unsigned ref_off = pr->best_overlap_offset( ref );
+        float ref_corr = TestCorr( pr, ref_off );
+        unsigned off = pf->best_overlap_offset( flt );
+        float corr = TestCorr( pr, off );
+
+        /* the vectorized kernels only change the summation order */
+        if( decimate == 1 )
+            assert( off == ref_off
+                 || fabsf( corr - ref_corr ) <= 1e-4f * fabsf( ref_corr ) );
+        else
+        {
+            assert( corr <= ref_corr * ( 1.f + 1e-4f ) );
+            quality += corr / ref_corr;
+        }
+        count++;
+    }
+
+    if( decimate > 1 )
+    {
+        quality /= count;
+        fprintf( stderr, "%5u Hz %u ch x%.2f 1/%u: %.4f quality\n",
+                 rate, channels, tests[t].scale, decimate, quality );
+        assert( quality >= .998 );
+    }
+
+    TestFilterDelete( flt );
+    TestFilterDelete( ref );
+    free( signal );
+}
+
+static void TestExact( void )
+{
+    for( size_t i = 0; i < ARRAY_SIZE(corr_kernels); i++ )
+    {
+        if( !af_cpu_usable( corr_kernels[i].cpu, corr_kernels[i].name ) )
+            continue;
+        for( size_t t = 0; t < ARRAY_SIZE(tests); t++ )
+            TestOffsets( t, 1, corr_kernels[i].corr );
+    }
+}
+
+static void TestCoarse( void )
+{
+    for( size_t t = 0; t < ARRAY_SIZE(tests); t++ )
+    {
+        TestOffsets( t, 2, corr_float_c );
+        TestOffsets( t, 4, corr_float_c );
+    }
+}
+
+static void BenchSearch( void *opaque )
+{
+    filter_t *flt = opaque;
+    filter_sys_t *p = flt->p_sys;
+
+    p->best_overlap_offset( flt );
+}
+
+/* The default parameters on 48 kHz stereo at 1.5x */
+static void BenchOffsets( void )
+{
+    float *signal = TestSpeech( 48000, 2, 48000, 150.f );
+
+    for( size_t i = 0; i < ARRAY_SIZE(corr_kernels); i++ )
+    {
+        if( !af_cpu_usable( corr_kernels[i].cpu, corr_kernels[i].name ) )
+            continue;
+
+        for( unsigned decimate = 1; decimate <= 4; decimate *= 4 )
+        {
+            filter_t *flt = TestFilter( 48000, 2, 1.5, decimate );
+            filter_sys_t *p = flt->p_sys;
+
+            p->corr = corr_kernels[i].corr;
+            TestLoad( p, signal, 0 );
+
+            /* each search outputs one 30 ms stride */
+            double rate = af_bench( BenchSearch, flt );
+            printf( "%-4s 1/%u: %8.1f strides/s, %6.1fx realtime\n",
+                    corr_kernels[i].name, decimate, rate, rate * .030 );
+            TestFilterDelete( flt );
+        }
+    }
+    free( signal );
+}
+
+const struct af_case af_tests[] =
+{
+    { "exhaustive overlap search", TestExact },
+    { "coarse overlap search", TestCoarse },
+    { NULL, NULL },
+};
+
+const struct af_case af_benches[] =
+{
+    { "overlap search", BenchOffsets },
+    { NULL, NULL },
+};
@@ -0,0 +1,168 @@
+/*****************************************************************************
+ * annexb_bench.c: AnnexB scanning benchmarks
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_tick.h>
+
+#include "../modules/packetizer/startcode_helper.h"
+#include "../modules/packetizer/hxxx_ep3b.h"
+
+/* An intra-only 150 Mbit/s stream at 25 fps: 750 kB pictures in 4 slices */
+#define BENCH_SLICE_SIZE (750 * 1000 / 4)
+#define BENCH_SLICES     64
+
+typedef const uint8_t *(*find_cb)(const uint8_t *, const uint8_t *);
+typedef size_t (*skip_cb)(const uint8_t *, const uint8_t *);
+
+static uint32_t bench_rand( uint32_t *state )
+{
+    /* xorshift32, CABAC output is close enough to random */
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/* Random slices data with emulation prevention, behind 4 bytes startcodes */
+static uint8_t *bench_stream( size_t *pi_size, size_t *pi_nals )
+{
+    size_t i_max = BENCH_SLICES * (BENCH_SLICE_SIZE * 3 / 2 + 5);
+    uint8_t *p_stream = malloc( i_max );
+    assert( p_stream );
+
+    uint32_t state = 0x12345678;
+    size_t i = 0;
+    for( unsigned n = 0; n < BENCH_SLICES; n++ )
+    {
+        unsigned i_zeros = 0;
+
+        memcpy( &p_stream[i], "\x00\x00\x00\x01\x65", 5 );
+        i += 5;
+        for( unsigned j = 0; j < BENCH_SLICE_SIZE; j++ )
+        {
+            uint8_t b = bench_rand( &state );
+            if( i_zeros >= 2 && b <= 0x03 )
+            {
+                p_stream[i++] = 0x03;
+                i_zeros = 0;
+            }
+            p_stream[i++] = b;
+            i_zeros = b ? 0 : i_zeros + 1;
+        }
+        /* rbsp_trailing_bits */
+        p_stream[i++] = 0x80;
+    }
+    *pi_size = i;
+    *pi_nals = BENCH_SLICES;
+    return p_stream;
+}
+
+static void bench_find( const char *psz_name, find_cb pf_find,
+                        const uint8_t *p_stream, size_t i_stream, size_t i_nals )
+{
+    const uint8_t *p_end = &p_stream[i_stream];
+    size_t i_bytes = 0;
+    vlc_tick_t start = vlc_tick_now(), elapsed;
+
+    do
+    {
+        size_t i_found = 0;
+        for( const uint8_t *p = p_stream; (p = pf_find( p, p_end )) != NULL; p += 3 )
+            i_found++;
+        assert( i_found == i_nals );
+        i_bytes += i_stream;
+        elapsed = vlc_tick_now() - start;
+    }
+    while( elapsed < VLC_TICK_FROM_MS(500) );
+
+    printf( "startcode %-6s: %8.1f MB/s\n", psz_name,
+            i_bytes / secf_from_vlc_tick( elapsed ) / 1e6 );
+}
+
+static size_t bench_skip_none( const uint8_t *p, const uint8_t *p_end )
+{
+    VLC_UNUSED(p); VLC_UNUSED(p_end);
+    return 0;
+}
+
+static void bench_ep3b( const char *psz_name, skip_cb pf_skip,
+                        const uint8_t *p_stream, size_t i_stream )
+{
+    const uint8_t *p_end = &p_stream[i_stream];
+    size_t i_bytes = 0;
+    vlc_tick_t start = vlc_tick_now(), elapsed;
+
+    do
+    {
+        /* Slices, as given to the headers parsers */
+        const uint8_t *p = startcode_FindAnnexB( p_stream, p_end );
+        while( p != NULL )
+        {
+            const uint8_t *p_nal = p + 3;
+            p = startcode_FindAnnexB( p_nal, p_end );
+            const uint8_t *p_nal_end = p ? p - 1 : p_end;
+
+            size_t i_size = hxxx_ep3b_total_size_skip( p_nal, p_nal_end, pf_skip );
+            assert( i_size > BENCH_SLICE_SIZE );
+        }
+        i_bytes += i_stream;
+        elapsed = vlc_tick_now() - start;
+    }
+    while( elapsed < VLC_TICK_FROM_MS(500) );
+
+    printf( "ep3b      %-6s: %8.1f MB/s\n", psz_name,
+            i_bytes / secf_from_vlc_tick( elapsed ) / 1e6 );
+}
+
+int main( void )
+{
+    size_t i_stream, i_nals;
+    uint8_t *p_stream = bench_stream( &i_stream, &i_nals );
+
+    bench_find( "C", startcode_FindAnnexB_Bits, p_stream, i_stream, i_nals );
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    if( vlc_CPU_SSE2() )
+        bench_find( "SSE2", startcode_FindAnnexB_SSE2, p_stream, i_stream, i_nals );
+#endif
+#if defined(HAVE_AVX2_INTRINSICS)
+    if( vlc_CPU_AVX2() )
+        bench_find( "AVX2", startcode_FindAnnexB_AVX2, p_stream, i_stream, i_nals );
+#endif
+
+    bench_ep3b( "C", bench_skip_none, p_stream, i_stream );
+#if defined(HAVE_SSE2_INTRINSICS)
+    if( vlc_CPU_SSE2() )
+        bench_ep3b( "SSE2", hxxx_ep3b_skip_SSE2, p_stream, i_stream );
+#endif
+#if defined(HAVE_AVX2_INTRINSICS)
+    if( vlc_CPU_AVX2() )
+        bench_ep3b( "AVX2", hxxx_ep3b_skip_AVX2, p_stream, i_stream );
+#endif
+
+    free( p_stream );
+    return 0;
+}
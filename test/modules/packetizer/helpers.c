@@ -87,6 +87,28 @@ static int run_annexb_sets( const uint8_t *p_set, const uint8_t *p_end,
     }
     else printf("asm not built in, skipping test:\n");
 
+    /* And on every variant the CPU can run, not only the preferred one */
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    if( vlc_CPU_SSE2() )
+    {
+        printf("checking SSE2:\n");
+        i_ret = check_set( p_set, p_end, p_results, i_results, i_results_offset,
+                           startcode_FindAnnexB_SSE2 );
+        if( i_ret != 0 )
+            return i_ret;
+    }
+#endif
+#if defined(HAVE_AVX2_INTRINSICS)
+    if( vlc_CPU_AVX2() )
+    {
+        printf("checking AVX2:\n");
+        i_ret = check_set( p_set, p_end, p_results, i_results, i_results_offset,
+                           startcode_FindAnnexB_AVX2 );
+        if( i_ret != 0 )
+            return i_ret;
+    }
+#endif
+
     return 0;
 }
 
@@ -129,6 +151,25 @@ int main( void )
                                  p_data + 4096,
                                  test1_results, ARRAY_SIZE(test1_results),
                                  i_dataoffset );
+        if( i_ret != 0 )
+        {
+            free( p_data );
+            return i_ret;
+        }
+
+        /* Move the set across all the vector boundaries */
+        for( ssize_t i_offset = 0; i_offset < 64; i_offset++ )
+        {
+            memset( p_data, 0x42, 4096 );
+            memcpy( &p_data[i_offset], test1_annexbdata, sizeof(test1_annexbdata) );
+            printf("* Running tests on set 1 at offset %zd:\n", i_offset);
+            i_ret = run_annexb_sets( p_data,
+                                     p_data + i_offset + sizeof(test1_annexbdata),
+                                     test1_results, ARRAY_SIZE(test1_results),
+                                     i_offset );
+            if( i_ret != 0 )
+                break;
+        }
         free( p_data );
         if( i_ret != 0 )
             return i_ret;
@@ -31,6 +31,7 @@
 #include <vlc_block.h>
 #include "../modules/packetizer/hxxx_nal.h"
 #include "../modules/packetizer/hxxx_nal.c"
+#include "../modules/packetizer/hxxx_ep3b.h"
 
 static void test_iterators( const uint8_t *p_ab, size_t i_ab, /* AnnexB */
                             const uint8_t **pp_prefix, size_t *pi_prefix /* Prefixed */ )
@@ -213,9 +214,47 @@ static void test_annexb()
     test_iterators( NULL, 0, p_res, rgi_res );
 }
 
+static size_t ep3b_skip_none( const uint8_t *p, const uint8_t *p_end )
+{
+    VLC_UNUSED(p); VLC_UNUSED(p_end);
+    return 0;
+}
+
+static void test_ep3b( void )
+{
+    /* Mostly zeros and escapes, at every alignment */
+    static const uint8_t alphabet[] = { 0x00, 0x00, 0x00, 0x03, 0x03, 0x01, 0x55 };
+    uint8_t buf[300];
+
+    srand( 0 );
+    printf("\nTEST ep3b total size\n");
+    for( unsigned i = 0; i < 2000; i++ )
+    {
+        size_t i_buf = rand() % sizeof(buf);
+        bool b_sparse = i & 1;
+
+        for( size_t j = 0; j < i_buf; j++ )
+        {
+            if( b_sparse && rand() % 32 )
+                buf[j] = 0x55;
+            else
+                buf[j] = alphabet[rand() % ARRAY_SIZE(alphabet)];
+        }
+
+        size_t i_ref = hxxx_ep3b_total_size_skip( buf, buf + i_buf, ep3b_skip_none );
+        size_t i_size = hxxx_ep3b_total_size( buf, buf + i_buf );
+        if( i_ref != i_size )
+        {
+            printf("size %zu: expected %zu, got %zu\n", i_buf, i_ref, i_size );
+            assert( i_ref == i_size );
+        }
+    }
+}
+
 int main( void )
 {
     test_annexb();
+    test_ep3b();
 
     return 0;
 }
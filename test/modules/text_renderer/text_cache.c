@@ -0,0 +1,252 @@
+/*****************************************************************************
+ * text_cache.c: FreeType glyph and layout caches test
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include "../modules/text_renderer/freetype/text_cache.c"
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+const char vlc_module_name[] = "test";
+
+/* The layout code is not linked in: count the lines released by the cache */
+static unsigned freed_lines;
+
+void FreeLines(line_desc_t *p_lines)
+{
+    while (p_lines != NULL)
+    {
+        line_desc_t *p_next = p_lines->p_next;
+
+        free(p_lines);
+        freed_lines++;
+        p_lines = p_next;
+    }
+}
+
+/*
+ * Glyphs
+ */
+static FT_Library library;
+static FT_FaceRec faces[2]; /* only compared, never used */
+
+static glyph_cache_key_t glyph_key(unsigned face, unsigned index)
+{
+    return (glyph_cache_key_t) {
+        .p_face = &faces[face],
+        .i_glyph_index = index,
+    };
+}
+
+static void glyph_put(text_cache_t *cache, glyph_cache_key_t key, bool outline)
+{
+    glyph_cache_value_t value = {
+        .i_x_advance = key.i_glyph_index * 64,
+        .i_y_advance = key.i_outline_radius,
+    };
+
+    assert(FT_New_Glyph(library, FT_GLYPH_FORMAT_OUTLINE,
+                        &value.p_glyph) == 0);
+    if (outline)
+        assert(FT_New_Glyph(library, FT_GLYPH_FORMAT_OUTLINE,
+                            &value.p_outline) == 0);
+
+    GlyphCachePut(cache, &key, &value);
+
+    /* The cache keeps copies */
+    FT_Done_Glyph(value.p_glyph);
+    if (outline)
+        FT_Done_Glyph(value.p_outline);
+}
+
+static bool glyph_cached(text_cache_t *cache, glyph_cache_key_t key)
+{
+    const glyph_cache_value_t *value = GlyphCacheGet(cache, &key);
+
+    if (value == NULL)
+        return false;
+    assert(value->p_glyph != NULL);
+    assert(value->i_x_advance == (FT_Pos)key.i_glyph_index * 64);
+    assert(value->i_y_advance == key.i_outline_radius);
+    assert((value->p_outline != NULL) == (key.i_outline_radius != 0));
+    return true;
+}
+
+static void test_glyphs(filter_t *filter)
+{
+    text_cache_t *cache = TextCacheNew();
+    assert(cache != NULL);
+
+    for (unsigned i = 0; i < GLYPH_CACHE_SIZE; i++)
+        glyph_put(cache, glyph_key(0, i), false);
+    for (unsigned i = 0; i < GLYPH_CACHE_SIZE; i++)
+        assert(glyph_cached(cache, glyph_key(0, i)));
+
+    /* Every part of the key matters */
+    glyph_cache_key_t key = glyph_key(1, 0);
+    assert(!glyph_cached(cache, key));
+    key = glyph_key(0, 0);
+    key.i_style_flags = STYLE_BOLD;
+    assert(!glyph_cached(cache, key));
+    key = glyph_key(0, 0);
+    key.i_style_flags = STYLE_OUTLINE;
+    key.i_outline_radius = 64;
+    assert(!glyph_cached(cache, key));
+
+    /* The least recently used glyph goes first */
+    assert(glyph_cached(cache, glyph_key(0, 0)));
+    glyph_put(cache, key, true);
+    assert(glyph_cached(cache, key));
+    assert(glyph_cached(cache, glyph_key(0, 0)));
+    assert(!glyph_cached(cache, glyph_key(0, 1)));
+    assert(glyph_cached(cache, glyph_key(0, 2)));
+
+    TextCacheDelete(filter, cache);
+}
+
+/*
+ * Layouts
+ */
+static layout_cache_key_t layout_key(const char *text, int font_size)
+{
+    size_t count = strlen(text);
+    layout_cache_key_t key = {
+        .p_uchars = malloc(count * sizeof (uni_char_t)),
+        .pp_styles = malloc(count * sizeof (text_style_t *)),
+        .i_count = count,
+        .i_max_width = 640,
+        .i_max_height = 480,
+        .i_scale = 100,
+        .i_video_width = 1280,
+        .i_video_height = 720,
+    };
+    assert(key.p_uchars != NULL && key.pp_styles != NULL);
+
+    /* A fresh style every time: styles are compared by value */
+    text_style_t *style = text_style_Create(STYLE_NO_DEFAULTS);
+    assert(style != NULL);
+    style->i_font_size = font_size;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        key.p_uchars[i] = (unsigned char)text[i];
+        key.pp_styles[i] = style;
+    }
+    return key;
+}
+
+static void layout_key_clean(layout_cache_key_t *key)
+{
+    text_style_Delete(key->pp_styles[0]);
+    free(key->pp_styles);
+    free(key->p_uchars);
+}
+
+static void layout_put(text_cache_t *cache, const char *text, int font_size)
+{
+    layout_cache_key_t key = layout_key(text, font_size);
+    layout_cache_value_t value = {
+        .p_lines = calloc(1, sizeof (line_desc_t)),
+        .i_max_face_height = font_size,
+    };
+    assert(value.p_lines != NULL);
+
+    /* The cache takes ownership of the key arrays and of the lines */
+    assert(LayoutCachePut(cache, &key, &value) == VLC_SUCCESS);
+}
+
+static bool layout_cached(text_cache_t *cache, const char *text,
+                          int font_size, unsigned max_width)
+{
+    layout_cache_key_t key = layout_key(text, font_size);
+    key.i_max_width = max_width;
+
+    const layout_cache_value_t *value = LayoutCacheGet(cache, &key);
+    assert(value == NULL || value->i_max_face_height == font_size);
+    layout_key_clean(&key);
+    return value != NULL;
+}
+
+static void test_layouts(filter_t *filter)
+{
+    char text[16];
+    text_cache_t *cache = TextCacheNew();
+    assert(cache != NULL);
+
+    freed_lines = 0;
+    for (unsigned i = 0; i < LAYOUT_CACHE_SIZE; i++)
+    {
+        sprintf(text, "line %u", i);
+        layout_put(cache, text, 20);
+    }
+
+    for (unsigned i = 0; i < LAYOUT_CACHE_SIZE; i++)
+    {
+        sprintf(text, "line %u", i);
+        assert(layout_cached(cache, text, 20, 640));
+        /* Same text, other style or other constraints */
+        assert(!layout_cached(cache, text, 24, 640));
+        assert(!layout_cached(cache, text, 20, 320));
+    }
+    assert(!layout_cached(cache, "line", 20, 640));
+    assert(freed_lines == 0);
+
+    /* The least recently used layout goes first, and is released */
+    assert(layout_cached(cache, "line 0", 20, 640));
+    layout_put(cache, "ticker", 20);
+    assert(freed_lines == 1);
+    assert(layout_cached(cache, "ticker", 20, 640));
+    assert(layout_cached(cache, "line 0", 20, 640));
+    assert(!layout_cached(cache, "line 1", 20, 640));
+    assert(layout_cached(cache, "line 2", 20, 640));
+
+    /* Everything else is released with the cache */
+    TextCacheDelete(filter, cache);
+    assert(freed_lines == LAYOUT_CACHE_SIZE + 1);
+}
+
+int main(void)
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs,
+                                        test_defaults_args);
+    assert(vlc != NULL);
+
+    filter_t *filter = vlc_object_create(vlc->p_libvlc_int, sizeof (*filter));
+    assert(filter != NULL);
+    assert(FT_Init_FreeType(&library) == 0);
+
+    test_glyphs(filter);
+    test_layouts(filter);
+
+    FT_Done_FreeType(library);
+    vlc_object_release(filter);
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,222 @@
+/*****************************************************************************
+ * chain.c: chroma conversion and resizing chain test
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_modules.h>
+#include <vlc_picture.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+#define MAX_STEPS 8
+
+static picture_t *BufferNew(filter_t *filter)
+{
+    return picture_NewFromFormat(&filter->fmt_out.video);
+}
+
+static const struct filter_video_callbacks cbs = {
+    .buffer_new = BufferNew,
+};
+
+static void SetupFormat(es_format_t *fmt, vlc_fourcc_t chroma,
+                        unsigned width, unsigned height)
+{
+    video_format_t video;
+
+    video_format_Init(&video, chroma);
+    video_format_Setup(&video, chroma, width, height, width, height, 1, 1);
+    video_format_FixRgb(&video);
+    es_format_InitFromVideo(fmt, &video);
+    video_format_Clean(&video);
+}
+
+static filter_t *CreateConverter(vlc_object_t *parent,
+                                 vlc_fourcc_t in_chroma,
+                                 unsigned in_width, unsigned in_height,
+                                 vlc_fourcc_t out_chroma,
+                                 unsigned out_width, unsigned out_height)
+{
+    filter_t *filter = vlc_object_create(parent, sizeof (*filter));
+    assert(filter != NULL);
+
+    SetupFormat(&filter->fmt_in, in_chroma, in_width, in_height);
+    SetupFormat(&filter->fmt_out, out_chroma, out_width, out_height);
+    filter->owner.video = &cbs;
+    return filter;
+}
+
+static void DeleteConverter(filter_t *filter)
+{
+    es_format_Clean(&filter->fmt_in);
+    es_format_Clean(&filter->fmt_out);
+    vlc_object_release(filter);
+}
+
+static bool Resizes(const filter_t *filter)
+{
+    return filter->fmt_in.video.i_width != filter->fmt_out.video.i_width
+        || filter->fmt_in.video.i_height != filter->fmt_out.video.i_height;
+}
+
+/* Returns the steps of the chain, which are its children, in order */
+static size_t GetSteps(filter_t *filter, filter_t **steps)
+{
+    vlc_object_t *children[MAX_STEPS];
+    size_t count = vlc_list_children(VLC_OBJECT(filter), children,
+                                     ARRAY_SIZE(children));
+    assert(count <= ARRAY_SIZE(children));
+
+    /* Each step takes the output of the previous one */
+    const es_format_t *fmt = &filter->fmt_in;
+    for (size_t i = 0; i < count; i++)
+    {
+        steps[i] = NULL;
+        for (size_t j = 0; j < count; j++)
+        {
+            filter_t *child = (filter_t *)children[j];
+
+            if (child != NULL
+             && child->fmt_in.video.i_chroma == fmt->video.i_chroma
+             && child->fmt_in.video.i_width == fmt->video.i_width
+             && child->fmt_in.video.i_height == fmt->video.i_height)
+            {
+                steps[i] = child;
+                children[j] = NULL;
+                break;
+            }
+        }
+        assert(steps[i] != NULL);
+        fmt = &steps[i]->fmt_out;
+    }
+    return count;
+}
+
+static void test_chroma_resize(vlc_object_t *parent,
+                               vlc_fourcc_t in_chroma,
+                               unsigned in_width, unsigned in_height,
+                               vlc_fourcc_t out_chroma,
+                               unsigned out_width, unsigned out_height)
+{
+    printf("Testing %4.4s %ux%u to %4.4s %ux%u\n",
+           (const char *)&in_chroma, in_width, in_height,
+           (const char *)&out_chroma, out_width, out_height);
+
+    filter_t *filter = CreateConverter(parent, in_chroma, in_width, in_height,
+                                       out_chroma, out_width, out_height);
+    module_t *mod = module_need(filter, "video converter", "chain", true);
+    assert(mod != NULL);
+
+    /* Two steps, each of them a single module, one of them resizing */
+    filter_t *steps[MAX_STEPS];
+    size_t count = GetSteps(filter, steps);
+    assert(count == 2);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        filter_t *step = steps[i];
+        const char *name = module_get_object(step->p_module);
+        vlc_object_t *children[1];
+
+        printf(" step %zu: %s, %4.4s %ux%u to %4.4s %ux%u\n", i, name,
+               (const char *)&step->fmt_in.video.i_chroma,
+               step->fmt_in.video.i_width, step->fmt_in.video.i_height,
+               (const char *)&step->fmt_out.video.i_chroma,
+               step->fmt_out.video.i_width, step->fmt_out.video.i_height);
+        assert(strcmp(name, "chain") != 0);
+        assert(vlc_list_children(VLC_OBJECT(step), children, 1) == 0);
+    }
+
+    assert(steps[0]->fmt_out.video.i_chroma != in_chroma);
+    assert(steps[0]->fmt_out.video.i_chroma != out_chroma);
+    assert(steps[1]->fmt_out.video.i_chroma == out_chroma);
+    assert(steps[1]->fmt_out.video.i_width == out_width);
+    assert(steps[1]->fmt_out.video.i_height == out_height);
+    assert(Resizes(steps[0]) != Resizes(steps[1]));
+
+    for (size_t i = 0; i < count; i++)
+        vlc_object_release(steps[i]);
+
+    /* The chain runs */
+    picture_t *in = picture_NewFromFormat(&filter->fmt_in.video);
+    assert(in != NULL);
+    picture_t *out = filter->pf_video_filter(filter, in);
+    assert(out != NULL);
+    assert(out->format.i_chroma == out_chroma);
+    assert(out->format.i_width == out_width);
+    assert(out->format.i_height == out_height);
+    picture_Release(out);
+
+    module_unneed(filter, mod);
+    DeleteConverter(filter);
+}
+
+/* The chain does not nest itself where its parent only takes single module
+ * steps */
+static void test_single_step(vlc_object_t *parent)
+{
+    vlc_object_t *obj = vlc_object_create(parent, sizeof (*obj));
+    assert(obj != NULL);
+
+    filter_t *filter = CreateConverter(obj, VLC_CODEC_NV12, 1280, 720,
+                                       VLC_CODEC_RGB32, 1280, 720);
+    module_t *mod = module_need(filter, "video converter", "chain", true);
+    assert(mod != NULL);
+    module_unneed(filter, mod);
+
+    var_Create(obj, "chain-single-step", VLC_VAR_BOOL);
+    mod = module_need(filter, "video converter", "chain", true);
+    assert(mod == NULL);
+    var_Destroy(obj, "chain-single-step");
+
+    DeleteConverter(filter);
+    vlc_object_release(obj);
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    const char *argv[] = { "-v", "--ignore-config" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    test_chroma_resize(obj, VLC_CODEC_NV12, 1280, 720,
+                       VLC_CODEC_RGB32, 640, 360);
+    test_chroma_resize(obj, VLC_CODEC_NV12, 320, 240,
+                       VLC_CODEC_RGB32, 640, 480);
+    test_single_step(obj);
+
+    libvlc_release(vlc);
+    return 0;
+}
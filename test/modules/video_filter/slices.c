@@ -0,0 +1,265 @@
+/*****************************************************************************
+ * slices.c: sliced video filters test
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_modules.h>
+#include <vlc_picture.h>
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc/vlc.h>
+
+/* An odd height, so that the bands do not fall on chroma lines boundaries,
+ * and a width that is not a multiple of 8, so that the tail loops run. The
+ * width is even, as packed 4:2:2 requires. */
+#define WIDTH  78
+#define HEIGHT 67
+
+/* How the owner of the filter splits the lines */
+enum split
+{
+    SPLIT_NONE, /* no run_slices callback: a single call */
+    SPLIT_LINES, /* one line per band */
+    SPLIT_BANDS_REVERSED, /* uneven bands, last one first */
+};
+
+static picture_t *BufferNew(filter_t *filter)
+{
+    return picture_NewFromFormat(&filter->fmt_out.video);
+}
+
+static void RunSlices(filter_t *filter, filter_slice_cb cb, void *opaque,
+                      unsigned lines)
+{
+    const enum split *split = filter->owner.sys;
+
+    if (*split == SPLIT_LINES)
+    {
+        for (unsigned i = 0; i < lines; i++)
+            cb(filter, opaque, i, 1);
+        return;
+    }
+
+    assert(*split == SPLIT_BANDS_REVERSED);
+    unsigned last = lines;
+    for (unsigned size = 1; last > 0; size = size * 3 % 23 + 1)
+    {
+        unsigned first = last > size ? last - size : 0;
+
+        cb(filter, opaque, first, last - first);
+        last = first;
+    }
+}
+
+static const struct filter_video_callbacks sliced_cbs = {
+    .buffer_new = BufferNew,
+    .run_slices = RunSlices,
+};
+
+static const struct filter_video_callbacks unsliced_cbs = {
+    .buffer_new = BufferNew,
+};
+
+struct option
+{
+    const char *name;
+    float value;
+};
+
+static picture_t *TestPicture(const video_format_t *fmt)
+{
+    picture_t *pic = picture_NewFromFormat(fmt);
+    const vlc_chroma_description_t *desc =
+        vlc_fourcc_GetChromaDescription(fmt->i_chroma);
+    uint32_t state = 0x12345678;
+
+    assert(pic != NULL && desc != NULL);
+    for (int i = 0; i < pic->i_planes; i++)
+    {
+        plane_t *plane = &pic->p[i];
+
+        for (int y = 0; y < plane->i_lines; y++)
+            for (int x = 0; x < plane->i_pitch; x++)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                plane->p_pixels[y * plane->i_pitch + x] = state;
+            }
+
+        /* Keep high bit depth samples in range */
+        if (desc->pixel_size == 2)
+            for (int y = 0; y < plane->i_lines; y++)
+            {
+                uint16_t *line =
+                    (uint16_t *)&plane->p_pixels[y * plane->i_pitch];
+                for (int x = 0; x < plane->i_pitch / 2; x++)
+                    line[x] &= (1 << desc->pixel_bits) - 1;
+            }
+    }
+    return pic;
+}
+
+static void ComparePictures(const picture_t *a, const picture_t *b)
+{
+    assert(a->i_planes == b->i_planes);
+    for (int i = 0; i < a->i_planes; i++)
+    {
+        const plane_t *pa = &a->p[i], *pb = &b->p[i];
+
+        assert(pa->i_visible_lines == pb->i_visible_lines);
+        assert(pa->i_visible_pitch == pb->i_visible_pitch);
+        for (int y = 0; y < pa->i_visible_lines; y++)
+            assert(memcmp(&pa->p_pixels[y * pa->i_pitch],
+                          &pb->p_pixels[y * pb->i_pitch],
+                          pa->i_visible_pitch) == 0);
+    }
+}
+
+static picture_t *RunFilter(vlc_object_t *parent, const char *capability,
+                            const char *module, const video_format_t *fmt,
+                            vlc_fourcc_t out_chroma,
+                            const struct option *options, picture_t *in,
+                            enum split split)
+{
+    filter_t *filter = vlc_object_create(parent, sizeof (*filter));
+    assert(filter != NULL);
+
+    es_format_InitFromVideo(&filter->fmt_in, fmt);
+    es_format_InitFromVideo(&filter->fmt_out, fmt);
+    filter->fmt_out.i_codec = filter->fmt_out.video.i_chroma = out_chroma;
+    filter->owner.video = split != SPLIT_NONE ? &sliced_cbs : &unsliced_cbs;
+    filter->owner.sys = &split;
+
+    for (const struct option *opt = options; opt->name != NULL; opt++)
+    {
+        var_Create(filter, opt->name, VLC_VAR_FLOAT);
+        var_SetFloat(filter, opt->name, opt->value);
+    }
+
+    module_t *mod = module_need(filter, capability, module, true);
+    assert(mod != NULL);
+
+    picture_t *out = filter->pf_video_filter(filter, picture_Hold(in));
+    assert(out != NULL);
+
+    module_unneed(filter, mod);
+    es_format_Clean(&filter->fmt_in);
+    es_format_Clean(&filter->fmt_out);
+    vlc_object_release(filter);
+    return out;
+}
+
+static void test_module(vlc_object_t *parent, const char *capability,
+                        const char *module, vlc_fourcc_t chroma,
+                        vlc_fourcc_t out_chroma, unsigned height,
+                        const struct option *options)
+{
+    video_format_t fmt;
+
+    printf("Testing %s, %4.4s to %4.4s\n", module, (const char *)&chroma,
+           (const char *)&out_chroma);
+    video_format_Init(&fmt, chroma);
+    video_format_Setup(&fmt, chroma, WIDTH, height, WIDTH, height, 1, 1);
+
+    picture_t *in = TestPicture(&fmt);
+    picture_t *ref = RunFilter(parent, capability, module, &fmt, out_chroma,
+                               options, in, SPLIT_NONE);
+
+    /* The output does not depend on the bands, nor on their order */
+    static const enum split splits[] = {
+        SPLIT_LINES, SPLIT_BANDS_REVERSED,
+    };
+    for (size_t i = 0; i < ARRAY_SIZE(splits); i++)
+    {
+        picture_t *out = RunFilter(parent, capability, module, &fmt,
+                                   out_chroma, options, in, splits[i]);
+        ComparePictures(ref, out);
+        picture_Release(out);
+    }
+
+    picture_Release(ref);
+    picture_Release(in);
+    video_format_Clean(&fmt);
+}
+
+static void test_filter(vlc_object_t *parent, const char *module,
+                        vlc_fourcc_t chroma, const struct option *options)
+{
+    test_module(parent, "video filter", module, chroma, chroma, HEIGHT,
+                options);
+}
+
+static void test_converter(vlc_object_t *parent, const char *module,
+                           vlc_fourcc_t chroma, vlc_fourcc_t out_chroma)
+{
+    static const struct option none[] = { { NULL, 0.f } };
+
+    /* The converters only take even sizes */
+    test_module(parent, "video converter", module, chroma, out_chroma,
+                HEIGHT + 1, none);
+}
+
+int main(void)
+{
+    static const struct option adjust[] = {
+        { "contrast", 1.3f },
+        { "brightness", 1.1f },
+        { "hue", 30.f },
+        { "saturation", 1.7f },
+        { "gamma", .8f },
+        { NULL, 0.f },
+    };
+    static const struct option sharpen[] = {
+        { "sharpen-sigma", 1.5f },
+        { NULL, 0.f },
+    };
+
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    const char *argv[] = { "-v", "--ignore-config" };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    test_filter(obj, "adjust", VLC_CODEC_I420, adjust);
+    test_filter(obj, "adjust", VLC_CODEC_I422, adjust);
+    test_filter(obj, "adjust", VLC_CODEC_I420_10L, adjust);
+    test_filter(obj, "adjust", VLC_CODEC_YUYV, adjust);
+    test_filter(obj, "adjust", VLC_CODEC_UYVY, adjust);
+    test_filter(obj, "sharpen", VLC_CODEC_I420, sharpen);
+    test_filter(obj, "sharpen", VLC_CODEC_I420_10L, sharpen);
+    test_converter(obj, "i422_yuy2", VLC_CODEC_I422, VLC_CODEC_YUYV);
+    test_converter(obj, "i422_yuy2", VLC_CODEC_I422, VLC_CODEC_UYVY);
+
+    libvlc_release(vlc);
+    return 0;
+}
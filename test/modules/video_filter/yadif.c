@@ -0,0 +1,367 @@
+/*****************************************************************************
+ * yadif.c: yadif deinterlacer line kernels and slices test
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../modules/video_filter/deinterlace/algo_yadif.c"
+
+/* The plugin source includes config.h again, which defines NDEBUG */
+#undef NDEBUG
+#include <assert.h>
+
+/* RenderYadif() only falls back to it without a full history */
+int RenderX(filter_t *filter, picture_t *dst, picture_t *src)
+{
+    VLC_UNUSED(filter); VLC_UNUSED(dst); VLC_UNUSED(src);
+    abort();
+}
+
+static const struct
+{
+    yadif_filter_line filter;
+    yadif_filter_line ref;
+    unsigned pixel_size;
+    unsigned cpu;
+    const char *name;
+} kernels[] =
+{
+#ifdef HAVE_YADIF_AVX2
+    { yadif_filter_line_avx2, yadif_filter_line_c, 1, VLC_CPU_AVX2, "avx2" },
+    { yadif_filter_line_avx2_16bit, yadif_filter_line_c_16bit, 2,
+      VLC_CPU_AVX2, "avx2 16-bit" },
+#endif
+    { yadif_filter_line_c, yadif_filter_line_c, 1, 0, "c" },
+    { yadif_filter_line_c_16bit, yadif_filter_line_c_16bit, 2, 0, "c 16-bit" },
+};
+
+static bool cpu_usable(unsigned cpu, const char *name)
+{
+    if ((vlc_CPU() & cpu) == cpu)
+        return true;
+    printf("Skipping %s: not supported by the CPU\n", name);
+    return false;
+}
+
+static uint32_t state = 0x12345678;
+
+static uint32_t Random(void)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/* Fills with random samples of the given depth */
+static void FillSamples(uint8_t *buf, size_t size, unsigned pixel_size,
+                        unsigned bits)
+{
+    if (pixel_size == 2)
+        for (size_t i = 0; i < size / 2; i++)
+            ((uint16_t *)buf)[i] = Random() & ((1 << bits) - 1);
+    else
+        for (size_t i = 0; i < size; i++)
+            buf[i] = Random();
+}
+
+/* Samples of margin on both sides of a line, as the filter reads up to 3
+ * samples past its ends */
+#define PAD 8
+
+static void TestLine(size_t k, int w, unsigned bits, int parity, int mode)
+{
+    const unsigned size = kernels[k].pixel_size;
+    const int stride = (w + 2 * PAD) * size;
+    /* 5 lines per picture: the filter reads up to 2 lines above and below */
+    uint8_t *pics = malloc(3 * 5 * stride);
+    uint8_t *dst_ref = malloc(stride);
+    uint8_t *dst = malloc(stride);
+    assert(pics != NULL && dst_ref != NULL && dst != NULL);
+
+    FillSamples(pics, 3 * 5 * stride, size, bits);
+    memset(dst_ref, 0xA5, stride);
+    memset(dst, 0xA5, stride);
+
+    uint8_t *prev = &pics[2 * stride + PAD * size];
+    uint8_t *cur = prev + 5 * stride;
+    uint8_t *next = cur + 5 * stride;
+
+    kernels[k].ref(&dst_ref[PAD * size], prev, cur, next, w,
+                   stride, -stride, parity, mode);
+    kernels[k].filter(&dst[PAD * size], prev, cur, next, w,
+                      stride, -stride, parity, mode);
+
+    /* Bit-exact, and nothing written past the line */
+    assert(memcmp(dst_ref, dst, stride) == 0);
+
+    free(dst);
+    free(dst_ref);
+    free(pics);
+}
+
+static void test_lines(void)
+{
+    for (size_t k = 0; k < ARRAY_SIZE(kernels); k++)
+    {
+        if (!cpu_usable(kernels[k].cpu, kernels[k].name))
+            continue;
+
+        printf("Testing %s lines\n", kernels[k].name);
+
+        /* Every tail length of the vector loops, then full size lines */
+        static const int widths[] = { 720, 1921 };
+        static const unsigned depths_8bit[] = { 8 };
+        static const unsigned depths_16bit[] = { 10, 16 };
+        const unsigned *depths = kernels[k].pixel_size == 2 ? depths_16bit
+                                                            : depths_8bit;
+        const size_t depths_count = kernels[k].pixel_size == 2
+                                  ? ARRAY_SIZE(depths_16bit)
+                                  : ARRAY_SIZE(depths_8bit);
+
+        for (size_t d = 0; d < depths_count; d++)
+            for (int parity = 0; parity <= 1; parity++)
+                for (int mode = 0; mode <= 2; mode += 2)
+                {
+                    for (int w = 1; w <= 67; w++)
+                        TestLine(k, w, depths[d], parity, mode);
+                    for (size_t i = 0; i < ARRAY_SIZE(widths); i++)
+                        TestLine(k, widths[i], depths[d], parity, mode);
+                }
+    }
+}
+
+/* How the owner of the filter splits the lines */
+enum split
+{
+    SPLIT_NONE, /* no run_slices callback: a single call */
+    SPLIT_LINES, /* one line per band */
+    SPLIT_BANDS_REVERSED, /* uneven bands, last one first */
+};
+
+static void RunSlices(filter_t *filter, filter_slice_cb cb, void *opaque,
+                      unsigned lines)
+{
+    const enum split *split = filter->owner.sys;
+
+    if (*split == SPLIT_LINES)
+    {
+        for (unsigned i = 0; i < lines; i++)
+            cb(filter, opaque, i, 1);
+        return;
+    }
+
+    assert(*split == SPLIT_BANDS_REVERSED);
+    unsigned last = lines;
+    for (unsigned size = 1; last > 0; size = size * 3 % 23 + 1)
+    {
+        unsigned first = last > size ? last - size : 0;
+
+        cb(filter, opaque, first, last - first);
+        last = first;
+    }
+}
+
+static const struct filter_video_callbacks sliced_cbs = {
+    .run_slices = RunSlices,
+};
+
+static picture_t *TestPicture(const video_format_t *fmt, unsigned bits)
+{
+    picture_t *pic = picture_NewFromFormat(fmt);
+    assert(pic != NULL);
+
+    const unsigned size = bits > 8 ? 2 : 1;
+    for (int i = 0; i < pic->i_planes; i++)
+        FillSamples(pic->p[i].p_pixels,
+                    pic->p[i].i_pitch * pic->p[i].i_lines, size, bits);
+    return pic;
+}
+
+static void ComparePictures(const picture_t *a, const picture_t *b)
+{
+    assert(a->i_planes == b->i_planes);
+    for (int i = 0; i < a->i_planes; i++)
+    {
+        const plane_t *pa = &a->p[i], *pb = &b->p[i];
+
+        assert(pa->i_visible_lines == pb->i_visible_lines);
+        assert(pa->i_visible_pitch == pb->i_visible_pitch);
+        for (int y = 0; y < pa->i_visible_lines; y++)
+            assert(memcmp(&pa->p_pixels[y * pa->i_pitch],
+                          &pb->p_pixels[y * pb->i_pitch],
+                          pa->i_visible_pitch) == 0);
+    }
+}
+
+static void test_pictures(vlc_fourcc_t chroma, unsigned width,
+                          unsigned height)
+{
+    const vlc_chroma_description_t *desc =
+        vlc_fourcc_GetChromaDescription(chroma);
+    video_format_t fmt;
+
+    assert(desc != NULL);
+    printf("Testing %4.4s %ux%u pictures\n", (const char *)&chroma,
+           width, height);
+    video_format_Init(&fmt, chroma);
+    video_format_Setup(&fmt, chroma, width, height, width, height, 1, 1);
+
+    picture_t *prev = TestPicture(&fmt, desc->pixel_bits);
+    picture_t *cur = TestPicture(&fmt, desc->pixel_bits);
+    picture_t *next = TestPicture(&fmt, desc->pixel_bits);
+
+    /* 2 is the soft field repeat, which copies the current picture */
+    for (int parity = 0; parity <= 2; parity++)
+        for (int field = 0; field <= 1; field++)
+        {
+            struct yadif_slice slice = {
+                .filter = desc->pixel_size == 2 ? yadif_filter_line_c_16bit
+                                                : yadif_filter_line_c,
+                .p_prev = prev,
+                .p_cur = cur,
+                .p_next = next,
+                .i_pixel_size = desc->pixel_size,
+                .i_field = field,
+                .i_parity = parity,
+            };
+
+            /* The reference: the C kernel over the whole picture at once */
+            picture_t *ref = picture_NewFromFormat(&fmt);
+            assert(ref != NULL);
+            slice.p_dst = ref;
+            YadifSlice(NULL, &slice, 0, height);
+
+            for (size_t k = 0; k < ARRAY_SIZE(kernels); k++)
+            {
+                if (kernels[k].pixel_size != desc->pixel_size
+                 || (vlc_CPU() & kernels[k].cpu) != kernels[k].cpu)
+                    continue;
+
+                static const enum split splits[] = {
+                    SPLIT_NONE, SPLIT_LINES, SPLIT_BANDS_REVERSED,
+                };
+                for (size_t i = 0; i < ARRAY_SIZE(splits); i++)
+                {
+                    filter_t filter = {
+                        .owner = {
+                            .video = splits[i] != SPLIT_NONE ? &sliced_cbs
+                                                             : NULL,
+                            .sys = (void *)&splits[i],
+                        },
+                    };
+                    picture_t *out = picture_NewFromFormat(&fmt);
+                    assert(out != NULL);
+
+                    slice.filter = kernels[k].filter;
+                    slice.p_dst = out;
+                    filter_RunSlices(&filter, YadifSlice, &slice, height);
+                    ComparePictures(ref, out);
+                    picture_Release(out);
+                }
+            }
+            picture_Release(ref);
+        }
+
+    picture_Release(next);
+    picture_Release(cur);
+    picture_Release(prev);
+    video_format_Clean(&fmt);
+}
+
+/* RenderYadif() picks the best kernel, and runs through the slices */
+static void test_render(vlc_fourcc_t chroma, unsigned width, unsigned height)
+{
+    const vlc_chroma_description_t *desc =
+        vlc_fourcc_GetChromaDescription(chroma);
+    video_format_t fmt;
+
+    assert(desc != NULL);
+    printf("Testing %4.4s %ux%u rendering\n", (const char *)&chroma,
+           width, height);
+    video_format_Init(&fmt, chroma);
+    video_format_Setup(&fmt, chroma, width, height, width, height, 1, 1);
+
+    filter_sys_t sys = { .chroma = desc };
+    for (int i = 0; i < HISTORY_SIZE; i++)
+        sys.context.pp_history[i] = TestPicture(&fmt, desc->pixel_bits);
+
+    for (int order = 0; order <= 1; order++)
+        for (int field = 0; field <= 1; field++)
+        {
+            struct yadif_slice slice = {
+                .filter = desc->pixel_size == 2 ? yadif_filter_line_c_16bit
+                                                : yadif_filter_line_c,
+                .p_prev = sys.context.pp_history[0],
+                .p_cur = sys.context.pp_history[1],
+                .p_next = sys.context.pp_history[2],
+                .i_pixel_size = desc->pixel_size,
+                .i_field = field,
+                .i_parity = (order + 1) % 2,
+            };
+            picture_t *ref = picture_NewFromFormat(&fmt);
+            assert(ref != NULL);
+            slice.p_dst = ref;
+            YadifSlice(NULL, &slice, 0, height);
+
+            enum split split = SPLIT_BANDS_REVERSED;
+            filter_t filter = {
+                .p_sys = &sys,
+                .owner = { .video = &sliced_cbs, .sys = &split },
+            };
+            picture_t *out = picture_NewFromFormat(&fmt);
+            assert(out != NULL);
+            assert(RenderYadif(&filter, out, NULL, order, field)
+                   == VLC_SUCCESS);
+            ComparePictures(ref, out);
+            picture_Release(out);
+            picture_Release(ref);
+        }
+
+    for (int i = 0; i < HISTORY_SIZE; i++)
+        picture_Release(sys.context.pp_history[i]);
+    video_format_Clean(&fmt);
+}
+
+int main(void)
+{
+    static const vlc_fourcc_t chromas[] = {
+        VLC_CODEC_I420, VLC_CODEC_I422, VLC_CODEC_I420_10L, VLC_CODEC_I420_16L,
+    };
+    /* Odd sizes, so that the tails of the kernels run on every plane */
+    static const struct { unsigned width, height; } sizes[] = {
+        { 18, 5 }, { 33, 67 }, { 78, 67 }, { 721, 288 },
+    };
+
+    test_lines();
+
+    for (size_t c = 0; c < ARRAY_SIZE(chromas); c++)
+        for (size_t s = 0; s < ARRAY_SIZE(sizes); s++)
+        {
+            test_pictures(chromas[c], sizes[s].width, sizes[s].height);
+            test_render(chromas[c], sizes[s].width, sizes[s].height);
+        }
+    return 0;
+}
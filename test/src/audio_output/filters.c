@@ -0,0 +1,270 @@
+/*****************************************************************************
+ * filters.c: test the audio filters chain and its output buffers
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_aout.h>
+#include <vlc_block.h>
+
+#define FRAMES 1024
+
+static audio_sample_format_t fmt(vlc_fourcc_t format, unsigned rate,
+                                 uint16_t channels)
+{
+    audio_sample_format_t f = {
+        .i_format = format,
+        .i_rate = rate,
+        .i_physical_channels = channels,
+        .channel_type = AUDIO_CHANNEL_TYPE_BITMAP,
+    };
+    aout_FormatPrepare(&f);
+    return f;
+}
+
+/* A stereo S16 block, with some room left in its storage or not */
+static block_t *input(size_t room)
+{
+    const size_t size = FRAMES * 2 * sizeof (int16_t);
+    block_t *block = block_Alloc(size + room);
+    assert(block != NULL);
+
+    int16_t *s = (int16_t *)block->p_buffer;
+    for (unsigned i = 0; i < FRAMES * 2; i++)
+        s[i] = (int16_t)(i * 37 - 32768);
+    block->i_buffer = size;
+    block->i_nb_samples = FRAMES;
+    block->i_pts = block->i_dts = VLC_TICK_0;
+    block->i_length = vlc_tick_from_samples(FRAMES, 48000);
+    return block;
+}
+
+static void check_s16(const block_t *block, unsigned step)
+{
+    const int16_t *s = (const int16_t *)block->p_buffer;
+
+    assert(block->i_nb_samples == FRAMES * step);
+    assert(block->i_buffer == FRAMES * step * 2 * sizeof (int16_t));
+    for (unsigned i = 0; i < FRAMES * step; i++)
+        for (unsigned c = 0; c < 2; c++)
+            assert(s[i * 2 + c] == (int16_t)((i / step * 2 + c) * 37 - 32768));
+}
+
+static void check_fl32(const block_t *block)
+{
+    const float *f = (const float *)block->p_buffer;
+
+    assert(block->i_nb_samples == FRAMES);
+    assert(block->i_buffer == FRAMES * 2 * sizeof (float));
+    for (unsigned i = 0; i < FRAMES * 2; i++)
+        assert(f[i] == (int16_t)(i * 37 - 32768) / 32768.f);
+}
+
+/* Same formats: the block goes through untouched */
+static void test_passthrough(vlc_object_t *obj)
+{
+    const audio_sample_format_t f = fmt(VLC_CODEC_S16N, 48000,
+                                        AOUT_CHANS_STEREO);
+    aout_filters_t *filters = aout_FiltersNew(obj, &f, &f, NULL);
+    assert(filters != NULL);
+
+    block_t *in = input(0);
+    block_t *out = aout_FiltersPlay(filters, in, 1.f);
+    assert(out == in);
+    check_s16(out, 1);
+    block_Release(out);
+
+    aout_FiltersDelete(obj, filters);
+}
+
+/* Wider samples: the input block is converted in place if its storage can
+ * hold the output, otherwise the output comes from the pool */
+static void test_convert(vlc_object_t *obj)
+{
+    const audio_sample_format_t in_fmt = fmt(VLC_CODEC_S16N, 48000,
+                                             AOUT_CHANS_STEREO);
+    const audio_sample_format_t out_fmt = fmt(VLC_CODEC_FL32, 48000,
+                                              AOUT_CHANS_STEREO);
+    aout_filters_t *filters = aout_FiltersNew(obj, &in_fmt, &out_fmt, NULL);
+    assert(filters != NULL);
+
+    block_t *in = input(FRAMES * 2 * sizeof (float));
+    block_t *out = aout_FiltersPlay(filters, in, 1.f);
+    assert(out == in);
+    check_fl32(out);
+    block_Release(out);
+
+    in = input(0);
+    out = aout_FiltersPlay(filters, in, 1.f);
+    assert(out != NULL && out != in);
+    check_fl32(out);
+    assert(out->i_pts == VLC_TICK_0);
+
+    /* The released output is recycled for the next block */
+    block_t *prev = out;
+    block_Release(out);
+    out = aout_FiltersPlay(filters, input(0), 1.f);
+    assert(out == prev);
+    check_fl32(out);
+    block_Release(out);
+
+    aout_FiltersDelete(obj, filters);
+}
+
+/* Upsampling: every output comes from the pool, and the buffers still held
+ * outlive the chain */
+static void test_resample(vlc_object_t *obj)
+{
+    const audio_sample_format_t in_fmt = fmt(VLC_CODEC_S16N, 48000,
+                                             AOUT_CHANS_STEREO);
+    const audio_sample_format_t out_fmt = fmt(VLC_CODEC_S16N, 96000,
+                                              AOUT_CHANS_STEREO);
+    aout_filters_t *filters = aout_FiltersNew(obj, &in_fmt, &out_fmt, NULL);
+    block_t *held[4];
+    assert(filters != NULL);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(held); i++)
+    {
+        block_t *in = input(0);
+
+        held[i] = aout_FiltersPlay(filters, in, 1.f);
+        assert(held[i] != NULL && held[i] != in);
+        check_s16(held[i], 2);
+        for (unsigned j = 0; j < i; j++)
+            assert(held[j] != held[i]);
+    }
+
+    /* Release one: the next output reuses it */
+    block_t *prev = held[1];
+    block_Release(held[1]);
+    held[1] = aout_FiltersPlay(filters, input(0), 1.f);
+    assert(held[1] == prev);
+    check_s16(held[1], 2);
+
+    aout_FiltersDelete(obj, filters);
+
+    for (unsigned i = 0; i < ARRAY_SIZE(held); i++)
+    {
+        check_s16(held[i], 2);
+        block_Release(held[i]);
+    }
+}
+
+/* Remixing: converted to float, mixed down, and converted back */
+static void test_remix(vlc_object_t *obj)
+{
+    const audio_sample_format_t in_fmt = fmt(VLC_CODEC_S16N, 48000,
+                                             AOUT_CHANS_STEREO);
+    const audio_sample_format_t out_fmt = fmt(VLC_CODEC_FL32, 48000,
+                                              AOUT_CHAN_CENTER);
+    aout_filters_t *filters = aout_FiltersNew(obj, &in_fmt, &out_fmt, NULL);
+    assert(filters != NULL);
+
+    for (unsigned n = 0; n < 3; n++)
+    {
+        block_t *in = input(0);
+        int16_t *s = (int16_t *)in->p_buffer;
+
+        /* Same signal on both channels: whatever the mixing matrix, the
+         * output is proportional to it */
+        for (unsigned i = 0; i < FRAMES; i++)
+            s[2 * i] = s[2 * i + 1] = 1024 + i;
+
+        block_t *out = aout_FiltersPlay(filters, in, 1.f);
+        assert(out != NULL);
+        assert(out->i_nb_samples == FRAMES);
+        assert(out->i_buffer == FRAMES * sizeof (float));
+
+        const float *f = (const float *)out->p_buffer;
+        const float gain = f[0] / (1024 / 32768.f);
+        assert(gain > .1f && gain < 2.f);
+        for (unsigned i = 0; i < FRAMES; i++)
+        {
+            float expected = gain * (1024 + i) / 32768.f;
+            assert(fabsf(f[i] - expected) <= 1e-6f);
+        }
+        block_Release(out);
+    }
+
+    aout_FiltersDelete(obj, filters);
+}
+
+/* The heap allocations rate is published about once per second, and drops
+ * to zero once the pool is warm */
+static void test_stats(vlc_object_t *obj)
+{
+    const audio_sample_format_t in_fmt = fmt(VLC_CODEC_S16N, 48000,
+                                             AOUT_CHANS_STEREO);
+    const audio_sample_format_t out_fmt = fmt(VLC_CODEC_S16N, 96000,
+                                              AOUT_CHANS_STEREO);
+    aout_filters_t *filters = aout_FiltersNew(obj, &in_fmt, &out_fmt, NULL);
+    assert(filters != NULL);
+    assert(var_Type(obj, "audio-filter-allocs") == VLC_VAR_INTEGER);
+    assert(var_GetInteger(obj, "audio-filter-allocs") == 0);
+
+    /* Two buffers in flight, allocated within the first second */
+    block_t *a = aout_FiltersPlay(filters, input(0), 1.f);
+    block_t *b = aout_FiltersPlay(filters, input(0), 1.f);
+    assert(a != NULL && b != NULL);
+    block_Release(a);
+    block_Release(b);
+
+    vlc_tick_wait(vlc_tick_now() + VLC_TICK_FROM_MS(1100));
+    block_Release(aout_FiltersPlay(filters, input(0), 1.f));
+    int64_t rate = var_GetInteger(obj, "audio-filter-allocs");
+    assert(rate >= 1 && rate <= 2);
+
+    /* Warm pool: no more allocations */
+    vlc_tick_wait(vlc_tick_now() + VLC_TICK_FROM_MS(1100));
+    block_Release(aout_FiltersPlay(filters, input(0), 1.f));
+    assert(var_GetInteger(obj, "audio-filter-allocs") == 0);
+
+    aout_FiltersDelete(obj, filters);
+    assert(var_Type(obj, "audio-filter-allocs") == 0);
+}
+
+int main(void)
+{
+    test_init();
+
+    static const char *argv[] = {
+        "-v",
+        "--ignore-config",
+        "--no-audio-time-stretch",
+        "--audio-resampler=ugly",
+        "--audio-visual=none",
+    };
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    test_passthrough(obj);
+    test_convert(obj);
+    test_resample(obj);
+    test_remix(obj);
+    test_stats(obj);
+
+    libvlc_release(vlc);
+    return 0;
+}
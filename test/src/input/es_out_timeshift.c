@@ -0,0 +1,262 @@
+/*****************************************************************************
+ * es_out_timeshift.c: timeshift elementary stream output test
+ *****************************************************************************
+ * Copyright (C) 2019 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <signal.h>
+#include <string.h>
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif
+
+#include <vlc_common.h>
+#include "../src/input/es_out_timeshift.c"
+#include "../../../lib/libvlc_internal.h"
+#include "../../libvlc/test.h"
+
+#include <vlc/vlc.h>
+
+#define BLOCKS 100 /* about 3 MiB, i.e. several 1 MiB segments */
+
+const char vlc_module_name[] = "test";
+
+/* Rate resets are never triggered: the rate is not changed */
+void input_ControlPush(input_thread_t *input, int type,
+                       const input_control_param_t *param)
+{
+    (void) input; (void) type; (void) param;
+    assert(!"unexpected input control");
+}
+
+static size_t block_size(unsigned i)
+{
+    return 1 + (i * 7919) % 65536;
+}
+
+static uint8_t block_byte(unsigned i, size_t j)
+{
+    return i * 31 + j;
+}
+
+/* Records the blocks coming out of the timeshift */
+struct sink
+{
+    es_out_t out;
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    unsigned count;
+    int last;
+    size_t size;
+};
+
+static es_out_id_t *sink_Add(es_out_t *out, const es_format_t *fmt)
+{
+    (void) fmt;
+    return (es_out_id_t *)out;
+}
+
+static int sink_Send(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    struct sink *sink = container_of(out, struct sink, out);
+    unsigned i = block->i_pts;
+
+    assert(id == (es_out_id_t *)out);
+    assert(block->i_dts == (vlc_tick_t)i);
+    assert(block->i_length == (vlc_tick_t)i);
+    assert(block->i_flags == ((i & 1) ? BLOCK_FLAG_TYPE_I : BLOCK_FLAG_TYPE_P));
+    assert(block->i_buffer == block_size(i));
+    for (size_t j = 0; j < block->i_buffer; j++)
+        assert(block->p_buffer[j] == block_byte(i, j));
+
+    vlc_mutex_lock(&sink->lock);
+    assert((int)i > sink->last); /* in order, possibly with gaps */
+    sink->last = i;
+    sink->count++;
+    sink->size += block->i_buffer;
+    vlc_cond_signal(&sink->wait);
+    vlc_mutex_unlock(&sink->lock);
+
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+static void sink_Del(es_out_t *out, es_out_id_t *id)
+{
+    assert(id == (es_out_id_t *)out);
+}
+
+static int sink_Control(es_out_t *out, int query, va_list args)
+{
+    (void) out;
+
+    switch (query)
+    {
+        case ES_OUT_GET_BUFFERING:
+            *va_arg(args, bool *) = false;
+            return VLC_SUCCESS;
+        case ES_OUT_SET_PAUSE_STATE:
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static const struct es_out_callbacks sink_cbs =
+{
+    sink_Add, sink_Send, sink_Del, sink_Control, NULL,
+};
+
+/* Makes writing to the segment files fail */
+static void disk_full(bool full)
+{
+#ifndef _WIN32
+    static struct rlimit saved;
+
+    if (full)
+    {
+        struct rlimit lim;
+
+        signal(SIGXFSZ, SIG_IGN);
+        assert(getrlimit(RLIMIT_FSIZE, &saved) == 0);
+        lim = saved;
+        lim.rlim_cur = 0;
+        assert(setrlimit(RLIMIT_FSIZE, &lim) == 0);
+    }
+    else
+        assert(setrlimit(RLIMIT_FSIZE, &saved) == 0);
+#else
+    (void) full;
+#endif
+}
+
+/* Sends blocks while paused, then resumes and waits for the last one.
+ * Returns how many segment files were written to while paused. */
+static unsigned test_timeshift(vlc_object_t *parent, int memory, bool full,
+                               unsigned blocks, struct sink *sink)
+{
+    input_thread_t *input = vlc_object_create(parent,
+                                              sizeof (input_thread_private_t));
+    assert(input != NULL);
+    assert(!input_priv(input)->b_can_pace_control);
+
+    var_Create(input, "input-timeshift-granularity", VLC_VAR_INTEGER);
+    var_SetInteger(input, "input-timeshift-granularity", 1);
+    var_Create(input, "input-timeshift-memory", VLC_VAR_INTEGER);
+    var_SetInteger(input, "input-timeshift-memory", memory);
+
+    sink->out.cbs = &sink_cbs;
+    vlc_mutex_init(&sink->lock);
+    vlc_cond_init(&sink->wait);
+    sink->count = 0;
+    sink->last = -1;
+    sink->size = 0;
+
+    es_out_t *out = input_EsOutTimeshiftNew(input, &sink->out, INPUT_RATE_DEFAULT);
+    assert(out != NULL);
+
+    es_format_t fmt;
+    es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_H264);
+    es_out_id_t *id = es_out_Add(out, &fmt);
+    assert(id != NULL);
+
+    assert(es_out_SetPauseState(out, false, true, vlc_tick_now()) == VLC_SUCCESS);
+
+    if (full)
+        disk_full(true);
+    for (unsigned i = 0; i < blocks; i++)
+    {
+        block_t *block = block_Alloc(block_size(i));
+        assert(block != NULL);
+
+        for (size_t j = 0; j < block->i_buffer; j++)
+            block->p_buffer[j] = block_byte(i, j);
+        block->i_pts = block->i_dts = block->i_length = i;
+        block->i_flags = (i & 1) ? BLOCK_FLAG_TYPE_I : BLOCK_FLAG_TYPE_P;
+        assert(es_out_Send(out, id, block) == VLC_SUCCESS);
+    }
+    if (full)
+        disk_full(false);
+
+    /* Nothing goes through while paused */
+    vlc_mutex_lock(&sink->lock);
+    assert(sink->count == 0);
+    vlc_mutex_unlock(&sink->lock);
+
+    es_out_sys_t *sys = container_of(out, es_out_sys_t, out);
+    ts_thread_t *ts = sys->p_ts;
+    unsigned files = 0;
+
+    assert(sys->b_delayed);
+    vlc_mutex_lock(&ts->lock);
+    for (ts_storage_t *storage = ts->p_storage_r; storage != NULL;
+         storage = storage->p_next)
+        if (storage->i_file_size > 0)
+            files++;
+    vlc_mutex_unlock(&ts->lock);
+
+    assert(es_out_SetPauseState(out, false, false, vlc_tick_now()) == VLC_SUCCESS);
+
+    vlc_mutex_lock(&sink->lock);
+    while (sink->last != (int)blocks - 1)
+        vlc_cond_wait(&sink->wait, &sink->lock);
+    vlc_mutex_unlock(&sink->lock);
+
+    es_out_Del(out, id);
+    es_out_Delete(out);
+    vlc_cond_destroy(&sink->wait);
+    vlc_mutex_destroy(&sink->lock);
+    vlc_object_release(input);
+    return files;
+}
+
+int main(void)
+{
+    struct sink sink;
+
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs,
+                                        test_defaults_args);
+    assert(vlc != NULL);
+
+    vlc_object_t *parent = VLC_OBJECT(vlc->p_libvlc_int);
+
+    /* Everything is spilled to segment files, and read back whole and in
+     * order, whether the segments are mapped or read */
+    assert(test_timeshift(parent, 0, false, BLOCKS, &sink) >= 3);
+    assert(sink.count == BLOCKS);
+
+    /* Recent data fitting in one segment never leaves memory */
+    assert(test_timeshift(parent, 10, false, 16, &sink) == 0);
+    assert(sink.count == 16);
+
+    /* If spilling fails, the oldest data is dropped and memory stays within
+     * one segment, but the most recent data still goes through */
+    test_timeshift(parent, 0, true, BLOCKS, &sink);
+#ifndef _WIN32
+    assert(sink.count < BLOCKS);
+    assert(sink.size <= 1024 * 1024 + 65536);
+#endif
+
+    libvlc_release(vlc);
+    return 0;
+}
@@ -21,6 +21,7 @@
  *****************************************************************************/
 
 #include <limits.h>
+#include <stdatomic.h>
 
 #include "../../libvlc/test.h"
 #include "../lib/libvlc_internal.h"
@@ -444,6 +445,162 @@ static void test_creation_and_type( libvlc_int_t *p_libvlc )
     assert( var_Get( p_libvlc, "bla", &val ) == VLC_ENOVAR );
 }
 
+static void test_recreation( libvlc_int_t *p_libvlc )
+{
+    /* The same name may be reused with another type */
+    var_Create( p_libvlc, "bla", VLC_VAR_INTEGER );
+    var_SetInteger( p_libvlc, "bla", 42 );
+    assert( var_GetInteger( p_libvlc, "bla" ) == 42 );
+    var_Destroy( p_libvlc, "bla" );
+    assert( var_Type( p_libvlc, "bla" ) == 0 );
+    assert( var_GetInteger( p_libvlc, "bla" ) == 0 );
+
+    var_Create( p_libvlc, "bla", VLC_VAR_STRING );
+    var_SetString( p_libvlc, "bla", "foo" );
+    char *psz = var_GetString( p_libvlc, "bla" );
+    assert( psz != NULL && !strcmp( psz, "foo" ) );
+    free( psz );
+    var_Destroy( p_libvlc, "bla" );
+
+    var_Create( p_libvlc, "bla", VLC_VAR_FLOAT );
+    assert( var_GetFloat( p_libvlc, "bla" ) == 0.f );
+    var_SetFloat( p_libvlc, "bla", 1.5f );
+    assert( var_GetFloat( p_libvlc, "bla" ) == 1.5f );
+    var_Destroy( p_libvlc, "bla" );
+}
+
+#define RACE_READS 200000
+#define RACE_MAGIC INT64_C(0x5a5a5a5a5a5a5a5a)
+
+static atomic_bool race_stop;
+
+static void *race_read( void *data )
+{
+    libvlc_int_t *p_libvlc = data;
+
+    for( unsigned i = 0; i < RACE_READS; i++ )
+    {
+        vlc_value_t val;
+
+        if( var_Get( p_libvlc, "race", &val ) != VLC_SUCCESS )
+            continue;
+        if( val.i_int == 0 || val.i_int == RACE_MAGIC )
+            continue; /* integer */
+
+        /* Otherwise, this must be a copy of the string value: a string
+         * pointer returned as an integer would be freed twice. */
+        assert( !strcmp( val.psz_string, "" )
+             || !strcmp( val.psz_string, "race" ) );
+        free( val.psz_string );
+    }
+    return NULL;
+}
+
+static void *race_write( void *data )
+{
+    libvlc_int_t *p_libvlc = data;
+
+    /* Keep re-creating the variable with another type */
+    while( !atomic_load( &race_stop ) )
+    {
+        var_Create( p_libvlc, "race", VLC_VAR_INTEGER );
+        var_SetInteger( p_libvlc, "race", RACE_MAGIC );
+        var_Destroy( p_libvlc, "race" );
+
+        var_Create( p_libvlc, "race", VLC_VAR_STRING );
+        var_SetString( p_libvlc, "race", "race" );
+        var_Destroy( p_libvlc, "race" );
+    }
+    return NULL;
+}
+
+static void test_recreation_race( libvlc_int_t *p_libvlc )
+{
+    vlc_thread_t readers[2], writer;
+
+    atomic_init( &race_stop, false );
+    assert( vlc_clone( &writer, race_write, p_libvlc,
+                       VLC_THREAD_PRIORITY_LOW ) == 0 );
+    for( unsigned i = 0; i < ARRAY_SIZE(readers); i++ )
+        assert( vlc_clone( &readers[i], race_read, p_libvlc,
+                           VLC_THREAD_PRIORITY_LOW ) == 0 );
+    for( unsigned i = 0; i < ARRAY_SIZE(readers); i++ )
+        vlc_join( readers[i], NULL );
+    atomic_store( &race_stop, true );
+    vlc_join( writer, NULL );
+
+    assert( var_Type( p_libvlc, "race" ) == 0 );
+}
+
+#define BENCH_THREADS 4
+#define BENCH_READS   (1 << 20)
+
+static atomic_bool bench_stop;
+
+static void *bench_read( void *data )
+{
+    libvlc_int_t *p_libvlc = data;
+    int64_t i_last = 0;
+
+    for( unsigned i = 0; i < BENCH_READS; i++ )
+    {
+        int64_t i_val = var_GetInteger( p_libvlc, "bench-counter" );
+        assert( i_val >= i_last ); /* The writer only increments it */
+        i_last = i_val;
+        (void) var_InheritBool( p_libvlc, "bench-flag" );
+    }
+    return NULL;
+}
+
+static void *bench_write( void *data )
+{
+    libvlc_int_t *p_libvlc = data;
+    char psz_name[32];
+    unsigned i = 0;
+
+    /* Keep modifying values and growing the index while readers run */
+    while( !atomic_load( &bench_stop ) )
+    {
+        var_IncInteger( p_libvlc, "bench-counter" );
+        snprintf( psz_name, sizeof (psz_name), "bench-%u", i++ % 256 );
+        var_Create( p_libvlc, psz_name, VLC_VAR_INTEGER );
+        var_Destroy( p_libvlc, psz_name );
+    }
+    return NULL;
+}
+
+static void test_contended_reads( libvlc_int_t *p_libvlc )
+{
+    vlc_thread_t readers[BENCH_THREADS], writer;
+
+    var_Create( p_libvlc, "bench-counter", VLC_VAR_INTEGER );
+    var_Create( p_libvlc, "bench-flag", VLC_VAR_BOOL );
+    atomic_init( &bench_stop, false );
+
+    for( unsigned n = 1; n <= BENCH_THREADS; n *= 2 )
+    {
+        vlc_tick_t start = vlc_tick_now();
+
+        atomic_store( &bench_stop, false );
+        assert( vlc_clone( &writer, bench_write, p_libvlc,
+                           VLC_THREAD_PRIORITY_LOW ) == 0 );
+        for( unsigned i = 0; i < n; i++ )
+            assert( vlc_clone( &readers[i], bench_read, p_libvlc,
+                               VLC_THREAD_PRIORITY_LOW ) == 0 );
+        for( unsigned i = 0; i < n; i++ )
+            vlc_join( readers[i], NULL );
+        atomic_store( &bench_stop, true );
+        vlc_join( writer, NULL );
+
+        vlc_tick_t elapsed = vlc_tick_now() - start;
+        test_log( "%u reader(s): %"PRId64" ns per read\n", n,
+                  NS_FROM_VLC_TICK(elapsed) / (2 * BENCH_READS) );
+    }
+
+    var_Destroy( p_libvlc, "bench-flag" );
+    var_Destroy( p_libvlc, "bench-counter" );
+}
+
 static void test_variables( libvlc_instance_t *p_vlc )
 {
     libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
@@ -481,6 +638,15 @@ static void test_variables( libvlc_instance_t *p_vlc )
 
     test_log( "Testing type at creation\n" );
     test_creation_and_type( p_libvlc );
+
+    test_log( "Testing re-creation with another type\n" );
+    test_recreation( p_libvlc );
+
+    test_log( "Testing re-creation against concurrent reads\n" );
+    test_recreation_race( p_libvlc );
+
+    test_log( "Testing contended reads\n" );
+    test_contended_reads( p_libvlc );
 }
 
 